@@ -293,7 +293,7 @@ int handle_analyze(int argc, const char** argv) {
             cerr << "==========================================" << endl;
             cerr << "Error. Log before the error:" << endl << "..." << endl;
             shared_ptr<const char> p(pilot_get_last_log_lines(3), [](const char*p){ pilot_free((void*)p);});
-            cerr << *p;
+            cerr << p.get();
             cerr.flush();
             fatal_log << format("I/O error (%1%): %2%") % errno % strerror(errno);
             return errno;
@@ -54,18 +54,26 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/format.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cerrno>
+#include <chrono>
 #include <common.h>
 #include <config.h>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <pilot/libpilot.h>
+#include <poll.h>
 #include <sstream>
 #include <stdexcept>
+#include <unistd.h>
 #include <vector>
 
 #define GREETING_MSG "Pilot " stringify(PILOT_VERSION_MAJOR) "." \
     stringify(PILOT_VERSION_MINOR) " (compiled by " CC_VERSION " on " __DATE__ ")"
 
 int handle_analyze(int argc, const char** argv);
+int handle_run_plugin(int argc, const char** argv);
 int handle_run_program(int argc, const char** argv);
 int handle_detect_changepoint_edm(int argc, const char** argv);
 
@@ -83,7 +91,7 @@ inline std::string get_timestamp(void) {
 }
 
 template <typename ResultType>
-std::vector<ResultType> extract_csv_fields(const std::string &csvstr,
+std::vector<ResultType> extract_csv_fields(const boost::string_ref csvstr,
                                            const std::vector<int> &columns) {
     using namespace std;
     using namespace boost;
@@ -101,6 +109,209 @@ std::vector<ResultType> extract_csv_fields(const std::string &csvstr,
     return r;
 }
 
+/**
+ * \brief Splits the data read from a file descriptor into lines
+ * \details Data are read with read() into a buffer that grows as needed,
+ * and lines are found with memchr(), so reading a line takes time linear to
+ * its length no matter how long it is. The returned lines point into the
+ * buffer without being copied.
+ */
+class line_reader_t {
+public:
+    enum status_t {
+        LINE,           //! a line is read
+        END_OF_FILE,    //! no more lines, line holds the data after the last '\n', which may be empty
+        TIMED_OUT,      //! the timeout expired before a whole line was read
+    };
+
+    explicit line_reader_t(int fd = -1) : fd_(fd), buf_(kInitBufSize), begin_(0), scanned_(0), end_(0) {}
+
+    /**
+     * \brief Start reading from another file descriptor and drop the buffered data
+     */
+    void reset(int fd) {
+        fd_ = fd;
+        begin_ = scanned_ = end_ = 0;
+    }
+
+    int fd(void) const { return fd_; }
+
+    /**
+     * \brief Read the next line
+     * @param[out] line the line without the trailing '\n'. It is only valid
+     * until the next call.
+     * @param timeout_ms the time limit in milliseconds, or -1 for no limit
+     * @return the status
+     */
+    status_t read_line(boost::string_ref *line, int timeout_ms = -1) {
+        using namespace std::chrono;
+        const steady_clock::time_point deadline = steady_clock::now() + milliseconds(timeout_ms);
+        for (;;) {
+            const char *nl = static_cast<const char*>(memchr(buf_.data() + scanned_, '\n', end_ - scanned_));
+            if (nl) {
+                const size_t len = nl - (buf_.data() + begin_);
+                *line = boost::string_ref(buf_.data() + begin_, len);
+                begin_ += len + 1;
+                scanned_ = begin_;
+                return LINE;
+            }
+            scanned_ = end_;
+            if (timeout_ms >= 0) {
+                int left = static_cast<int>(duration_cast<milliseconds>(deadline - steady_clock::now()).count());
+                struct pollfd pfd = {fd_, POLLIN, 0};
+                int res = poll(&pfd, 1, std::max(left, 0));
+                if (res < 0 && EINTR != errno) {
+                    throw std::runtime_error(std::string("poll() failed: ") + strerror(errno));
+                }
+                if (0 == res) return TIMED_OUT;
+                if (res < 0) continue;
+            }
+            make_room();
+            ssize_t n = read(fd_, &buf_[end_], buf_.size() - end_);
+            if (n < 0) {
+                if (EINTR == errno) continue;
+                throw std::runtime_error(std::string("read() failed: ") + strerror(errno));
+            }
+            if (0 == n) {
+                *line = boost::string_ref(buf_.data() + begin_, end_ - begin_);
+                begin_ = scanned_ = end_ = 0;
+                return END_OF_FILE;
+            }
+            end_ += n;
+        }
+    }
+
+private:
+    static const size_t kInitBufSize = 4096;
+    static const size_t kMinReadSize = 1024;
+
+    // Move the pending data to the front of the buffer, and grow the buffer
+    // if that still leaves too little room to read into
+    void make_room(void) {
+        if (buf_.size() - end_ >= kMinReadSize) return;
+        if (begin_ != 0) {
+            memmove(&buf_[0], &buf_[begin_], end_ - begin_);
+            end_ -= begin_;
+            scanned_ -= begin_;
+            begin_ = 0;
+        }
+        if (buf_.size() - end_ < kMinReadSize) {
+            buf_.resize(buf_.size() * 2);
+        }
+    }
+
+    int fd_;
+    std::vector<char> buf_;
+    size_t begin_;      //! the beginning of the pending data
+    size_t scanned_;    //! data between begin_ and scanned_ have no '\n'
+    size_t end_;        //! the end of the data in buf_
+};
+
+/**
+ * \brief Parse one column of a text file of unit readings
+ * \details A field separator is a comma with optional whitespace around it,
+ * or a run of whitespace, so both CSV files and fio-style logs ("123, 456, 0,
+ * 4096") can be read. Empty lines are skipped, and so is the first line if its
+ * field is not a number (a header). The fields are parsed in place without
+ * allocating memory for each line.
+ * @param begin the beginning of the data
+ * @param end the end of the data
+ * @param column the column (0-based) to parse
+ * @param[out] out the unit readings are appended to it
+ * @return the number of unit readings appended
+ */
+inline size_t parse_unit_readings(const char *begin, const char *end, size_t column,
+                                  std::vector<double> *out) {
+    auto is_space = [](char c) { return ' ' == c || '\t' == c || '\r' == c; };
+    const size_t old_size = out->size();
+    bool first_line = true;
+    size_t line_no = 0;
+    for (const char *p = begin; p < end; ) {
+        const char *eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+        ++line_no;
+        const char *f = p;
+        p = eol + 1;
+        while (f < eol && is_space(*f)) ++f;
+        if (f == eol) continue;     // empty line
+
+        // move to the beginning of the column
+        const char *fend = f;
+        bool found = false;
+        for (size_t col = 0; ; ++col) {
+            fend = f;
+            while (fend < eol && ',' != *fend && !is_space(*fend)) ++fend;
+            if (col == column) {
+                found = true;
+                break;
+            }
+            if (fend == eol) break;
+            f = fend;
+            while (f < eol && is_space(*f)) ++f;
+            if (f < eol && ',' == *f) {
+                ++f;
+                while (f < eol && is_space(*f)) ++f;
+            }
+        }
+
+        // the field is copied so that strtod() never reads past end
+        char buf[64];
+        const size_t len = fend - f;
+        double v = 0;
+        bool ok = false;
+        if (found && len > 0 && len < sizeof(buf)) {
+            memcpy(buf, f, len);
+            buf[len] = '\0';
+            char *num_end;
+            v = strtod(buf, &num_end);
+            ok = (num_end == buf + len);
+        }
+        if (!ok) {
+            if (first_line) {
+                first_line = false;
+                continue;
+            }
+            throw std::runtime_error(str(boost::format("Cannot parse column %1% of line %2%") % column % line_no));
+        }
+        first_line = false;
+        out->push_back(v);
+    }
+    return out->size() - old_size;
+}
+
+/**
+ * \brief Sum the values of a key in a cgroup v2 stat file
+ * \details Both flat keyed files with "key value" lines (like cpu.stat) and
+ * nested keyed files with "name key=value ..." lines (like io.stat and the PSI
+ * files) can be read. The values of the key on all lines are summed, which
+ * adds up the devices in io.stat.
+ * @param content the content of the file
+ * @param line_key only the lines that start with line_key are used, or all
+ * lines if it is empty
+ * @param key the key of the values
+ * @return the sum, or 0 if the key is not found
+ */
+inline double sum_cgroup_stat(const std::string &content, const std::string &line_key, const std::string &key) {
+    std::istringstream in(content);
+    std::string line, field;
+    double sum = 0;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        if (!(fields >> field)) continue;
+        if (!line_key.empty() && field != line_key) continue;
+        if (field == key) {
+            double v;
+            if (fields >> v) sum += v;
+            continue;
+        }
+        while (fields >> field) {
+            if (field.size() > key.size() && '=' == field[key.size()] && 0 == field.compare(0, key.size(), key))
+                sum += strtod(field.c_str() + key.size() + 1, NULL);
+        }
+    }
+    return sum;
+}
+
 inline void print_read_the_doc_info(void) {
     std::cerr << "To understand the math behind Pilot or read tutorials, please read the" << std::endl;
     std::cerr << "documentation at https://docs.ascar.io/" << std::endl;
@@ -70,6 +70,7 @@ void print_help_msg(const char* argv0) {
 #endif
     cerr << "Available commands:" << endl;
     cerr << "  analyze                 analyze existing data" << endl;
+    cerr << "  run_plugin              run the workload function of a shared object in-process" << endl;
     cerr << "  run_program             run a benchmark program" << endl;
     cerr << "  detect_changepoint_edm  use EDM method to detect changepoints from an input file" << endl;
     cerr << "Add --help after any command to see command specific help." << endl << endl;
@@ -100,6 +101,8 @@ int main(int argc, const char** argv) {
         return 2;
     } else if ("analyze" == cmd) {
         return handle_analyze(argc, argv);
+    } else if ("run_plugin" == cmd) {
+        return handle_run_plugin(argc, argv);
     } else if ("run_program" == cmd) {
         return handle_run_program(argc, argv);
     } else if ("detect_changepoint_edm" == cmd) {
@@ -1,8 +1,11 @@
 /*
- * Implementation of the run_program command of Pilot CLI
+ * Implementation of the run_program and run_plugin commands of Pilot CLI
  *
  * We provide a workload_func() for Pilot to execute. workload_func() implements the running of
- * the target program and extracting Readings (we don't support unit readings for run_program yet).
+ * the target program and extracting Readings, and optionally Unit Readings from a binary stream.
+ * With --instances several copies of the target program run in each round.
+ * With --cgroup each target program runs in its own cgroup v2 for isolation and accounting.
+ * run_plugin instead calls the workload function of a shared object in-process.
  *
  * Copyright (c) 2017-2019 Yan Li <yanli@tuneup.ai>. All rights reserved.
  * The Pilot tool and library is free software; you can redistribute it
@@ -52,20 +55,37 @@
  */
 
 #include <boost/algorithm/string.hpp>
+#include <boost/endian/conversion.hpp>
 #include <boost/exception/diagnostic_information.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/program_options.hpp>
 #include <boost/timer/timer.hpp>
+#include <chrono>
+#include <cmath>
 #include <common.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <linux/sched.h>  // for clone_args
 #include <memory>
 #include "pilot-cli.h"
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
 #include <signal.h>
+#include <spawn.h>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <sys/mman.h>    // for mmap()
+#include <sys/resource.h>  // for wait4()
+#include <sys/stat.h>
+#include <sys/syscall.h>  // for SYS_clone3
 #include <sys/types.h>   // for kill()
 #include <sys/wait.h>    // for waitpid()
 #include <signal.h>      // for kill()
@@ -82,133 +102,950 @@ using namespace boost::filesystem;
 using namespace std;
 using namespace pilot;
 
-static const char**   g_client_cmd;
-static size_t         g_client_cmd_len;
-static string         g_client_name;
-static int            g_client_pid = 0;
-static FILE*          g_client_out_fs = NULL;
+/**
+ * \brief The resource usage of the client program that --resource-pi can add
+ * as PIs
+ */
+enum resource_t {
+    RES_UTIME, RES_STIME, RES_MAXRSS, RES_MINFLT, RES_MAJFLT, RES_NVCSW, RES_NIVCSW,
+    RES_RCHAR, RES_WCHAR, RES_READ_BYTES, RES_WRITE_BYTES, NUM_OF_RESOURCES
+};
+static const struct {
+    const char *name;
+    const char *unit;
+} kResources[NUM_OF_RESOURCES] = {
+    {"utime", "s"}, {"stime", "s"}, {"maxrss", "KB"}, {"minflt", "faults"}, {"majflt", "faults"},
+    {"nvcsw", "switches"}, {"nivcsw", "switches"},
+    // from /proc/PID/io
+    {"rchar", "bytes"}, {"wchar", "bytes"}, {"read_bytes", "bytes"}, {"write_bytes", "bytes"},
+};
+
+/**
+ * \brief The statistics of the cgroup of --cgroup that --cgroup-pi can add as
+ * PIs
+ */
+enum cgroup_stat_t {
+    CG_CPU_USAGE, CG_CPU_USER, CG_CPU_SYSTEM, CG_CPU_THROTTLED, CG_MEMORY_PEAK, CG_IO_RBYTES, CG_IO_WBYTES,
+    CG_CPU_PRESSURE, CG_MEMORY_PRESSURE, CG_IO_PRESSURE, NUM_OF_CGROUP_STATS
+};
+static const struct {
+    const char *name;
+    const char *unit;
+} kCgroupStats[NUM_OF_CGROUP_STATS] = {
+    {"cpu.usage", "s"}, {"cpu.user", "s"}, {"cpu.system", "s"}, {"cpu.throttled", "s"},
+    {"memory.peak", "bytes"}, {"io.rbytes", "bytes"}, {"io.wbytes", "bytes"},
+    // the time that some tasks stalled, from the PSI files
+    {"cpu.pressure", "s"}, {"memory.pressure", "s"}, {"io.pressure", "s"},
+};
+
+/**
+ * \brief The state of a client program
+ */
+struct client_program_t {
+    const char**      cmd;
+    size_t            cmd_len;
+    string            name;
+    int               pid = 0;
+    int               in_fd = -1;       //! the stdin of the running client program in --coprocess mode
+    line_reader_t     out;              //! reads the stdout of the running client program
+    int               ur_fd = -1;       //! the unit readings stream of the running client program
+    size_t            num_of_urs = 0;   //! number of unit readings of each PI in the last round
+    uint64_t          ur_header = 0;    //! N of the unit readings record being read
+    size_t            ur_got = 0;       //! bytes of the unit readings record read so far
+    vector<double>    urs;              //! unit readings of the last round, PI after PI
+    chrono::steady_clock::time_point started_at;  //! when the running client program was started
+    chrono::steady_clock::time_point line_at;     //! when the output of the last round was received
+    string            line;             //! the output line kept while waiting for the client to exit
+    double            resources[NUM_OF_RESOURCES] = {};  //! resource usage of the last exited client program
+    string            output_dir;
+    string            round_results_dir;
+    vector<pair<string, string> > params;   //! values of %PARAM:name% macros
+    size_t            instance = 0;     //! value of the %INSTANCE% macro
+    bool              has_cpuset = false;
+    cpu_set_t         cpuset;           //! the CPUs the client program runs on if has_cpuset
+    string            cgroup_dir;       //! the cgroup of the client program, empty if not used
+    int               cgroup_peak_fd = -1;  //! memory.peak of the cgroup, reset before each round
+    int               cgroup_fd = -1;   //! the directory of the cgroup, for starting the client in it
+    //! the statistics of the cgroup at the start of the round, then their changes during the round
+    double            cgroup_stats[NUM_OF_CGROUP_STATS] = {};
+};
+
+/**
+ * \brief A file of unit readings written by the client program in each round
+ */
+struct ur_file_t {
+    string            pattern;          //! file name pattern in the round results directory
+    size_t            column;           //! column of the unit readings in a text file
+    bool              binary;           //! the file is an array of little-endian float64
+};
+
+//! The state of reading the unit readings record of a round
+enum ur_status_t {
+    UR_PARTIAL,         //! part of the record is read
+    UR_RECORD,          //! the whole record is read
+    UR_END,             //! the stream ends before the record starts
+};
+
+// The functions that a workload plugin of run_plugin can export, in addition
+// to the required pilot_workload_func_t pilot_plugin_workload()
+typedef int plugin_init_func_t(int argc, const char **argv, void **data);
+typedef int plugin_setup_round_func_t(size_t round, size_t work_amount, void *data);
+typedef void plugin_fini_func_t(void *data);
+
+/**
+ * \brief A workload plugin loaded by run_plugin
+ */
+struct plugin_t {
+    void*                       handle = nullptr;
+    pilot_workload_func_t*      workload_func = nullptr;
+    plugin_setup_round_func_t*  setup_round = nullptr;   //! optional, called before each round
+    plugin_fini_func_t*         fini = nullptr;          //! optional
+    void*                       data = nullptr;          //! set by the optional pilot_plugin_init()
+};
+
+// One client for each workload: g_clients[0] for g_wl, and g_clients[i + 1]
+// for g_other_wls[i]
+static vector<client_program_t> g_clients;
 static size_t         g_duration_col = (size_t)-1; // column of the round duration
 static int            g_num_of_pi = 0;
 static vector<int>    g_pi_col;          // column of each PI in client program's output
+static vector<resource_t> g_resource_pis;  // resource usage PIs, which follow the PIs in g_pi_col
+static vector<cgroup_stat_t> g_cgroup_pis;  // cgroup PIs, which follow the resource usage PIs
+static double         g_max_pressure = 0;  // reject rounds that stalled longer than this percent, 0 means never
+static string         g_cgroup_parent;   // the cgroup under which the cgroups of --cgroup are created
+static string         g_self_cgroup_dir;  // the leaf cgroup that Pilot has moved itself into for --cgroup
+static bool           g_cgroup_required = false;  // the clients must start in their cgroups, for --cgroup-limit and --max-pressure
+static bool           g_clone_into_cgroup = true;  // start the clients in their cgroups with clone3()
+static vector<string> g_enabled_controllers;  // the controllers that Pilot has enabled for --cgroup
 static string         g_output_dir;
-static string         g_round_results_dir;
 static bool           g_quiet = false;
 static vector<int>    g_valid_rc;
 static bool           g_verbose = false;
+static bool           g_coprocess = false;  // keep the client programs running and send them requests
+static bool           g_include_spawn_time = false;  // count the starting of clients in round durations
+static int            g_round_timeout = 0;   // in seconds, 0 means no timeout
+static size_t         g_round_retries = 0;   // number of retries of a timed-out round
+static bool           g_unit_readings = false;  // read unit readings from the UR stream of the clients
+static vector<ur_file_t> g_ur_files;     // the unit readings file of each PI
+static plugin_t       g_plugin;          // the workload plugin of run_plugin
+// the copies of g_clients[0] that run at the same time with --instances
+static vector<client_program_t> g_instances;
+static vector<bool>   g_pi_sum;          // sum (instead of average) the readings of the instances for each PI
+// the fd of the unit readings stream in the client program
+static const int      UR_STREAM_FD = 3;
+// more unit readings of a PI in a round than this means a corrupt record
+static const uint64_t MAX_UNIT_READINGS = 1ULL << 32;
 static shared_ptr<pilot_workload_t> g_wl;
-static string         g_prog_stdout;
+// variant B in --compare mode, or the other parameter values in --param mode
+static vector<shared_ptr<pilot_workload_t> > g_other_wls;
+
+/**
+ * \brief Thrown when a round does not finish within --round-timeout
+ */
+class round_timeout_error : public runtime_error {
+public:
+    explicit round_timeout_error(const string &what) : runtime_error(what) {}
+};
+
+typedef chrono::steady_clock::time_point deadline_t;
+
+/**
+ * \brief The milliseconds left before the deadline of the round
+ * @return -1 if --round-timeout is not set
+ */
+static int _ms_left(const deadline_t &deadline) {
+    if (0 == g_round_timeout) return -1;
+    auto left = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+    return left > 0 ? static_cast<int>(left) : 0;
+}
 
 void sigint_handler(int dummy) {
     if (g_wl)
         pilot_stop_workload(g_wl.get());
+    for (auto &wl : g_other_wls)
+        pilot_stop_workload(wl.get());
+}
+
+/**
+ * \brief Call a pilot_set_*() function on the workload, and also on the
+ * other workloads in --compare and --param modes
+ */
+template <typename F, typename... Args>
+static void set_all_workloads(F func, Args... args) {
+    func(g_wl.get(), args...);
+    for (auto &wl : g_other_wls)
+        func(wl.get(), args...);
+}
+
+/**
+ * \brief Start a child process with posix_spawnp()
+ * @param pid[out] the PID of the child process
+ * @param ur_fd the fd of the unit readings stream, or -1
+ * @return 0 on success, or an error number
+ */
+static int _spawn(pid_t *pid, char * const*command, int stdin_fd, int stdout_fd, int ur_fd,
+                  const cpu_set_t *cpuset) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, stdin_fd, STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, stdout_fd, STDOUT_FILENO);
+    // done last so that it can't be overwritten by the other fds
+    if (ur_fd >= 0)
+        posix_spawn_file_actions_adddup2(&actions, ur_fd, UR_STREAM_FD);
+    // With --round-timeout the client gets its own process group so that the
+    // watchdog can kill it together with its children
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    short flags = POSIX_SPAWN_SETSIGDEF;
+    if (g_round_timeout > 0) {
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attr, 0);
+    }
+    // ignored signals stay ignored across exec, so SIGPIPE, which we ignore
+    // in --coprocess mode, is reset for the client
+    sigset_t default_signals;
+    sigemptyset(&default_signals);
+    sigaddset(&default_signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &default_signals);
+    posix_spawnattr_setflags(&attr, flags);
+    // posix_spawn() has no attribute for the CPU affinity, so the child
+    // inherits it from the calling thread
+    cpu_set_t old_cpuset;
+    if (cpuset) {
+        pthread_getaffinity_np(pthread_self(), sizeof(old_cpuset), &old_cpuset);
+        int res = pthread_setaffinity_np(pthread_self(), sizeof(*cpuset), cpuset);
+        if (0 != res) {
+            warning_log << "Cannot set the CPU set of " << command[0] << ": " << strerror(res);
+        }
+    }
+    int rc = posix_spawnp(pid, command[0], &actions, &attr, command, environ);
+    if (cpuset)
+        pthread_setaffinity_np(pthread_self(), sizeof(old_cpuset), &old_cpuset);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    return rc;
+}
+
+/**
+ * \brief Start a child process directly in a cgroup with clone3()
+ * \details CLONE_INTO_CGROUP puts the child in the cgroup before it runs, so
+ * none of its processes can escape the cgroup. clone3() without CLONE_VM is a
+ * fork(), so the child only makes async-signal-safe calls before exec, and
+ * reports a failure of exec through a close-on-exec pipe like posix_spawn().
+ * @param pid[out] the PID of the child process
+ * @param ur_fd the fd of the unit readings stream, or -1
+ * @return 0 on success, or an error number, which is ENOSYS if clone3() or
+ * CLONE_INTO_CGROUP is not supported
+ */
+static int _clone_into_cgroup(pid_t *pid, char * const*command, int cgroup_fd, int stdin_fd, int stdout_fd,
+                              int ur_fd, const cpu_set_t *cpuset) {
+#if defined(SYS_clone3) && defined(CLONE_INTO_CGROUP)
+    int err_pipe[2];
+    if (pipe2(err_pipe, O_CLOEXEC) != 0)
+        return errno;
+    struct clone_args args;
+    memset(&args, 0, sizeof(args));
+    args.flags = CLONE_INTO_CGROUP;
+    args.exit_signal = SIGCHLD;
+    args.cgroup = cgroup_fd;
+    long res = syscall(SYS_clone3, &args, sizeof(args));
+    if (0 == res) {
+        close(err_pipe[0]);
+        if (dup2(stdin_fd, STDIN_FILENO) >= 0 && dup2(stdout_fd, STDOUT_FILENO) >= 0 &&
+            (ur_fd < 0 || dup2(ur_fd, UR_STREAM_FD) >= 0) &&
+            (g_round_timeout <= 0 || setpgid(0, 0) == 0) &&
+            (!cpuset || sched_setaffinity(0, sizeof(*cpuset), cpuset) == 0) &&
+            signal(SIGPIPE, SIG_DFL) != SIG_ERR) {
+            execvp(command[0], command);
+        }
+        int err = errno;
+        if (write(err_pipe[1], &err, sizeof(err)) < 0) {}
+        _exit(127);
+    }
+    int err = res < 0 ? errno : 0;
+    close(err_pipe[1]);
+    if (res > 0) {
+        ssize_t n;
+        while ((n = read(err_pipe[0], &err, sizeof(err))) < 0 && EINTR == errno) {}
+        if (sizeof(err) == n) {
+            waitpid(res, NULL, 0);
+        } else {
+            err = 0;
+            *pid = static_cast<pid_t>(res);
+        }
+    }
+    close(err_pipe[0]);
+    // Linux before 5.7 doesn't know the cgroup field and returns E2BIG
+    return E2BIG == err && res < 0 ? ENOSYS : err;
+#else
+    return ENOSYS;
+#endif
 }
 
 /**
  * \brief Our own version of popen that returns the PID of the child process
+ * \details The child is started by posix_spawnp(), which has vfork semantics,
+ * so starting it is fast no matter how much memory Pilot is using. A child
+ * with a cgroup is started in it by _clone_into_cgroup() instead, unless that
+ * is not supported and the cgroup is only used for accounting.
  * @param command[in] the command to run
- * @param infp[out] the new fd for stdin
- * @param outfp[out] the new fd for stdout of the child process
+ * @param infd[out] the new fd for stdin
+ * @param outfd[out] the new fd for stdout of the child process
+ * @param urfd[out] (optional) the new fd for reading the unit readings stream,
+ * which the child process writes to UR_STREAM_FD
+ * @param cpuset[in] (optional) the CPUs the child process runs on
+ * @param cgroup_fd[in] (optional) the directory of the cgroup of the child
+ * process
  * @return
  */
-static pid_t popen2(char * const*command, FILE **infp, FILE **outfp)
+static pid_t popen2(char * const*command, int *infd, int *outfd, int *urfd = NULL,
+                    const cpu_set_t *cpuset = NULL, int cgroup_fd = -1)
 {
     const int READ = 0, WRITE = 1;
-    int p_stdin[2], p_stdout[2];
+    int p_stdin[2], p_stdout[2], p_ur[2] = {-1, -1};
     pid_t pid;
 
-    if (pipe(p_stdin) != 0 || pipe(p_stdout) != 0)
+    // All our fds are close-on-exec so that the child and other client
+    // programs only get the ones that are dup2()ed below. In particular, other
+    // clients must not inherit our ends of the pipes, or this client would
+    // never see EOF on its stdin.
+    if (pipe2(p_stdin, O_CLOEXEC) != 0 || pipe2(p_stdout, O_CLOEXEC) != 0 ||
+        (urfd && pipe2(p_ur, O_CLOEXEC) != 0))
         throw runtime_error("Failed to create pipes");
+    if (urfd && UR_STREAM_FD == p_ur[WRITE]) {
+        // dup2() to the same fd would not clear its close-on-exec flag
+        int fd = fcntl(p_ur[WRITE], F_DUPFD_CLOEXEC, UR_STREAM_FD + 1);
+        close(p_ur[WRITE]);
+        p_ur[WRITE] = fd;
+    }
 
-    pid = fork();
+    int rc = ENOSYS;
+    if (cgroup_fd >= 0 && g_clone_into_cgroup) {
+        rc = _clone_into_cgroup(&pid, command, cgroup_fd, p_stdin[READ], p_stdout[WRITE],
+                                urfd ? p_ur[WRITE] : -1, cpuset);
+        if (ENOSYS == rc && !g_cgroup_required) {
+            warning_log << "Cannot start the programs in their cgroups, so they are moved into them right after they start";
+            g_clone_into_cgroup = false;
+        }
+    }
+    if (cgroup_fd < 0 || !g_clone_into_cgroup)
+        rc = _spawn(&pid, command, p_stdin[READ], p_stdout[WRITE], urfd ? p_ur[WRITE] : -1, cpuset);
 
-    if (pid < 0)
-        throw runtime_error("Fork failed");
-    else if (pid == 0)    /* Child */
-    {
-        dup2(p_stdin[READ], READ);
+    close(p_stdin[READ]);
+    close(p_stdout[WRITE]);
+    if (urfd)
+        close(p_ur[WRITE]);
+    if (0 != rc) {
         close(p_stdin[WRITE]);
-        close(p_stdin[READ]);
-        dup2(p_stdout[WRITE], WRITE);
         close(p_stdout[READ]);
-        close(p_stdout[WRITE]);
-        execvp(*command, command);
-        perror("execvp");
-        exit(1);
+        if (urfd)
+            close(p_ur[READ]);
+        if (cgroup_fd >= 0 && ENOSYS == rc) {
+            throw runtime_error(str(format("Cannot start %1% in its cgroup, which --cgroup-limit and --max-pressure need: %2%")
+                                    % command[0] % strerror(rc)));
+        }
+        throw runtime_error(str(format("Cannot start %1%: %2%") % command[0] % strerror(rc)));
     }
-    close(p_stdin[READ]);
-    close(p_stdout[WRITE]);
 
-    if (infp == NULL)
+    if (infd == NULL)
         close(p_stdin[WRITE]);
     else
-        *infp = fdopen(p_stdin[WRITE], "w");
+        *infd = p_stdin[WRITE];
 
-    if (outfp == NULL)
+    if (outfd == NULL)
         close(p_stdout[READ]);
     else
-        *outfp = fdopen(p_stdout[READ], "r");
+        *outfd = p_stdout[READ];
+
+    if (urfd)
+        *urfd = p_ur[READ];
 
     return pid;
 }
 
-static int pclose2(pid_t pid) {
+/**
+ * \brief Read the I/O counters of a process from /proc/PID/io
+ */
+static void _read_proc_io(pid_t pid, double *resources) {
+    std::ifstream f(str(format("/proc/%1%/io") % pid));
+    string name;
+    uint64_t value;
+    while (f >> name >> value) {
+        for (int r = RES_RCHAR; r <= RES_WRITE_BYTES; ++r) {
+            if (name.size() == strlen(kResources[r].name) + 1 &&
+                0 == name.compare(0, name.size() - 1, kResources[r].name))
+                resources[r] = value;
+        }
+    }
+    if (!f.eof()) {
+        warning_log << "Cannot read /proc/" << pid << "/io, I/O counters are set to 0";
+    }
+}
+
+/**
+ * \brief Wait for the child process to exit
+ * @param pid the PID of the child process
+ * @param[out] resources (optional) the resource usage of the child process,
+ * indexed by resource_t
+ * @return the exit code of the child process
+ */
+static int pclose2(pid_t pid, double *resources = NULL) {
     int internal_stat;
-    waitpid(pid, &internal_stat, 0);
+    if (!resources) {
+        waitpid(pid, &internal_stat, 0);
+        return WEXITSTATUS(internal_stat);
+    }
+    // /proc/PID/io is only available before the child is reaped
+    siginfo_t info;
+    waitid(P_PID, pid, &info, WEXITED | WNOWAIT);
+    fill(resources, resources + NUM_OF_RESOURCES, 0);
+    _read_proc_io(pid, resources);
+    struct rusage ru;
+    wait4(pid, &internal_stat, 0, &ru);
+    resources[RES_UTIME] = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6;
+    resources[RES_STIME] = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+    resources[RES_MAXRSS] = ru.ru_maxrss;
+    resources[RES_MINFLT] = ru.ru_minflt;
+    resources[RES_MAJFLT] = ru.ru_majflt;
+    resources[RES_NVCSW] = ru.ru_nvcsw;
+    resources[RES_NIVCSW] = ru.ru_nivcsw;
     return WEXITSTATUS(internal_stat);
 }
 
+static bool _write_all(int fd, const string &s) {
+    size_t written = 0;
+    while (written < s.size()) {
+        ssize_t n = write(fd, s.data() + written, s.size() - written);
+        if (n < 0) {
+            if (EINTR == errno) continue;
+            return false;
+        }
+        written += n;
+    }
+    return true;
+}
+
+static void _little_to_native(double *data, size_t n) {
+    if (boost::endian::order::native == boost::endian::order::little) return;
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t v;
+        memcpy(&v, data + i, sizeof(v));
+        boost::endian::little_to_native_inplace(v);
+        memcpy(data + i, &v, sizeof(v));
+    }
+}
+
+/**
+ * \brief Read what is available of the unit readings record of a round
+ * \details The record of a round is the number of unit readings N as a
+ * little-endian uint64, followed by N little-endian float64 unit readings of
+ * PI 0, N of PI 1, and so on. The record is read in pieces as it comes so
+ * that the stdout of the client can be read at the same time. Only one read()
+ * is done, which does not block when poll() says the stream is readable.
+ * @return UR_PARTIAL if the record is not complete yet, UR_RECORD when it is,
+ * or UR_END if the stream ends before the record starts
+ */
+static ur_status_t _read_unit_readings(client_program_t *client) {
+    const size_t header_size = sizeof(client->ur_header);
+    char *dest;
+    size_t size;
+    if (client->ur_got < header_size) {
+        dest = reinterpret_cast<char*>(&client->ur_header) + client->ur_got;
+        size = header_size - client->ur_got;
+    } else {
+        const size_t got = client->ur_got - header_size;
+        if (got == sizeof(double) * client->urs.size()) {
+            // The buffer grows with the data, so that a corrupt N can't make
+            // us allocate more than the client has sent
+            const size_t total = client->ur_header * g_num_of_pi;
+            try {
+                client->urs.resize(min(total, max<size_t>(2 * client->urs.size(), 65536)));
+            } catch (const bad_alloc &) {
+                throw runtime_error(str(format("Not enough memory for %1% unit readings") % client->ur_header));
+            }
+        }
+        dest = reinterpret_cast<char*>(client->urs.data()) + got;
+        size = sizeof(double) * client->urs.size() - got;
+    }
+    ssize_t n = read(client->ur_fd, dest, size);
+    if (n < 0) {
+        if (EINTR == errno) return UR_PARTIAL;
+        throw runtime_error(str(format("Cannot read unit readings: %1%") % strerror(errno)));
+    }
+    if (0 == n) {
+        if (0 == client->ur_got) return UR_END;
+        throw runtime_error("Incomplete unit readings record from the client program");
+    }
+    client->ur_got += n;
+    if (client->ur_got == header_size) {
+        client->ur_header = boost::endian::little_to_native(client->ur_header);
+        if (client->ur_header > MAX_UNIT_READINGS)
+            throw runtime_error(str(format("Invalid number of unit readings from the client program: %1%") % client->ur_header));
+        client->urs.clear();
+    }
+    if (client->ur_got < header_size || client->ur_got < header_size + sizeof(double) * client->ur_header * g_num_of_pi)
+        return UR_PARTIAL;
+    _little_to_native(client->urs.data(), client->urs.size());
+    client->num_of_urs = client->ur_header;
+    client->ur_got = 0;
+    return UR_RECORD;
+}
+
+/**
+ * \brief Append the unit readings in a file to urs
+ * \details The file is mapped into memory and parsed in place.
+ * @return the number of unit readings appended
+ */
+static size_t _read_unit_readings_file(const string &path, const ur_file_t &ur_file, vector<double> *urs) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw runtime_error(str(format("Cannot open %1%: %2%") % path % strerror(errno)));
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw runtime_error(str(format("Cannot stat %1%: %2%") % path % strerror(errno)));
+    }
+    const size_t size = st.st_size;
+    if (0 == size) {
+        close(fd);
+        return 0;
+    }
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == data)
+        throw runtime_error(str(format("Cannot mmap %1%: %2%") % path % strerror(errno)));
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    size_t n = 0;
+    try {
+        if (ur_file.binary) {
+            if (0 != size % sizeof(double))
+                throw runtime_error(str(format("The size of %1% is not a multiple of 8") % path));
+            n = size / sizeof(double);
+            urs->resize(urs->size() + n);
+            memcpy(urs->data() + urs->size() - n, data, size);
+            _little_to_native(urs->data() + urs->size() - n, n);
+        } else {
+            const char *p = static_cast<const char*>(data);
+            n = parse_unit_readings(p, p + size, ur_file.column, urs);
+        }
+    } catch (const runtime_error &e) {
+        munmap(data, size);
+        throw runtime_error(path + ": " + e.what());
+    }
+    munmap(data, size);
+    return n;
+}
+
+/**
+ * \brief Read the unit readings of a round from the files set by --ur-file
+ * \details The files of a PI are all files in the round results directory
+ * that match its pattern, read in the order of their names.
+ */
+static void _read_unit_readings_files(client_program_t *client, const string &round_dir) {
+    client->urs.clear();
+    client->num_of_urs = 0;
+    vector<string> files;
+    for (size_t piid = 0; piid < g_ur_files.size(); ++piid) {
+        files.clear();
+        for (directory_iterator it(round_dir); it != directory_iterator(); ++it) {
+            if (is_regular_file(it->status()) &&
+                0 == fnmatch(g_ur_files[piid].pattern.c_str(), it->path().filename().c_str(), 0))
+                files.push_back(it->path().string());
+        }
+        sort(files.begin(), files.end());
+        size_t n = 0;
+        for (const string &f : files)
+            n += _read_unit_readings_file(f, g_ur_files[piid], &client->urs);
+        if (0 == piid) {
+            client->num_of_urs = n;
+        } else if (n != client->num_of_urs) {
+            throw runtime_error(str(format("PI %1% has %2% unit readings but PI 0 has %3%")
+                                    % piid % n % client->num_of_urs));
+        }
+    }
+}
+
+/**
+ * \brief Close the pipes to the client program and wait for it to exit
+ * @param[out] resources (optional) the resource usage of the client program
+ * @return the exit code of the client program
+ */
+static int _close_client(client_program_t *client, double *resources = NULL) {
+    close(client->out.fd());
+    client->out.reset(-1);
+    if (client->in_fd >= 0) {
+        close(client->in_fd);
+        client->in_fd = -1;
+    }
+    if (client->ur_fd >= 0) {
+        close(client->ur_fd);
+        client->ur_fd = -1;
+    }
+    int rc = pclose2(client->pid, resources);
+    client->pid = 0;
+    return rc;
+}
+
+/**
+ * \brief Kill a client program that did not finish its round in time,
+ * together with its process group
+ */
+static void _kill_client(client_program_t *client) {
+    if (0 == client->pid) return;
+    kill(-client->pid, SIGKILL);
+    _close_client(client);
+}
+
+static bool _read_file(const string &path, string *content) {
+    std::ifstream f(path);
+    if (!f) return false;
+    stringstream ss;
+    ss << f.rdbuf();
+    *content = ss.str();
+    return true;
+}
+
+static bool _write_file(const string &path, const string &content) {
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool res = _write_all(fd, content);
+    int saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return res;
+}
+
+/**
+ * \brief Find the cgroup v2 directory of Pilot itself
+ * @return an empty string if the cgroup v2 hierarchy is not mounted
+ */
+static string _own_cgroup_dir(void) {
+    string mount_dir, path, line;
+    std::ifstream mounts("/proc/self/mounts");
+    while (getline(mounts, line)) {
+        vector<string> fields;
+        boost::split(fields, line, boost::is_any_of(" "));
+        if (fields.size() > 2 && "cgroup2" == fields[2]) {
+            mount_dir = fields[1];
+            break;
+        }
+    }
+    std::ifstream cgroups("/proc/self/cgroup");
+    while (getline(cgroups, line)) {
+        if (0 == line.compare(0, 3, "0::"))
+            path = line.substr(3);
+    }
+    if (mount_dir.empty() || path.empty())
+        return "";
+    return "/" == path ? mount_dir : mount_dir + path;
+}
+
+/**
+ * \brief Move Pilot into a leaf cgroup under its own cgroup
+ * \details cgroup v2 only lets a cgroup enable controllers for its children
+ * when it has no processes of its own, so Pilot moves itself out of the way.
+ * @return false if Pilot cannot be moved
+ */
+static bool _enter_self_cgroup(const string &parent) {
+    const string dir = str(format("%1%/pilot.%2%.self") % parent % getpid());
+    if (mkdir(dir.c_str(), 0755) != 0 && EEXIST != errno) {
+        warning_log << format("Cannot create cgroup %1%: %2%") % dir % strerror(errno);
+        return false;
+    }
+    if (!_write_file(dir + "/cgroup.procs", to_string(getpid()))) {
+        warning_log << format("Cannot move Pilot into cgroup %1%: %2%") % dir % strerror(errno);
+        rmdir(dir.c_str());
+        return false;
+    }
+    g_self_cgroup_dir = dir;
+    return true;
+}
+
+/**
+ * \brief Enable the controllers of the limits for the children of a cgroup
+ * \details A controller that can't be enabled only makes its limits fail
+ * later, so the failures are not errors here.
+ */
+static void _enable_cgroup_controllers(const string &parent) {
+    string controllers, enabled, c;
+    if (!_read_file(parent + "/cgroup.controllers", &controllers)) return;
+    // the controllers that are already enabled are left alone
+    vector<string> already_enabled;
+    if (_read_file(parent + "/cgroup.subtree_control", &enabled))
+        boost::split(already_enabled, enabled, boost::is_any_of(" \n"));
+    istringstream ss(controllers);
+    while (ss >> c) {
+        if ("cpu" != c && "cpuset" != c && "io" != c && "memory" != c) continue;
+        if (find(already_enabled.begin(), already_enabled.end(), c) != already_enabled.end()) continue;
+        if (_write_file(parent + "/cgroup.subtree_control", "+" + c)) {
+            g_enabled_controllers.push_back(c);
+        } else {
+            debug_log << format("Cannot enable the %1% controller in %2%: %3%") % c % parent % strerror(errno);
+        }
+    }
+}
+
+/**
+ * \brief Undo _enable_cgroup_controllers() and _enter_self_cgroup()
+ * \details The cgroups of the client programs must have been removed.
+ */
+static void _restore_parent_cgroup(const string &parent) {
+    // a cgroup with enabled controllers can't take Pilot back
+    for (auto it = g_enabled_controllers.rbegin(); it != g_enabled_controllers.rend(); ++it) {
+        if (!_write_file(parent + "/cgroup.subtree_control", "-" + *it)) {
+            debug_log << format("Cannot disable the %1% controller in %2%: %3%") % *it % parent % strerror(errno);
+        }
+    }
+    g_enabled_controllers.clear();
+    if (g_self_cgroup_dir.empty()) return;
+    if (!_write_file(parent + "/cgroup.procs", to_string(getpid())) || rmdir(g_self_cgroup_dir.c_str()) != 0) {
+        warning_log << format("Cannot remove cgroup %1%: %2%") % g_self_cgroup_dir % strerror(errno);
+    }
+    g_self_cgroup_dir.clear();
+}
+
+/**
+ * \brief Create the cgroup of a client program
+ * @return false if the cgroup cannot be created
+ */
+static bool _create_cgroup(client_program_t *client, const string &dir) {
+    if (mkdir(dir.c_str(), 0755) != 0 && EEXIST != errno) {
+        warning_log << format("Cannot create cgroup %1%: %2%") % dir % strerror(errno);
+        return false;
+    }
+    client->cgroup_dir = dir;
+    client->cgroup_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    // memory.peak can be reset through a writable fd since Linux 6.12
+    client->cgroup_peak_fd = open((dir + "/memory.peak").c_str(), O_RDWR | O_CLOEXEC);
+    if (client->cgroup_peak_fd < 0) {
+        client->cgroup_peak_fd = open((dir + "/memory.peak").c_str(), O_RDONLY | O_CLOEXEC);
+        if (client->cgroup_peak_fd >= 0) {
+            warning_log << "memory.peak cannot be reset on this system, so it is the peak of the whole session";
+        }
+    }
+    info_log << "Running " << client->name << " in cgroup " << dir;
+    return true;
+}
+
+/**
+ * \brief Set the limits of --cgroup-limit in the cgroup of a client program
+ * @return false if a limit cannot be set
+ */
+static bool _set_cgroup_limits(const client_program_t *client, const vector<pair<string, string> > &limits) {
+    for (const auto &limit : limits) {
+        if (!_write_file(client->cgroup_dir + "/" + limit.first, limit.second)) {
+            fatal_log << format("Cannot set %1% of cgroup %2%: %3%") % limit.first % client->cgroup_dir % strerror(errno);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * \brief Remove the cgroup of a client program
+ */
+static void _remove_cgroup(client_program_t *client) {
+    if (client->cgroup_dir.empty()) return;
+    if (client->cgroup_peak_fd >= 0) {
+        close(client->cgroup_peak_fd);
+        client->cgroup_peak_fd = -1;
+    }
+    if (client->cgroup_fd >= 0) {
+        close(client->cgroup_fd);
+        client->cgroup_fd = -1;
+    }
+    // the stopped client programs may take a moment to exit
+    int rc;
+    for (int i = 0; (rc = rmdir(client->cgroup_dir.c_str())) != 0 && EBUSY == errno && i < 10; ++i)
+        usleep(100000);
+    if (0 != rc) {
+        warning_log << format("Cannot remove cgroup %1%: %2%") % client->cgroup_dir % strerror(errno);
+    }
+    client->cgroup_dir.clear();
+}
+
+/**
+ * \brief Remove the cgroups of all client programs and give the parent
+ * cgroup back the way it was
+ */
+static void _remove_cgroups(void) {
+    for (client_program_t &client : g_clients)
+        _remove_cgroup(&client);
+    if (!g_cgroup_parent.empty()) {
+        _restore_parent_cgroup(g_cgroup_parent);
+        g_cgroup_parent.clear();
+    }
+}
+
+/**
+ * \brief Move a client program that has just been started into its cgroup
+ * \details Only needed when the program could not be started in the cgroup,
+ * and then the processes that the program starts before it is moved stay
+ * outside.
+ */
+static void _enter_cgroup(const client_program_t *client) {
+    if (client->cgroup_dir.empty() || (client->cgroup_fd >= 0 && g_clone_into_cgroup)) return;
+    if (!_write_file(client->cgroup_dir + "/cgroup.procs", to_string(client->pid))) {
+        warning_log << format("Cannot move %1% into cgroup %2%: %3%") % client->name % client->cgroup_dir % strerror(errno);
+    }
+}
+
+/**
+ * \brief Read the current statistics of the cgroup of a client program
+ * \details A statistic whose controller is not enabled is 0.
+ */
+static void _read_cgroup_stats(const client_program_t *client, double *stats) {
+    fill(stats, stats + NUM_OF_CGROUP_STATS, 0);
+    const string &dir = client->cgroup_dir;
+    string s;
+    if (_read_file(dir + "/cpu.stat", &s)) {
+        stats[CG_CPU_USAGE] = sum_cgroup_stat(s, "", "usage_usec") / 1e6;
+        stats[CG_CPU_USER] = sum_cgroup_stat(s, "", "user_usec") / 1e6;
+        stats[CG_CPU_SYSTEM] = sum_cgroup_stat(s, "", "system_usec") / 1e6;
+        stats[CG_CPU_THROTTLED] = sum_cgroup_stat(s, "", "throttled_usec") / 1e6;
+    }
+    if (_read_file(dir + "/io.stat", &s)) {
+        stats[CG_IO_RBYTES] = sum_cgroup_stat(s, "", "rbytes");
+        stats[CG_IO_WBYTES] = sum_cgroup_stat(s, "", "wbytes");
+    }
+    const char *psi_files[] = {"/cpu.pressure", "/memory.pressure", "/io.pressure"};
+    for (int i = 0; i < 3; ++i) {
+        if (_read_file(dir + psi_files[i], &s))
+            stats[CG_CPU_PRESSURE + i] = sum_cgroup_stat(s, "some", "total") / 1e6;
+    }
+    if (client->cgroup_peak_fd >= 0) {
+        char buf[32];
+        ssize_t n = pread(client->cgroup_peak_fd, buf, sizeof(buf) - 1, 0);
+        if (n > 0) {
+            buf[n] = '\0';
+            stats[CG_MEMORY_PEAK] = strtod(buf, NULL);
+        }
+    }
+}
+
+/**
+ * \brief Start the accounting of a round in the cgroup of a client program
+ */
+static void _begin_cgroup_round(client_program_t *client) {
+    if (client->cgroup_dir.empty()) return;
+    if (client->cgroup_peak_fd >= 0) {
+        // fails harmlessly if memory.peak can't be reset
+        _write_all(client->cgroup_peak_fd, "reset\n");
+    }
+    _read_cgroup_stats(client, client->cgroup_stats);
+}
+
+/**
+ * \brief Finish the accounting of a round in the cgroup of a client program
+ * \details client->cgroup_stats is set to the changes of the statistics during
+ * the round, except for memory.peak that is the peak of the round.
+ */
+static void _end_cgroup_round(client_program_t *client) {
+    if (client->cgroup_dir.empty()) return;
+    double stats[NUM_OF_CGROUP_STATS];
+    _read_cgroup_stats(client, stats);
+    for (int i = 0; i < NUM_OF_CGROUP_STATS; ++i)
+        client->cgroup_stats[i] = CG_MEMORY_PEAK == i ? stats[i] : stats[i] - client->cgroup_stats[i];
+}
+
+/**
+ * \brief Throw if the exit code of a client program is not in --valid-rc
+ */
+static void _check_rc(int rc) {
+    // pclose() returns -1 when the client is already exited
+    if (-1 != rc && find(g_valid_rc.begin(), g_valid_rc.end(), rc) == g_valid_rc.end()) {
+        throw runtime_error(str(format("Client program returned %1%") % rc).c_str());
+    }
+}
+
 /**
  * \brief Execute cmd and return one line of the stdout of the cmd
  *
  * The client program can output many lines and they will all be read in. Each
- * line should contain exactly one sample.
+ * line should contain exactly one sample. Throws round_timeout_error if
+ * --round-timeout is set and the round takes longer.
+ * @param client the client program
  * @param cmd
- * @param stdout the stdout of the client program
- * @return one line of the stdout from running the cmd
+ * @param request the request line sent to the client in --coprocess mode
+ * @return one line of the stdout from running the cmd. It points into the
+ * buffer of client->out and is only valid until the next call.
  */
-string exec(char* const* cmd) {
-    char buffer[128];
+boost::string_ref exec(client_program_t *client, char* const* cmd, const string &request) {
     clearerr(stdin);
-    string result;
+    boost::string_ref result;
+    const deadline_t deadline = chrono::steady_clock::now() + chrono::seconds(g_round_timeout);
+    client->num_of_urs = 0;
     for (int loop_time = 0; loop_time < 3; ++loop_time) {
-        if (0 == g_client_pid) {
-            g_client_pid = popen2(cmd, NULL, &g_client_out_fs);
-        }
-        for(;;) {
-            size_t newline_pos = g_prog_stdout.find('\n');
-            if (string::npos != newline_pos) {
-                result = g_prog_stdout.substr(0, newline_pos);
-                g_prog_stdout = g_prog_stdout.substr(newline_pos+1, g_prog_stdout.size()-newline_pos-1);
-                if (result == "") {
-                    // Skip empty lines
+        if (0 == client->pid) {
+            int out_fd;
+            client->pid = popen2(cmd, g_coprocess ? &client->in_fd : NULL, &out_fd,
+                                 g_unit_readings ? &client->ur_fd : NULL,
+                                 client->has_cpuset ? &client->cpuset : NULL, client->cgroup_fd);
+            client->started_at = chrono::steady_clock::now();
+            client->out.reset(out_fd);
+            client->ur_got = 0;
+            _enter_cgroup(client);
+        }
+        // A client that has exited shows up as EOF below and is started again
+        if (g_coprocess && !_write_all(client->in_fd, request)) {
+            warning_log << "Cannot send the request to the client program: " << strerror(errno);
+        }
+        // The line and the unit readings record are waited for at the same
+        // time, since the client may write either first and blocks if the
+        // other pipe is full. Lines left in the buffer from the last round
+        // are taken first, as poll() doesn't see them.
+        line_reader_t::status_t status;
+        // Skip empty lines
+        while (line_reader_t::LINE == (status = client->out.read_line(&result, 0)) && result.empty());
+        ur_status_t ur_status = g_unit_readings ? UR_PARTIAL : UR_RECORD;
+        while (line_reader_t::TIMED_OUT == status || UR_PARTIAL == ur_status) {
+            struct pollfd pfds[2];
+            nfds_t nfds = 0;
+            if (line_reader_t::TIMED_OUT == status) pfds[nfds++] = {client->out.fd(), POLLIN, 0};
+            if (UR_PARTIAL == ur_status) pfds[nfds++] = {client->ur_fd, POLLIN, 0};
+            int res = poll(pfds, nfds, _ms_left(deadline));
+            if (res < 0) {
+                if (EINTR == errno) continue;
+                throw runtime_error(string("poll() failed: ") + strerror(errno));
+            }
+            if (0 == res) {
+                throw round_timeout_error(str(format("Client program did not finish the round in %1% seconds") % g_round_timeout));
+            }
+            for (nfds_t i = 0; i < nfds; ++i) {
+                if (0 == pfds[i].revents) continue;
+                if (pfds[i].fd == client->ur_fd) {
+                    ur_status = _read_unit_readings(client);
                     continue;
                 }
+                while (line_reader_t::LINE == (status = client->out.read_line(&result, 0)) && result.empty());
+            }
+        }
+        // The round ends here, before waiting for the client to exit for
+        // --resource-pi
+        client->line_at = chrono::steady_clock::now();
+        // A round without its unit readings record is not complete
+        if (UR_END == ur_status) result.clear();
+        if (line_reader_t::LINE == status && UR_RECORD == ur_status) {
+            if (g_resource_pis.empty())
                 return result;
+            // The resource usage of the round is known only after the
+            // client exits, so the rest of its output is discarded
+            client->line.assign(result.data(), result.size());
+            while (line_reader_t::LINE == (status = client->out.read_line(&result, _ms_left(deadline)))) {
+                if (!result.empty()) {
+                    warning_log << "Ignoring extra output of the client program: " << result;
+                }
             }
-
-            if (feof(g_client_out_fs))
-                break;
-
-            if (fgets(buffer, 128, g_client_out_fs) != NULL) {
-                g_prog_stdout += buffer;
-            } else {
-                // eof reached
-                break;
+            if (line_reader_t::TIMED_OUT == status) {
+                throw round_timeout_error(str(format("Client program did not finish the round in %1% seconds") % g_round_timeout));
             }
+            result = client->line;
         }
         // We reach here when eof is detected
-        fclose(g_client_out_fs);
-        g_client_out_fs = NULL;
-        int rc = pclose2(g_client_pid);
-        // pclose() returns -1 when the client is already exited
-        if (-1 != rc && find(g_valid_rc.begin(), g_valid_rc.end(), rc) == g_valid_rc.end()) {
-            throw runtime_error(str(format("Client program returned %1%") % rc).c_str());
-        }
-        g_client_pid = 0;
+        _check_rc(_close_client(client, g_resource_pis.empty() ? NULL : client->resources));
         // Return whatever we have no matter if it ends with a \n
-        if (g_prog_stdout.size() != 0) {
-            result = g_prog_stdout;
-            g_prog_stdout = "";
+        if (!result.empty()) {
             return result;
         }
         // If we still have nothing so far, run the benchmark command again
@@ -217,11 +1054,249 @@ string exec(char* const* cmd) {
     throw runtime_error("Client program does not generate output");
 }
 
+/**
+ * \brief Run a round on all instances of --instances at the same time
+ * \details The outputs of the instances are collected with poll() as they
+ * come, so a slow instance does not hold up reading the others. An instance
+ * that exits without giving its line is started again, up to 3 times. Unless
+ * in --coprocess mode, the instances are reaped before returning. Throws
+ * round_timeout_error if --round-timeout is set and the round takes longer.
+ * @param cmds the command of each instance
+ * @param request the request line sent to the instances in --coprocess mode
+ * @param[out] lines the output line of each instance
+ * @param[out] finished_at when each instance gave its line
+ */
+static void _exec_instances(const vector<vector<char*> > &cmds, const string &request,
+                            vector<string> *lines, vector<deadline_t> *finished_at) {
+    const size_t n = g_instances.size();
+    const deadline_t deadline = chrono::steady_clock::now() + chrono::seconds(g_round_timeout);
+    vector<int> num_of_starts(n, 0);
+    vector<bool> requested(n, false);
+    vector<bool> done(n, false);
+    size_t num_of_done = 0;
+    lines->assign(n, string());
+    finished_at->assign(n, deadline_t());
+    vector<struct pollfd> pfds;
+    vector<size_t> pfd_instances;
+    while (num_of_done < n) {
+        pfds.clear();
+        pfd_instances.clear();
+        for (size_t i = 0; i < n; ++i) {
+            if (done[i]) continue;
+            client_program_t *client = &g_instances[i];
+            if (0 == client->pid) {
+                // We've already tried three times and didn't get anything
+                if (++num_of_starts[i] > 3)
+                    throw runtime_error(str(format("Instance %1% does not generate output") % i));
+                int out_fd;
+                client->pid = popen2(cmds[i].data(), g_coprocess ? &client->in_fd : NULL, &out_fd, NULL,
+                                     client->has_cpuset ? &client->cpuset : NULL, client->cgroup_fd);
+                client->started_at = chrono::steady_clock::now();
+                client->out.reset(out_fd);
+                _enter_cgroup(client);
+                requested[i] = false;
+            }
+            if (g_coprocess && !requested[i]) {
+                if (!_write_all(client->in_fd, request)) {
+                    warning_log << format("Cannot send the request to instance %1%: %2%") % i % strerror(errno);
+                }
+                requested[i] = true;
+            }
+            pfds.push_back({client->out.fd(), POLLIN, 0});
+            pfd_instances.push_back(i);
+        }
+        int res = poll(pfds.data(), pfds.size(), _ms_left(deadline));
+        if (res < 0) {
+            if (EINTR == errno) continue;
+            throw runtime_error(string("poll() failed: ") + strerror(errno));
+        }
+        if (0 == res) {
+            throw round_timeout_error(str(format("%1% of %2% instances did not finish the round in %3% seconds")
+                                          % (n - num_of_done) % n % g_round_timeout));
+        }
+        for (size_t k = 0; k < pfds.size(); ++k) {
+            if (0 == pfds[k].revents) continue;
+            const size_t i = pfd_instances[k];
+            client_program_t *client = &g_instances[i];
+            boost::string_ref line;
+            line_reader_t::status_t status;
+            // With no time to wait read_line() only reads what poll() found
+            while (line_reader_t::LINE == (status = client->out.read_line(&line, 0)) && line.empty()) {}
+            if (line_reader_t::TIMED_OUT == status) continue;
+            // Take whatever we have no matter if it ends with a \n
+            if (!line.empty()) {
+                (*lines)[i].assign(line.data(), line.size());
+                (*finished_at)[i] = chrono::steady_clock::now();
+                done[i] = true;
+                ++num_of_done;
+            }
+            // An instance that has exited without its line is started again above
+            if (line_reader_t::END_OF_FILE == status)
+                _check_rc(_close_client(client));
+        }
+    }
+    if (g_coprocess) return;
+    // Each round starts its own instances, so the instances of this round
+    // are reaped here and the rest of their output is discarded
+    for (size_t i = 0; i < n; ++i) {
+        client_program_t *client = &g_instances[i];
+        if (0 == client->pid) continue;
+        boost::string_ref line;
+        line_reader_t::status_t status;
+        while (line_reader_t::LINE == (status = client->out.read_line(&line, _ms_left(deadline)))) {
+            if (!line.empty()) {
+                warning_log << format("Ignoring extra output of instance %1%: %2%") % i % line;
+            }
+        }
+        if (line_reader_t::TIMED_OUT == status) {
+            throw round_timeout_error(str(format("Instance %1% did not exit in %2% seconds") % i % g_round_timeout));
+        }
+        _check_rc(_close_client(client));
+    }
+}
+
+/**
+ * \brief Wait for a client program to exit and reap it
+ * @return true if the client has exited within timeout_ms milliseconds
+ */
+static bool _reap_client(pid_t pid, int timeout_ms) {
+    for (int waited = 0; ; waited += 100) {
+        pid_t res = waitpid(pid, NULL, WNOHANG);
+        if (pid == res || (res < 0 && ECHILD == errno))
+            return true;
+        if (waited >= timeout_ms)
+            return false;
+        usleep(100000);
+    }
+}
+
+/**
+ * \brief Stop a client program that is still running
+ * \details In --coprocess mode the client is asked to exit by closing its
+ * stdin first. A client that is still running after 5 seconds gets SIGTERM,
+ * and SIGKILL if it does not exit in another 5 seconds. The client is always
+ * reaped, so it leaves no zombie and its cgroup can be removed.
+ */
+static void _stop_client(client_program_t *client) {
+    if (0 == client->pid) return;
+    if (client->in_fd >= 0) {
+        close(client->in_fd);
+        client->in_fd = -1;
+        if (_reap_client(client->pid, 5000))
+            client->pid = 0;
+    }
+    if (0 != client->pid) {
+        // with --round-timeout the client leads its own process group
+        const pid_t target = g_round_timeout > 0 ? -client->pid : client->pid;
+        kill(target, SIGTERM);
+        if (!_reap_client(client->pid, 5000)) {
+            warning_log << "Client program " << client->pid << " did not exit after SIGTERM, killing it";
+            kill(target, SIGKILL);
+            waitpid(client->pid, NULL, 0);
+        }
+        client->pid = 0;
+    }
+    if (client->ur_fd >= 0) {
+        close(client->ur_fd);
+        client->ur_fd = -1;
+    }
+}
+
+/**
+ * \brief Copy the unit readings of the last round of the client into the
+ * output parameters of workload_func()
+ */
+static void _give_unit_readings(const client_program_t *client, pilot_malloc_func_t *lib_malloc_func,
+                                size_t *num_of_work_unit, double ***unit_readings) {
+    const size_t n = client->num_of_urs;
+    debug_log << "Got " << n << " unit readings for each PI";
+    *num_of_work_unit = n;
+    *unit_readings = (double**)lib_malloc_func(sizeof(double*) * g_num_of_pi);
+    for (int i = 0; i < g_num_of_pi; ++i) {
+        (*unit_readings)[i] = (double*)lib_malloc_func(sizeof(double) * n);
+        memcpy((*unit_readings)[i], client->urs.data() + i * n, sizeof(double) * n);
+    }
+}
+
 static void _free_argv_vector(vector<char*> &v) {
     for (char* p : v)
         free(p);
 }
 
+/**
+ * \brief Substitute the macros in the command of the client program
+ * @return the argv of the command, to be freed by _free_argv_vector()
+ */
+static vector<char*> _make_cmd(const client_program_t *client, const string &result_dir, size_t work_amount) {
+    vector<char*> cmd(client->cmd_len+1);
+    for (size_t i = 0; i < client->cmd_len; ++i) {
+        string tmp(client->cmd[i]);
+        replace_all(tmp, "%RESULT_DIR%", result_dir);
+        replace_all(tmp, "%WORK_AMOUNT%", to_string(work_amount));
+        replace_all(tmp, "%INSTANCE%", to_string(client->instance));
+        for (const auto &param : client->params)
+            replace_all(tmp, "%PARAM:" + param.first + "%", param.second);
+        cmd[i] = strdup(tmp.c_str());
+    }
+    cmd[client->cmd_len] = NULL;   // execvp requires this
+
+    stringstream ss;
+    ss << "Executing client program:";
+    for (const char* p : cmd) {
+        if (!p) break;
+        ss << " ";
+        ss << *p;
+    }
+    debug_log << ss.str();
+    return cmd;
+}
+
+/**
+ * \brief Combine the readings of the instances of --instances and report how
+ * much they differ
+ * \details The readings of a PI are summed or averaged as set in --pi.
+ * @param lines the output line of each instance
+ * @param finished_at when each instance gave its line
+ * @param[out] rs the combined readings
+ */
+static void _combine_instance_readings(const vector<string> &lines, const vector<deadline_t> &finished_at,
+                                       vector<double> *rs) {
+    const size_t n = lines.size();
+    rs->assign(g_pi_col.size(), 0);
+    vector<double> lo(g_pi_col.size(), numeric_limits<double>::max());
+    vector<double> hi(g_pi_col.size(), numeric_limits<double>::lowest());
+    for (size_t i = 0; i < n; ++i) {
+        info_log << format("Got output from instance %1%: %2%") % i % lines[i];
+        vector<double> r;
+        try {
+            r = extract_csv_fields<double>(lines[i], g_pi_col);
+        } catch (const boost::bad_lexical_cast &) {
+            fatal_log << "Cannot parse the output of instance " << i << ": " << lines[i];
+            throw;
+        }
+        for (size_t piid = 0; piid < g_pi_col.size(); ++piid) {
+            (*rs)[piid] += r[piid];
+            lo[piid] = min(lo[piid], r[piid]);
+            hi[piid] = max(hi[piid], r[piid]);
+        }
+    }
+    for (size_t piid = 0; piid < g_pi_col.size(); ++piid) {
+        const double mean = (*rs)[piid] / n;
+        if (!g_pi_sum[piid])
+            (*rs)[piid] = mean;
+        if (0 != mean) {
+            info_log << format("[PI %1%] instance skew: %2%%% (min %3%, max %4%)")
+                        % piid % ((hi[piid] - lo[piid]) / fabs(mean) * 100) % lo[piid] % hi[piid];
+        }
+    }
+    const auto first = min_element(finished_at.begin(), finished_at.end());
+    const auto last = max_element(finished_at.begin(), finished_at.end());
+    info_log << format("Instance %1% finished %2% seconds after instance %3%")
+                % (last - finished_at.begin())
+                % chrono::duration_cast<chrono::duration<double> >(*last - *first).count()
+                % (first - finished_at.begin());
+}
+
 /**
  * \brief the sequential write workload func for libpilot
  * \details This function generates a series of sequential I/O and calculate the throughput.
@@ -232,6 +1307,7 @@ static void _free_argv_vector(vector<char*> &v) {
  * @param[out] num_of_work_unit
  * @param[out] reading_per_work_unit the memory can be
  * @param[out] readings the final readings of this workload run. Format: readings[piid]. The user needs to allocate memory using lib_malloc_func.
+ * @param[in] data the client_program_t to run
  * @return
  */
 int workload_func(const pilot_workload_t *wl,
@@ -242,58 +1318,143 @@ int workload_func(const pilot_workload_t *wl,
                   double ***unit_readings,
                   double **readings,
                   nanosecond_type *round_duration, void *data) {
-    // allocate space for storing result readings
-    *readings = (double*)lib_malloc_func(sizeof(double) * g_num_of_pi);
-    // this workload has no unit readings
+    // readings are not given for a timed-out round
+    *readings = NULL;
+    // unit readings are only given in --unit-readings and --ur-file modes
     *num_of_work_unit = 0;
     *unit_readings = NULL;
 
+    client_program_t *client = static_cast<client_program_t*>(data);
+
     // substitute macros
-    string my_result_dir = g_round_results_dir + str(format("/%1%") % round);
+    string my_result_dir = client->round_results_dir + str(format("/%1%") % round);
     create_directories(my_result_dir);
-    vector<char*> my_cmd(g_client_cmd_len+1);
-    for (size_t i = 0; i < g_client_cmd_len; ++i) {
-        string tmp(g_client_cmd[i]);
-        replace_all(tmp, "%RESULT_DIR%", my_result_dir);
-        replace_all(tmp, "%WORK_AMOUNT%", to_string(total_work_amount));
-        my_cmd[i] = strdup(tmp.c_str());
+    // with --instances the command of each instance is run instead
+    vector<vector<char*> > my_cmds;
+    if (g_instances.empty()) {
+        my_cmds.push_back(_make_cmd(client, my_result_dir, total_work_amount));
+    } else {
+        for (const client_program_t &instance : g_instances)
+            my_cmds.push_back(_make_cmd(&instance, my_result_dir, total_work_amount));
     }
-    my_cmd[g_client_cmd_len] = NULL;   // execvp requires this
 
-    stringstream ss;
-    ss << "Executing client program:";
-    for (const char* p : my_cmd) {
-        if (!p) break;
-        ss << " ";
-        ss << *p;
+    _begin_cgroup_round(client);
+    const auto round_start = chrono::steady_clock::now();
+    // the unit readings of the last round must not be given again
+    client->num_of_urs = 0;
+    boost::string_ref prog_stdout;
+    vector<string> instance_lines;
+    vector<deadline_t> instance_finished_at;
+    bool timed_out = false;
+    string request;
+    if (g_coprocess)
+        request = str(format("%1% %2% %3%\n") % round % total_work_amount % my_result_dir);
+    for (size_t attempt = 0; ; ++attempt) {
+        try {
+            if (g_instances.empty())
+                prog_stdout = exec(client, (char* const*)my_cmds[0].data(), request);
+            else
+                _exec_instances(my_cmds, request, &instance_lines, &instance_finished_at);
+            break;
+        } catch (const round_timeout_error &e) {
+            warning_log << e.what();
+            _kill_client(client);
+            for (client_program_t &instance : g_instances)
+                _kill_client(&instance);
+            if (attempt == g_round_retries) {
+                timed_out = true;
+                break;
+            }
+            const unsigned backoff = 1U << min<size_t>(attempt, 6);
+            warning_log << format("Retrying round %1% in %2% seconds") % round % backoff;
+            sleep(backoff);
+        } catch (const runtime_error& e) {
+            error_log << e.what();
+            for (auto &cmd : my_cmds)
+                _free_argv_vector(cmd);
+            return 1;
+        }
     }
-    debug_log << ss.str();
+    for (auto &cmd : my_cmds)
+        _free_argv_vector(cmd);
+    // the round ends when the output of the client program is received, not
+    // when the client has exited for --resource-pi
+    auto end = timed_out ? chrono::steady_clock::now() : client->line_at;
+    if (!timed_out && !g_instances.empty())
+        end = *max_element(instance_finished_at.begin(), instance_finished_at.end());
+    auto begin = round_start;
+    if (!g_include_spawn_time) {
+        // the round starts when the client program has been started, or
+        // when the first instance has been started
+        if (g_instances.empty()) {
+            begin = max(begin, client->started_at);
+        } else {
+            auto first_started_at = g_instances[0].started_at;
+            for (const client_program_t &instance : g_instances)
+                first_started_at = min(first_started_at, instance.started_at);
+            begin = max(begin, first_started_at);
+        }
+    }
+    *round_duration = chrono::duration_cast<chrono::nanoseconds>(end - begin).count();
 
-    string prog_stdout;
-    try {
-        prog_stdout = exec((char* const*)my_cmd.data());
-    } catch (const runtime_error& e) {
-        error_log << e.what();
-        _free_argv_vector(my_cmd);
-        return 1;
+    if (!timed_out && g_instances.empty()) {
+        info_log << "Got output from client program: " << prog_stdout;
     }
-    _free_argv_vector(my_cmd);
-    // remove trailing \n
-    int i = prog_stdout.size() - 1;
-    while (i >= 0 && '\n' == prog_stdout[i])
-        --i;
-    prog_stdout.resize(i + 1);
 
-    info_log << "Got output from client program: " << prog_stdout;
+    // A round that timed out, or that stalled for long because other jobs
+    // disturbed it, is rejected
+    string rejected_because;
+    if (timed_out) {
+        rejected_because = "it timed out";
+    } else if (!client->cgroup_dir.empty()) {
+        _end_cgroup_round(client);
+        const double secs = chrono::duration_cast<chrono::duration<double> >(chrono::steady_clock::now() - round_start).count();
+        for (int i = CG_CPU_PRESSURE; g_max_pressure > 0 && i <= CG_IO_PRESSURE; ++i) {
+            const double stalled = client->cgroup_stats[i] / secs * 100;
+            if (stalled > g_max_pressure) {
+                rejected_because = str(format("some tasks stalled on %1% for %2%%% of the round")
+                                       % kCgroupStats[i].name % stalled);
+                break;
+            }
+        }
+    }
+    if (!rejected_because.empty()) {
+        // The round is recorded without readings, which the library counts as
+        // a rejected round. The unit readings that were completely received
+        // before a timeout are kept, but those of a disturbed round are not.
+        warning_log << "Round " << round << " is rejected because " << rejected_because;
+        if (timed_out && client->num_of_urs > 0) {
+            warning_log << "Salvaged " << client->num_of_urs << " unit readings of each PI from round " << round;
+            _give_unit_readings(client, lib_malloc_func, num_of_work_unit, unit_readings);
+        }
+        return 0;
+    }
+
+    // allocate space for storing result readings
+    *readings = (double*)lib_malloc_func(sizeof(double) * g_num_of_pi);
 
     // parse the result
     try {
-        vector<double> rs = extract_csv_fields<double>(prog_stdout, g_pi_col);
-        assert(g_pi_col.size() == static_cast<size_t>(g_num_of_pi));
-        for (int i = 0; i < g_num_of_pi; ++i) {
-            debug_log << str(format("[PI %1%] new reading: %2%") % i % rs[i]);
+        vector<double> rs;
+        if (g_instances.empty())
+            rs = extract_csv_fields<double>(prog_stdout, g_pi_col);
+        else
+            _combine_instance_readings(instance_lines, instance_finished_at, &rs);
+        assert(g_pi_col.size() + g_resource_pis.size() + g_cgroup_pis.size() == static_cast<size_t>(g_num_of_pi));
+        for (size_t i = 0; i < g_pi_col.size(); ++i) {
+            debug_log << format("[PI %1%] new reading: %2%") % i % rs[i];
             (*readings)[i] = rs[i];
         }
+        for (size_t i = 0; i < g_resource_pis.size(); ++i) {
+            const size_t piid = g_pi_col.size() + i;
+            (*readings)[piid] = client->resources[g_resource_pis[i]];
+            debug_log << format("[PI %1%] new reading: %2%") % piid % (*readings)[piid];
+        }
+        for (size_t i = 0; i < g_cgroup_pis.size(); ++i) {
+            const size_t piid = g_pi_col.size() + g_resource_pis.size() + i;
+            (*readings)[piid] = client->cgroup_stats[g_cgroup_pis[i]];
+            debug_log << format("[PI %1%] new reading: %2%") % piid % (*readings)[piid];
+        }
     } catch (const boost::bad_lexical_cast &e) {
         fatal_log << "Cannot parse client program's output: " << prog_stdout;
         fatal_log << "Parsing error: " << boost::diagnostic_information(e);
@@ -303,28 +1464,192 @@ int workload_func(const pilot_workload_t *wl,
         return ERR_WL_FAIL;
     }
 
+    if (!g_ur_files.empty()) {
+        try {
+            _read_unit_readings_files(client, my_result_dir);
+        } catch (const exception &e) {
+            fatal_log << "Cannot read unit readings: " << e.what();
+            return ERR_WL_FAIL;
+        }
+    }
+    if (client->num_of_urs > 0) {
+        _give_unit_readings(client, lib_malloc_func, num_of_work_unit, unit_readings);
+    }
+
     return 0;
 }
 
-int handle_run_program(int argc, const char** argv) {
-    po::options_description desc("Usage: " + string(argv[0]) + " [options] -- program_path [program_options]", 120, 120);
+/**
+ * \brief The workload func of run_plugin that calls the plugin
+ * \details The per-round setup of the plugin is not included in the round
+ * duration unless the plugin reports its own round duration.
+ */
+static int plugin_workload_func(const pilot_workload_t *wl,
+                                size_t round,
+                                size_t total_work_amount,
+                                pilot_malloc_func_t *lib_malloc_func,
+                                size_t *num_of_work_unit,
+                                double ***unit_readings,
+                                double **readings,
+                                nanosecond_type *round_duration, void *data) {
+    plugin_t *plugin = static_cast<plugin_t*>(data);
+    if (plugin->setup_round) {
+        int rc = plugin->setup_round(round, total_work_amount, plugin->data);
+        if (0 != rc) {
+            error_log << "Plugin failed to set up round " << round << ": " << rc;
+            return rc;
+        }
+    }
+    cpu_timer timer;
+    int rc = plugin->workload_func(wl, round, total_work_amount, lib_malloc_func, num_of_work_unit,
+                                   unit_readings, readings, round_duration, plugin->data);
+    if (0 == *round_duration)
+        *round_duration = timer.elapsed().wall;
+    if (0 == rc && g_num_of_pi > 0 && NULL == *readings) {
+        error_log << "Plugin returned no readings in round " << round;
+        return ERR_WL_FAIL;
+    }
+    return rc;
+}
+
+/**
+ * \brief Load the workload plugin and call its pilot_plugin_init()
+ * @param argc the number of elements in argv
+ * @param argv the path of the plugin followed by its arguments
+ * @return 0 on success
+ */
+static int _load_plugin(int argc, const char **argv) {
+    g_plugin.handle = dlopen(argv[0], RTLD_NOW | RTLD_LOCAL);
+    if (!g_plugin.handle) {
+        fatal_log << "Cannot load plugin: " << dlerror();
+        return 1;
+    }
+    g_plugin.workload_func = reinterpret_cast<pilot_workload_func_t*>(dlsym(g_plugin.handle, "pilot_plugin_workload"));
+    if (!g_plugin.workload_func) {
+        fatal_log << "Plugin " << argv[0] << " does not export pilot_plugin_workload()";
+        dlclose(g_plugin.handle);
+        g_plugin = plugin_t();
+        return 1;
+    }
+    g_plugin.setup_round = reinterpret_cast<plugin_setup_round_func_t*>(dlsym(g_plugin.handle, "pilot_plugin_setup_round"));
+    g_plugin.fini = reinterpret_cast<plugin_fini_func_t*>(dlsym(g_plugin.handle, "pilot_plugin_fini"));
+    plugin_init_func_t *init = reinterpret_cast<plugin_init_func_t*>(dlsym(g_plugin.handle, "pilot_plugin_init"));
+    if (init) {
+        int rc = init(argc, argv, &g_plugin.data);
+        if (0 != rc) {
+            fatal_log << "Plugin initialization failed: " << rc;
+            dlclose(g_plugin.handle);
+            g_plugin = plugin_t();
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void _unload_plugin(void) {
+    if (!g_plugin.handle) return;
+    if (g_plugin.fini)
+        g_plugin.fini(g_plugin.data);
+    dlclose(g_plugin.handle);
+    g_plugin = plugin_t();
+}
+
+/**
+ * \brief Pin the calling thread to a CPU
+ * @param cpu the CPU, or -1 for the CPU the thread is running on
+ */
+static void _pin_thread(int cpu) {
+    if (cpu < 0)
+        cpu = sched_getcpu();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (0 != rc) {
+        warning_log << "Cannot pin the workload thread to CPU " << cpu << ": " << strerror(rc);
+    } else {
+        info_log << "Pinned the workload thread to CPU " << cpu;
+    }
+}
+
+/**
+ * \brief Parse a list of CPUs and ranges of CPUs, such as "0-3,8"
+ * @return false if cpus is invalid
+ */
+static bool _parse_cpuset(const string &cpus, cpu_set_t *set) {
+    CPU_ZERO(set);
+    vector<string> ranges;
+    boost::split(ranges, cpus, boost::is_any_of(","));
+    try {
+        for (const string &range : ranges) {
+            const size_t dash = range.find('-');
+            const int first = lexical_cast<int>(range.substr(0, dash));
+            const int last = string::npos == dash ? first : lexical_cast<int>(range.substr(dash + 1));
+            if (first < 0 || last < first || last >= CPU_SETSIZE)
+                return false;
+            for (int cpu = first; cpu <= last; ++cpu)
+                CPU_SET(cpu, set);
+        }
+    } catch (const boost::bad_lexical_cast &) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * \brief The implementation of the run_program and run_plugin commands
+ * @param plugin true for run_plugin
+ */
+static int _handle_run(int argc, const char** argv, bool plugin) {
+    po::options_description desc("Usage: " + string(argv[0]) + (plugin ?
+            " [options] -- plugin_path [plugin_args]" :
+            " [options] -- program_path [program_options] [::: program_path [program_options]]"), 120, 120);
     desc.add_options()
             ("help", "Print help message for run_command.")
             ("ac,a", po::value<double>(), "Set the required range of autocorrelation coefficient. arg should be a value within (0, 1], and the range will be set to [-arg,arg]")
+            ("cgroup", po::value<string>()->implicit_value(""), "Run each program in its own cgroup v2, created under the cgroup directory arg that must be writable (default: the cgroup of Pilot, which Pilot moves itself out of). "
+                    "The program is started in the cgroup, or on Linux before 5.7 moved into it right after it starts, which --cgroup-limit and --max-pressure don't allow. "
+                    "If the cgroups can't be created, the programs run without them.")
+            ("cgroup-limit", po::value<vector<string> >()->composing(), "A limit of the cgroups of --cgroup, formatted as \"FILE=VALUE\", such as \"cpuset.cpus=0-3\", \"memory.high=2G\", or \"io.max=8:0 wbps=104857600\" (can be set more than once). "
+                    "Pilot stops if a limit cannot be set.")
+            ("cgroup-pi", po::value<vector<string> >()->composing(), "Add a statistic of the cgroup of --cgroup in each round as a PI, after the PIs set by --pi and --resource-pi (can be set more than once). "
+                    "arg can be cpu.usage, cpu.user, cpu.system, or cpu.throttled (CPU time in seconds from cpu.stat), memory.peak (bytes), io.rbytes or io.wbytes (from io.stat), "
+                    "or cpu.pressure, memory.pressure, or io.pressure (the time in seconds that some tasks stalled, from the PSI files)")
             ("ci,c", po::value<double>(), "The required width of confidence interval (absolute value). Set it to -1 to disable CI (absolute value) check.")
             ("ci-perc", po::value<double>(), "The required width of confidence interval (as the percentage of mean). Set it to -1 disables CI (percent of mean) check. If both ci and ci-perc are set, the narrower one will be used. See preset below for the default value.")
+            ("compare", po::value<size_t>()->implicit_value(100), "Compare two programs, given as \"-- program_a [program_options] ::: program_b [program_options]\", by running them alternately in pairs of rounds so that drift of the system cancels out. arg is the maximum number of pairs (default: 100). The first PI with must_satisfy set is compared.")
+            ("coprocess", "Start the program only once and keep it running for the whole session, so that it warms up only once. "
+                    "Before each round Pilot writes a request line \"ROUND WORK_AMOUNT RESULT_DIR\" to the stdin of the program, and the program replies with one line of output for the round in the usual format. "
+                    "The program should exit when its stdin is closed at the end of the session, and is restarted if it exits earlier. "
+                    "Macros in program_options are replaced with the values of the first round.")
+            ("cpu", po::value<int>(), "(run_plugin only) The CPU to pin the thread that runs the plugin to (default: the CPU it starts on)")
+            ("cpuset-per-instance", po::value<string>(), "The CPUs that each instance of --instances runs on, formatted as \"CPUS:CPUS:...\" with one CPUS for each instance, "
+                    "where CPUS is a comma-separated list of CPUs or ranges of CPUs, such as \"0-3,8\"")
             ("duration-col,d", po::value<size_t>(), "Set the column (0-based) of the round duration in seconds for WPS analysis.")
             ("env", po::value<std::vector<string> >()->multitoken(), "Environment variable to pass to program, formatted as \"NAME=VALUE\". This option can be used to set variables such as LD_PRELOAD that should be set only for the benchmark program and not for Pilot. It may be specified multiple times.")
+            ("include-spawn-time", "Include the time of starting the program in the round duration, which is excluded by default")
+            ("instances", po::value<size_t>(), "Run arg instances of the program at the same time in each round, for scale-out tests. %INSTANCE% in program_options is replaced by the number of the instance (0-based). "
+                    "The readings of the instances are summed or averaged as set for each PI by --pi, and how much they differ is logged. The round lasts until the last instance gives its line.")
+            ("journal", "Journal the data of every round to session.journal in the output directory, which must be set by --output-dir, so that an interrupted session can be continued with --resume. "
+                    "The journal is flushed to the storage device once every 10 rounds.")
+            ("max-pressure", po::value<double>(), "Reject a round if some tasks in the cgroup of --cgroup stalled on CPU, memory, or I/O for more than arg percent of the round, "
+                    "which means other jobs disturbed it. A rejected round has no readings or unit readings, and like a timed-out round it is left out of the analyses of round durations.")
             ("min-sample-size,m", po::value<size_t>(), "The required minimum subsession sample size (default to 30, also see Preset Modes below)")
+            ("objective", po::value<vector<string> >()->composing(), "An objective of the --param search, formatted as \"PIID,min\" or \"PIID,max\" (can be set more than once)")
             ("output-dir,o", po::value<string>(), "Set output directory name to arg")
+            ("param", po::value<vector<string> >()->composing(), "A parameter of the program, formatted as \"NAME=VALUE1,VALUE2,...\" (can be set more than once). %PARAM:NAME% in program_options is replaced by the value. "
+                    "When set, the program is run with every combination of the values, and the combinations that are dominated in all objectives (see --objective) by another one are eliminated as soon as their confidence intervals show it. "
+                    "Every combination is printed at the end with whether it is on the Pareto frontier of the objectives and its mean of each objective, "
+                    "which is nan if none of its rounds gave data for the objectives. Such combinations are not on the frontier.")
             ("pi,p", po::value<string>(), "Performance Index to read from the stdout of the program, which is expected to be csv\n"
-                    "Format:     \tname,unit,column,type,must_satisfy:...\n"
+                    "Format:     \tname,unit,column,type,must_satisfy,instances:...\n"
                     "name:       \tname of the PI, can be empty\n"
                     "unit:       \tunit of the PI, can be empty (the name and unit are used only for display purpose)\n"
-                    "column:     \tthe column of the PI in the csv output of the client program (0-based)\n"
+                    "column:     \tthe column of the PI in the csv output of the client program (0-based), ignored by run_plugin whose plugin returns the readings in the order of the PIs\n"
                     "type:       \t0 - ordinary value (like time, bytes, etc.), 1 - ratio (like throughput, speed), 2 - binary (0 or 1). "
                     "Setting the correct type ensures Pilot uses the correct mean calculation method. For binary type, binomial proportion confidence interval will be calculated.\n"
                     "must_satisfy: \t1 - if this PI's CI must satisfy the requirement of CI width; 0 (or missing) - record data only, no need to satisfy\n"
+                    "instances:  \tsum - sum the readings of the instances of --instances (like throughput); mean (or missing) - average them (like latency)\n"
                     "more than one PI's information can be separated by colon (:)")
             ("preset", po::value<string>(), "preset modes control the statistical requirements for the results to be satisfactory\n"
                     "quick:      \t(default) autocorrelation limit: 0.8,\n"
@@ -340,8 +1665,24 @@ int handle_run_program(int argc, const char** argv) {
                     "            \tmin. subsession sample size: 200,\n"
                     "            \tworkload round duration threshold: 20 seconds (only used when work amount is set)")
             ("quiet,q", "Enable quiet mode")
+            ("resource-pi", po::value<vector<string> >()->composing(), "Add the resource usage of the program in each round as a PI, after the PIs set by --pi (can be set more than once). "
+                    "The program must exit after each round. arg can be utime or stime (CPU time in seconds), maxrss (maximum resident set size in KB), "
+                    "minflt or majflt (page faults), nvcsw or nivcsw (voluntary or involuntary context switches), "
+                    "or rchar, wchar, read_bytes, or write_bytes (I/O counters from /proc/PID/io)")
+            ("resume", "Continue an interrupted session from the journal that --journal wrote in the output directory, which must be set by --output-dir, and keep journaling to it. The other options should be the same as the ones used for the interrupted session.")
+            ("round-retries", po::value<size_t>(), "The number of times to retry a round that times out (default: 0). The n-th retry waits 2^(n-1) seconds (up to 64) before it starts.")
+            ("round-timeout", po::value<int>(), "Kill the program and its process group if a round takes longer than arg seconds. "
+                    "After the retries the round is recorded without readings, but with the unit readings that were completely sent by --unit-readings before the timeout.")
             ("session-limit,s", po::value<int>(), "Set the session duration limit in seconds. Pilot will stop with error code 13 if the session runs longer (default: unlimited).")
             ("tui", "Enable the text user interface")
+            ("ur-file", po::value<vector<string> >()->composing(), "Read the unit readings of a PI from files that the program writes to %RESULT_DIR% in each round, "
+                    "formatted as \"pattern,column[,format]\". It must be set once for each PI, in the order of the PIs. "
+                    "pattern is a file name pattern (wildcards allowed) and all matching files are read in the order of their names after the program outputs the line of the round. "
+                    "format is text (default) for CSV or fio-style logs, whose column (0-based) holds the unit readings, or binary for an array of little-endian float64 (column is ignored).")
+            ("unit-readings", "Read the unit readings (e.g., the latency of every operation) of the PIs from a binary stream that the program writes to fd 3 "
+                    "(the fd number is also given in the PILOT_UR_FD environment variable). "
+                    "For each round the program writes the number of unit readings N as a little-endian uint64, "
+                    "followed by N little-endian float64 unit readings of PI 0, then N of PI 1, and so on. N can be 0 and must be less than 2^32.")
             ("valid-rc", po::value<vector<int> >()->composing(), "Valid return code from the target program (default to 0, can be set more than once). Returning code not within this list by the target program causes Pilot to terminate.")
             ("verbose,v", "Print debug information")
             ("work-amount,w", po::value<string>(), "Set the valid range of work amount [min,max]")
@@ -369,6 +1710,20 @@ int handle_run_program(int argc, const char** argv) {
         cerr << e.what() << endl;
         return 1;
     }
+    const char *program_only_opts[] = {"cgroup", "cgroup-limit", "cgroup-pi", "compare", "coprocess",
+                                       "cpuset-per-instance", "duration-col", "include-spawn-time", "instances",
+                                       "max-pressure", "param", "resource-pi", "round-retries", "round-timeout",
+                                       "unit-readings", "ur-file", "valid-rc"};
+    for (const char *opt : program_only_opts) {
+        if (plugin && vm.count(opt)) {
+            cerr << "--" << opt << " cannot be used with run_plugin" << endl;
+            return 2;
+        }
+    }
+    if (!plugin && vm.count("cpu")) {
+        cerr << "--cpu can only be used with run_plugin" << endl;
+        return 2;
+    }
 
     if (vm.count("help")) {
         cerr << desc << endl;
@@ -396,39 +1751,338 @@ int handle_run_program(int argc, const char** argv) {
     if (vm.count("tui"))
         use_tui = true;
 
+    bool journal = false;
+    if (vm.count("journal")) {
+        if (!vm.count("output-dir")) {
+            fatal_log << "--journal requires --output-dir to be set";
+            return 2;
+        }
+        journal = true;
+    }
+
+    bool resume = false;
+    if (vm.count("resume")) {
+        if (!vm.count("output-dir")) {
+            fatal_log << "--resume requires --output-dir to be set to the output directory of the interrupted session";
+            return 2;
+        }
+        resume = true;
+    }
+
     if (vm.count("output-dir")) {
         g_output_dir = vm["output-dir"].as<string>();
     } else {
         g_output_dir = "pilot_result_" + get_timestamp();
     }
     info_log << "Saving results to directory " << g_output_dir;
-    g_round_results_dir = g_output_dir + "/round_results";
-    create_directories(g_round_results_dir);
+
+    if (vm.count("coprocess")) {
+        g_coprocess = true;
+        // a client that exits early must not kill us when we send it a request
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+    if (vm.count("round-timeout")) {
+        g_round_timeout = vm["round-timeout"].as<int>();
+        if (g_round_timeout <= 0) {
+            fatal_log << "Round timeout must be greater than 0";
+            return 2;
+        }
+        info_log << "Setting the round timeout to " << g_round_timeout << " seconds";
+    }
+    if (vm.count("round-retries")) {
+        if (0 == g_round_timeout) {
+            fatal_log << "--round-retries requires --round-timeout";
+            return 2;
+        }
+        g_round_retries = vm["round-retries"].as<size_t>();
+    }
+    if (vm.count("include-spawn-time")) {
+        g_include_spawn_time = true;
+    }
+    if (vm.count("unit-readings")) {
+        g_unit_readings = true;
+        // inherited by the client programs
+        setenv("PILOT_UR_FD", to_string(UR_STREAM_FD).c_str(), true);
+    }
+    if (vm.count("ur-file")) {
+        if (g_unit_readings) {
+            fatal_log << "--ur-file cannot be used with --unit-readings";
+            return 2;
+        }
+        for (const string &f : vm["ur-file"].as<vector<string> >()) {
+            vector<string> fields;
+            boost::split(fields, f, boost::is_any_of(","));
+            ur_file_t ur_file;
+            try {
+                if (fields.size() < 2 || fields.size() > 3 || fields[0].empty())
+                    throw runtime_error("wrong number of fields");
+                ur_file.pattern = fields[0];
+                ur_file.column = lexical_cast<size_t>(fields[1]);
+                ur_file.binary = (3 == fields.size() && "binary" == fields[2]);
+                if (3 == fields.size() && !ur_file.binary && "text" != fields[2])
+                    throw runtime_error("unknown format");
+            } catch (const exception &) {
+                fatal_log << "Unit readings file must be in \"pattern,column[,text|binary]\" format: " << f;
+                return 2;
+            }
+            g_ur_files.push_back(ur_file);
+        }
+    }
+
+    if (vm.count("resource-pi")) {
+        if (g_coprocess || g_unit_readings || !g_ur_files.empty()) {
+            fatal_log << "--resource-pi cannot be used with --coprocess, --unit-readings, or --ur-file";
+            return 2;
+        }
+        for (const string &name : vm["resource-pi"].as<vector<string> >()) {
+            int r = 0;
+            while (r < NUM_OF_RESOURCES && name != kResources[r].name)
+                ++r;
+            if (NUM_OF_RESOURCES == r) {
+                fatal_log << "Unknown resource: " << name;
+                return 2;
+            }
+            g_resource_pis.push_back(static_cast<resource_t>(r));
+        }
+    }
+
+    vector<pair<string, string> > cgroup_limits;
+    if (!vm.count("cgroup") && (vm.count("cgroup-limit") || vm.count("cgroup-pi") || vm.count("max-pressure"))) {
+        fatal_log << "--cgroup-limit, --cgroup-pi, and --max-pressure require --cgroup";
+        return 2;
+    }
+    if (vm.count("cgroup-limit")) {
+        for (const string &limit : vm["cgroup-limit"].as<vector<string> >()) {
+            size_t eq = limit.find('=');
+            if (string::npos == eq || 0 == eq || limit.find('/') < eq) {
+                fatal_log << "Cgroup limit must be in \"FILE=VALUE\" format: " << limit;
+                return 2;
+            }
+            cgroup_limits.emplace_back(limit.substr(0, eq), limit.substr(eq + 1));
+        }
+    }
+    if (vm.count("cgroup-pi")) {
+        for (const string &name : vm["cgroup-pi"].as<vector<string> >()) {
+            int i = 0;
+            while (i < NUM_OF_CGROUP_STATS && name != kCgroupStats[i].name)
+                ++i;
+            if (NUM_OF_CGROUP_STATS == i) {
+                fatal_log << "Unknown cgroup statistic: " << name;
+                return 2;
+            }
+            g_cgroup_pis.push_back(static_cast<cgroup_stat_t>(i));
+        }
+    }
+    if (vm.count("max-pressure")) {
+        g_max_pressure = vm["max-pressure"].as<double>();
+        if (g_max_pressure <= 0 || g_max_pressure > 100) {
+            fatal_log << "Valid range for the maximum pressure is (0,100], exiting...";
+            return 2;
+        }
+    }
+
+    bool compare = false;
+    size_t max_num_of_pairs = 0;
+    if (vm.count("compare")) {
+        if (journal || resume || use_tui) {
+            fatal_log << "--compare cannot be used with --journal, --resume, or --tui";
+            return 2;
+        }
+        max_num_of_pairs = vm["compare"].as<size_t>();
+        if (0 == max_num_of_pairs) {
+            fatal_log << "The maximum number of pairs must be greater than 0";
+            return 2;
+        }
+        compare = true;
+    }
+
+    // parse the parameters and objectives of --param mode
+    vector<pair<string, vector<string> > > params;
+    vector<size_t> objective_piids;
+    vector<bool> objective_lower_is_better;
+    if (vm.count("param")) {
+        if (journal || resume || use_tui || compare) {
+            fatal_log << "--param cannot be used with --journal, --resume, --tui, or --compare";
+            return 2;
+        }
+        for (const string &p : vm["param"].as<vector<string> >()) {
+            size_t eq = p.find('=');
+            if (string::npos == eq || 0 == eq || eq == p.size() - 1) {
+                fatal_log << "Parameter must be in \"NAME=VALUE1,VALUE2,...\" format: " << p;
+                return 2;
+            }
+            vector<string> values;
+            boost::split(values, p.substr(eq + 1), boost::is_any_of(","));
+            params.emplace_back(p.substr(0, eq), values);
+        }
+        if (!vm.count("objective")) {
+            fatal_log << "--param requires at least one --objective";
+            return 2;
+        }
+        for (const string &o : vm["objective"].as<vector<string> >()) {
+            vector<string> fields;
+            boost::split(fields, o, boost::is_any_of(","));
+            if (2 != fields.size() || ("min" != fields[1] && "max" != fields[1])) {
+                fatal_log << "Objective must be in \"PIID,min\" or \"PIID,max\" format: " << o;
+                return 2;
+            }
+            try {
+                objective_piids.push_back(lexical_cast<size_t>(fields[0]));
+            } catch (const boost::bad_lexical_cast &) {
+                fatal_log << "Invalid PIID in objective: " << o;
+                return 2;
+            }
+            objective_lower_is_better.push_back("min" == fields[1]);
+        }
+    }
+
+    size_t num_of_instances = 1;
+    if (vm.count("instances")) {
+        num_of_instances = vm["instances"].as<size_t>();
+        if (0 == num_of_instances) {
+            fatal_log << "The number of instances must be greater than 0";
+            return 2;
+        }
+        if (compare || !params.empty() || g_unit_readings || !g_ur_files.empty() || !g_resource_pis.empty()) {
+            fatal_log << "--instances cannot be used with --compare, --param, --unit-readings, --ur-file, or --resource-pi";
+            return 2;
+        }
+    }
+    vector<cpu_set_t> instance_cpusets;
+    if (vm.count("cpuset-per-instance")) {
+        if (compare || !params.empty()) {
+            fatal_log << "--cpuset-per-instance cannot be used with --compare or --param";
+            return 2;
+        }
+        vector<string> cpusets;
+        boost::split(cpusets, vm["cpuset-per-instance"].as<string>(), boost::is_any_of(":"));
+        if (cpusets.size() != num_of_instances) {
+            fatal_log << "--cpuset-per-instance must have one CPU set for each of the " << num_of_instances << " instances";
+            return 2;
+        }
+        for (const string &cpus : cpusets) {
+            instance_cpusets.emplace_back();
+            if (!_parse_cpuset(cpus, &instance_cpusets.back())) {
+                fatal_log << "Invalid CPU set: " << cpus;
+                return 2;
+            }
+        }
+    }
 
     // parse program_cmd
     if (0 == program_path_start_loc || program_path_start_loc == argc - 1) {
-        fatal_log << "Error: program_path is required" << endl;
+        fatal_log << "Error: " << (plugin ? "plugin_path" : "program_path") << " is required" << endl;
         cerr << desc << endl;
         return 2;
     }
     ++program_path_start_loc;   // move pass "--"
-    g_client_cmd = &(argv[program_path_start_loc]);
-    g_client_cmd_len = argc - program_path_start_loc;
-    string client_cmd_str = g_client_name = string(argv[program_path_start_loc]);
-    while (++program_path_start_loc < argc) {
-        client_cmd_str += " ";
-        client_cmd_str += argv[program_path_start_loc];
+    int program_path_end_loc = argc;
+    if (compare) {
+        program_path_end_loc = program_path_start_loc;
+        while (program_path_end_loc < argc && strcmp(argv[program_path_end_loc], ":::") != 0)
+            ++program_path_end_loc;
+        if (program_path_end_loc == program_path_start_loc || program_path_end_loc >= argc - 1) {
+            fatal_log << "Error: --compare requires two programs separated by :::" << endl;
+            cerr << desc << endl;
+            return 2;
+        }
     }
     info_log << GREETING_MSG;
-    debug_log << "Program path and args: " << client_cmd_str;
+    for (int i = 0; i < (compare ? 2 : 1); ++i) {
+        client_program_t client;
+        client.cmd = &(argv[program_path_start_loc]);
+        client.cmd_len = program_path_end_loc - program_path_start_loc;
+        string client_cmd_str = client.name = string(argv[program_path_start_loc]);
+        while (++program_path_start_loc < program_path_end_loc) {
+            client_cmd_str += " ";
+            client_cmd_str += argv[program_path_start_loc];
+        }
+        debug_log << "Program path and args" << (compare ? (0 == i ? " (A)" : " (B)") : "") << ": " << client_cmd_str;
+        client.output_dir = compare ? g_output_dir + (0 == i ? "/A" : "/B") : g_output_dir;
+        g_clients.push_back(client);
+
+        // move past ":::" to program B
+        program_path_start_loc = program_path_end_loc + 1;
+        program_path_end_loc = argc;
+    }
+    // one client for each combination of the parameter values
+    for (const auto &param : params) {
+        const string macro = "%PARAM:" + param.first + "%";
+        const client_program_t &c = g_clients[0];
+        if (none_of(c.cmd, c.cmd + c.cmd_len, [&macro](const char *arg) { return string(arg).find(macro) != string::npos; })) {
+            fatal_log << "Parameter " << param.first << " is not used: " << macro << " is not in program_options";
+            return 2;
+        }
+        vector<client_program_t> clients;
+        for (const client_program_t &c : g_clients) {
+            for (const string &value : param.second) {
+                clients.push_back(c);
+                clients.back().params.emplace_back(param.first, value);
+            }
+        }
+        g_clients.swap(clients);
+    }
+    if (!params.empty()) {
+        for (size_t i = 0; i < g_clients.size(); ++i)
+            g_clients[i].output_dir = g_output_dir + "/" + to_string(i);
+    }
+    for (client_program_t &client : g_clients) {
+        client.round_results_dir = client.output_dir + "/round_results";
+        create_directories(client.round_results_dir);
+    }
+    if (vm.count("cgroup")) {
+        g_cgroup_parent = vm["cgroup"].as<string>();
+        bool ok = true;
+        if (g_cgroup_parent.empty()) {
+            g_cgroup_parent = _own_cgroup_dir();
+            if (g_cgroup_parent.empty()) {
+                warning_log << "Cannot find the cgroup v2 hierarchy";
+                ok = false;
+            } else {
+                _enter_self_cgroup(g_cgroup_parent);
+            }
+        }
+        if (ok)
+            _enable_cgroup_controllers(g_cgroup_parent);
+        for (size_t i = 0; ok && i < g_clients.size(); ++i)
+            ok = _create_cgroup(&g_clients[i], str(format("%1%/pilot.%2%.%3%") % g_cgroup_parent % getpid() % i));
+        if (!ok) {
+            _remove_cgroups();
+            if (!cgroup_limits.empty()) {
+                fatal_log << "Cannot create the cgroups, so --cgroup-limit cannot be set";
+                return 1;
+            }
+            warning_log << "Running the programs without cgroups, --cgroup-pi and --max-pressure are ignored";
+            g_cgroup_pis.clear();
+            g_max_pressure = 0;
+        }
+        g_cgroup_required = !cgroup_limits.empty() || g_max_pressure > 0;
+        for (size_t i = 0; ok && i < g_clients.size(); ++i) {
+            if (!_set_cgroup_limits(&g_clients[i], cgroup_limits))
+                return 1;
+        }
+    }
+    // the instances share the workload, the results, and the cgroup of g_clients[0]
+    for (size_t i = 0; num_of_instances > 1 && i < num_of_instances; ++i) {
+        g_instances.push_back(g_clients[0]);
+        g_instances.back().instance = i;
+    }
+    for (size_t i = 0; i < instance_cpusets.size(); ++i) {
+        client_program_t &client = g_instances.empty() ? g_clients[0] : g_instances[i];
+        client.has_cpuset = true;
+        client.cpuset = instance_cpusets[i];
+    }
 
     // create the workload
-    g_wl.reset(pilot_new_workload(g_client_name.c_str()), pilot_destroy_workload);
+    g_wl.reset(pilot_new_workload(g_clients[0].name.c_str()), pilot_destroy_workload);
+    for (size_t i = 1; i < g_clients.size(); ++i)
+        g_other_wls.emplace_back(pilot_new_workload(g_clients[i].name.c_str()), pilot_destroy_workload);
     if (signal(SIGINT, sigint_handler) == SIG_ERR) {
         fatal_log << "signal(): " << strerror(errno) << endl;
         return 1;
     }
-    if (!g_wl) {
+    if (!g_wl || any_of(g_other_wls.begin(), g_other_wls.end(), [](const shared_ptr<pilot_workload_t> &wl) { return !wl; })) {
         fatal_log << "Error: cannot create workload";
         return 3;
     }
@@ -442,12 +2096,12 @@ int handle_run_program(int argc, const char** argv) {
     if (vm.count("work-amount")) {
         vector<int> wa_cols{0, 1};
         vector<size_t> wa = extract_csv_fields<size_t>(vm["work-amount"].as<string>(), wa_cols);
-        pilot_set_init_work_amount(g_wl.get(), wa[0]);
-        pilot_set_work_amount_limit(g_wl.get(), wa[1]);
-        info_log << str(format("Setting work amount range to [%1%, %2%]") % wa[0] % wa[1]);
+        set_all_workloads(pilot_set_init_work_amount, wa[0]);
+        set_all_workloads(pilot_set_work_amount_limit, wa[1]);
+        info_log << format("Setting work amount range to [%1%, %2%]") % wa[0] % wa[1];
     } else {
         // this workload doesn't need work amount
-        pilot_set_work_amount_limit(g_wl.get(), 0);
+        set_all_workloads(pilot_set_work_amount_limit, 0);
     }
 
     // parse session limit
@@ -458,21 +2112,22 @@ int handle_run_program(int argc, const char** argv) {
             return 2;
         }
         info_log << format("Setting session limit to %1% seconds") % session_limit;
-        pilot_set_session_duration_limit(g_wl.get(), static_cast<size_t>(session_limit));
+        set_all_workloads(pilot_set_session_duration_limit, static_cast<size_t>(session_limit));
     }
 
     // parse and set PI info
     g_num_of_pi = 0;
+    int compared_piid = -1;
     try {
         if (vm.count("pi")) {
             vector<string> pi_info_strs;
             boost::split(pi_info_strs, vm["pi"].as<string>(), boost::is_any_of(":"));
-            g_num_of_pi = pi_info_strs.size();
+            g_num_of_pi = pi_info_strs.size() + g_resource_pis.size() + g_cgroup_pis.size();
             if (0 == g_num_of_pi) {
                 throw runtime_error("Error parsing PI information: empty string provided");
             }
             debug_log << "Total number of PIs: " << g_num_of_pi;
-            pilot_set_num_of_pi(g_wl.get(), g_num_of_pi);
+            set_all_workloads(pilot_set_num_of_pi, g_num_of_pi);
 
             int num_of_PIs_must_satisfy = 0;
             for (auto &pistr : pi_info_strs) {
@@ -503,32 +2158,71 @@ int handle_run_program(int argc, const char** argv) {
                 bool reading_must_satisfy = false;
                 if (pidata.size() > 4) {
                     reading_must_satisfy = lexical_cast<bool>(pidata[4]);
-                    if (reading_must_satisfy)
+                    if (reading_must_satisfy) {
+                        if (0 == num_of_PIs_must_satisfy)
+                            compared_piid = g_pi_col.size() - 1;
                         ++num_of_PIs_must_satisfy;
+                    }
                 }
+                bool sum_instances = false;
+                if (pidata.size() > 5) {
+                    sum_instances = ("sum" == pidata[5]);
+                    if (!sum_instances && "mean" != pidata[5]) {
+                        throw runtime_error("Error: the instances field of PI info must be sum or mean");
+                    }
+                }
+                g_pi_sum.push_back(sum_instances);
                 debug_log << "PI[" << g_pi_col.size() - 1 << "] name: " << pi_name << ", "
                           << "unit: " << pi_unit << ", "
                           << "reading must satisfy: " << (reading_must_satisfy? "yes" : "no") << ", "
                           << "mean method: " << (pi_mean_method == 0? "arithmetic": "harmonic");
-                pilot_set_pi_info(g_wl.get(), g_pi_col.size() - 1,  /* PIID */
+                set_all_workloads(pilot_set_pi_info,
+                                  g_pi_col.size() - 1,            /* PIID */
                                   pi_name.c_str(),                /* PI name */
                                   pi_unit.c_str(),                /* PI unit */
-                                  NULL, NULL,                     /* format functions */
+                                  nullptr, nullptr,               /* format functions */
                                   reading_must_satisfy,
                                   false,                          /* unit readings no need to satisfy */
                                   pi_mean_method,
                                   ARITHMETIC_MEAN,
                                   pi_ci_type);
             }
+            for (size_t i = 0; i < g_resource_pis.size(); ++i) {
+                const resource_t r = g_resource_pis[i];
+                set_all_workloads(pilot_set_pi_info,
+                                  g_pi_col.size() + i,            /* PIID */
+                                  kResources[r].name, kResources[r].unit,
+                                  nullptr, nullptr,
+                                  false, false,                   /* record data only */
+                                  ARITHMETIC_MEAN, ARITHMETIC_MEAN, SAMPLE_MEAN);
+            }
+            for (size_t i = 0; i < g_cgroup_pis.size(); ++i) {
+                const cgroup_stat_t stat = g_cgroup_pis[i];
+                set_all_workloads(pilot_set_pi_info,
+                                  g_pi_col.size() + g_resource_pis.size() + i,  /* PIID */
+                                  kCgroupStats[stat].name, kCgroupStats[stat].unit,
+                                  nullptr, nullptr,
+                                  false, false,                   /* record data only */
+                                  ARITHMETIC_MEAN, ARITHMETIC_MEAN, SAMPLE_MEAN);
+            }
             if (0 == num_of_PIs_must_satisfy) {
                 throw runtime_error("Error: at least one PI needs to have must_satisfy set.");
             }
+            if (!g_ur_files.empty() && g_ur_files.size() != static_cast<size_t>(g_num_of_pi)) {
+                throw runtime_error("Error: --ur-file must be set once for each PI");
+            }
         } else {
             if ((size_t)-1 != g_duration_col) {
                 info_log << "No PI information, will do WPS analysis only";
             } else {
                 throw runtime_error("Error: no PI or duration column set, exiting...");
             }
+            if (compare || !params.empty()) {
+                throw runtime_error("Error: --compare and --param require PIs to compare");
+            }
+            if (g_unit_readings || !g_ur_files.empty() || !g_resource_pis.empty() || !g_cgroup_pis.empty()) {
+                throw runtime_error("Error: --unit-readings, --ur-file, --resource-pi, and --cgroup-pi require PIs");
+            }
         }
     } catch (const runtime_error &e) {
         cerr << e.what() << endl;
@@ -541,8 +2235,9 @@ int handle_run_program(int argc, const char** argv) {
         g_valid_rc.push_back(0);
     }
 
+    // a plugin's round duration is reported by it or measured by us
     if (vm.count("wps")) {
-        if ((size_t)-1 == g_duration_col) {
+        if (!plugin && (size_t)-1 == g_duration_col) {
             cerr << "Duration column must be set for WPS analysis";
             return 2;
         }
@@ -550,14 +2245,22 @@ int handle_run_program(int argc, const char** argv) {
             cerr << "Work amount must be set for WPS analysis";
             return 2;
         }
-        pilot_set_wps_analysis(g_wl.get(), NULL, true, true);
+        set_all_workloads(pilot_set_wps_analysis, nullptr, true, true, WPS_EVEN_SLICES);
         info_log << "WPS analysis enabled";
-    } else if ((size_t)-1 != g_duration_col && vm.count("work-amount")) {
-        pilot_set_wps_analysis(g_wl.get(), NULL, true, false);
+    } else if ((plugin || (size_t)-1 != g_duration_col) && vm.count("work-amount")) {
+        set_all_workloads(pilot_set_wps_analysis, nullptr, true, false, WPS_EVEN_SLICES);
+    } else {
+        set_all_workloads(pilot_set_wps_analysis, nullptr, false, false, WPS_EVEN_SLICES);
+    }
+    if (plugin) {
+        pilot_set_workload_func(g_wl.get(), plugin_workload_func);
+        pilot_set_workload_data(g_wl.get(), &g_plugin);
     } else {
-        pilot_set_wps_analysis(g_wl.get(), NULL, false, false);
+        set_all_workloads(pilot_set_workload_func, workload_func);
+        pilot_set_workload_data(g_wl.get(), &g_clients[0]);
+        for (size_t i = 0; i < g_other_wls.size(); ++i)
+            pilot_set_workload_data(g_other_wls[i].get(), &g_clients[i + 1]);
     }
-    pilot_set_workload_func(g_wl.get(), workload_func);
 
     string preset_mode = "quick";
     if (vm.count("preset")) {
@@ -610,12 +2313,12 @@ int handle_run_program(int argc, const char** argv) {
             fatal_log << "Error: CI (percent of mean) and CI (absolute value) cannot be both disabled. At least one must be set.";
             return 2;
         }
-        pilot_set_required_confidence_interval(g_wl.get(), ci_perc, ci);
+        set_all_workloads(pilot_set_required_confidence_interval, ci_perc, ci);
         if (ci_perc > 0) {
-            info_log << str(format("Setting the required width of confidence interval to %1%%% of mean") % (ci_perc * 100));
+            info_log << format("Setting the required width of confidence interval to %1%%% of mean") % (ci_perc * 100);
         }
         if (ci > 0) {
-            info_log << str(format("Setting the required width of confidence interval to %1%") % ci);
+            info_log << format("Setting the required width of confidence interval to %1%") % ci;
         }
 
         if (vm.count("ac")) {
@@ -625,7 +2328,7 @@ int handle_run_program(int argc, const char** argv) {
                 return 2;
             }
         }
-        pilot_set_autocorrelation_coefficient(g_wl.get(), ac);
+        set_all_workloads(pilot_set_autocorrelation_coefficient, ac);
         info_log << "Setting the limit of autocorrelation coefficient to " << ac;
 
         if (vm.count("min-sample-size")) {
@@ -634,19 +2337,97 @@ int handle_run_program(int argc, const char** argv) {
         } else {
             info_log << "Setting the required minimum subsession sample size to " << ms;
         }
-        pilot_set_min_sample_size(g_wl.get(), ms);
+        set_all_workloads(pilot_set_min_sample_size, ms);
 
         if (vm.count("work-amount")) {
-            pilot_set_short_round_detection_threshold(g_wl.get(), sr);
+            set_all_workloads(pilot_set_short_round_detection_threshold, sr);
             info_log << "Setting the short round threshold to " << sr << " second(s)";
         } else {
-            pilot_set_short_round_detection_threshold(g_wl.get(), 0);
+            set_all_workloads(pilot_set_short_round_detection_threshold, 0);
             info_log << "Disabled short round detection because work amount information is not set.";
         }
 
     }
+    // the fini of the plugin is called and the plugin is closed on every
+    // return below
+    shared_ptr<void> plugin_scope_guard(NULL, [](void*) { _unload_plugin(); });
+    if (plugin) {
+        // the plugin is initialized on the CPU that it will run on
+        _pin_thread(vm.count("cpu") ? vm["cpu"].as<int>() : -1);
+        if (0 != _load_plugin(g_clients[0].cmd_len, g_clients[0].cmd))
+            return 1;
+    }
+
+    // With --journal every round is journaled so an interrupted session can be
+    // continued with --resume
+    const string journal_file = g_output_dir + "/session.journal";
+    if (resume) {
+        int res = pilot_load_journal(g_wl.get(), journal_file.c_str());
+        if (0 != res) {
+            fatal_log << "Cannot resume from " << journal_file << ": " << pilot_strerror(res);
+            return res;
+        }
+        info_log << "Resuming the session from round " << pilot_get_num_of_rounds(g_wl.get());
+    } else if (journal) {
+        int res = pilot_set_journal(g_wl.get(), journal_file.c_str());
+        if (0 != res) {
+            warning_log << "Cannot create " << journal_file << ", the session cannot be resumed if interrupted";
+        }
+    }
+
     int wl_res;
-    if (use_tui)
+    if (compare) {
+        pilot_ab_result_t ab;
+        wl_res = pilot_run_ab_comparison(g_wl.get(), g_other_wls[0].get(), compared_piid, &ab, max_num_of_pairs);
+        if (0 != wl_res && ERR_STOPPED_BY_REQUEST != wl_res) {
+            cerr << pilot_strerror(wl_res) << endl;
+        }
+        const char *decision_strs[] = {"undecided", "B is lower than A", "B is higher than A",
+                                       "B is equivalent to A", "inconclusive"};
+        if (!g_quiet) {
+            cout << format("A/B comparison of PI %1% after %2% pairs: %3%") % compared_piid % ab.pairs % decision_strs[ab.decision] << endl;
+            cout << format("Mean difference (B - A): %1%, CI: [%2%, %3%], p-value: %4%")
+                    % ab.mean_diff % ab.ci_left % ab.ci_right % ab.p_value << endl;
+        } else {
+            cout << "piid,pairs,decision,mean_diff,ci_left,ci_right,p_value" << endl;
+            cout << format("%1%,%2%,%3%,%4%,%5%,%6%,%7%") % compared_piid % ab.pairs % ab.decision
+                    % ab.mean_diff % ab.ci_left % ab.ci_right % ab.p_value << endl;
+        }
+    } else if (!params.empty()) {
+        vector<pilot_workload_t*> wls{g_wl.get()};
+        for (auto &wl : g_other_wls)
+            wls.push_back(wl.get());
+        const size_t K = objective_piids.size();
+        unique_ptr<bool[]> lower_is_better(new bool[K]);
+        copy(objective_lower_is_better.begin(), objective_lower_is_better.end(), lower_is_better.get());
+        unique_ptr<bool[]> on_frontier(new bool[wls.size()]);
+        vector<double> means(wls.size() * K);
+        wl_res = pilot_run_pareto_search(wls.data(), wls.size(), objective_piids.data(),
+                                         lower_is_better.get(), K, on_frontier.get(), means.data());
+        if (0 != wl_res && ERR_STOPPED_BY_REQUEST != wl_res) {
+            cerr << pilot_strerror(wl_res) << endl;
+        }
+        if (!g_quiet) {
+            cout << "Results of the parameter search (on_frontier is 1 for the Pareto frontier):" << endl;
+        }
+        // print one line for each combination of the parameter values
+        cout << "config";
+        for (const auto &param : params)
+            cout << "," << param.first;
+        cout << ",on_frontier,rounds";
+        for (size_t k = 0; k < K; ++k)
+            cout << ",pi" << objective_piids[k] << "_mean";
+        cout << endl;
+        for (size_t i = 0; i < wls.size(); ++i) {
+            cout << i;
+            for (const auto &param : g_clients[i].params)
+                cout << "," << param.second;
+            cout << "," << on_frontier[i] << "," << pilot_get_num_of_rounds(wls[i]);
+            for (size_t k = 0; k < K; ++k)
+                cout << "," << means[i * K + k];
+            cout << endl;
+        }
+    } else if (use_tui)
         pilot_run_workload_tui(g_wl.get());
     else {
         wl_res = pilot_run_workload(g_wl.get());
@@ -688,16 +2469,32 @@ int handle_run_program(int argc, const char** argv) {
         } /* if in quiet output mode */
     }
 
-    int res = pilot_export(g_wl.get(), g_output_dir.c_str());
+    int res = pilot_export(g_wl.get(), g_clients[0].output_dir.c_str());
+    for (size_t i = 0; 0 == res && i < g_other_wls.size(); ++i)
+        res = pilot_export(g_other_wls[i].get(), g_clients[i + 1].output_dir.c_str());
     if (res != 0) {
         cout << pilot_strerror(res) << endl;
         return res;
     }
     info_log << "Results saved in " << g_output_dir;
 
-    if (g_client_pid != 0) {
-        kill(g_client_pid, SIGTERM);
+    for (client_program_t &client : g_clients) {
+        _stop_client(&client);
+    }
+    for (client_program_t &instance : g_instances) {
+        _stop_client(&instance);
     }
 
     return wl_res;
 }
+
+int handle_run_program(int argc, const char** argv) {
+    int res = _handle_run(argc, argv, false);
+    // also done here so that no cgroup is left behind when we exit early
+    _remove_cgroups();
+    return res;
+}
+
+int handle_run_plugin(int argc, const char** argv) {
+    return _handle_run(argc, argv, true);
+}
@@ -1,6 +1,8 @@
 #!/usr/bin/env bash
 # Mock benchmark for testing Pilot CLI. This script displays one mock benchmark
-# result on each run. Progress is stored at /tmp/pilot_mock_benchmark_round.txt.
+# result on each run. Progress is stored at /tmp/pilot_mock_benchmark_round.txt,
+# or the file set by PILOT_MOCK_ROUND_FILE. PILOT_MOCK_OFFSET is added to the
+# results if set.
 #
 # Copyright (c) 2017-2019 Yan Li <yanli@tuneup.ai>. All rights reserved.
 # The Pilot tool and library is free software; you can redistribute it
@@ -50,11 +52,43 @@
 set -euo pipefail
 
 # If $1 is "-r" we return 0,1 alternatively to test Pilot's option "valid-rc"
+# If $1 is "-c" we keep running and answer the requests of Pilot's option
+# "coprocess" from stdin
+# If $1 is "-u" we also write 3 unit readings (1.0, 2.0, and 3.0) to the stream
+# of Pilot's option "unit-readings"
+# If $1 is "-U" we do the same as "-u" but first print 100 KiB of empty lines,
+# more than a pipe buffer, before the result line
+# If $1 is "-C" we write a corrupt record that claims 2^40 unit readings to the
+# stream of Pilot's option "unit-readings"
+# If $1 is "-f" we also write the same unit readings to a fio-style log in
+# directory $2 for Pilot's option "ur-file"
+# If $1 is "-e" we take 0.5 seconds to exit after printing the result, to test
+# that Pilot's option "resource-pi" doesn't count it in the round duration
+# If $1 is "-h" we hang in round 5 the first time it is run, to test Pilot's
+# option "round-timeout"
 
 # These sample response time are taken from [Ferrari78], page 79.
 DATA=(1.21 1.67 1.71 1.53 2.03 2.15 1.88 2.02 1.75 1.84 1.61 1.35 1.43 1.64 1.52 1.44 1.17 1.42 1.64 1.86 1.68 1.91 1.73 2.18 2.27 1.93 2.19 2.04 1.92 1.97 1.65 1.71 1.89 1.70 1.62 1.48 1.55 1.39 1.45 1.67 1.62 1.77 1.88 1.82 1.93 2.09 2.24 2.16)
 
-ROUND_FILE=/tmp/pilot_mock_benchmark_round.txt
+if [ "${1:-}" = "-c" ]; then
+    # Pilot ignores SIGPIPE in coprocess mode, but must not pass it on to us
+    if [ -r /proc/$$/status ] && (( 0x`awk '/^SigIgn/ {print $2}' /proc/$$/status` & 0x1000 )); then
+        exit 3
+    fi
+    ROUND=0
+    while read REQ_ROUND WORK_AMOUNT RESULT_DIR; do
+        if [ "$REQ_ROUND" != "$ROUND" ] || [ ! -d "$RESULT_DIR" ]; then
+            exit 2
+        fi
+        COLA=`echo ${DATA[$ROUND]} + ${PILOT_MOCK_OFFSET:-0} | bc`
+        COLB=`echo $COLA + 1 | bc`
+        echo $COLA,$COLB
+        ROUND=`expr $ROUND + 1`
+    done
+    exit 0
+fi
+
+ROUND_FILE=${PILOT_MOCK_ROUND_FILE:-/tmp/pilot_mock_benchmark_round.txt}
 
 if [ -f $ROUND_FILE ]; then
     ROUND=`cat $ROUND_FILE`
@@ -66,13 +100,36 @@ if [ $ROUND -ge ${#DATA[@]} ]; then
     exit 1
 fi
 
-COLA=${DATA[$ROUND]}
+if [ "${1:-}" = "-h" ] && [ $ROUND -eq 5 ] && [ ! -f "$ROUND_FILE.hung" ]; then
+    touch "$ROUND_FILE.hung"
+    sleep 1000
+fi
+
+COLA=`echo ${DATA[$ROUND]} + ${PILOT_MOCK_OFFSET:-0} | bc`
 COLB=`echo $COLA + 1 | bc`
+# the log must be complete before the result line is printed
+if [ "${1:-}" = "-f" ]; then
+    printf '1, 1, 0, 4096\n2, 2, 0, 4096\n3, 3, 0, 4096\n' >"$2/mock_lat.1.log"
+fi
+if [ "${1:-}" = "-U" ]; then
+    head -c 102400 /dev/zero | tr '\0' '\n'
+fi
 echo $COLA,$COLB
+if [ "${1:-}" = "-C" ]; then
+    printf '\x00\x00\x00\x00\x00\x01\x00\x00' >&${PILOT_UR_FD}
+fi
+if [ "${1:-}" = "-u" ] || [ "${1:-}" = "-U" ]; then
+    printf '\x03\x00\x00\x00\x00\x00\x00\x00' >&${PILOT_UR_FD}
+    printf '\x00\x00\x00\x00\x00\x00\xf0\x3f\x00\x00\x00\x00\x00\x00\x00\x40\x00\x00\x00\x00\x00\x00\x08\x40' >&${PILOT_UR_FD}
+fi
 
 ROUND=`expr $ROUND + 1`
 echo $ROUND >$ROUND_FILE
 
+if [ "${1:-}" = "-e" ]; then
+    sleep 0.5
+fi
+
 if [ "${1:-}" = "-r" ]; then
     exit `expr $ROUND % 2`
 fi
\ No newline at end of file
@@ -60,7 +60,7 @@ check() {
     rm -f /tmp/pilot_mock_benchmark_round.txt
     OUTPUT_DIR=`mktemp -d -u`
     ./bench run_program --ci-perc 0.3 --min-sample-size 10 --pi "response time,ms,0,0,1:delay time,ms,1,0" \
-        --quiet -o ${OUTPUT_DIR} \
+        --quiet --journal -o ${OUTPUT_DIR} \
         -- ./mock_benchmark.sh >"$TMPFILE" 2>&1
     # we don't directly compare the output with an expected file, because the
     # session_duration on the first line will always be different
@@ -72,6 +72,15 @@ check() {
     grep -q "0,44,1.72477,1.72477,0.0446593,0.0446593,0.283944,0.283944,0" "${OUTPUT_DIR}/pi_results.csv"
     grep -q "1,44,2.72477,2.72477,0.0446593,0.0446593,0.283944,0.283944,0" "${OUTPUT_DIR}/pi_results.csv"
 
+    # resuming a finished session loads all rounds from its journal and needs
+    # no more rounds
+    test -s "${OUTPUT_DIR}/session.journal"
+    ./bench run_program --ci-perc 0.3 --min-sample-size 10 --pi "response time,ms,0,0,1:delay time,ms,1,0" \
+        --quiet --resume -o ${OUTPUT_DIR} \
+        -- ./mock_benchmark.sh >"$TMPFILE" 2>&1
+    grep -q "0,1.72477,0.283944,0.0446593,0,1.72477,0.283944,0.0446593," "$TMPFILE"
+    grep -q "0,44,1.72477,1.72477,0.0446593,0.0446593,0.283944,0.283944,0" "${OUTPUT_DIR}/pi_results.csv"
+
     # TODO: add more checks here
 }
 
@@ -84,4 +93,127 @@ rm "$TMPFILE"
 rm -f /tmp/pilot_mock_benchmark_round.txt
 ./bench run_program --ci-perc 0.3 --min-sample-size 10 --pi "response time,ms,0,0,1" --valid-rc 0 --valid-rc 1\
     -- ./mock_benchmark.sh -r >"$TMPFILE" 2>&1
-check
\ No newline at end of file
+check
+# Test coprocess mode: a restarted mock would start again from the first
+# sample and give a different mean
+rm "$TMPFILE"
+./bench run_program --ci-perc 0.3 --min-sample-size 10 --pi "response time,ms,0,0,1:delay time,ms,1,0" \
+    --quiet --coprocess -- ./mock_benchmark.sh -c >"$TMPFILE" 2>&1
+grep -q "0,1.72477,0.283944,0.0446593,0,1.72477,0.283944,0.0446593," "$TMPFILE"
+# Test unit readings: the mock gives 1, 2, and 3 in every round
+rm "$TMPFILE"
+rm -f /tmp/pilot_mock_benchmark_round.txt
+OUTPUT_DIR=`mktemp -d -u`
+./bench run_program --ci-perc 0.3 --min-sample-size 10 --pi "response time,ms,0,0,1" \
+    --quiet --unit-readings -o ${OUTPUT_DIR} -- ./mock_benchmark.sh -u >"$TMPFILE" 2>&1
+grep -q "0,1.72477,0.283944,0.0446593,0,1.72477,0.283944,0.0446593," "$TMPFILE"
+grep -q "^0,44,1.72477,.*,132,2,2,0.671756,0.671756," "${OUTPUT_DIR}/pi_results.csv"
+# Test unit readings after more stdout than a pipe buffer holds
+rm "$TMPFILE"
+rm -f /tmp/pilot_mock_benchmark_round.txt
+OUTPUT_DIR=`mktemp -d -u`
+./bench run_program --ci-perc 0.3 --min-sample-size 10 --pi "response time,ms,0,0,1" \
+    --quiet --unit-readings --round-timeout 60 -o ${OUTPUT_DIR} -- ./mock_benchmark.sh -U >"$TMPFILE" 2>&1
+grep -q "0,1.72477,0.283944,0.0446593,0,1.72477,0.283944,0.0446593," "$TMPFILE"
+grep -q "^0,44,1.72477,.*,132,2,2,0.671756,0.671756," "${OUTPUT_DIR}/pi_results.csv"
+# A corrupt unit readings record fails the round instead of crashing Pilot
+rm -f /tmp/pilot_mock_benchmark_round.txt
+! ./bench run_program --ci-perc 0.3 --min-sample-size 10 --pi "response time,ms,0,0,1" \
+    --quiet --unit-readings -- ./mock_benchmark.sh -C >"$TMPFILE" 2>&1
+grep -q "Invalid number of unit readings" "$TMPFILE"
+# Test unit readings files: the same unit readings are in the mock's fio-style logs
+rm "$TMPFILE"
+rm -f /tmp/pilot_mock_benchmark_round.txt
+OUTPUT_DIR=`mktemp -d -u`
+./bench run_program --ci-perc 0.3 --min-sample-size 10 --pi "response time,ms,0,0,1" \
+    --quiet --ur-file "mock_lat.*.log,1" -o ${OUTPUT_DIR} -- ./mock_benchmark.sh -f %RESULT_DIR% >"$TMPFILE" 2>&1
+grep -q "0,1.72477,0.283944,0.0446593,0,1.72477,0.283944,0.0446593," "$TMPFILE"
+grep -q "^0,44,1.72477,.*,132,2,2,0.671756,0.671756," "${OUTPUT_DIR}/pi_results.csv"
+# Test resource usage PIs, which follow the PIs of the program's output. The
+# time the mock takes to exit is not in the round durations.
+rm "$TMPFILE"
+rm -f /tmp/pilot_mock_benchmark_round.txt
+OUTPUT_DIR=`mktemp -d -u`
+./bench run_program --ci-perc 0.3 --min-sample-size 10 --pi "response time,ms,0,0,1" \
+    --resource-pi maxrss --resource-pi wchar --quiet -o ${OUTPUT_DIR} -- ./mock_benchmark.sh -e >"$TMPFILE" 2>&1
+grep -q "0,1.72477,0.283944,0.0446593,0,1.72477,0.283944,0.0446593," "$TMPFILE"
+grep -q "^1,44,[1-9]" "${OUTPUT_DIR}/pi_results.csv"
+grep -q "^2,44,[1-9]" "${OUTPUT_DIR}/pi_results.csv"
+awk -F, 'NR > 1 && $3 >= 500000000 {exit 1}' "${OUTPUT_DIR}/rounds.csv"
+# Test cgroups: the program runs without them if they can't be created, which
+# doesn't change the results, but a limit that can't be set stops the run
+rm "$TMPFILE"
+rm -f /tmp/pilot_mock_benchmark_round.txt
+./bench run_program --ci-perc 0.3 --min-sample-size 10 --pi "response time,ms,0,0,1" \
+    --cgroup --cgroup-pi cpu.usage --quiet -- ./mock_benchmark.sh >"$TMPFILE" 2>&1
+grep -q "0,1.72477,0.283944,0.0446593,0,1.72477,0.283944,0.0446593," "$TMPFILE"
+rm -f /tmp/pilot_mock_benchmark_round.txt
+! ./bench run_program --ci-perc 0.3 --min-sample-size 10 --pi "response time,ms,0,0,1" \
+    --cgroup --cgroup-limit no.such.limit=1 --quiet -- ./mock_benchmark.sh >"$TMPFILE" 2>&1
+grep -q "cannot be set\|Cannot set no.such.limit" "$TMPFILE"
+test ! -f /tmp/pilot_mock_benchmark_round.txt
+# Test round timeout: the hung round is killed and retried
+rm "$TMPFILE"
+rm -f /tmp/pilot_mock_benchmark_round.txt /tmp/pilot_mock_benchmark_round.txt.hung
+./bench run_program --ci-perc 0.3 --min-sample-size 10 --pi "response time,ms,0,0,1" \
+    --round-timeout 2 --round-retries 1 --quiet -- ./mock_benchmark.sh -h >"$TMPFILE" 2>&1
+grep -q "0,1.72477,0.283944,0.0446593,0,1.72477,0.283944,0.0446593," "$TMPFILE"
+test -f /tmp/pilot_mock_benchmark_round.txt.hung
+rm -f /tmp/pilot_mock_benchmark_round.txt.hung
+# Test run_plugin: the mock plugin gives the same results as mock_benchmark.sh
+rm "$TMPFILE"
+./bench run_plugin --ci-perc 0.3 --min-sample-size 10 --pi "response time,ms,0,0,1:delay time,ms,1,0" \
+    --quiet -- ./libmock_plugin.so >"$TMPFILE" 2>&1
+grep -q "0,1.72477,0.283944,0.0446593,0,1.72477,0.283944,0.0446593," "$TMPFILE"
+grep -q "1,2.72477,0.283944,0.0446593,0,2.72477,0.283944,0.0446593"  "$TMPFILE"
+# The plugin is finalized even when the session fails to start
+FINI_FILE=`mktemp -u`
+OUTPUT_DIR=`mktemp -d -u`
+! PILOT_MOCK_FINI_FILE=$FINI_FILE ./bench run_plugin --pi "response time,ms,0,0,1" --quiet --resume \
+    -o ${OUTPUT_DIR} -- ./libmock_plugin.so >"$TMPFILE" 2>&1
+test -f $FINI_FILE
+rm $FINI_FILE
+# Test A/B comparison: B is always 0.5 higher than A, which is only trusted
+# after --min-sample-size pairs
+rm "$TMPFILE"
+A_ROUND_FILE=`mktemp -u`
+B_ROUND_FILE=`mktemp -u`
+OUTPUT_DIR=`mktemp -d -u`
+./bench run_program --min-sample-size 10 --pi "response time,ms,0,0,1" --compare 10 --quiet -o ${OUTPUT_DIR} \
+    -- env PILOT_MOCK_ROUND_FILE=${A_ROUND_FILE} ./mock_benchmark.sh \
+    ::: env PILOT_MOCK_ROUND_FILE=${B_ROUND_FILE} PILOT_MOCK_OFFSET=0.5 ./mock_benchmark.sh >"$TMPFILE" 2>&1
+grep -q "^0,10,2,0.5,0.5,0.5,0$" "$TMPFILE"
+grep -q "^0,1,1.67,$" "${OUTPUT_DIR}/A/readings.csv"
+grep -q "^0,1,2.17,$" "${OUTPUT_DIR}/B/readings.csv"
+# both A and B have the whole session log
+grep -q "Finished workload round 0" "${OUTPUT_DIR}/A/session_log.txt"
+grep -q "Finished workload round 0" "${OUTPUT_DIR}/B/session_log.txt"
+rm -f "$TMPFILE" "$A_ROUND_FILE" "$B_ROUND_FILE"
+
+# Test parameter search: the results of each value of off are shifted by off
+TMPFILE=`mktemp`
+ROUND_FILE_PREFIX=`mktemp -u`
+OUTPUT_DIR=`mktemp -d -u`
+./bench run_program --ci-perc 0.3 --min-sample-size 10 --pi "response time,ms,0,0,1" --quiet -o ${OUTPUT_DIR} \
+    --param off=0,0.5,1 --objective 0,min \
+    -- env PILOT_MOCK_ROUND_FILE=${ROUND_FILE_PREFIX}_%PARAM:off% PILOT_MOCK_OFFSET=%PARAM:off% ./mock_benchmark.sh >"$TMPFILE" 2>&1
+grep -q "^0,0,1,44,1.72477$" "$TMPFILE"
+grep -q "^1,0.5,0," "$TMPFILE"
+grep -q "^2,1,0," "$TMPFILE"
+test -s "${OUTPUT_DIR}/2/readings.csv"
+rm -f "$TMPFILE" ${ROUND_FILE_PREFIX}_*
+
+# Test instances: instance 1 is always 1 higher than instance 0, PI 0 is
+# averaged and PI 1 is summed. The instances are reaped at the end of each
+# round, and the 0.5 seconds they take to exit is not counted in the round
+# duration. Both instances share one CPU, so a round takes about 0.5 seconds.
+TMPFILE=`mktemp`
+ROUND_FILE_PREFIX=`mktemp -u`
+OUTPUT_DIR=`mktemp -d -u`
+./bench run_program --ci-perc 0.3 --min-sample-size 10 --pi "response time,ms,0,0,1:delay time,ms,1,0,0,sum" \
+    --quiet --instances 2 --cpuset-per-instance 0:0 -o ${OUTPUT_DIR} \
+    -- env PILOT_MOCK_ROUND_FILE=${ROUND_FILE_PREFIX}_%INSTANCE% PILOT_MOCK_OFFSET=%INSTANCE% ./mock_benchmark.sh -e >"$TMPFILE" 2>&1
+grep -q "^0,2.22477,0.283944,0.0446593,0," "$TMPFILE"
+grep -q "^1,6.44955,0.567887,0.178637,0," "$TMPFILE"
+awk -F, 'NR > 1 && $3 >= 900000000 {exit 1}' "${OUTPUT_DIR}/rounds.csv"
+rm -rf "$TMPFILE" ${ROUND_FILE_PREFIX}_* "${OUTPUT_DIR}"
@@ -51,6 +51,7 @@
 #include "gtest/gtest.h"
 #include "../pilot-cli.h"
 #include <string>
+#include <thread>
 
 using namespace std;
 
@@ -67,6 +68,77 @@ TEST(PilotCLIUnitTest, ExtractCSVFields) {
     ASSERT_DOUBLE_EQ(14, results2[1]);
 }
 
+TEST(PilotCLIUnitTest, LineReader) {
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    line_reader_t reader(fds[0]);
+    boost::string_ref line;
+    // nothing to read yet
+    ASSERT_EQ(line_reader_t::TIMED_OUT, reader.read_line(&line, 10));
+    ASSERT_EQ(2, write(fds[1], "5,", 2));
+    ASSERT_EQ(line_reader_t::TIMED_OUT, reader.read_line(&line, 10));
+
+    // lines much longer than the buffer and the pipe, empty lines, and a
+    // last line without '\n'
+    const string long_line(100000, '1');
+    const string data = "6\n" + long_line + ",1\n\n2\n" + long_line + ",3";
+    thread writer([&]() {
+        ASSERT_EQ(ssize_t(data.size()), write(fds[1], data.data(), data.size()));
+        close(fds[1]);
+    });
+    ASSERT_EQ(line_reader_t::LINE, reader.read_line(&line, 1000));
+    ASSERT_EQ("5,6", line);
+    ASSERT_EQ(line_reader_t::LINE, reader.read_line(&line));
+    ASSERT_EQ(long_line + ",1", line);
+    ASSERT_EQ(line_reader_t::LINE, reader.read_line(&line));
+    ASSERT_EQ("", line);
+    ASSERT_EQ(line_reader_t::LINE, reader.read_line(&line));
+    ASSERT_EQ("2", line);
+    ASSERT_EQ(line_reader_t::END_OF_FILE, reader.read_line(&line));
+    ASSERT_EQ(long_line + ",3", line);
+    ASSERT_EQ(line_reader_t::END_OF_FILE, reader.read_line(&line));
+    ASSERT_TRUE(line.empty());
+    writer.join();
+    close(fds[0]);
+}
+
+TEST(PilotCLIUnitTest, ParseUnitReadings) {
+    // fio-style log with a header, an empty line, and no '\n' at the end
+    const string fio = "time, lat, dir, bs\n1, 250, 0, 4096\n\n2, 1.5e2, 0, 4096\r\n3,\t-7 ,0,4096";
+    vector<double> urs{42};
+    ASSERT_EQ(3U, parse_unit_readings(fio.data(), fio.data() + fio.size(), 1, &urs));
+    ASSERT_EQ(vector<double>({42, 250, 150, -7}), urs);
+
+    // empty fields are kept in CSV files
+    const string csv = "1,,3\n4,,6\n";
+    urs.clear();
+    ASSERT_EQ(2U, parse_unit_readings(csv.data(), csv.data() + csv.size(), 2, &urs));
+    ASSERT_EQ(vector<double>({3, 6}), urs);
+    ASSERT_THROW(parse_unit_readings(csv.data(), csv.data() + csv.size(), 1, &urs), runtime_error);
+    // a missing column is an error after the first line
+    ASSERT_THROW(parse_unit_readings(csv.data(), csv.data() + csv.size(), 3, &urs), runtime_error);
+    // the data may be a part of a buffer
+    urs.clear();
+    ASSERT_EQ(1U, parse_unit_readings(csv.data(), csv.data() + 3, 0, &urs));
+    ASSERT_EQ(vector<double>({1}), urs);
+}
+
+TEST(PilotCLIUnitTest, SumCgroupStat) {
+    const string cpu_stat = "usage_usec 1500\nuser_usec 1000\nsystem_usec 500\nnr_periods 0\n";
+    ASSERT_EQ(1500, sum_cgroup_stat(cpu_stat, "", "usage_usec"));
+    ASSERT_EQ(0, sum_cgroup_stat(cpu_stat, "", "throttled_usec"));
+
+    // the devices are summed
+    const string io_stat = "8:0 rbytes=4096 wbytes=0 rios=1 wios=0\n8:16 rbytes=1024 wbytes=512 rios=1 wios=1\n";
+    ASSERT_EQ(5120, sum_cgroup_stat(io_stat, "", "rbytes"));
+    ASSERT_EQ(512, sum_cgroup_stat(io_stat, "", "wbytes"));
+
+    const string pressure = "some avg10=1.00 avg60=0.50 avg300=0.10 total=2500\n"
+                            "full avg10=0.00 avg60=0.00 avg300=0.00 total=700\n";
+    ASSERT_EQ(2500, sum_cgroup_stat(pressure, "some", "total"));
+    ASSERT_EQ(700, sum_cgroup_stat(pressure, "full", "total"));
+}
+
 int main(int argc, char **argv) {
     // this does away a gtest warning message, and we don't care about execution time
     ::testing::FLAGS_gtest_death_test_style = "threadsafe";
@@ -137,6 +137,13 @@ grep -q "Setting the short round threshold to 20 second(s)" $TMPFILE
 run ./bench run_program -v --pi "throughput,MB/s,2,1,1" --session-limit 50 -- true 2>&1 | grep -q "Setting session limit to 50 seconds"
 run ./bench run_program -v --pi "throughput,MB/s,2,1,1" --session-limit -1 -- true 2>&1 | grep -q "<fatal> Session limit must be greater than 0, exiting..."
 
+# Test resuming
+run ./bench run_program --pi "throughput,MB/s,2,1,1" --resume -- true 2>&1 | grep -q "<fatal> --resume requires --output-dir"
+run ./bench run_program --pi "throughput,MB/s,2,1,1" --journal -- true 2>&1 | grep -q "<fatal> --journal requires --output-dir"
+
+# Test parameter search
+run ./bench run_program --pi "throughput,MB/s,2,1,1" --param size=1,2 --objective 0,max -- true 2>&1 | grep -q "<fatal> Parameter size is not used: %PARAM:size% is not in program_options"
+
 # Test other options
 run ./bench run_program -v --pi "throughput,MB/s,2,1,1" -- true 2>&1 | grep -q "PI\[0\] name: throughput, unit: MB/s, reading must satisfy: yes, mean method: harmonic"
 
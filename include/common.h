@@ -62,12 +62,26 @@
 #include <string>
 #include <vector>
 
-#define trace_log   BOOST_LOG_TRIVIAL(trace)
-#define debug_log   BOOST_LOG_TRIVIAL(debug)
-#define info_log    BOOST_LOG_TRIVIAL(info)
-#define warning_log BOOST_LOG_TRIVIAL(warning)
-#define error_log   BOOST_LOG_TRIVIAL(error)
-#define fatal_log   BOOST_LOG_TRIVIAL(fatal)
+// Log statements below this level (0 trace, 1 debug, 2 info, 3 warning,
+// 4 error, 5 fatal) are compiled out entirely. Set it using the CMake
+// option PILOT_MIN_LOG_LEVEL.
+#ifndef PILOT_MIN_LOG_LEVEL
+#define PILOT_MIN_LOG_LEVEL 0
+#endif
+
+// BOOST_LOG_TRIVIAL checks the severity filters before evaluating the
+// streamed expressions, so the message is only built for records that will
+// be stored. Avoid building a message (e.g., with str(format(...))) before
+// streaming it to these macros.
+#define _pilot_log(level, sev) \
+    if ((level) < PILOT_MIN_LOG_LEVEL) {} else BOOST_LOG_TRIVIAL(sev)
+
+#define trace_log   _pilot_log(0, trace)
+#define debug_log   _pilot_log(1, debug)
+#define info_log    _pilot_log(2, info)
+#define warning_log _pilot_log(3, warning)
+#define error_log   _pilot_log(4, error)
+#define fatal_log   _pilot_log(5, fatal)
 
 // extra indirection so other macros can be used as parameter
 // http://stackoverflow.com/questions/6713420/c-convert-integer-to-string-at-compile-time#comment7949445_6713658
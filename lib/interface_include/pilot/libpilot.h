@@ -181,7 +181,7 @@ struct pilot_workload_t;
  * @param[in] total_work_amount
  * @param[in] data arbitrary data that can be passed to the workload func. Set by using pilot_set_workload_data().
  * @param[out] num_of_work_unit
- * @param[out] unit_readings the reading of each work unit. Format: unit_readings[piid][unit_id]. The user needs to allocate memory using lib_malloc_func.
+ * @param[out] unit_readings the reading of each work unit. Format: unit_readings[piid][unit_id]. The user needs to allocate memory using lib_malloc_func. unit_readings[piid] can be NULL for a PI without unit readings in this round.
  * @param[out] readings the final readings of this workload run. Format: readings[piid]. The user needs to allocate memory using lib_malloc_func.
  * @return
  */
@@ -387,6 +387,22 @@ enum pilot_warm_up_removal_detection_method_t {
     EDM,
 };
 
+/**
+ * \brief The methods for deciding the work amount of the next round
+ * \details GREEDY_PLANNER uses the largest work amount proposed by the
+ * runtime analysis plugins. MPC_PLANNER fits a cost model of the rounds
+ * (fixed cost per round and cost per unit of work amount) and a yield model
+ * of the unit readings (usable unit readings per unit of work amount and the
+ * number lost to warm-up removal per round), and picks the number and size of
+ * the remaining rounds that are predicted to meet all the sample size
+ * requirements in the shortest time. The plan is recalculated after every
+ * round.
+ */
+enum pilot_session_planner_t {
+    GREEDY_PLANNER = 0,
+    MPC_PLANNER,
+};
+
 /**
  * \brief Set the warm-up removal method
  * @param[in] wl pointer to the workload struct
@@ -425,6 +441,17 @@ DLL_PUBLIC int pilot_warm_up_removal_detect(const pilot_workload_t *wl,
  */
 DLL_PUBLIC void pilot_set_short_workload_check(pilot_workload_t* wl, bool check_short_workload) NOEXCEPT;
 
+/**
+ * \brief Set the method for deciding the work amount of each round
+ * \details The default is GREEDY_PLANNER. MPC_PLANNER falls back to the
+ * greedy method for the rounds it has not enough data to plan for, e.g.,
+ * before the required sample sizes can be calculated. It does not plan WPS
+ * analysis, so the greedy method is used while WPS analysis must satisfy.
+ * @param[in] wl pointer to the workload struct
+ * @param planner the planning method
+ */
+DLL_PUBLIC void pilot_set_session_planner(pilot_workload_t* wl, pilot_session_planner_t planner) NOEXCEPT;
+
 /**
  * \brief Run the workload as specified in wl
  * @param[in] wl pointer to the workload struct
@@ -433,6 +460,54 @@ DLL_PUBLIC void pilot_set_short_workload_check(pilot_workload_t* wl, bool check_
  */
 DLL_PUBLIC int pilot_run_workload(pilot_workload_t *wl) NOEXCEPT;
 
+/**
+ * \brief Journal the data of each round to a file
+ * \details After each round is imported, its data are appended to an
+ * append-only binary journal, so a session that is interrupted (by a crash,
+ * a power loss, or a kill) can be continued later with
+ * pilot_resume_workload(). The file is overwritten and the rounds the
+ * workload already has are written to it first. To limit the overhead, the
+ * journal is flushed to the storage device once every fsync_batch rounds and
+ * when pilot_run_workload() returns, so at most the last fsync_batch - 1
+ * rounds are lost on a power loss. This function must be called after
+ * pilot_set_num_of_pi().
+ * @param[in] wl pointer to the workload struct
+ * @param[in] filename the journal file, or NULL to stop journaling
+ * @param fsync_batch the number of rounds between two fsync() calls
+ * @return 0 on success; ERR_IO on I/O errors; ERR_WRONG_PARAM if the workload
+ * is running
+ */
+DLL_PUBLIC int pilot_set_journal(pilot_workload_t *wl, const char *filename,
+                                 size_t fsync_batch DEFAULT_VALUE(10)) NOEXCEPT;
+
+/**
+ * \brief Load the rounds from a journal and keep journaling to it
+ * \details The workload must have the same number of PIs as the one that
+ * wrote the journal and must not have any round yet. The stored warm-up
+ * detection results are used, so the loaded rounds are identical to the
+ * original ones. An incomplete record at the end of the journal, which is
+ * left by a crash during writing, is discarded.
+ * @param[in] wl pointer to the workload struct
+ * @param[in] filename the journal file
+ * @param fsync_batch the number of rounds between two fsync() calls
+ * @return 0 on success; ERR_IO if the file cannot be read or is not a
+ * journal; ERR_WRONG_PARAM if the workload already has rounds or the number
+ * of PIs does not match
+ */
+DLL_PUBLIC int pilot_load_journal(pilot_workload_t *wl, const char *filename,
+                                  size_t fsync_batch DEFAULT_VALUE(10)) NOEXCEPT;
+
+/**
+ * \brief Continue an interrupted session from its journal
+ * \details This is pilot_load_journal() followed by pilot_run_workload().
+ * @param[in] wl pointer to the workload struct
+ * @param[in] filename the journal file
+ * @param fsync_batch the number of rounds between two fsync() calls
+ * @return the same as pilot_load_journal() and pilot_run_workload()
+ */
+DLL_PUBLIC int pilot_resume_workload(pilot_workload_t *wl, const char *filename,
+                                     size_t fsync_batch DEFAULT_VALUE(10)) NOEXCEPT;
+
 /**
  * \brief Run the workload as specified in wl using the text user interface
  * \details Call pilot_set_pi_info() prior to running TUI to set up the PI information that
@@ -499,9 +574,12 @@ DLL_PUBLIC int pilot_get_num_of_rounds(const pilot_workload_t *wl) NOEXCEPT;
 
 /**
  * \brief Return the read only copy of all raw readings of a performance index
+ * \details There is one reading for each round that has readings, in the
+ * order of the rounds. A round without readings, such as a rejected one, is
+ * skipped.
  * @param[in] wl pointer to the workload struct
  * @param piid Performance Index ID
- * @return a pointer to readings data, the length of which can be get by using pilot_get_num_of_rounds() NOEXCEPT; NULL on error.
+ * @return a pointer to readings data, the length of which is readings_num in the analytical result; NULL on error.
  */
 DLL_PUBLIC const double* pilot_get_pi_readings(const pilot_workload_t *wl, size_t piid) NOEXCEPT;
 
@@ -550,6 +628,17 @@ enum pilot_log_level_t
  */
 DLL_PUBLIC void pilot_set_log_level(pilot_log_level_t log_level) NOEXCEPT;
 
+/**
+ * \brief Set the level of the in-memory log
+ * \details The in-memory log is saved to session_log.txt by pilot_export(),
+ * which keeps the log, so every export has the whole log.
+ * The default is lv_debug. Log records below both this level and the level
+ * set by pilot_set_log_level() are discarded before their messages are
+ * constructed, so raising both levels reduces the logging overhead.
+ * @param log_level
+ */
+DLL_PUBLIC void pilot_set_in_mem_log_level(pilot_log_level_t log_level) NOEXCEPT;
+
 /**
  * \brief Get last n log lines
  * @return A pointer to the static log lines. Need to be freed using pilot_free()
@@ -557,6 +646,23 @@ DLL_PUBLIC void pilot_set_log_level(pilot_log_level_t log_level) NOEXCEPT;
  */
 DLL_PUBLIC const char* pilot_get_last_log_lines(size_t n DEFAULT_VALUE(1)) NOEXCEPT;
 
+/**
+ * \brief Configure the in-memory log buffer
+ * \details The library keeps all log records in a fixed-capacity in-memory
+ * ring buffer (16 MB by default), which is saved by pilot_export(). When the
+ * ring is full the oldest records are evicted. If spill_dir is not NULL, the
+ * evicted records are appended to file session_log_evicted.txt (.txt.gz when
+ * the library is built with zlib) in spill_dir instead of being dropped.
+ * Calling this function discards all records in the ring. It must not be
+ * called while a workload is running.
+ * @param capacity the capacity of the ring in bytes
+ * @param spill_dir the directory for saving evicted records, usually the
+ * same directory as passed to pilot_export(); NULL to drop evicted records
+ * @return 0 on success; ERR_WRONG_PARAM if capacity is 0; ERR_IO if the spill
+ * file cannot be opened
+ */
+DLL_PUBLIC int pilot_set_log_buffer(size_t capacity, const char *spill_dir DEFAULT_VALUE(NULL)) NOEXCEPT;
+
 /**
  * \brief Get the logging level of the library
  * @return log_level
@@ -634,6 +740,9 @@ DLL_PUBLIC pilot_round_info_t* pilot_round_info(const pilot_workload_t *wl, size
 
 /**
  * \brief Basic and statistics information of a workload
+ * \details All per-PI arrays are stored in one contiguous block of memory
+ * that readings_num points to, so copying a result of the same number of
+ * PIs takes a single memcpy() and no allocation.
  */
 #pragma pack(push, 1)
 struct pilot_analytical_result_t {
@@ -707,7 +816,19 @@ struct pilot_analytical_result_t {
     double wps_v_ci;                   //! the width of the confidence interval of v
     double wps_v_ci_formatted;
 
+    // Session planner (only used by MPC_PLANNER)
+    bool   planner_has_data;                 //! whether the following fields have data
+    size_t planner_planned_rounds;           //! the number of rounds still needed according to the latest plan
+    size_t planner_planned_work_amount;      //! the work amount of each of the planned rounds
+    double planner_round_fixed_cost;         //! the fixed cost of a round in seconds, including the time spent between rounds
+    double planner_work_amount_cost;         //! the cost of one unit of work amount in seconds
+    double planner_predicted_remaining_time; //! the predicted remaining session time in seconds
+    size_t planner_num_of_predictions;       //! the number of round durations that were predicted and then measured
+    double planner_round_duration_error;     //! the mean absolute relative error of the predicted round durations
+    double planner_remaining_time_error;     //! the mean absolute relative error of the predicted remaining session times, -1 until the session finishes
+
 #ifdef __cplusplus
+    inline size_t _block_size(size_t n) const;
     inline void _free_all_field();
     inline void _copyfrom(const pilot_analytical_result_t &a);
     pilot_analytical_result_t();
@@ -735,6 +856,25 @@ DLL_PUBLIC pilot_analytical_result_t* pilot_analytical_result(const pilot_worklo
 
 DLL_PUBLIC void pilot_free_analytical_result(pilot_analytical_result_t *info) NOEXCEPT;
 
+/**
+ * \brief Get the latest published snapshot of the analytical result
+ * \details Once this function has been called, pilot_run_workload()
+ * publishes a snapshot of the analytical result after each round and
+ * before calling the post-round hook. Getting and reading a snapshot
+ * neither copies the result nor takes a lock, so it can be done from
+ * another thread while the workload is running. The snapshot does not
+ * change until it is released by pilot_release_analytical_result_snapshot().
+ * @param[in] wl pointer to the workload struct
+ * @return the snapshot, or NULL if none has been published yet
+ */
+DLL_PUBLIC const pilot_analytical_result_t* pilot_acquire_analytical_result_snapshot(const pilot_workload_t *wl) NOEXCEPT;
+
+/**
+ * \brief Release a snapshot returned by pilot_acquire_analytical_result_snapshot()
+ * @param[in] snapshot the snapshot to release
+ */
+DLL_PUBLIC void pilot_release_analytical_result_snapshot(const pilot_analytical_result_t *snapshot) NOEXCEPT;
+
 DLL_PUBLIC void pilot_free_round_info(pilot_round_info_t *info) NOEXCEPT;
 
 /**
@@ -938,10 +1078,14 @@ DLL_PUBLIC void pilot_pi_unit_readings_iter_destroy(pilot_pi_unit_readings_iter_
  * @param work_amount the amount of work of that round (you can set it to equal
  * num_of_unit_readings if you have no special use for this value)
  * @param round_duration the duration of the round
- * @param[in] readings the readings of each PI
+ * @param[in] readings the readings of each PI, can be NULL if there are no
+ * readings in this round. A round without readings in a workload whose other
+ * rounds have readings is rejected, and is left out of the analyses of round
+ * durations, such as WPS analysis.
  * @param num_of_unit_readings the number of unit readings
  * @param[in] unit_readings the unit readings of each PI, can be NULL if there
- * is no unit readings in this round
+ * is no unit readings in this round. unit_readings[piid] can be NULL for a PI
+ * that has no unit readings in this round.
  */
 DLL_PUBLIC void pilot_import_benchmark_results(pilot_workload_t *wl, size_t round,
                                     size_t work_amount,
@@ -1043,6 +1187,28 @@ DLL_PUBLIC bool calc_next_round_work_amount_from_wps(const pilot_workload_t *wl,
  */
 DLL_PUBLIC bool calc_next_round_work_amount_for_comparison(const pilot_workload_t *wl, size_t *needed_work_amount) NOEXCEPT;
 
+/**
+ * \brief How the work amounts of WPS analysis rounds are chosen
+ * \details WPS_EVEN_SLICES sweeps evenly spaced slices between the minimum
+ * and maximum work amount, halving the slice size each time it reaches the
+ * top ([Li16] Equation (5)).
+ *
+ * WPS_OPTIMAL_DESIGN places most rounds at the two ends of the work amount
+ * range, which minimizes the variance of v in t = alpha + v*w. The share of
+ * the cheaper low end is sqrt(t_high)/(sqrt(t_low)+sqrt(t_high)), which
+ * minimizes the CI width of v per second of benchmark time. One round in
+ * five goes to one of three interior points so that non-linearity still
+ * shows up in the residuals. The high end is capped at the work amount whose
+ * round takes a fifth of the desired session duration or four times as long
+ * as a low-end round, whichever is longer. The order of the rounds is
+ * shuffled within blocks of ten so the design itself doesn't add
+ * autocorrelation to the per-round WPS.
+ */
+enum pilot_wps_schedule_t {
+    WPS_EVEN_SLICES = 0,
+    WPS_OPTIMAL_DESIGN,
+};
+
 /**
  * \brief Set if WPS analysis should be enabled
  * @param[in] wl pointer to the workload struct
@@ -1051,11 +1217,13 @@ DLL_PUBLIC bool calc_next_round_work_amount_for_comparison(const pilot_workload_
  * to NULL to disable it.
  * @param enabled if WPS analysis is enabled
  * @param wps_must_satisfy if WPS CI must satisfy
+ * @param schedule how the work amounts of WPS rounds are chosen
  * @return 0 on success; otherwise error code
  */
 DLL_PUBLIC int pilot_set_wps_analysis(pilot_workload_t *wl,
         pilot_pi_display_format_func_t *format_wps_func,
-        bool enabled, bool wps_must_satisfy) NOEXCEPT;
+        bool enabled, bool wps_must_satisfy,
+        pilot_wps_schedule_t schedule DEFAULT_VALUE(WPS_EVEN_SLICES)) NOEXCEPT;
 
 /**
  * \brief Set the desired duration for running a session
@@ -1117,6 +1285,232 @@ DLL_PUBLIC int pilot_get_baseline(const pilot_workload_t *wl, size_t piid, pilot
  */
 DLL_PUBLIC int pilot_load_baseline_file(pilot_workload_t *wl, const char *filename) NOEXCEPT;
 
+/**
+ * \brief The methods for deciding when a comparison against a baseline stops
+ * \details FIXED_SAMPLE_SIZE_COMPARISON runs until the sample size calculated
+ * by pilot_optimal_sample_size_for_eq_test() is reached.
+ *
+ * SEQUENTIAL_COMPARISON is a group-sequential test that takes a look at the
+ * data after every round and stops as soon as a decision is reached. At look
+ * k of at most K looks, the test may spend
+ * alpha(k/K) - alpha((k-1)/K) of the error rate, where
+ * alpha(t) = 2 - 2 * Phi(z_{1 - p/2} / sqrt(t)) is the O'Brien-Fleming-type
+ * alpha spending function (Lan-DeMets) and p is the desired p-value. So
+ * early looks need very strong evidence and the total error rate of each
+ * decision is no more than p. At each look the mean is declared lower or
+ * higher than the baseline if Welch's t-test rejects equality, or
+ * equivalent to the baseline if the two one-sided tests (TOST) show that the
+ * difference is within the equivalence margin. If there is no decision
+ * after K looks, the result is inconclusive and the comparison stops asking
+ * for more rounds.
+ *
+ * Only unit readings are compared for now.
+ */
+enum pilot_comparison_method_t {
+    FIXED_SAMPLE_SIZE_COMPARISON = 0,
+    SEQUENTIAL_COMPARISON,
+};
+
+enum pilot_comparison_decision_t {
+    COMPARISON_UNDECIDED = 0,
+    COMPARISON_LOWER,        //! the mean is lower than the baseline
+    COMPARISON_HIGHER,       //! the mean is higher than the baseline
+    COMPARISON_EQUIVALENT,   //! the mean is within the equivalence margin of the baseline
+    COMPARISON_INCONCLUSIVE, //! no decision was reached within the maximum number of looks
+};
+
+/**
+ * \brief Set the method for deciding when a comparison against a baseline stops
+ * @param[in] wl pointer to the workload struct
+ * @param method the comparison method
+ * @param equivalence_margin (SEQUENTIAL_COMPARISON only) the largest
+ * difference from the baseline mean, as a fraction of the baseline mean,
+ * that counts as equivalent
+ * @param max_looks (SEQUENTIAL_COMPARISON only) the maximum number of looks
+ * @return 0 on success; ERR_WRONG_PARAM if equivalence_margin <= 0 or
+ * max_looks is 0
+ */
+DLL_PUBLIC int pilot_set_comparison_method(pilot_workload_t *wl, pilot_comparison_method_t method,
+                                           double equivalence_margin DEFAULT_VALUE(0.05),
+                                           size_t max_looks DEFAULT_VALUE(20)) NOEXCEPT;
+
+/**
+ * \brief Get the result of comparing the unit readings of a PI against its baseline
+ * \details With SEQUENTIAL_COMPARISON the decision is made at the looks
+ * described in pilot_comparison_method_t and doesn't change once made. With
+ * FIXED_SAMPLE_SIZE_COMPARISON, the decision is that of Welch's t-test on
+ * the current data at the desired p-value, which is either lower, higher, or
+ * undecided.
+ * @param[in] wl pointer to the workload struct
+ * @param piid the PI to get the result for
+ * @param[out] decision the decision
+ * @param[out] looks (optional) the number of looks taken so far
+ * (SEQUENTIAL_COMPARISON only)
+ * @param[out] p_value (optional) the p-value of the t-test at the last look
+ * @return 0 on success; ERR_WRONG_PARAM if piid is invalid; ERR_NOT_INIT if
+ * the PI has no baseline of unit readings
+ */
+DLL_PUBLIC int pilot_get_comparison_result(const pilot_workload_t *wl, size_t piid,
+                                           pilot_comparison_decision_t *decision,
+                                           size_t *looks DEFAULT_VALUE(NULL),
+                                           double *p_value DEFAULT_VALUE(NULL)) NOEXCEPT;
+
+/**
+ * \brief The result of an interleaved A/B comparison
+ */
+#pragma pack(push, 1)
+struct pilot_ab_result_t {
+    size_t  pairs;        //! the number of pairs of rounds used in the comparison
+    double  mean_diff;    //! the mean of the per-pair differences (B - A)
+    double  ci_left;      //! the left end of the confidence interval of mean_diff
+    double  ci_right;     //! the right end of the confidence interval of mean_diff
+    double  p_value;      //! the p-value of the paired t-test at the last look
+    pilot_comparison_decision_t decision;  //! whether B is lower, higher, or equivalent to A
+};
+#pragma pack(pop)
+
+/**
+ * \brief Compare two variants of a workload by interleaving their rounds
+ * \details Rounds of wl_a and wl_b are run alternately in pairs, so slow
+ * drift of the system (thermal state, background load, caches, etc.)
+ * affects both variants in the same way and cancels out in the per-pair
+ * difference. Pairs come in blocks of two, one AB and one BA, in random
+ * order, so neither variant always runs first. Both rounds of a pair use
+ * the same work amount, which is the larger of the two workloads' next work
+ * amounts.
+ *
+ * The metric of a round is the mean of its unit readings after warm-up
+ * removal of the PI, or the round's reading if it has no unit readings.
+ * After every pair the paired differences are tested with the same
+ * group-sequential design as SEQUENTIAL_COMPARISON: a paired t-test for a
+ * difference and TOST for equivalence, at the desired p-value and the
+ * equivalence margin of wl_a (as a fraction of the mean of A), with
+ * max_num_of_pairs as the maximum number of looks. While all differences
+ * are the same, their variance is unknown, so no decision is made until
+ * there are as many pairs as the minimum sample size of wl_a or the last
+ * look is reached. The results of the rounds are also imported into wl_a and
+ * wl_b as usual, and the hooks and the session duration limit of each
+ * workload apply to its rounds as in pilot_run_workload().
+ * @param[in] wl_a pointer to the workload struct of variant A
+ * @param[in] wl_b pointer to the workload struct of variant B
+ * @param piid the PI to compare
+ * @param[out] result the result of the comparison
+ * @param max_num_of_pairs the maximum number of pairs to run
+ * @param seed the random seed for the order within blocks
+ * @return 0 on success; ERR_NOT_INIT if either workload has no workload
+ * function; ERR_WRONG_PARAM if piid is invalid or max_num_of_pairs is 0;
+ * ERR_WL_FAIL if a round fails; ERR_STOPPED_BY_REQUEST if either workload
+ * is stopped by pilot_stop_workload(); ERR_STOPPED_BY_HOOK or
+ * ERR_STOPPED_BY_DURATION_LIMIT as in pilot_run_workload()
+ */
+DLL_PUBLIC int pilot_run_ab_comparison(pilot_workload_t *wl_a, pilot_workload_t *wl_b,
+                                       size_t piid, pilot_ab_result_t *result,
+                                       size_t max_num_of_pairs DEFAULT_VALUE(100),
+                                       unsigned int seed DEFAULT_VALUE(0)) NOEXCEPT;
+
+/**
+ * \brief The result of racing workloads
+ */
+#pragma pack(push, 1)
+struct pilot_race_result_t {
+    size_t  winner;       //! the index of the best workload
+    bool    identified;   //! whether all other workloads were eliminated
+    size_t  rounds;       //! the total number of rounds run by all workloads
+    double  winner_mean;  //! the mean of the per-round metrics of the winner, NaN if no workload has any
+};
+#pragma pack(pop)
+
+/**
+ * \brief Find the best of a set of workloads (such as the same benchmark
+ * with different configurations) in as few rounds as possible
+ * \details This is a race (successive elimination): in each iteration,
+ * every workload that is still in the race runs one round, in a random
+ * order and with the same work amount, which is the largest of the
+ * workloads' next work amounts. The metric of a round is the same as in
+ * pilot_run_ab_comparison(). After each iteration in which every remaining
+ * workload has at least two metrics, a confidence interval of the mean
+ * metric is calculated for each workload, and workloads whose interval is
+ * entirely worse than the interval of the workload with the best mean are
+ * eliminated. The confidence level of the intervals is adjusted for the
+ * number of workloads and of such iterations, so the winner is
+ * the best with an error rate of no more than the desired p-value of
+ * wls[0]. The race stops when only one workload is left, or when every
+ * remaining workload has run max_rounds_per_workload rounds, in which case
+ * the workload with the best mean is returned as the winner and
+ * result->identified is false. The hooks and the session duration limit of
+ * each workload apply to its rounds as in pilot_run_workload().
+ * @param[in] wls the workloads to race
+ * @param num_of_wls the number of workloads
+ * @param piid the PI to compare
+ * @param[out] result the result of the race
+ * @param lower_is_better true if lower values of the PI are better (like
+ * time), false if higher values are better (like throughput)
+ * @param max_rounds_per_workload the maximum number of rounds each
+ * workload can run
+ * @param seed the random seed for the order of workloads in each iteration
+ * @return 0 on success; ERR_NOT_INIT if any workload has no workload
+ * function; ERR_WRONG_PARAM if there are fewer than two workloads, a
+ * workload appears more than once, piid is invalid, or
+ * max_rounds_per_workload is smaller than 2; ERR_WL_FAIL if a round fails;
+ * ERR_STOPPED_BY_REQUEST if any workload is stopped by pilot_stop_workload();
+ * ERR_STOPPED_BY_HOOK or ERR_STOPPED_BY_DURATION_LIMIT as in
+ * pilot_run_workload()
+ */
+DLL_PUBLIC int pilot_run_race(pilot_workload_t **wls, size_t num_of_wls, size_t piid,
+                              pilot_race_result_t *result,
+                              bool lower_is_better DEFAULT_VALUE(true),
+                              size_t max_rounds_per_workload DEFAULT_VALUE(100),
+                              unsigned int seed DEFAULT_VALUE(0)) NOEXCEPT;
+
+/**
+ * \brief Find the Pareto frontier of a set of workloads (such as a benchmark
+ * with different parameter values) over several PIs
+ * \details In each iteration, every workload that is still in the search
+ * runs one round with its own next work amount, in a random order, until
+ * the workload's own statistical requirements are satisfied or it has run
+ * max_rounds_per_workload rounds. So each workload runs as many rounds
+ * as its confidence intervals require. The metric of a round is the same as
+ * in pilot_run_ab_comparison(). After each iteration, workloads that are
+ * dominated with confidence are eliminated: workload i is dominated if
+ * another workload in the search is better than i in every objective, that
+ * is, its confidence interval of the mean metric is entirely better than
+ * i's. The confidence intervals are adjusted for the number of workloads
+ * and iterations as in pilot_run_race(). The search stops when no workload
+ * in the search needs more rounds. The workloads on the frontier are those
+ * still in the search, have metrics, and are not dominated by another such
+ * workload by their means. The hooks and the session duration limit of each
+ * workload apply to its rounds as in pilot_run_workload().
+ * @param[in] wls the workloads to search
+ * @param num_of_wls the number of workloads
+ * @param[in] piids the PIs of the objectives
+ * @param[in] lower_is_better for each objective, true if lower values of
+ * the PI are better (like latency), false if higher values are better (like
+ * throughput)
+ * @param num_of_objectives the number of objectives
+ * @param[out] on_frontier an array of num_of_wls elements that is set to
+ * whether each workload is on the Pareto frontier
+ * @param[out] means (optional) an array of num_of_wls * num_of_objectives
+ * elements that is set to the mean metric of each workload (row) and
+ * objective (column), or NaN if none of the workload's rounds has data for
+ * every objective
+ * @param max_rounds_per_workload the maximum number of rounds each
+ * workload can run
+ * @param seed the random seed for the order of workloads in each iteration
+ * @return 0 on success; ERR_NOT_INIT if any workload has no workload
+ * function; ERR_WRONG_PARAM if there is no workload or objective, a
+ * workload appears more than once, a piid is invalid, or
+ * max_rounds_per_workload is smaller than 2; ERR_WL_FAIL if a round fails;
+ * ERR_STOPPED_BY_REQUEST if any workload is stopped by pilot_stop_workload();
+ * ERR_STOPPED_BY_HOOK or ERR_STOPPED_BY_DURATION_LIMIT as in
+ * pilot_run_workload()
+ */
+DLL_PUBLIC int pilot_run_pareto_search(pilot_workload_t **wls, size_t num_of_wls,
+                                       const size_t *piids, const bool *lower_is_better,
+                                       size_t num_of_objectives, bool *on_frontier,
+                                       double *means DEFAULT_VALUE(NULL),
+                                       size_t max_rounds_per_workload DEFAULT_VALUE(100),
+                                       unsigned int seed DEFAULT_VALUE(0)) NOEXCEPT;
+
 /**
  * \brief Set the lower threshold of sample size used in all statistical
  * analyses. Default to 200.
@@ -1126,6 +1520,22 @@ DLL_PUBLIC int pilot_load_baseline_file(pilot_workload_t *wl, const char *filena
  */
 DLL_PUBLIC size_t pilot_set_min_sample_size(pilot_workload_t *wl, size_t min_sample_size) NOEXCEPT;
 
+/**
+ * \brief Collect performance counters in simple_runner()
+ * \details When enabled, simple_runner() opens a group of performance
+ * counters (instructions, cycles, cache misses, and branch misses; or task
+ * clock, context switches, and page faults when the hardware counters are
+ * not accessible) for the calling thread. Each counter becomes an additional
+ * PI whose unit readings are the counter deltas of each call and whose
+ * readings are the per-call averages of each round. An IPC PI is added when
+ * both instructions and cycles are available. These PIs are not required to
+ * satisfy the quality requirements, so they do not prolong the session.
+ * @param enabled true to enable collecting performance counters
+ * @return 0 on success; ERR_NOT_IMPL if performance counters are not
+ * supported on this platform
+ */
+DLL_PUBLIC int pilot_simple_runner_set_perf_counters(bool enabled) NOEXCEPT;
+
 DLL_PUBLIC int _simple_runner(pilot_simple_workload_func_t func,
                    const char *benchmark_name) NOEXCEPT;
 DLL_PUBLIC int _simple_runner_with_wa(pilot_simple_workload_with_wa_func_t func,
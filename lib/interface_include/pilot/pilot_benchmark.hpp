@@ -0,0 +1,259 @@
+/*
+ * pilot_benchmark.hpp: header-only micro-benchmark API that inlines the
+ * measured callable into the measuring loop.
+ *
+ * Copyright (c) 2017-2019 Yan Li <yanli@tuneup.ai>. All rights reserved.
+ * The Pilot tool and library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 (not any other version) as published by the Free
+ * Software Foundation.
+ *
+ * The Pilot tool and library is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program in file lgpl-2.1.txt; if not, see
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ *
+ * Commit 033228934e11b3f86fb0a4932b54b2aeea5c803c and before were
+ * released with the following license:
+ * Copyright (c) 2015, 2016, University of California, Santa Cruz, CA, USA.
+ * Created by Yan Li <yanli@tuneup.ai>,
+ * Department of Computer Science, Baskin School of Engineering.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Storage Systems Research Center, the
+ *       University of California, nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OF THE UNIVERSITY OF CALIFORNIA BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LIB_INTERFACE_INCLUDE_PILOT_BENCHMARK_HPP_
+#define LIB_INTERFACE_INCLUDE_PILOT_BENCHMARK_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include "libpilot.h"
+#include <memory>
+#include <string>
+#include <type_traits>
+
+namespace pilot {
+
+/**
+ * \brief Prevent the compiler from optimizing away a value
+ * \details The value is forced into a register or memory location as if it
+ * was read by an opaque piece of code. Use it on the result of the measured
+ * code, e.g. `do_not_optimize(hash(buf));`.
+ * @param[in] value the value to keep
+ */
+template <class T>
+inline void do_not_optimize(T const &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * \brief Prevent the compiler from optimizing away a value
+ * \details This overload also tells the compiler the value may have been
+ * modified, so computations depending on it cannot be hoisted out of the
+ * measuring loop.
+ * @param[in,out] value the value to keep
+ */
+template <class T>
+inline void do_not_optimize(T &value) {
+#if defined(__clang__)
+    asm volatile("" : "+r,m"(value) : : "memory");
+#else
+    asm volatile("" : "+m,r"(value) : : "memory");
+#endif
+}
+
+/**
+ * \brief Force all pending memory writes to be considered visible
+ * \details Acts as a compiler-level read/write barrier so that stores done
+ * by the measured code are not eliminated as dead stores.
+ */
+inline void clobber_memory() {
+    asm volatile("" : : : "memory");
+}
+
+/**
+ * \brief Options for pilot::benchmark()
+ * \details All fields have sensible defaults; only set what you need.
+ */
+struct benchmark_options {
+    //! The log level used during the benchmark
+    pilot_log_level_t log_level = lv_info;
+    //! Initial work amount (number of calls in the first round)
+    size_t init_work_amount = 0;
+    //! Maximal work amount (number of calls) in one round
+    size_t work_amount_limit = ULONG_MAX;
+    //! Rounds shorter than this (in seconds) are considered too short
+    size_t short_round_detection_threshold = 1;
+    //! Desired session duration in seconds, 0 for the library default
+    size_t session_desired_duration = 0;
+    //! Required CI width as a percent of the mean, 0 for the library default
+    double required_ci_percent_of_mean = 0;
+    /**
+     * Called before each round, outside of the measured region. Use it
+     * to prepare the data that the round is going to work on.
+     */
+    std::function<void(size_t round, size_t work_amount)> setup;
+    //! Called after each round, outside of the measured region
+    std::function<void(size_t round, size_t work_amount)> teardown;
+    //! Called on the workload before it is run for further customization
+    std::function<void(pilot_workload_t *wl)> customize;
+    //! Called on the workload after it finished and before it is destroyed
+    std::function<void(const pilot_workload_t *wl, int wl_res)> on_finished;
+    //! Whether to save the results using pilot_export()
+    bool export_results = true;
+    //! Directory for pilot_export(), empty means using the benchmark name
+    std::string export_dir;
+};
+
+template <class F>
+struct _benchmark_context {
+    F                       &func;
+    const benchmark_options &opts;
+};
+
+template <class F>
+inline int _benchmark_call(F &func, std::true_type /* returns void */) {
+    func();
+    return 0;
+}
+
+template <class F>
+inline int _benchmark_call(F &func, std::false_type /* returns a result code */) {
+    return static_cast<int>(func());
+}
+
+template <class F>
+int _benchmark_workload_func(const pilot_workload_t *wl,
+                             size_t round,
+                             size_t total_work_amount,
+                             pilot_malloc_func_t *lib_malloc_func,
+                             size_t *num_of_work_unit,
+                             double ***unit_readings,
+                             double **readings,
+                             nanosecond_type *round_duration,
+                             void *data) {
+    typedef typename std::is_void<typename std::result_of<F&()>::type>::type returns_void;
+    typedef std::chrono::steady_clock clock;
+    _benchmark_context<F> *ctx = static_cast<_benchmark_context<F>*>(data);
+    const size_t num_of_pi = 1;
+    *num_of_work_unit = total_work_amount;
+    *unit_readings = (double**)lib_malloc_func(sizeof(double*) * num_of_pi);
+    (*unit_readings)[0] = (double*)lib_malloc_func(sizeof(double) * total_work_amount);
+
+    if (ctx->opts.setup)
+        ctx->opts.setup(round, total_work_amount);
+
+    int rc = 0;
+    size_t calls = 0;
+    std::chrono::nanoseconds measured(0);
+    while (calls != total_work_amount) {
+        clobber_memory();
+        clock::time_point start_time = clock::now();
+        rc = _benchmark_call(ctx->func, returns_void());
+        clock::time_point end_time = clock::now();
+        std::chrono::nanoseconds d = end_time - start_time;
+        measured += d;
+        (*unit_readings)[0][calls++] = std::chrono::duration<double>(d).count();
+        if (rc)
+            break;
+    }
+    if (calls != total_work_amount) {
+        // only the calls made before the error have unit readings
+        std::fill((*unit_readings)[0] + calls, (*unit_readings)[0] + total_work_amount, 0.0);
+        *num_of_work_unit = calls;
+    }
+
+    if (ctx->opts.teardown)
+        ctx->opts.teardown(round, total_work_amount);
+
+    // report only the measured time so setup and teardown are excluded
+    // from the round duration
+    *round_duration = measured.count();
+    return rc;
+}
+
+/**
+ * \brief Benchmark a callable using the full Pilot statistics engine
+ * \details This is a header-only alternative to simple_runner(). Because the
+ * callable is a template parameter, the measured call can be inlined into the
+ * measuring loop instead of going through a function pointer. The callable
+ * can return void, or an int where non-zero means an error that stops the
+ * benchmark. Each call is one work unit and its duration is stored as the
+ * unit reading of PI 0 ("Duration", in seconds).
+ *
+ * Example:
+ * \code
+ * pilot::benchmark("hash", [&] { pilot::do_not_optimize(hash(buf)); });
+ * \endcode
+ * @param[in] name the name of the benchmark
+ * @param[in] func the callable to measure
+ * @param[in] opts benchmark options
+ * @return 0 on success, otherwise an error code from pilot_run_workload()
+ */
+template <class F>
+int benchmark(const char *name, F &&func,
+              const benchmark_options &opts = benchmark_options()) {
+    PILOT_LIB_SELF_CHECK;
+    typedef typename std::remove_reference<F>::type func_type;
+    _benchmark_context<func_type> ctx{func, opts};
+
+    pilot_set_log_level(opts.log_level);
+    std::shared_ptr<pilot_workload_t> wl(pilot_new_workload(name), pilot_destroy_workload);
+    pilot_set_num_of_pi(wl.get(), 1);
+    pilot_set_pi_info(wl.get(), 0, "Duration", "second", NULL, NULL, false, true,
+                      ARITHMETIC_MEAN, ARITHMETIC_MEAN, SAMPLE_MEAN);
+    pilot_set_wps_analysis(wl.get(), NULL, false, false);
+    pilot_set_init_work_amount(wl.get(), opts.init_work_amount);
+    pilot_set_work_amount_limit(wl.get(), opts.work_amount_limit);
+    pilot_set_short_round_detection_threshold(wl.get(), opts.short_round_detection_threshold);
+    if (opts.session_desired_duration)
+        pilot_set_session_desired_duration(wl.get(), opts.session_desired_duration);
+    if (opts.required_ci_percent_of_mean > 0)
+        pilot_set_required_confidence_interval(wl.get(), opts.required_ci_percent_of_mean, -1);
+    pilot_set_workload_data(wl.get(), &ctx);
+    pilot_set_workload_func(wl.get(), &_benchmark_workload_func<func_type>);
+    if (opts.customize)
+        opts.customize(wl.get());
+
+    int wl_res = pilot_run_workload(wl.get());
+    if (opts.on_finished)
+        opts.on_finished(wl.get(), wl_res);
+
+    if (opts.export_results) {
+        std::string dir = opts.export_dir.empty() ? name : opts.export_dir;
+        pilot_export(wl.get(), dir.c_str());
+    }
+    return wl_res;
+}
+
+} // namespace pilot
+
+#endif /* LIB_INTERFACE_INCLUDE_PILOT_BENCHMARK_HPP_ */
@@ -0,0 +1,347 @@
+/*
+ * journal.cc: append-only binary journal of the data of each round
+ *
+ * Copyright (c) 2017-2019 Yan Li <yanli@tuneup.ai>. All rights reserved.
+ * The Pilot tool and library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 (not any other version) as published by the Free
+ * Software Foundation.
+ *
+ * The Pilot tool and library is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program in file lgpl-2.1.txt; if not, see
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ *
+ * Commit 033228934e11b3f86fb0a4932b54b2aeea5c803c and before were
+ * released with the following license:
+ * Copyright (c) 2015, 2016, University of California, Santa Cruz, CA, USA.
+ * Created by Yan Li <yanli@tuneup.ai>,
+ * Department of Computer Science, Baskin School of Engineering.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Storage Systems Research Center, the
+ *       University of California, nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OF THE UNIVERSITY OF CALIFORNIA BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "common.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include "journal.hpp"
+#include <limits>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace pilot {
+
+static const char     kJournalMagic[8] = {'P', 'I', 'L', 'O', 'T', 'J', 'N', 'L'};
+static const uint32_t kJournalVersion = 1;
+
+/**
+ * 32-bit FNV-1a hash, used as the checksum of records
+ */
+static uint32_t _fnv1a(const char *p, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= static_cast<unsigned char>(p[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+template <typename T>
+static void _put(string &buf, const T &v) {
+    buf.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+/**
+ * Reads values from a buffer; sets ok to false on any overrun
+ */
+class _journal_reader_t {
+public:
+    _journal_reader_t(const char *p, size_t len) : p_(p), end_(p + len), ok(true) {}
+
+    template <typename T>
+    T get() {
+        T v = T();
+        if (!ok || static_cast<size_t>(end_ - p_) < sizeof(T)) {
+            ok = false;
+            return v;
+        }
+        memcpy(&v, p_, sizeof(T));
+        p_ += sizeof(T);
+        return v;
+    }
+
+    // Guards vector sizes read from the file against the remaining length
+    bool can_hold(uint64_t n, size_t elem_size) {
+        ok = ok && n <= static_cast<size_t>(end_ - p_) / elem_size;
+        return ok;
+    }
+
+    bool at_end() const { return p_ == end_; }
+
+private:
+    const char *p_;
+    const char *end_;
+public:
+    bool ok;
+};
+
+static bool _write_all(int fd, const char *p, size_t len) {
+    while (len > 0) {
+        ssize_t r = ::write(fd, p, len);
+        if (r < 0) {
+            if (EINTR == errno) continue;
+            return false;
+        }
+        p += r;
+        len -= r;
+    }
+    return true;
+}
+
+pilot_journal_t::pilot_journal_t() : fd_(-1), num_of_pi_(0), fsync_batch_(1),
+        num_of_unsynced_records_(0), end_offset_(0), failed_(false) {}
+
+pilot_journal_t::~pilot_journal_t() {
+    close();
+}
+
+void pilot_journal_t::close() {
+    if (fd_ < 0) return;
+    sync();
+    ::close(fd_);
+    fd_ = -1;
+}
+
+int pilot_journal_t::create(const string &filename, const string &workload_name,
+                            size_t num_of_pi, size_t fsync_batch) {
+    close();
+    fd_ = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        error_log << "cannot create journal " << filename << ": " << strerror(errno);
+        return ERR_IO;
+    }
+    filename_ = filename;
+    num_of_pi_ = num_of_pi;
+    fsync_batch_ = fsync_batch > 0 ? fsync_batch : 1;
+    num_of_unsynced_records_ = 0;
+
+    string buf(kJournalMagic, sizeof(kJournalMagic));
+    _put(buf, kJournalVersion);
+    _put(buf, static_cast<uint32_t>(num_of_pi));
+    _put(buf, static_cast<uint32_t>(workload_name.size()));
+    buf.append(workload_name);
+    if (!_write_all(fd_, buf.data(), buf.size()) || 0 != ::fsync(fd_)) {
+        error_log << "failed writing journal " << filename << ": " << strerror(errno);
+        close();
+        return ERR_IO;
+    }
+    end_offset_ = buf.size();
+    failed_ = false;
+    return 0;
+}
+
+int pilot_journal_t::open(const string &filename, size_t num_of_pi, size_t fsync_batch,
+                          function<void(const pilot_journal_round_t&)> round_func) {
+    close();
+    int fd = ::open(filename.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        error_log << "cannot open journal " << filename << ": " << strerror(errno);
+        return ERR_IO;
+    }
+    struct stat st;
+    if (0 != fstat(fd, &st)) {
+        error_log << "cannot stat journal " << filename << ": " << strerror(errno);
+        ::close(fd);
+        return ERR_IO;
+    }
+    string content(st.st_size, '\0');
+    size_t got = 0;
+    while (got < content.size()) {
+        ssize_t r = ::pread(fd, &content[got], content.size() - got, got);
+        if (r < 0 && EINTR == errno) continue;
+        if (r <= 0) {
+            error_log << "failed reading journal " << filename;
+            ::close(fd);
+            return ERR_IO;
+        }
+        got += r;
+    }
+
+    _journal_reader_t hdr(content.data(), content.size());
+    char magic[sizeof(kJournalMagic)];
+    for (size_t i = 0; i < sizeof(magic); ++i) magic[i] = hdr.get<char>();
+    uint32_t version = hdr.get<uint32_t>();
+    uint32_t file_num_of_pi = hdr.get<uint32_t>();
+    uint32_t name_len = hdr.get<uint32_t>();
+    if (!hdr.ok || 0 != memcmp(magic, kJournalMagic, sizeof(magic)) ||
+        kJournalVersion != version || !hdr.can_hold(name_len, 1)) {
+        error_log << filename << " is not a valid journal";
+        ::close(fd);
+        return ERR_IO;
+    }
+    if (file_num_of_pi != num_of_pi) {
+        error_log << "journal " << filename << " has " << file_num_of_pi
+                  << " PIs but the workload has " << num_of_pi;
+        ::close(fd);
+        return ERR_WRONG_PARAM;
+    }
+
+    size_t offset = sizeof(kJournalMagic) + 3 * sizeof(uint32_t) + name_len;
+    size_t num_of_records = 0;
+    while (content.size() - offset >= 2 * sizeof(uint32_t)) {
+        uint32_t len, checksum;
+        memcpy(&len, &content[offset], sizeof(len));
+        memcpy(&checksum, &content[offset + sizeof(len)], sizeof(checksum));
+        const size_t payload_offset = offset + 2 * sizeof(uint32_t);
+        if (content.size() - payload_offset < len) break;
+        const char *payload = content.data() + payload_offset;
+        if (_fnv1a(payload, len) != checksum) break;
+
+        _journal_reader_t rd(payload, len);
+        pilot_journal_round_t r;
+        r.round = rd.get<uint64_t>();
+        r.work_amount = rd.get<uint64_t>();
+        r.round_duration = rd.get<int64_t>();
+        r.has_readings = rd.get<uint8_t>();
+        if (r.has_readings) {
+            r.readings.resize(num_of_pi);
+            for (auto &v : r.readings) v = rd.get<double>();
+        }
+        r.unit_readings.resize(num_of_pi);
+        r.warm_up_phase_len.resize(num_of_pi);
+        for (size_t piid = 0; piid < num_of_pi; ++piid) {
+            uint64_t n = rd.get<uint64_t>();
+            if (!rd.can_hold(n, sizeof(double))) break;
+            r.unit_readings[piid].resize(n);
+            for (auto &v : r.unit_readings[piid]) v = rd.get<double>();
+            r.warm_up_phase_len[piid] = rd.get<uint64_t>();
+        }
+        if (!rd.ok || !rd.at_end()) break;
+
+        round_func(r);
+        ++num_of_records;
+        offset = payload_offset + len;
+    }
+    if (offset != content.size()) {
+        warning_log << "discarding " << content.size() - offset
+                    << " bytes of incomplete data at the end of journal " << filename;
+        if (0 != ftruncate(fd, offset)) {
+            error_log << "cannot truncate journal " << filename << ": " << strerror(errno);
+            ::close(fd);
+            return ERR_IO;
+        }
+    }
+    if (static_cast<off_t>(offset) != lseek(fd, offset, SEEK_SET)) {
+        error_log << "cannot seek in journal " << filename << ": " << strerror(errno);
+        ::close(fd);
+        return ERR_IO;
+    }
+    info_log << "loaded " << num_of_records << " rounds from journal " << filename;
+
+    fd_ = fd;
+    filename_ = filename;
+    num_of_pi_ = num_of_pi;
+    fsync_batch_ = fsync_batch > 0 ? fsync_batch : 1;
+    num_of_unsynced_records_ = 0;
+    end_offset_ = offset;
+    failed_ = false;
+    return 0;
+}
+
+int pilot_journal_t::append(const pilot_journal_round_t &r) {
+    die_if(fd_ < 0, ERR_NOT_INIT, "journal is not open");
+    if (r.unit_readings.size() != num_of_pi_ || r.warm_up_phase_len.size() != num_of_pi_ ||
+        (r.has_readings && r.readings.size() != num_of_pi_)) {
+        error_log << "the number of PIs of round " << r.round << " does not match journal " << filename_;
+        return ERR_WRONG_PARAM;
+    }
+    if (failed_) {
+        error_log << "journal " << filename_ << " has a torn record at its end, not appending round " << r.round;
+        return ERR_IO;
+    }
+
+    string buf(2 * sizeof(uint32_t), '\0');  // placeholder for len and checksum
+    _put(buf, static_cast<uint64_t>(r.round));
+    _put(buf, static_cast<uint64_t>(r.work_amount));
+    _put(buf, static_cast<int64_t>(r.round_duration));
+    _put(buf, static_cast<uint8_t>(r.has_readings));
+    if (r.has_readings)
+        for (size_t piid = 0; piid < num_of_pi_; ++piid)
+            _put(buf, r.readings[piid]);
+    for (size_t piid = 0; piid < num_of_pi_; ++piid) {
+        _put(buf, static_cast<uint64_t>(r.unit_readings[piid].size()));
+        buf.append(reinterpret_cast<const char*>(r.unit_readings[piid].data()),
+                   r.unit_readings[piid].size() * sizeof(double));
+        _put(buf, static_cast<uint64_t>(r.warm_up_phase_len[piid]));
+    }
+    if (buf.size() - 2 * sizeof(uint32_t) > numeric_limits<uint32_t>::max()) {
+        error_log << "round " << r.round << " is too large to be journaled in " << filename_;
+        return ERR_WRONG_PARAM;
+    }
+    const uint32_t len = buf.size() - 2 * sizeof(uint32_t);
+    const uint32_t checksum = _fnv1a(buf.data() + 2 * sizeof(uint32_t), len);
+    memcpy(&buf[0], &len, sizeof(len));
+    memcpy(&buf[sizeof(len)], &checksum, sizeof(checksum));
+
+    if (!_write_all(fd_, buf.data(), buf.size())) {
+        error_log << "failed writing journal " << filename_ << ": " << strerror(errno);
+        // Drop the partial record, otherwise open() would stop at it and lose
+        // all the records appended after it
+        if (0 != ftruncate(fd_, end_offset_) || end_offset_ != lseek(fd_, end_offset_, SEEK_SET)) {
+            error_log << "cannot remove the partial record from journal " << filename_ << ": " << strerror(errno);
+            failed_ = true;
+        }
+        return ERR_IO;
+    }
+    end_offset_ += buf.size();
+    if (++num_of_unsynced_records_ >= fsync_batch_)
+        return sync();
+    return 0;
+}
+
+int pilot_journal_t::sync() {
+    if (fd_ < 0 || 0 == num_of_unsynced_records_) return 0;
+#ifdef __APPLE__
+    // macOS has no fdatasync()
+    if (0 != ::fsync(fd_)) {
+#else
+    if (0 != ::fdatasync(fd_)) {
+#endif
+        error_log << "failed syncing journal " << filename_ << ": " << strerror(errno);
+        return ERR_IO;
+    }
+    num_of_unsynced_records_ = 0;
+    return 0;
+}
+
+} // namespace pilot
@@ -66,8 +66,12 @@
 #include <cstdio>
 #include "csv.h"
 #include <fstream>
+#include "journal.hpp"
 #include "pilot/libpilot.h"
 #include "libpilotcpp.h"
+#include "log_ring.hpp"
+#include <numeric>
+#include "perf_counters.hpp"
 #include "pilot/pilot_tui.hpp"
 #include "pilot/pilot_workload_runner.hpp"
 #include <vector>
@@ -83,12 +87,14 @@ extern vector<int> EDM_percent(const double *Z, int n, int min_size, double perc
 
 namespace pilot {
 
-stringstream g_in_mem_log_buffer;
+pilot_log_ring_t g_in_mem_log;
 boost::shared_ptr< boost::log::sinks::synchronous_sink< boost::log::sinks::text_ostream_backend> > g_console_log_sink;
 pilot_log_level_t g_log_level = lv_info;
+pilot_log_level_t g_in_mem_log_level = lv_debug;
 
 // We store the log in memory to prevent generating I/O, which may interfere
-// with the benchmark. TODO: compress the log.
+// with the benchmark. The ring has a fixed capacity; see
+// pilot_set_log_buffer() for spilling evicted records to a file.
 class PilotInMemLogBackend :
         public boost::log::sinks::basic_formatted_sink_backend<
         char,
@@ -98,10 +104,40 @@ public:
     explicit PilotInMemLogBackend() {}
 
     void consume(boost::log::record_view const& rec, string_type const& msg) {
-        g_in_mem_log_buffer << msg << std::endl;
+        string line;
+        line.reserve(msg.size() + 1);
+        line.append(msg).push_back('\n');
+        g_in_mem_log.append(line);
     }
 };
 
+boost::shared_ptr< boost::log::sinks::synchronous_sink<PilotInMemLogBackend> > g_in_mem_log_sink;
+
+// Records below both the console and the in-memory log levels are rejected
+// by the core before their messages are constructed.
+static void _update_log_filters() {
+    namespace logging = boost::log;
+    logging::core::get()->set_filter
+    (
+        logging::trivial::severity >= (logging::trivial::severity_level)min(g_log_level, g_in_mem_log_level)
+    );
+    g_in_mem_log_sink->set_filter
+    (
+        logging::trivial::severity >= (logging::trivial::severity_level)g_in_mem_log_level
+    );
+    g_console_log_sink->set_filter
+    (
+        logging::trivial::severity >= (logging::trivial::severity_level)g_log_level
+    );
+}
+
+// Whether a log record of level lv would be stored by any sink. Use it to
+// skip building expensive messages that are not streamed directly into a
+// log macro.
+static inline bool _log_enabled(pilot_log_level_t lv) {
+    return lv >= PILOT_MIN_LOG_LEVEL && lv >= min(g_log_level, g_in_mem_log_level);
+}
+
 bool g_lib_self_check_done = false;
 
 void pilot_lib_self_check(int vmajor, int vminor, size_t nanosecond_type_size) noexcept {
@@ -130,6 +166,7 @@ void pilot_lib_self_check(int vmajor, int vminor, size_t nanosecond_type_size) n
     // The backend requires synchronization in the frontend.
     typedef sinks::synchronous_sink<PilotInMemLogBackend> sink_t;
     boost::shared_ptr<sink_t> sink(new sink_t(backend));
+    g_in_mem_log_sink = sink;
     sink->set_formatter
     (
             expr::format("%1%:[%2%] <%3%> %4%")
@@ -147,6 +184,7 @@ void pilot_lib_self_check(int vmajor, int vminor, size_t nanosecond_type_size) n
                 % logging::trivial::severity
                 % expr::smessage
     ));
+    _update_log_filters();
     g_lib_self_check_done = true;
 }
 
@@ -181,6 +219,7 @@ void pilot_set_pi_info(pilot_workload_t* wl, int piid,
     wl->pi_info_[piid].reading_must_satisfy = reading_must_satisfy;
     wl->pi_info_[piid].unit_reading_must_satisfy = unit_reading_must_satisfy;
     wl->pi_info_[piid].reading_ci_type = reading_ci_type;
+    wl->invalidate_analytical_result(piid);
 }
 
 pilot_workload_t* pilot_new_workload(const char *workload_name) noexcept {
@@ -295,6 +334,65 @@ void pilot_set_short_workload_check(pilot_workload_t* wl, bool check_short_workl
     wl->short_workload_check_ = check_short_workload;
 }
 
+void pilot_set_session_planner(pilot_workload_t* wl, pilot_session_planner_t planner) noexcept {
+    ASSERT_VALID_POINTER(wl);
+    wl->session_planner_ = planner;
+}
+
+/**
+ * \brief Run one round of the workload and import its results
+ * @param[in] wl pointer to the workload struct
+ * @param work_amount the work amount of the round
+ * @param[out] round_end_time (optional) the time when workload_func returned
+ * @return 0 on success; ERR_WL_FAIL if workload_func failed
+ */
+static int _run_workload_round(pilot_workload_t *wl, size_t work_amount,
+                               std::chrono::steady_clock::time_point *round_end_time) {
+    size_t num_of_unit_readings = 0;
+    double **unit_readings = NULL;
+    double *readings = NULL;
+    nanosecond_type reported_round_duration = 0;
+
+    cpu_timer round_timer;
+    int rc = wl->workload_func_(wl, wl->rounds_, work_amount, &pilot_malloc_func,
+                                &num_of_unit_readings, &unit_readings,
+                                &readings, &reported_round_duration, wl->workload_data_);
+    nanosecond_type measured_round_duration = round_timer.elapsed().wall;
+    if (round_end_time) *round_end_time = std::chrono::steady_clock::now();
+    info_log << "Finished workload round " << wl->rounds_;
+    nanosecond_type round_duration = reported_round_duration == 0 ? measured_round_duration : reported_round_duration;
+
+    // Use unique_ptrs to free readings and unit_readings automatically
+    unique_ptr<double, decltype(&std::free)> readings_unique_ptr(readings, &std::free);
+    unique_ptr<double*, std::function<void(double**)> > unit_readings_unique_ptr(unit_readings, [wl](double **p) {
+        if (p) {
+            for (size_t piid = 0; piid < wl->num_of_pi_; ++piid) {
+                if (p[piid])
+                    free(p[piid]);
+            }
+            free(p);
+        }
+    });
+
+    // result check first
+    if (0 != rc) {
+        return ERR_WL_FAIL;
+    }
+
+    //! TODO validity check: if (wl->short_workload_check_) ...
+    // Get the total_elapsed_time and avg_time_per_unit = total_elapsed_time / num_of_work_units.
+    // If avg_time_per_unit is not at least 100 times longer than the CPU time resolution then
+    // the results cannot be used. See FB#2808 and
+    // http://www.boost.org/doc/libs/1_59_0/libs/timer/doc/cpu_timers.html
+
+    // move all data into the permanent location
+    pilot_import_benchmark_results(wl, wl->rounds_, work_amount,
+                                   round_duration, readings,
+                                   num_of_unit_readings,
+                                   unit_readings);
+    return 0;
+}
+
 int pilot_run_workload(pilot_workload_t *wl) noexcept {
     // sanity check
     ASSERT_VALID_POINTER(wl);
@@ -310,19 +408,14 @@ int pilot_run_workload(pilot_workload_t *wl) noexcept {
     wl->status_ = WL_RUNNING;
 
     int result = 0;
-    size_t num_of_unit_readings;
-    double **unit_readings;
-    double *readings;
-    unique_ptr<cpu_timer> round_timer;
 
     // ready to start the workload
     size_t work_amount;
-    nanosecond_type measured_round_duration, reported_round_duration, round_duration;
     auto session_start_time = std::chrono::steady_clock::now();
+    // for measuring the time spent between rounds (analysis, hooks, and UI)
+    bool has_last_round_end_time = false;
+    std::chrono::steady_clock::time_point last_round_end_time;
     while (true) {
-        unit_readings = NULL;
-        readings = NULL;
-
         if (!wl->calc_next_round_work_amount(&work_amount)) {
             info_log << "Analytical requirement achieved, exiting";
             break;
@@ -345,63 +438,33 @@ int pilot_run_workload(pilot_workload_t *wl) noexcept {
             break;
         }
 
-        string infos = str(format("Starting workload round %1% with work_amount %2%")
-                           % wl->rounds_ % work_amount);
-        if (wl->adjusted_min_work_amount_ > 0) {
-            infos += str(format(", expected duration %1% seconds")
-                         % (wl->duration_to_work_amount_ratio() * work_amount));
-        }
-        info_log << infos;
-
-        reported_round_duration = 0;
-        readings = NULL;
-        unit_readings = NULL;
-        round_timer.reset(new cpu_timer);
-        int rc = wl->workload_func_(wl, wl->rounds_, work_amount, &pilot_malloc_func,
-                                    &num_of_unit_readings, &unit_readings,
-                                    &readings, &reported_round_duration, wl->workload_data_);
-        measured_round_duration = round_timer->elapsed().wall;
-        info_log << "Finished workload round " << wl->rounds_;
-        round_duration = reported_round_duration == 0 ? measured_round_duration : reported_round_duration;
-
-        // Use unique_ptrs to free readings and unit_readings automatically
-        unique_ptr<double, decltype(&std::free)> readings_unique_ptr(readings, &std::free);
-        unique_ptr<double*, std::function<void(double**)> > unit_readings_unique_ptr(unit_readings, [wl](double **p) {
-            if (p) {
-                for (size_t piid = 0; piid < wl->num_of_pi_; ++piid) {
-                    if (p[piid])
-                        free(p[piid]);
-                }
-                free(p);
-            }
-        });
+        info_log << "Starting workload round " << wl->rounds_ << " with work_amount " << work_amount
+                 << (wl->adjusted_min_work_amount_ > 0 ?
+                     str(format(", expected duration %1% seconds")
+                         % (wl->duration_to_work_amount_ratio() * work_amount)) : string());
 
-        // result check first
+        if (has_last_round_end_time) {
+            wl->total_round_overhead_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - last_round_end_time).count();
+            ++wl->num_of_round_overheads_;
+        }
+        int rc = _run_workload_round(wl, work_amount, &last_round_end_time);
+        has_last_round_end_time = true;
         if (0 != rc) {
-            result = ERR_WL_FAIL;
+            result = rc;
             break;
         }
 
-        //! TODO validity check: if (wl->short_workload_check_) ...
-        // Get the total_elapsed_time and avg_time_per_unit = total_elapsed_time / num_of_work_units.
-        // If avg_time_per_unit is not at least 100 times longer than the CPU time resolution then
-        // the results cannot be used. See FB#2808 and
-        // http://www.boost.org/doc/libs/1_59_0/libs/timer/doc/cpu_timers.html
-
-        // move all data into the permanent location
-        pilot_import_benchmark_results(wl, wl->rounds_, work_amount,
-                                       round_duration, readings,
-                                       num_of_unit_readings,
-                                       unit_readings);
-
-        //! TODO: save the data to a database
-
+        if (wl->snapshots_wanted_) {
+            wl->publish_analytical_result_snapshot();
+        }
         // refresh UI
         if (wl->tui_) {
-            unique_ptr<pilot_analytical_result_t> wi(wl->get_analytical_result());
-            *(wl->tui_) << *wi;
-        } else {
-            unique_ptr<pilot_analytical_result_t> wi(wl->get_analytical_result());
+            wl->refresh_analytical_result();
+            *(wl->tui_) << wl->analytical_result_;
+        } else if (_log_enabled(lv_info)) {
+            // only run the analyses whose results are printed below
+            const pilot_analytical_result_t *wi = &wl->analytical_result_;
             stringstream ss;
             ss << setw(3) << left << wl->rounds_ - 1 << " | ";
             if (!wl->num_of_pi_) {
@@ -410,7 +473,8 @@ int pilot_run_workload(pilot_workload_t *wl) noexcept {
             for (size_t piid = 0; piid < wl->num_of_pi_; ++piid) {
                 if (0 != piid) ss << "; ";
                 ss << wl->pi_info_[piid].name << ": ";
-                if (4 < wl->analytical_result_.readings_num[piid]) {
+                if (4 < wl->readings_[piid].size()) {
+                    wl->refresh_analytical_result(piid, pilot_workload_t::READINGS_ANALYSIS);
                     ss << "R m" << setprecision(4) << wl->analytical_result_.readings_mean_formatted[piid];
                     if (wl->analytical_result_.readings_required_sample_size[piid] > 0) {
                         ss << " c" << wl->analytical_result_.readings_optimal_subsession_ci_width_formatted[piid]
@@ -422,7 +486,8 @@ int pilot_run_workload(pilot_workload_t *wl) noexcept {
                 } else {
                     // No need to print anything when there is no readings data
                 }
-                if (4 < wl->analytical_result_.unit_readings_num[piid]) {
+                if (4 < wl->total_num_of_unit_readings_[piid]) {
+                    wl->refresh_analytical_result(piid, pilot_workload_t::UNIT_READINGS_ANALYSIS);
                     ss << "UR m" << setprecision(4) << wl->analytical_result_.unit_readings_mean_formatted[piid];
                     if (wl->analytical_result_.unit_readings_optimal_subsession_size[piid] > 0) {
                         ss << " c" << wl->analytical_result_.unit_readings_optimal_subsession_ci_width_formatted[piid]
@@ -435,6 +500,7 @@ int pilot_run_workload(pilot_workload_t *wl) noexcept {
                 }
             }
             if (wl->wps_enabled()) {
+                wl->refresh_wps_analysis_results();
                 ss << " WPS ";
                 if (wi->wps_has_data) {
                     ss << str(format("a %1%, v %2%, v_ci %3% (%4%%%)")
@@ -467,6 +533,9 @@ int pilot_run_workload(pilot_workload_t *wl) noexcept {
         }
     }
 
+    if (wl->journal_ && 0 != wl->journal_->sync()) {
+        warning_log << "Failed to sync the journal, the data of the last rounds may be lost on a crash";
+    }
     return result;
 }
 
@@ -510,7 +579,7 @@ static void _pilot_ui_printf(pilot_workload_t *wl, const char* prefix, const cha
     } else {
         *(wl->tui_) << prefix << buf.get();
     }
-    g_in_mem_log_buffer << buf.get();
+    g_in_mem_log.append(buf.get(), size);
 }
 
 void pilot_ui_printf(pilot_workload_t *wl, const char* format, ...) noexcept {
@@ -611,8 +680,15 @@ int pilot_export(const pilot_workload_t *wl, const char *dirname) noexcept {
         filename << dirname << "/" << "session_log.txt";
         of.exceptions(ofstream::failbit | ofstream::badbit);
         of.open(filename.str().c_str());
-        of << g_in_mem_log_buffer.str();
-        g_in_mem_log_buffer.str(string());
+        if (g_in_mem_log.evicted_records() > 0) {
+            of << "(" << g_in_mem_log.evicted_records() << " earlier log records were evicted from the in-memory log";
+            if (!g_in_mem_log.spill_file().empty())
+                of << " and saved in " << g_in_mem_log.spill_file();
+            of << ")" << endl;
+        }
+        // the log is kept, so that every workload exported after the same
+        // session gets the whole log
+        g_in_mem_log.copy(of);
         of.close();
 
         // refresh analytical result
@@ -657,10 +733,10 @@ int pilot_export(const pilot_workload_t *wl, const char *dirname) noexcept {
         of.open(filename.str().c_str());
         of << "piid,round,readings" << endl;
         for (size_t piid = 0; piid < wl->num_of_pi_; ++piid)
-            for (size_t round = 0; round < wl->rounds_; ++round) {
+            for (size_t round = 0, i = 0; round < wl->rounds_; ++round) {
                 of << piid << "," << round << ",";
-                if (wl->readings_[piid].size() > round) {
-                    of << wl->readings_[piid][round] << ",";
+                if (wl->round_has_readings_[round]) {
+                    of << wl->readings_[piid][i++] << ",";
                 } else {
                     of << ",";
                 }
@@ -762,22 +838,45 @@ int pilot_destroy_workload(pilot_workload_t *wl) noexcept {
 void pilot_set_log_level(pilot_log_level_t log_level) noexcept {
     ASSERT_VALID_POINTER(g_console_log_sink);
     g_log_level = log_level;
-    // We only change the verbose level on the console log sink. The backend always stores
-    // every piece of log.
-    g_console_log_sink->set_filter
-    (
-        boost::log::trivial::severity >= (boost::log::trivial::severity_level)log_level
-    );
+    // This only changes the verbose level on the console log sink. The
+    // in-memory log has its own level.
+    _update_log_filters();
+}
+
+void pilot_set_in_mem_log_level(pilot_log_level_t log_level) noexcept {
+    ASSERT_VALID_POINTER(g_in_mem_log_sink);
+    g_in_mem_log_level = log_level;
+    _update_log_filters();
 }
 
 const char* pilot_get_last_log_lines(size_t n) noexcept {
-    const string s = sstream_get_last_lines(g_in_mem_log_buffer, n);
-    char *r = (char*)malloc(s.size());
+    const string s = g_in_mem_log.last_lines(n);
+    char *r = (char*)malloc(s.size() + 1);
     if (!r) abort();
-    memcpy(r, s.data(), s.size());
+    memcpy(r, s.c_str(), s.size() + 1);
     return r;
 }
 
+int pilot_set_log_buffer(size_t capacity, const char *spill_dir) noexcept {
+    if (0 == capacity) {
+        error_log << __func__ << "(): capacity must be positive";
+        return ERR_WRONG_PARAM;
+    }
+    g_in_mem_log.reset(capacity);
+    string spill_file;
+    if (spill_dir) {
+        spill_file = string(spill_dir) + "/session_log_evicted.txt";
+#ifdef HAVE_ZLIB
+        spill_file += ".gz";
+#endif
+    }
+    if (!g_in_mem_log.set_spill_file(spill_file)) {
+        error_log << __func__ << "(): cannot open spill file " << spill_file;
+        return ERR_IO;
+    }
+    return 0;
+}
+
 pilot_log_level_t pilot_get_log_level(void) noexcept {
     return g_log_level;
 }
@@ -797,110 +896,100 @@ void pilot_free_analytical_result(pilot_analytical_result_t *result) noexcept {
     delete result;
 }
 
+const pilot_analytical_result_t* pilot_acquire_analytical_result_snapshot(const pilot_workload_t *wl) noexcept {
+    ASSERT_VALID_POINTER(wl);
+    return wl->acquire_analytical_result_snapshot();
+}
+
+void pilot_release_analytical_result_snapshot(const pilot_analytical_result_t *snapshot) noexcept {
+    ASSERT_VALID_POINTER(snapshot);
+    --reinterpret_cast<const analytical_result_snapshot_t*>(snapshot)->readers;
+}
+
+// All the per-PI arrays of pilot_analytical_result_t in the order they are
+// laid out in the block. readings_num must come first because it points to
+// the beginning of the block.
+#define PILOT_ANALYTICAL_RESULT_ARRAYS(X)                               \
+    X(readings_num)                                                     \
+    X(readings_mean_method)                                             \
+    X(readings_ci_type)                                                 \
+    X(readings_last_changepoint)                                        \
+    X(readings_mean)                                                    \
+    X(readings_mean_formatted)                                          \
+    X(readings_var)                                                     \
+    X(readings_var_formatted)                                           \
+    X(readings_autocorrelation_coefficient)                             \
+    X(readings_required_sample_size)                                    \
+    X(readings_optimal_subsession_size)                                 \
+    X(readings_optimal_subsession_var)                                  \
+    X(readings_optimal_subsession_var_formatted)                        \
+    X(readings_optimal_subsession_autocorrelation_coefficient)          \
+    X(readings_optimal_subsession_ci_width)                             \
+    X(readings_optimal_subsession_ci_width_formatted)                   \
+    X(readings_raw_mean)                                                \
+    X(readings_raw_mean_formatted)                                      \
+    X(readings_raw_var)                                                 \
+    X(readings_raw_var_formatted)                                       \
+    X(readings_raw_autocorrelation_coefficient)                         \
+    X(readings_raw_required_sample_size)                                \
+    X(readings_raw_optimal_subsession_size)                             \
+    X(readings_raw_optimal_subsession_var)                              \
+    X(readings_raw_optimal_subsession_var_formatted)                    \
+    X(readings_raw_optimal_subsession_autocorrelation_coefficient)      \
+    X(readings_raw_optimal_subsession_ci_width)                         \
+    X(readings_raw_optimal_subsession_ci_width_formatted)               \
+    X(unit_readings_num)                                                \
+    X(unit_readings_mean)                                               \
+    X(unit_readings_mean_formatted)                                     \
+    X(unit_readings_mean_method)                                        \
+    X(unit_readings_var)                                                \
+    X(unit_readings_var_formatted)                                      \
+    X(unit_readings_autocorrelation_coefficient)                        \
+    X(unit_readings_optimal_subsession_size)                            \
+    X(unit_readings_optimal_subsession_var)                             \
+    X(unit_readings_optimal_subsession_var_formatted)                   \
+    X(unit_readings_optimal_subsession_autocorrelation_coefficient)     \
+    X(unit_readings_optimal_subsession_ci_width)                        \
+    X(unit_readings_optimal_subsession_ci_width_formatted)              \
+    X(unit_readings_required_sample_size)                               \
+    X(unit_readings_required_sample_size_is_from_user)
+
+/**
+ * The size of an array of n elements of elem_size in the block, padded so
+ * that the next array stays aligned
+ */
+static inline size_t _block_array_size(size_t n, size_t elem_size) {
+    return (n * elem_size + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+}
+
+size_t pilot_analytical_result_t::_block_size(size_t n) const {
+    size_t size = 0;
+#define ADD_ARRAY_SIZE(field) size += _block_array_size(n, sizeof(field[0]));
+    PILOT_ANALYTICAL_RESULT_ARRAYS(ADD_ARRAY_SIZE)
+#undef ADD_ARRAY_SIZE
+    return size;
+}
+
 void pilot_analytical_result_t::_free_all_field() {
-#define FREE_AND_NULL(field) free(field); field = NULL
-
-    FREE_AND_NULL(readings_num);
-    FREE_AND_NULL(readings_mean_method);
-    FREE_AND_NULL(readings_ci_type);
-    FREE_AND_NULL(readings_last_changepoint);
-    FREE_AND_NULL(readings_mean);
-    FREE_AND_NULL(readings_mean_formatted);
-    FREE_AND_NULL(readings_var);
-    FREE_AND_NULL(readings_var_formatted);
-    FREE_AND_NULL(readings_autocorrelation_coefficient);
-    FREE_AND_NULL(readings_optimal_subsession_size);
-    FREE_AND_NULL(readings_optimal_subsession_var);
-    FREE_AND_NULL(readings_optimal_subsession_var_formatted);
-    FREE_AND_NULL(readings_optimal_subsession_autocorrelation_coefficient);
-    FREE_AND_NULL(readings_optimal_subsession_ci_width);
-    FREE_AND_NULL(readings_optimal_subsession_ci_width_formatted);
-    FREE_AND_NULL(readings_required_sample_size);
-    FREE_AND_NULL(readings_raw_mean);
-    FREE_AND_NULL(readings_raw_mean_formatted);
-    FREE_AND_NULL(readings_raw_var);
-    FREE_AND_NULL(readings_raw_var_formatted);
-    FREE_AND_NULL(readings_raw_autocorrelation_coefficient);
-    FREE_AND_NULL(readings_raw_optimal_subsession_size);
-    FREE_AND_NULL(readings_raw_optimal_subsession_var);
-    FREE_AND_NULL(readings_raw_optimal_subsession_var_formatted);
-    FREE_AND_NULL(readings_raw_optimal_subsession_autocorrelation_coefficient);
-    FREE_AND_NULL(readings_raw_optimal_subsession_ci_width);
-    FREE_AND_NULL(readings_raw_optimal_subsession_ci_width_formatted);
-    FREE_AND_NULL(readings_raw_required_sample_size);
-
-    FREE_AND_NULL(unit_readings_num);
-    FREE_AND_NULL(unit_readings_mean);
-    FREE_AND_NULL(unit_readings_mean_formatted);
-    FREE_AND_NULL(unit_readings_mean_method);
-    FREE_AND_NULL(unit_readings_var);
-    FREE_AND_NULL(unit_readings_var_formatted);
-    FREE_AND_NULL(unit_readings_autocorrelation_coefficient);
-    FREE_AND_NULL(unit_readings_optimal_subsession_size);
-    FREE_AND_NULL(unit_readings_optimal_subsession_var);
-    FREE_AND_NULL(unit_readings_optimal_subsession_var_formatted);
-    FREE_AND_NULL(unit_readings_optimal_subsession_autocorrelation_coefficient);
-    FREE_AND_NULL(unit_readings_optimal_subsession_ci_width);
-    FREE_AND_NULL(unit_readings_optimal_subsession_ci_width_formatted);
-    FREE_AND_NULL(unit_readings_required_sample_size);
-    FREE_AND_NULL(unit_readings_required_sample_size_is_from_user);
-
-#undef FREE_AND_NULL
+    free(readings_num);
+#define SET_NULL(field) field = NULL;
+    PILOT_ANALYTICAL_RESULT_ARRAYS(SET_NULL)
+#undef SET_NULL
 }
 
 void pilot_analytical_result_t::_copyfrom(const pilot_analytical_result_t &a) {
-    num_of_pi = a.num_of_pi;
+    if (!a.readings_num) {
+        _free_all_field();
+        num_of_pi = a.num_of_pi;
+    } else {
+        // results of the same number of PIs have the same block layout
+        if (!readings_num || num_of_pi != a.num_of_pi) {
+            set_num_of_pi(a.num_of_pi);
+        }
+        memcpy(readings_num, a.readings_num, _block_size(num_of_pi));
+    }
     num_of_rounds = a.num_of_rounds;
 
-#define COPY_ARRAY(field) if (a.field) { field = (typeof(field[0])*)realloc(field, sizeof(field[0]) * num_of_pi); \
-    memcpy(field, a.field, sizeof(field[0]) * num_of_pi); } else { field = NULL; }
-
-    COPY_ARRAY(readings_num);
-    COPY_ARRAY(readings_mean_method);
-    COPY_ARRAY(readings_ci_type);
-    COPY_ARRAY(readings_last_changepoint);
-    COPY_ARRAY(readings_mean);
-    COPY_ARRAY(readings_mean_formatted);
-    COPY_ARRAY(readings_var);
-    COPY_ARRAY(readings_var_formatted);
-    COPY_ARRAY(readings_autocorrelation_coefficient);
-    COPY_ARRAY(readings_optimal_subsession_size);
-    COPY_ARRAY(readings_optimal_subsession_var);
-    COPY_ARRAY(readings_optimal_subsession_var_formatted);
-    COPY_ARRAY(readings_optimal_subsession_autocorrelation_coefficient);
-    COPY_ARRAY(readings_optimal_subsession_ci_width);
-    COPY_ARRAY(readings_optimal_subsession_ci_width_formatted);
-    COPY_ARRAY(readings_required_sample_size);
-    COPY_ARRAY(readings_raw_mean);
-    COPY_ARRAY(readings_raw_mean_formatted);
-    COPY_ARRAY(readings_raw_var);
-    COPY_ARRAY(readings_raw_var_formatted);
-    COPY_ARRAY(readings_raw_autocorrelation_coefficient);
-    COPY_ARRAY(readings_raw_optimal_subsession_size);
-    COPY_ARRAY(readings_raw_optimal_subsession_var);
-    COPY_ARRAY(readings_raw_optimal_subsession_var_formatted);
-    COPY_ARRAY(readings_raw_optimal_subsession_autocorrelation_coefficient);
-    COPY_ARRAY(readings_raw_optimal_subsession_ci_width);
-    COPY_ARRAY(readings_raw_optimal_subsession_ci_width_formatted);
-    COPY_ARRAY(readings_raw_required_sample_size);
-
-    COPY_ARRAY(unit_readings_num);
-    COPY_ARRAY(unit_readings_mean);
-    COPY_ARRAY(unit_readings_mean_formatted);
-    COPY_ARRAY(unit_readings_mean_method);
-    COPY_ARRAY(unit_readings_var);
-    COPY_ARRAY(unit_readings_var_formatted);
-    COPY_ARRAY(unit_readings_autocorrelation_coefficient);
-    COPY_ARRAY(unit_readings_optimal_subsession_size);
-    COPY_ARRAY(unit_readings_optimal_subsession_var);
-    COPY_ARRAY(unit_readings_optimal_subsession_var_formatted);
-    COPY_ARRAY(unit_readings_optimal_subsession_autocorrelation_coefficient);
-    COPY_ARRAY(unit_readings_optimal_subsession_ci_width);
-    COPY_ARRAY(unit_readings_optimal_subsession_ci_width_formatted);
-    COPY_ARRAY(unit_readings_required_sample_size);
-    COPY_ARRAY(unit_readings_required_sample_size_is_from_user);
-#undef COPY_ARRAY
-
 #define COPY_FIELD(field) field = a.field;
     COPY_FIELD(wps_subsession_sample_size);
     COPY_FIELD(wps_harmonic_mean);
@@ -918,6 +1007,17 @@ void pilot_analytical_result_t::_copyfrom(const pilot_analytical_result_t &a) {
         COPY_FIELD(wps_err);
         COPY_FIELD(wps_err_percent);
     }
+    COPY_FIELD(planner_has_data);
+    if (a.planner_has_data) {
+        COPY_FIELD(planner_planned_rounds);
+        COPY_FIELD(planner_planned_work_amount);
+        COPY_FIELD(planner_round_fixed_cost);
+        COPY_FIELD(planner_work_amount_cost);
+        COPY_FIELD(planner_predicted_remaining_time);
+        COPY_FIELD(planner_num_of_predictions);
+        COPY_FIELD(planner_round_duration_error);
+        COPY_FIELD(planner_remaining_time_error);
+    }
     COPY_FIELD(session_duration);
 #undef COPY_FIELD
 }
@@ -938,64 +1038,36 @@ pilot_analytical_result_t::~pilot_analytical_result_t() {
 void pilot_analytical_result_t::set_num_of_pi(size_t new_num_of_pi) {
     size_t old_num_of_pi = num_of_pi;
     num_of_pi = new_num_of_pi;
-#define INIT_FIELD(field) field = (typeof(field[0])*)realloc(field, sizeof(field[0]) * num_of_pi)
+    if (0 == new_num_of_pi) {
+        _free_all_field();
+        return;
+    }
+    // Move the existing values into a new block. The old arrays stay valid
+    // until the old block is freed at the end.
+    char *old_block = reinterpret_cast<char*>(readings_num);
+    char *block = static_cast<char*>(calloc(1, _block_size(new_num_of_pi)));
+    die_if(!block, ERR_NOMEM, string(__func__) + "() cannot allocate memory");
+    const size_t num_to_keep = old_block ? min(old_num_of_pi, new_num_of_pi) : 0;
+    char *p = block;
+#define MOVE_ARRAY(field) {                                                            \
+        auto old_array = field;                                                        \
+        field = reinterpret_cast<decltype(field)>(p);                                  \
+        if (num_to_keep) memcpy(field, old_array, sizeof(field[0]) * num_to_keep);     \
+        p += _block_array_size(new_num_of_pi, sizeof(field[0]));                       \
+    }
+    PILOT_ANALYTICAL_RESULT_ARRAYS(MOVE_ARRAY)
+#undef MOVE_ARRAY
+    free(old_block);
+
 // SET_VAL only touches newly allocated space and doesn't change existing value
-#define SET_VAL(field, val) if (new_num_of_pi > old_num_of_pi) for (size_t i=old_num_of_pi; i<new_num_of_pi; ++i) field[i] = val
-
-    INIT_FIELD(readings_num);
-    SET_VAL(readings_num, 0);
-    INIT_FIELD(readings_mean_method);
-    INIT_FIELD(readings_ci_type);
-    INIT_FIELD(readings_last_changepoint);
-    SET_VAL(readings_last_changepoint, 0);
-    INIT_FIELD(readings_mean);
-    INIT_FIELD(readings_mean_formatted);
-    INIT_FIELD(readings_var);
-    INIT_FIELD(readings_var_formatted);
-    INIT_FIELD(readings_autocorrelation_coefficient);
-    INIT_FIELD(readings_required_sample_size);
+#define SET_VAL(field, val) for (size_t i = num_to_keep; i < new_num_of_pi; ++i) field[i] = val
     SET_VAL(readings_required_sample_size, -1);
-    INIT_FIELD(readings_optimal_subsession_size);
     SET_VAL(readings_optimal_subsession_size, -1);
-    INIT_FIELD(readings_optimal_subsession_var);
-    INIT_FIELD(readings_optimal_subsession_var_formatted);
-    INIT_FIELD(readings_optimal_subsession_autocorrelation_coefficient);
-    INIT_FIELD(readings_optimal_subsession_ci_width);
-    INIT_FIELD(readings_optimal_subsession_ci_width_formatted);
-    INIT_FIELD(readings_raw_mean);
-    INIT_FIELD(readings_raw_mean_formatted);
-    INIT_FIELD(readings_raw_var);
-    INIT_FIELD(readings_raw_var_formatted);
-    INIT_FIELD(readings_raw_autocorrelation_coefficient);
-    INIT_FIELD(readings_raw_required_sample_size);
     SET_VAL(readings_raw_required_sample_size, -1);
-    INIT_FIELD(readings_raw_optimal_subsession_size);
     SET_VAL(readings_raw_optimal_subsession_size, -1);
-    INIT_FIELD(readings_raw_optimal_subsession_var);
-    INIT_FIELD(readings_raw_optimal_subsession_var_formatted);
-    INIT_FIELD(readings_raw_optimal_subsession_autocorrelation_coefficient);
-    INIT_FIELD(readings_raw_optimal_subsession_ci_width);
-    INIT_FIELD(readings_raw_optimal_subsession_ci_width_formatted);
-
-    INIT_FIELD(unit_readings_num);
-    INIT_FIELD(unit_readings_mean);
-    INIT_FIELD(unit_readings_mean_formatted);
-    INIT_FIELD(unit_readings_mean_method);
-    INIT_FIELD(unit_readings_var);
-    INIT_FIELD(unit_readings_var_formatted);
-    INIT_FIELD(unit_readings_autocorrelation_coefficient);
-    INIT_FIELD(unit_readings_optimal_subsession_size);
     SET_VAL(unit_readings_optimal_subsession_size, -1);
-    INIT_FIELD(unit_readings_optimal_subsession_var);
-    INIT_FIELD(unit_readings_optimal_subsession_var_formatted);
-    INIT_FIELD(unit_readings_optimal_subsession_autocorrelation_coefficient);
-    INIT_FIELD(unit_readings_optimal_subsession_ci_width);
-    INIT_FIELD(unit_readings_optimal_subsession_ci_width_formatted);
-    INIT_FIELD(unit_readings_required_sample_size);
     SET_VAL(unit_readings_required_sample_size, -1);
-    INIT_FIELD(unit_readings_required_sample_size_is_from_user);
 #undef SET_VAL
-#undef INIT_FIELD
 }
 
 pilot_analytical_result_t& pilot_analytical_result_t::operator=(const pilot_analytical_result_t &a) {
@@ -1226,6 +1298,39 @@ int pilot_wps_warmup_removal_lr_method_p(size_t rounds, const size_t *round_work
                                               subsession_sample_size);
 }
 
+/**
+ * Detect the warm-up phase in the unit readings of a round without checking
+ * the round duration
+ */
+static int _warm_up_removal_detect(const pilot_workload_t *wl,
+                                   const double *data, size_t n,
+                                   pilot_warm_up_removal_detection_method_t method,
+                                   size_t *begin, size_t *end) {
+    switch (method) {
+    case NO_WARM_UP_REMOVAL:
+        *begin = 0;
+        *end = n;
+        return 0;
+        break;
+    case FIXED_PERCENTAGE:
+        *begin = static_cast<size_t>(round(wl->warm_up_removal_percentage_ * n));
+        *end = n;
+        if (*begin == n && n != 0) {
+            // we leave at least one data
+            --(*begin);
+        }
+        return 0;
+        break;
+    case EDM:
+        return pilot_find_dominant_segment(data, n, begin, end);
+        break;
+    default:
+        fatal_log << "Unknown method";
+        abort();
+        break;
+    }
+}
+
 int pilot_warm_up_removal_detect(const pilot_workload_t *wl,
                                  const double *data,
                                  size_t n,
@@ -1235,14 +1340,9 @@ int pilot_warm_up_removal_detect(const pilot_workload_t *wl,
     ASSERT_VALID_POINTER(wl);
     ASSERT_VALID_POINTER(begin);
     ASSERT_VALID_POINTER(end);
-    if (NO_WARM_UP_REMOVAL == method) {
-        *begin = 0;
-        *end = n;
-        return 0;
-    }
 
     // we reject any round that is too short
-    if (round_duration < wl->short_round_detection_threshold_) {
+    if (NO_WARM_UP_REMOVAL != method && round_duration < wl->short_round_detection_threshold_) {
         info_log << "Round duration shorter than the lower bound ("
                  << wl->short_round_detection_threshold_ / ONE_SECOND
                  << "s), rejecting";
@@ -1250,25 +1350,57 @@ int pilot_warm_up_removal_detect(const pilot_workload_t *wl,
         *end = n;
         return ERR_ROUND_TOO_SHORT;
     }
+    return _warm_up_removal_detect(wl, data, n, method, begin, end);
+}
 
-    switch (method) {
-    case FIXED_PERCENTAGE:
-        *begin = static_cast<size_t>(round(wl->warm_up_removal_percentage_ * n));
-        *end = n;
-        if (*begin == n && n != 0) {
-            // we leave at least one data
-            --(*begin);
+/**
+ * Store the data of a round as it is kept in wl into the journal
+ * @param readings the readings of each PI in this round, or NULL if the round
+ * has no readings
+ */
+static int _append_round_to_journal(const pilot_workload_t *wl, size_t round,
+                                    const double *readings) {
+    pilot_journal_round_t r;
+    r.round = round;
+    r.work_amount = wl->round_work_amounts_[round];
+    r.round_duration = wl->round_durations_[round];
+    r.has_readings = (NULL != readings);
+    for (size_t piid = 0; piid < wl->num_of_pi_; ++piid) {
+        if (readings) r.readings.push_back(readings[piid]);
+        r.unit_readings.push_back(wl->unit_readings_[piid][round]);
+        r.warm_up_phase_len.push_back(wl->warm_up_phase_len_[piid][round]);
+    }
+    return wl->journal_->append(r);
+}
+
+/**
+ * \brief Set the readings of a round, which can be a new round
+ * \details readings_ only holds the readings of the rounds that have them, so
+ * they are inserted or erased when a round gains or loses its readings.
+ * @param readings the readings of each PI, or NULL if the round has none
+ */
+static void _set_round_readings(pilot_workload_t *wl, size_t round, const double *readings) {
+    const size_t i = wl->readings_index(round);
+    const bool had_readings = round != wl->rounds_ && wl->round_has_readings_[round];
+    for (size_t piid = 0; piid < wl->num_of_pi_; ++piid) {
+        vector<double> &rs = wl->readings_[piid];
+        if (readings && had_readings) {
+            rs[i] = readings[piid];
+        } else if (readings) {
+            rs.insert(rs.begin() + i, readings[piid]);
+            ++wl->total_num_of_readings_[piid];
+        } else if (had_readings) {
+            rs.erase(rs.begin() + i);
+            --wl->total_num_of_readings_[piid];
+        } else {
+            continue;
         }
-        return 0;
-        break;
-    case EDM:
-        return pilot_find_dominant_segment(data, n, begin, end);
-        break;
-    default:
-        fatal_log << "Unknown method";
-        abort();
-        break;
+        wl->invalidate_analytical_result(piid, pilot_workload_t::READINGS_ANALYSIS);
     }
+    if (round == wl->rounds_)
+        wl->round_has_readings_.push_back(NULL != readings);
+    else
+        wl->round_has_readings_[round] = (NULL != readings);
 }
 
 void pilot_import_benchmark_results(pilot_workload_t *wl, size_t round,
@@ -1279,13 +1411,15 @@ void pilot_import_benchmark_results(pilot_workload_t *wl, size_t round,
                                     const double * const *unit_readings) noexcept {
     ASSERT_VALID_POINTER(wl);
     die_if(round > wl->rounds_, ERR_WRONG_PARAM, string("Invalid round value for ") + __func__);
-    wl->raw_data_changed_time_ = chrono::steady_clock::now();
 
     // update work_amount
-    if (round != wl->rounds_)
+    if (round != wl->rounds_) {
         wl->round_work_amounts_[round] = work_amount;
-    else
+        wl->wps_regression_.reset();
+        wl->wps_analysis_rounds_ = -1;
+    } else {
         wl->round_work_amounts_.push_back(work_amount);
+    }
 
     // update round_dueration
     if (round != wl->rounds_)
@@ -1310,25 +1444,39 @@ void pilot_import_benchmark_results(pilot_workload_t *wl, size_t round,
                 debug_log << "new round num_of_unit_readings = " << num_of_unit_readings;
                 wl->unit_readings_[piid].emplace_back(vector<double>(unit_readings[piid], unit_readings[piid] + num_of_unit_readings));
             } else {
-                debug_log << str(format("[PI %1%] has no unit readings data in round %2%") % piid % round);
+                debug_log << format("[PI %1%] has no unit readings data in round %2%") % piid % round;
                 wl->unit_readings_[piid].emplace_back(vector<double>());
             }
         } else {
             debug_log << "replacing data for an existing round";
-            wl->unit_readings_[piid][round].resize(num_of_unit_readings);
             if (unit_readings && unit_readings[piid])
-                memcpy(wl->unit_readings_[piid][round].data(), unit_readings[piid], sizeof(double) * num_of_unit_readings);
+                wl->unit_readings_[piid][round].assign(unit_readings[piid], unit_readings[piid] + num_of_unit_readings);
+            else
+                wl->unit_readings_[piid][round].clear();
         }
 
         // warm-up removal
         size_t dominant_begin = 0, dominant_end = 0;
-        if (unit_readings) {
+        if (unit_readings && unit_readings[piid]) {
             info_log << "Running changepoint detection on UR data";
-            int res = pilot_warm_up_removal_detect(wl, unit_readings[piid],
+            int res;
+            if (round_duration < wl->short_round_detection_threshold_ &&
+                wl->adjusted_min_work_amount_ < 0) {
+                // This round is one of the probes of the search for the
+                // shortest valid round (see calc_next_round_work_amount_meet_lower_bound()),
+                // so we keep its data instead of rejecting it for being short.
+                info_log << "Keeping the UR data of short probing round " << round;
+                res = _warm_up_removal_detect(wl, unit_readings[piid],
+                                              num_of_unit_readings,
+                                              wl->warm_up_removal_detection_method_,
+                                              &dominant_begin, &dominant_end);
+            } else {
+                res = pilot_warm_up_removal_detect(wl, unit_readings[piid],
                                                    num_of_unit_readings,
                                                    round_duration,
                                                    wl->warm_up_removal_detection_method_,
                                                    &dominant_begin, &dominant_end);
+            }
             if (res != 0) {
                 switch (res) {
                 case ERR_NOT_ENOUGH_DATA:
@@ -1343,8 +1491,8 @@ void pilot_import_benchmark_results(pilot_workload_t *wl, size_t round,
                     dominant_end = num_of_unit_readings;
                     break;
                 default:
-                    info_log << str(format("Non-stable phase detection failed on PI %1% at round %2% (error %3%). Ignoring UR data in last round.")
-                                    % piid % wl->rounds_ % res);
+                    info_log << format("Non-stable phase detection failed on PI %1% at round %2% (error %3%). Ignoring UR data in last round.")
+                                    % piid % wl->rounds_ % res;
                     dominant_begin = num_of_unit_readings;
                     dominant_end = num_of_unit_readings;
                 }
@@ -1365,22 +1513,16 @@ void pilot_import_benchmark_results(pilot_workload_t *wl, size_t round,
         if (new_urs > 0) {
             // increase total number of unit readings (the number of old unit readings are
             // subtracted at the beginning of the for loop).
-            info_log << str(format("Ingested %1% URs from last round") % new_urs);
+            info_log << format("Ingested %1% URs from last round") % new_urs;
             wl->total_num_of_unit_readings_[piid] += new_urs;
             at_least_one_piid_got_new_data = true;
         }
-
-        // handle readings
-        if (readings) {
-            at_least_one_piid_got_new_data = true;
-            if (round == wl->rounds_) {
-                wl->readings_[piid].push_back(readings[piid]);
-                ++wl->total_num_of_readings_[piid];
-            } else {
-                wl->readings_[piid][round] = readings[piid];
-            }
+        if (new_urs > 0 || round != wl->rounds_) {
+            wl->invalidate_analytical_result(piid, pilot_workload_t::UNIT_READINGS_ANALYSIS);
         }
     } // for loop for PI
+    _set_round_readings(wl, round, readings);
+    if (readings) at_least_one_piid_got_new_data = true;
     if (wl->num_of_pi_ != 0 && !at_least_one_piid_got_new_data) {
         info_log << "No data ingested in round " << round;
         ++wl->wholly_rejected_rounds_;
@@ -1388,6 +1530,118 @@ void pilot_import_benchmark_results(pilot_workload_t *wl, size_t round,
 
     if (round == wl->rounds_)
         ++wl->rounds_;
+
+    if (wl->journal_ && 0 != _append_round_to_journal(wl, round, readings)) {
+        warning_log << "Failed to append round " << round << " to the journal";
+    }
+}
+
+/**
+ * Load a round from the journal into wl. This is the counterpart of
+ * pilot_import_benchmark_results() that uses the stored warm-up phase
+ * lengths instead of running the detection again.
+ */
+static void _replay_journal_round(pilot_workload_t *wl, const pilot_journal_round_t &r) {
+    const size_t round = r.round;
+    die_if(round > wl->rounds_, ERR_WRONG_PARAM, "Invalid round value in the journal");
+    if (round != wl->rounds_) {
+        wl->round_work_amounts_[round] = r.work_amount;
+        wl->round_durations_[round] = r.round_duration;
+        wl->wps_regression_.reset();
+        wl->wps_analysis_rounds_ = -1;
+    } else {
+        wl->round_work_amounts_.push_back(r.work_amount);
+        wl->round_durations_.push_back(r.round_duration);
+    }
+
+    bool at_least_one_piid_got_new_data = false;
+    for (size_t piid = 0; piid < wl->num_of_pi_; ++piid) {
+        if (round != wl->rounds_) {
+            wl->total_num_of_unit_readings_[piid] -= wl->unit_readings_[piid][round].size()
+                                                     - wl->warm_up_phase_len_[piid][round];
+            wl->unit_readings_[piid][round] = r.unit_readings[piid];
+            wl->warm_up_phase_len_[piid][round] = r.warm_up_phase_len[piid];
+        } else {
+            wl->unit_readings_[piid].push_back(r.unit_readings[piid]);
+            wl->warm_up_phase_len_[piid].push_back(r.warm_up_phase_len[piid]);
+        }
+        int new_urs = int(r.unit_readings[piid].size()) - int(r.warm_up_phase_len[piid]);
+        if (new_urs > 0) {
+            wl->total_num_of_unit_readings_[piid] += new_urs;
+            at_least_one_piid_got_new_data = true;
+        }
+        if (new_urs > 0 || round != wl->rounds_) {
+            wl->invalidate_analytical_result(piid, pilot_workload_t::UNIT_READINGS_ANALYSIS);
+        }
+    }
+    _set_round_readings(wl, round, r.has_readings ? r.readings.data() : NULL);
+    if (r.has_readings) at_least_one_piid_got_new_data = true;
+    if (wl->num_of_pi_ != 0 && !at_least_one_piid_got_new_data)
+        ++wl->wholly_rejected_rounds_;
+
+    if (round == wl->rounds_)
+        ++wl->rounds_;
+}
+
+int pilot_set_journal(pilot_workload_t *wl, const char *filename,
+                      size_t fsync_batch) noexcept {
+    ASSERT_VALID_POINTER(wl);
+    if (WL_RUNNING == wl->status_) {
+        error_log << __func__ << "() cannot be called while the workload is running";
+        return ERR_WRONG_PARAM;
+    }
+    wl->journal_.reset();
+    if (!filename) return 0;
+
+    shared_ptr<pilot_journal_t> journal(new pilot_journal_t);
+    int res = journal->create(filename, wl->workload_name_, wl->num_of_pi_, fsync_batch);
+    if (0 != res) return res;
+    // write out the rounds we already have so the journal is complete
+    wl->journal_ = journal;
+    vector<double> readings(wl->num_of_pi_);
+    for (size_t round = 0, i = 0; round < wl->rounds_; ++round) {
+        const bool has_readings = wl->round_has_readings_[round];
+        for (size_t piid = 0; has_readings && piid < wl->num_of_pi_; ++piid)
+            readings[piid] = wl->readings_[piid][i];
+        if (has_readings) ++i;
+        res = _append_round_to_journal(wl, round, has_readings ? readings.data() : NULL);
+        if (0 != res) {
+            wl->journal_.reset();
+            return res;
+        }
+    }
+    return wl->journal_->sync();
+}
+
+int pilot_load_journal(pilot_workload_t *wl, const char *filename,
+                       size_t fsync_batch) noexcept {
+    ASSERT_VALID_POINTER(wl);
+    ASSERT_VALID_POINTER(filename);
+    if (WL_RUNNING == wl->status_) {
+        error_log << __func__ << "() cannot be called while the workload is running";
+        return ERR_WRONG_PARAM;
+    }
+    if (0 != wl->rounds_) {
+        error_log << __func__ << "() can only be used on a workload that has no rounds";
+        return ERR_WRONG_PARAM;
+    }
+    wl->journal_.reset();
+    shared_ptr<pilot_journal_t> journal(new pilot_journal_t);
+    int res = journal->open(filename, wl->num_of_pi_, fsync_batch,
+                            [wl](const pilot_journal_round_t &r) {
+                                _replay_journal_round(wl, r);
+                            });
+    if (0 != res) return res;
+    wl->journal_ = journal;
+    return 0;
+}
+
+int pilot_resume_workload(pilot_workload_t *wl, const char *filename,
+                          size_t fsync_batch) noexcept {
+    int res = pilot_load_journal(wl, filename, fsync_batch);
+    if (0 != res) return res;
+    info_log << "Resuming workload from round " << wl->rounds_;
+    return pilot_run_workload(wl);
 }
 
 pilot_pi_unit_readings_iter_t*
@@ -1428,6 +1682,54 @@ void pilot_set_required_confidence_interval(pilot_workload_t *wl, double percent
     wl->set_required_ci_absolute_value(absolute_value);
 }
 
+/**
+ * Predict the smallest work amount that makes a round no shorter than
+ * short_round_detection_threshold_ by fitting round duration vs. work amount
+ * of the rounds so far, like the WPS regression does. The prediction aims
+ * slightly above the threshold so noise doesn't make the next round short
+ * again.
+ */
+static size_t _predict_min_work_amount(const pilot_workload_t *wl) {
+    const double kSafetyMargin = 1.1;
+    const size_t last_wa = wl->round_work_amounts_.back();
+    vector<double> wa, dur;
+    for (size_t r = 0; r < wl->rounds_; ++r) {
+        if (0 == wl->round_work_amounts_[r] || wl->round_is_rejected(r)) continue;
+        wa.push_back(wl->round_work_amounts_[r]);
+        dur.push_back(wl->round_durations_[r]);
+    }
+
+    // duration = alpha + v * work_amount
+    double alpha = 0, v = 0;
+    bool fitted = false;
+    if (wa.size() >= 2 && any_of(wa.begin(), wa.end(), [&wa](double c) { return c != wa[0]; })) {
+        simple_regression_model(wa, dur, &alpha, &v);
+        fitted = v > 0 && isfinite(alpha);
+    }
+    if (!fitted) {
+        // Assume the duration is proportional to the work amount. This
+        // underestimates the work amount when rounds have a fixed cost, but
+        // the next round gives us a second work amount to fit.
+        alpha = 0;
+        v = accumulate(dur.begin(), dur.end(), 0.0) / accumulate(wa.begin(), wa.end(), 0.0);
+    }
+    const double predicted = (kSafetyMargin * wl->short_round_detection_threshold_ - alpha) / v;
+    size_t proposed;
+    if (!(v > 0) || !(predicted > last_wa)) {
+        // the data contradicts the model, fall back to doubling
+        proposed = 2 * last_wa;
+        info_log << format("Proposing to using previous round's work amount x 2 (%1%).") % proposed;
+    } else if (predicted >= wl->max_work_amount_) {
+        proposed = wl->max_work_amount_;
+        info_log << format("Proposing to using max_work_amount (%1%).") % proposed;
+    } else {
+        proposed = size_t(ceil(predicted));
+        info_log << format("Proposing work amount %1% predicted by round duration = %2% s + %3% s x work amount")
+                        % proposed % (alpha / ONE_SECOND) % (v / ONE_SECOND);
+    }
+    return min(max(proposed, last_wa + 1), wl->max_work_amount_);
+}
+
 bool calc_next_round_work_amount_meet_lower_bound(const pilot_workload_t *wl, size_t *needed_work_amount) noexcept {
     // We can't do anything if this workload doesn't support setting work amount.
     if (0 == wl->max_work_amount_) {
@@ -1443,21 +1745,11 @@ bool calc_next_round_work_amount_meet_lower_bound(const pilot_workload_t *wl, si
     if (wl->round_durations_.back() < wl->short_round_detection_threshold_) {
         info_log << "Previous round duration (" << double(wl->round_durations_.back()) / ONE_SECOND << " s) "
                  << "is shorter than the lower bound (" << double(wl->short_round_detection_threshold_) / ONE_SECOND << " s).";
-        if (wl->round_work_amounts_.back() == wl->max_work_amount_) {
+        if (wl->round_work_amounts_.back() >= wl->max_work_amount_) {
             fatal_log << "Running at max_work_amount_ still cannot meet round duration requirement. Please increase the max work amount upper limit.";
             *needed_work_amount = wl->max_work_amount_;
         } else {
-            if (wl->round_work_amounts_.back() == wl->max_work_amount_) {
-                fatal_log << "The round using max_work_amount_ is still shorter than the lower bound,"
-                             "please change your settings.";
-                abort();
-            } else if (wl->round_work_amounts_.back() > wl->max_work_amount_ / 2) {
-                *needed_work_amount = wl->max_work_amount_;
-                info_log << str(format("Proposing to using max_work_amount (%1%).") % *needed_work_amount);
-            } else {
-                *needed_work_amount = min(wl->round_work_amounts_.back() * 2, wl->max_work_amount_);
-                info_log << str(format("Proposing to using previous round's work amount x 2 (%1%).") % *needed_work_amount);
-            }
+            *needed_work_amount = _predict_min_work_amount(wl);
         }
         return true;
     } else if (wl->adjusted_min_work_amount_ < 0) {
@@ -1492,7 +1784,13 @@ bool calc_next_round_work_amount_from_readings(const pilot_workload_t *wl, size_
             continue;
         }
         if (0 == wl->total_num_of_readings_[piid]) {
-            // no need to do anything if this PIID has no unit reading
+            // Keep running while all rounds so far were rejected, e.g., timed
+            // out. A workload that only gives unit readings has no readings
+            // to wait for.
+            if (wl->wholly_rejected_rounds_ == wl->rounds_) {
+                info_log << "[PI " << piid << "] has no data yet, continuing to next round";
+                return true;
+            }
             continue;
         }
         ssize_t req = wl->required_num_of_readings(piid);
@@ -1502,7 +1800,7 @@ bool calc_next_round_work_amount_from_readings(const pilot_workload_t *wl, size_
                 info_log << "[PI " << piid << "] already has enough readings";
                 continue;
             } else {
-                info_log << str(format("[PI %1%] needs %2% more readings") % piid % (static_cast<size_t>(req) - wl->total_num_of_readings_[piid]));
+                info_log << format("[PI %1%] needs %2% more readings") % piid % (static_cast<size_t>(req) - wl->total_num_of_readings_[piid]);
             }
         } else {
             info_log << "[PI " << piid << "] doesn't have enough readings for calculating required sample size, continuing to next round";
@@ -1556,17 +1854,17 @@ bool calc_next_round_work_amount_from_unit_readings(const pilot_workload_t *wl,
             if (req > 0) {
                 ssize_t subsession_size = wl->analytical_result_.unit_readings_optimal_subsession_size[piid];
                 if (subsession_size > 1) {
-                    info_log << str(format("[PI %1%] has high autocorrelation (%2%), merging every %3% samples to make URs indepedent.")
+                    info_log << format("[PI %1%] has high autocorrelation (%2%), merging every %3% samples to make URs indepedent.")
                                            % piid % (wl->analytical_result_.unit_readings_autocorrelation_coefficient[piid])
-                                           % subsession_size);
+                                           % subsession_size;
                 }
-                string tmps = str(format("[PI %1%] required unit readings sample size %2% ") % piid % req);
                 if (wl->analytical_result_.unit_readings_required_sample_size_is_from_user[piid]) {
-                    tmps += "(supplied by the calc_required_unit_readings_func)";
+                    info_log << format("[PI %1%] required unit readings sample size %2% ") % piid % req
+                             << "(supplied by the calc_required_unit_readings_func)";
                 } else {
-                    tmps += str(format("(required sample size %1% x subsession size %2%)") % (req / subsession_size) % subsession_size);
+                    info_log << format("[PI %1%] required unit readings sample size %2% ") % piid % req
+                             << format("(required sample size %1% x subsession size %2%)") % (req / subsession_size) % subsession_size;
                 }
-                info_log << tmps;
                 if (static_cast<size_t>(req) < wl->total_num_of_unit_readings_[piid]) {
                     debug_log << "[PI " << piid << "] already has enough samples";
                     continue;
@@ -1597,6 +1895,92 @@ bool calc_next_round_work_amount_from_unit_readings(const pilot_workload_t *wl,
     return need_more_rounds;
 }
 
+/**
+ * \brief A 64-bit mixing function (SplitMix64's finalizer)
+ * \details Used to shuffle the rounds of a WPS design block in a way that
+ * only depends on the block number, so a resumed session picks the same
+ * work amounts.
+ */
+static uint64_t _mix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * \brief Calculate the work amount of the next round for WPS_OPTIMAL_DESIGN
+ * \details See the comment of pilot_wps_schedule_t.
+ * @param[in] wl pointer to the workload struct
+ * @param min_wa the lowest work amount that can be used for WPS analysis
+ * @return the work amount for next round
+ */
+static size_t _wps_optimal_design_next_work_amount(const pilot_workload_t *wl, size_t min_wa) {
+    const size_t kBlockSize = 10;
+    const size_t kInteriorRoundsPerBlock = 2;
+    const size_t kInteriorPoints = 3;
+
+    // the round duration model t = alpha + inv_v * w in seconds
+    double alpha, inv_v;
+    if (wl->analytical_result_.wps_has_data) {
+        alpha = wl->analytical_result_.wps_alpha;
+        inv_v = 1.0 / wl->analytical_result_.wps_v;
+    } else {
+        alpha = 0;
+        inv_v = wl->round_work_amounts_.back() == 0 ? 0 :
+                double(wl->round_durations_.back()) / ONE_SECOND / wl->round_work_amounts_.back();
+    }
+    auto round_duration = [&](double w) { return max(0.0, alpha + inv_v * w); };
+
+    size_t high = wl->max_work_amount_;
+    if (inv_v > 0) {
+        double high_duration = max(double(wl->session_desired_duration_in_sec_) / 5,
+                                   4 * round_duration(min_wa));
+        double w = (high_duration - alpha) / inv_v;
+        if (w < double(high)) {
+            high = max(min_wa + 4 * kInteriorPoints, size_t(w));
+            high = min(high, wl->max_work_amount_);
+        }
+    }
+
+    // the cost of a round also includes the time spent between rounds
+    double overhead = 0 == wl->num_of_round_overheads_ ? 0 :
+                      double(wl->total_round_overhead_) / wl->num_of_round_overheads_ / ONE_SECOND;
+    double cost_low  = round_duration(min_wa) + overhead;
+    double cost_high = round_duration(high) + overhead;
+    double low_share = cost_low + cost_high <= 0 ? 0.5 :
+                       sqrt(cost_high) / (sqrt(cost_low) + sqrt(cost_high));
+
+    // lay out a block: interior rounds first, then the low end, then the high end
+    size_t num_of_low = size_t(round((kBlockSize - kInteriorRoundsPerBlock) * low_share));
+    num_of_low = min(kBlockSize - kInteriorRoundsPerBlock - 1, max(size_t(1), num_of_low));
+    std::vector<size_t> block(kBlockSize);
+    for (size_t i = 0; i < kBlockSize; ++i) {
+        block[i] = i;
+    }
+    // shuffle the block (Fisher-Yates)
+    size_t block_id = wl->rounds_ / kBlockSize;
+    uint64_t h = block_id;
+    for (size_t i = kBlockSize - 1; i > 0; --i) {
+        h = _mix64(h);
+        std::swap(block[i], block[h % (i + 1)]);
+    }
+    size_t slot = block[wl->rounds_ % kBlockSize];
+
+    size_t wa;
+    if (slot < kInteriorRoundsPerBlock) {
+        size_t point = (block_id * kInteriorRoundsPerBlock + slot) % kInteriorPoints + 1;
+        wa = min_wa + (high - min_wa) * point / (kInteriorPoints + 1);
+    } else if (slot < kInteriorRoundsPerBlock + num_of_low) {
+        wa = min_wa;
+    } else {
+        wa = high;
+    }
+    debug_log << format("WPS optimal design: range [%1%, %2%], low end share %3%, next work amount %4%")
+                        % min_wa % high % low_share % wa;
+    return wa;
+}
+
 bool calc_next_round_work_amount_from_wps(const pilot_workload_t *wl, size_t *needed_work_amount) noexcept {
     *needed_work_amount = 0;
     if (0 == wl->max_work_amount_) {
@@ -1630,8 +2014,8 @@ bool calc_next_round_work_amount_from_wps(const pilot_workload_t *wl, size_t *ne
             double slice_size_float = k * work_amount_per_nanosec;
             // 5 is a fail-safe value
             wl->wps_slices_ = max(size_t(5), size_t( (wl->max_work_amount_ - min_wa) / slice_size_float ));
-            info_log << str(format("Calculated initial number of WPS slices %1% with slice size %2%")
-                                   % wl->wps_slices_ % ((wl->max_work_amount_ - min_wa) / wl->wps_slices_));
+            info_log << format("Calculated initial number of WPS slices %1% with slice size %2%")
+                                   % wl->wps_slices_ % ((wl->max_work_amount_ - min_wa) / wl->wps_slices_);
         }
     }
     size_t wa_slice_size = (wl->max_work_amount_ - min_wa) / wl->wps_slices_;
@@ -1658,14 +2042,19 @@ bool calc_next_round_work_amount_from_wps(const pilot_workload_t *wl, size_t *ne
                 }
             } else {
                 if (wl->wps_must_satisfy_) {
-                    info_log << str(format("WPS analysis needs more samples (proposed subsession size %1%, probably needs %2% more samples)")
+                    info_log << format("WPS analysis needs more samples (proposed subsession size %1%, probably needs %2% more samples)")
                                            % wl->analytical_result_.wps_optimal_subsession_size
-                                           % ((kWPSSubsessionSampleSizeThreshold - wl->analytical_result_.wps_subsession_sample_size) * wl->analytical_result_.wps_optimal_subsession_size) );
+                                           % ((kWPSSubsessionSampleSizeThreshold - wl->analytical_result_.wps_subsession_sample_size) * wl->analytical_result_.wps_optimal_subsession_size) ;
                 }
             }
         }
     }
 
+    if (WPS_OPTIMAL_DESIGN == wl->wps_schedule_) {
+        *needed_work_amount = _wps_optimal_design_next_work_amount(wl, min_wa);
+        return wl->wps_must_satisfy_;
+    }
+
     size_t last_round_wa = wl->round_work_amounts_.back();
     if (last_round_wa < min_wa) {
         *needed_work_amount = min_wa + wa_slice_size;
@@ -1701,7 +2090,18 @@ bool calc_next_round_work_amount_for_comparison(const pilot_workload_t *wl, size
                 continue;
             }
             size_t work_amount_for_this_pi = 0;
-            if (0 != wl->max_work_amount_ && abs(wl->calc_avg_work_unit_per_amount(piid)) < 0.00000001) {
+            if (SEQUENTIAL_COMPARISON == wl->comparison_method_) {
+                wl->take_comparison_look(piid);
+                if (COMPARISON_UNDECIDED != wl->comparison_state_[piid].decision) {
+                    debug_log << "[PI " << piid << "] sequential comparison against baseline has finished";
+                    continue;
+                }
+                if (0 == wl->max_work_amount_) {
+                    return true;
+                }
+                // every look needs a new round, which keeps the size of the last round
+                work_amount_for_this_pi = wl->round_work_amounts_.back();
+            } else if (0 != wl->max_work_amount_ && abs(wl->calc_avg_work_unit_per_amount(piid)) < 0.00000001) {
                 error_log << "[PI " << piid << "] average work per unit reading is 0 (you probably need to report a bug)";
                 // when there's not enough information, we double the previous work amount
                 work_amount_for_this_pi = 2 * wl->round_work_amounts_.back();
@@ -1741,9 +2141,9 @@ bool calc_next_round_work_amount_for_comparison(const pilot_workload_t *wl, size
 
 int pilot_set_wps_analysis(pilot_workload_t *wl,
         pilot_pi_display_format_func_t *format_wps_func,
-        bool enabled, bool wps_must_satisfy) noexcept {
+        bool enabled, bool wps_must_satisfy, pilot_wps_schedule_t schedule) noexcept {
     wl->format_wps_.format_func_ = format_wps_func;
-    return wl->set_wps_analysis(enabled, wps_must_satisfy);
+    return wl->set_wps_analysis(enabled, wps_must_satisfy, schedule);
 }
 
 size_t pilot_set_session_desired_duration(pilot_workload_t *wl, size_t sec) noexcept {
@@ -1810,11 +2210,578 @@ int pilot_load_baseline_file(pilot_workload_t *wl, const char *filename) noexcep
     return wl->load_baseline_file(filename);
 }
 
+int pilot_set_comparison_method(pilot_workload_t *wl, pilot_comparison_method_t method,
+                                double equivalence_margin, size_t max_looks) noexcept {
+    ASSERT_VALID_POINTER(wl);
+    if (equivalence_margin <= 0 || 0 == max_looks) {
+        error_log << __func__ << "(): equivalence_margin must be positive and max_looks must not be 0";
+        return ERR_WRONG_PARAM;
+    }
+    wl->comparison_method_ = method;
+    wl->comparison_equivalence_margin_ = equivalence_margin;
+    wl->comparison_max_looks_ = max_looks;
+    return 0;
+}
+
+int pilot_get_comparison_result(const pilot_workload_t *wl, size_t piid,
+                                pilot_comparison_decision_t *decision,
+                                size_t *looks, double *p_value) noexcept {
+    ASSERT_VALID_POINTER(wl);
+    ASSERT_VALID_POINTER(decision);
+    if (piid >= wl->num_of_pi_) {
+        error_log << __func__ << "(): invalid piid " << piid;
+        return ERR_WRONG_PARAM;
+    }
+    const baseline_info_t &b = wl->baseline_of_unit_readings_[piid];
+    if (!b.set) return ERR_NOT_INIT;
+
+    if (SEQUENTIAL_COMPARISON == wl->comparison_method_) {
+        const comparison_state_t &s = wl->comparison_state_[piid];
+        *decision = s.decision;
+        if (looks) *looks = s.looks;
+        if (p_value) *p_value = s.p_value;
+        return 0;
+    }
+
+    *decision = COMPARISON_UNDECIDED;
+    if (looks) *looks = 0;
+    if (p_value) *p_value = 1;
+    wl->refresh_analytical_result(piid, pilot_workload_t::UNIT_READINGS_ANALYSIS);
+    ssize_t q = wl->analytical_result_.unit_readings_optimal_subsession_size[piid];
+    if (q < 0) return 0;
+    size_t n = wl->analytical_result_.unit_readings_num[piid] / q;
+    double mean = wl->analytical_result_.unit_readings_mean[piid];
+    double p = pilot_p_eq(mean, b.mean, n, b.sample_size,
+                          wl->analytical_result_.unit_readings_optimal_subsession_var[piid], b.var,
+                          NULL, NULL);
+    if (p_value) *p_value = p;
+    if (p < wl->desired_p_value_) {
+        *decision = mean < b.mean ? COMPARISON_LOWER : COMPARISON_HIGHER;
+    }
+    return 0;
+}
+
+/**
+ * \brief Check the workloads to be compared by pilot_run_race() or
+ * pilot_run_pareto_search()
+ * @return 0 if the workloads are valid; ERR_NOT_INIT if any workload has no
+ * workload function; ERR_WRONG_PARAM if a workload appears more than once or
+ * any piid is invalid
+ */
+static int _check_workloads_to_compare(pilot_workload_t **wls, size_t num_of_wls,
+                                       const size_t *piids, size_t num_of_piids) {
+    for (size_t i = 0; i < num_of_wls; ++i) {
+        ASSERT_VALID_POINTER(wls[i]);
+        if (nullptr == wls[i]->workload_func_) {
+            return ERR_NOT_INIT;
+        }
+        if (find(wls, wls + i, wls[i]) != wls + i ||
+            any_of(piids, piids + num_of_piids, [&](size_t piid) { return piid >= wls[i]->num_of_pi_; })) {
+            error_log << "The workloads to compare must be different and the PIIDs must be valid";
+            return ERR_WRONG_PARAM;
+        }
+        if (WL_RUNNING == wls[i]->status_) {
+            fatal_log << "Workload is already running";
+            abort();
+        }
+    }
+    return 0;
+}
+
+static bool _stop_requested(pilot_workload_t * const *wls, size_t num_of_wls) {
+    return any_of(wls, wls + num_of_wls, [](const pilot_workload_t *wl) { return WL_STOP_REQUESTED == wl->status_; });
+}
+
+/**
+ * \brief Run a round of one of the workloads being compared
+ * \details The pre- and post-workload-run hooks and the session duration
+ * limit of the workload apply as in pilot_run_workload(), with the session
+ * starting when the comparison starts.
+ * @return 0 on success; ERR_STOPPED_BY_HOOK if a hook returns false;
+ * ERR_STOPPED_BY_DURATION_LIMIT if the session duration limit is reached;
+ * other errors from the round
+ */
+static int _run_compared_round(pilot_workload_t *wl, size_t work_amount,
+                               std::chrono::steady_clock::time_point session_start_time) {
+    if (wl->hook_pre_workload_run_ && !wl->hook_pre_workload_run_(wl)) {
+        info_log << "pre_workload_run hook returns false, exiting";
+        return ERR_STOPPED_BY_HOOK;
+    }
+    int res = _run_workload_round(wl, work_amount, NULL);
+    if (0 != res) return res;
+    if (wl->hook_post_workload_run_ && !wl->hook_post_workload_run_(wl)) {
+        info_log << "post_workload_run hook returns false, exiting";
+        return ERR_STOPPED_BY_HOOK;
+    }
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - session_start_time;
+    wl->analytical_result_.session_duration = diff.count();
+    if (0 != wl->session_duration_limit_in_sec_ && diff.count() > wl->session_duration_limit_in_sec_) {
+        info_log << "reached session duration limit";
+        return ERR_STOPPED_BY_DURATION_LIMIT;
+    }
+    return 0;
+}
+
+static void _sync_journals(pilot_workload_t * const *wls, size_t num_of_wls) {
+    for (size_t i = 0; i < num_of_wls; ++i) {
+        if (wls[i]->journal_ && 0 != wls[i]->journal_->sync()) {
+            warning_log << "Failed to sync the journal, the data of the last rounds may be lost on a crash";
+        }
+    }
+}
+
+/**
+ * \brief Shuffle the workloads of an iteration so that none of them always
+ * runs first
+ */
+static vector<size_t> _shuffled(vector<size_t> ids, unsigned int seed, size_t iter) {
+    uint64_t h = _mix64(seed ^ (uint64_t(iter) << 32));
+    for (size_t k = ids.size(); k > 1; --k) {
+        h = _mix64(h);
+        swap(ids[k - 1], ids[h % k]);
+    }
+    return ids;
+}
+
+/**
+ * \brief Get the metric of the last round of a workload for comparing workloads
+ * @param[in] wl pointer to the workload struct
+ * @param piid the PI
+ * @param num_of_readings_before the number of readings of the PI before the round
+ * @param[out] metric the mean of the unit readings after warm-up removal,
+ * or the reading of the round if it has no unit readings
+ * @return false if the round has no data for the PI
+ */
+static bool _last_round_metric(const pilot_workload_t *wl, size_t piid,
+                             size_t num_of_readings_before, double *metric) {
+    size_t round = wl->rounds_ - 1;
+    const vector<double> &urs = wl->unit_readings_[piid][round];
+    size_t begin = wl->warm_up_phase_len_[piid][round];
+    if (begin < urs.size()) {
+        *metric = pilot_subsession_mean(urs.data() + begin, urs.size() - begin,
+                                        wl->pi_info_[piid].unit_reading_mean_method);
+        return true;
+    }
+    if (wl->readings_[piid].size() > num_of_readings_before) {
+        *metric = wl->readings_[piid].back();
+        return true;
+    }
+    return false;
+}
+
+static size_t _next_common_work_amount(const pilot_workload_t *wl) {
+    size_t work_amount;
+    if (wl->calc_next_round_work_amount(&work_amount))
+        return work_amount;
+    // the workload is satisfied on its own, so keep its last work amount
+    if (!wl->round_work_amounts_.empty())
+        return wl->round_work_amounts_.back();
+    return wl->init_work_amount_;
+}
+
+int pilot_run_ab_comparison(pilot_workload_t *wl_a, pilot_workload_t *wl_b,
+                            size_t piid, pilot_ab_result_t *result,
+                            size_t max_num_of_pairs, unsigned int seed) noexcept {
+    using namespace boost::math;
+    ASSERT_VALID_POINTER(wl_a);
+    ASSERT_VALID_POINTER(wl_b);
+    ASSERT_VALID_POINTER(result);
+    if (nullptr == wl_a->workload_func_ || nullptr == wl_b->workload_func_) {
+        return ERR_NOT_INIT;
+    }
+    if (wl_a == wl_b || piid >= wl_a->num_of_pi_ || piid >= wl_b->num_of_pi_ || 0 == max_num_of_pairs) {
+        error_log << __func__ << "(): wl_a and wl_b must be different, piid must be valid, and max_num_of_pairs must not be 0";
+        return ERR_WRONG_PARAM;
+    }
+    if (WL_RUNNING == wl_a->status_ || WL_RUNNING == wl_b->status_) {
+        fatal_log << "Workload is already running";
+        abort();
+    }
+    shared_ptr<void> wl_status_scope_guard(NULL, [wl_a, wl_b](void*) {
+        wl_a->status_ = WL_NOT_RUNNING;
+        wl_b->status_ = WL_NOT_RUNNING;
+    });
+    wl_a->status_ = WL_RUNNING;
+    wl_b->status_ = WL_RUNNING;
+
+    pilot_workload_t *wls[] = {wl_a, wl_b};
+    memset(result, 0, sizeof(*result));
+    result->p_value = 1;
+    result->decision = COMPARISON_UNDECIDED;
+    const double desired_p = wl_a->desired_p_value_;
+    const auto session_start_time = std::chrono::steady_clock::now();
+    vector<double> diffs;
+    double a_sum = 0;
+    double spent_alpha = 0;
+    int res = 0;
+    for (size_t pair = 0; pair < max_num_of_pairs; ++pair) {
+        if (_stop_requested(wls, 2)) {
+            info_log << "Stop requested, exiting A/B comparison";
+            res = ERR_STOPPED_BY_REQUEST;
+            break;
+        }
+        size_t work_amount = max(_next_common_work_amount(wl_a), _next_common_work_amount(wl_b));
+        // Each block of two pairs is either AB, BA or BA, AB
+        bool b_first = (_mix64(seed ^ (pair / 2)) & 1) != (pair & 1);
+        pilot_workload_t *order[2] = {wl_a, wl_b};
+        if (b_first) swap(order[0], order[1]);
+
+        double metric[2];  // metric[0] is A, metric[1] is B
+        bool has_metric[2] = {false, false};
+        for (pilot_workload_t *wl : order) {
+            const int v = (wl == wl_b);
+            info_log << format("A/B pair %1%: starting round %2% of variant %3% with work_amount %4%")
+                        % pair % wl->rounds_ % (v ? "B" : "A") % work_amount;
+            size_t num_of_readings_before = wl->readings_[piid].size();
+            res = _run_compared_round(wl, work_amount, session_start_time);
+            if (0 != res) break;
+            has_metric[v] = _last_round_metric(wl, piid, num_of_readings_before, &metric[v]);
+        }
+        if (0 != res) break;
+        if (!has_metric[0] || !has_metric[1]) {
+            info_log << format("A/B pair %1% has no data for PI %2%, skipping") % pair % piid;
+            continue;
+        }
+        diffs.push_back(metric[1] - metric[0]);
+        a_sum += metric[0];
+
+        const size_t n = diffs.size();
+        result->pairs = n;
+        result->mean_diff = pilot_subsession_mean(diffs.data(), n, ARITHMETIC_MEAN);
+        if (n < 2) continue;
+        double var = pilot_subsession_var(diffs.data(), n, 1, result->mean_diff, ARITHMETIC_MEAN);
+        double se = sqrt(var / n);
+        students_t dist(n - 1);
+        double t = quantile(complement(dist, desired_p / 2));
+        result->ci_left = result->mean_diff - t * se;
+        result->ci_right = result->mean_diff + t * se;
+
+        // the same group-sequential design as take_comparison_look()
+        double spent = pilot_obf_alpha_spending(double(pair + 1) / max_num_of_pairs, desired_p);
+        double alpha = spent - spent_alpha;
+        spent_alpha = spent;
+        // differences that vary only by rounding errors count as the same
+        if (se <= 1e-9 * (abs(a_sum / n) + abs(result->mean_diff))) {
+            // All differences are the same so far, which tells nothing
+            // about their variance. Decide only when the sample reaches the
+            // minimum sample size of A or at the last look.
+            if (n >= wl_a->min_sample_size_ || pair + 1 == max_num_of_pairs) {
+                result->p_value = 0 == result->mean_diff ? 1 : 0;
+                result->decision = result->mean_diff < 0 ? COMPARISON_LOWER :
+                                   result->mean_diff > 0 ? COMPARISON_HIGHER : COMPARISON_EQUIVALENT;
+            }
+        } else {
+            result->p_value = 2 * cdf(complement(dist, abs(result->mean_diff) / se));
+            if (result->p_value < alpha) {
+                result->decision = result->mean_diff < 0 ? COMPARISON_LOWER : COMPARISON_HIGHER;
+            } else {
+                double margin = wl_a->comparison_equivalence_margin_ * abs(a_sum / n);
+                double p_tost = max(cdf(complement(dist, (result->mean_diff + margin) / se)),
+                                    cdf(complement(dist, (margin - result->mean_diff) / se)));
+                if (p_tost < alpha) {
+                    result->decision = COMPARISON_EQUIVALENT;
+                }
+            }
+        }
+        info_log << format("[PI %1%] A/B look at pair %2%/%3%: mean difference (B - A) %4%, p-value %5% (alpha %6%), decision %7%")
+                    % piid % pair % max_num_of_pairs % result->mean_diff % result->p_value % alpha % result->decision;
+        if (COMPARISON_UNDECIDED != result->decision) break;
+    }
+    if (0 == res && COMPARISON_UNDECIDED == result->decision) {
+        result->decision = COMPARISON_INCONCLUSIVE;
+    }
+
+    _sync_journals(wls, 2);
+    return res;
+}
+
+/**
+ * \brief Calculate the confidence interval of the mean of round metrics
+ * \details The CI at the look-th look is calculated at the error rate
+ * p / (look * (look + 1)), so the CIs of all looks hold at the same time
+ * with an error rate of no more than p, because the sum of
+ * 1 / (look * (look + 1)) is 1. Only the looks that are actually taken are
+ * counted, so rounds without metrics don't weaken the correction.
+ * @param metrics the metrics, at least two
+ * @param p the error rate
+ * @param look the number of the look, starting from 1
+ * @param[out] mean the mean of the metrics
+ * @param[out] lower the lower end of the CI
+ * @param[out] upper the upper end of the CI
+ */
+static void _round_metrics_ci(const vector<double> &metrics, double p, size_t look,
+                              double *mean, double *lower, double *upper) {
+    using namespace boost::math;
+    const size_t n = metrics.size();
+    *mean = pilot_subsession_mean(metrics.data(), n, ARITHMETIC_MEAN);
+    double se = sqrt(pilot_subsession_var(metrics.data(), n, 1, *mean, ARITHMETIC_MEAN) / n);
+    students_t dist(n - 1);
+    double t = quantile(complement(dist, p / (2.0 * look * (look + 1))));
+    *lower = *mean - t * se;
+    *upper = *mean + t * se;
+}
+
+int pilot_run_race(pilot_workload_t **wls, size_t num_of_wls, size_t piid,
+                   pilot_race_result_t *result, bool lower_is_better,
+                   size_t max_rounds_per_workload, unsigned int seed) noexcept {
+    using namespace boost::math;
+    ASSERT_VALID_POINTER(wls);
+    ASSERT_VALID_POINTER(result);
+    if (num_of_wls < 2 || max_rounds_per_workload < 2) {
+        error_log << __func__ << "(): there must be at least two workloads and max_rounds_per_workload must be at least 2";
+        return ERR_WRONG_PARAM;
+    }
+    int res = _check_workloads_to_compare(wls, num_of_wls, &piid, 1);
+    if (0 != res) return res;
+    shared_ptr<void> wl_status_scope_guard(NULL, [wls, num_of_wls](void*) {
+        for (size_t i = 0; i < num_of_wls; ++i)
+            wls[i]->status_ = WL_NOT_RUNNING;
+    });
+    for (size_t i = 0; i < num_of_wls; ++i)
+        wls[i]->status_ = WL_RUNNING;
+
+    memset(result, 0, sizeof(*result));
+    const double desired_p = wls[0]->desired_p_value_;
+    const auto session_start_time = std::chrono::steady_clock::now();
+    // metrics are stored with this sign so that lower is always better
+    const double sign = lower_is_better ? 1 : -1;
+    vector<vector<double> > metrics(num_of_wls);
+    vector<double> means(num_of_wls, numeric_limits<double>::infinity());
+    size_t looks = 0;
+    vector<size_t> active(num_of_wls);
+    iota(active.begin(), active.end(), 0);
+    for (size_t iter = 0; active.size() > 1 && iter < max_rounds_per_workload; ++iter) {
+        size_t work_amount = 0;
+        for (size_t i : active)
+            work_amount = max(work_amount, _next_common_work_amount(wls[i]));
+        for (size_t i : _shuffled(active, seed, iter)) {
+            if (_stop_requested(wls, num_of_wls)) {
+                info_log << "Stop requested, exiting race";
+                res = ERR_STOPPED_BY_REQUEST;
+                break;
+            }
+            pilot_workload_t *wl = wls[i];
+            info_log << format("Race iteration %1%: starting round %2% of workload %3% with work_amount %4%")
+                        % iter % wl->rounds_ % i % work_amount;
+            size_t num_of_readings_before = wl->readings_[piid].size();
+            res = _run_compared_round(wl, work_amount, session_start_time);
+            if (0 != res) break;
+            ++result->rounds;
+            double metric;
+            if (_last_round_metric(wl, piid, num_of_readings_before, &metric)) {
+                metrics[i].push_back(sign * metric);
+            } else {
+                info_log << format("Round %1% of workload %2% has no data for PI %3%, skipping") % (wl->rounds_ - 1) % i % piid;
+            }
+        }
+        if (0 != res) break;
+
+        if (any_of(active.begin(), active.end(), [&metrics](size_t i) { return metrics[i].size() < 2; }))
+            continue;
+        ++looks;
+        vector<double> lower(num_of_wls), upper(num_of_wls);
+        for (size_t i : active) {
+            _round_metrics_ci(metrics[i], desired_p / num_of_wls, looks,
+                              &means[i], &lower[i], &upper[i]);
+        }
+        size_t best = *min_element(active.begin(), active.end(),
+                                   [&means](size_t a, size_t b) { return means[a] < means[b]; });
+        vector<size_t> remaining;
+        for (size_t i : active) {
+            if (lower[i] > upper[best]) {
+                info_log << format("Race iteration %1%: eliminated workload %2% (mean %3%) because it is worse than workload %4% (mean %5%)")
+                            % iter % i % (sign * means[i]) % best % (sign * means[best]);
+            } else {
+                remaining.push_back(i);
+            }
+        }
+        active.swap(remaining);
+    }
+
+    // the means of the last rounds, which may not have had a look
+    for (size_t i : active) {
+        if (!metrics[i].empty())
+            means[i] = pilot_subsession_mean(metrics[i].data(), metrics[i].size(), ARITHMETIC_MEAN);
+    }
+    result->winner = *min_element(active.begin(), active.end(),
+                                  [&means](size_t a, size_t b) { return means[a] < means[b]; });
+    result->identified = (1 == active.size());
+    // no workload in the race has any metric
+    result->winner_mean = std::isfinite(means[result->winner]) ?
+                          sign * means[result->winner] : numeric_limits<double>::quiet_NaN();
+    info_log << format("Race finished after %1% rounds: the best is workload %2% (mean %3%)%4%")
+                % result->rounds % result->winner % result->winner_mean
+                % (result->identified ? "" : ", but it could not be separated from all others");
+    _sync_journals(wls, num_of_wls);
+    return res;
+}
+
+int pilot_run_pareto_search(pilot_workload_t **wls, size_t num_of_wls,
+                            const size_t *piids, const bool *lower_is_better,
+                            size_t num_of_objectives, bool *on_frontier, double *means,
+                            size_t max_rounds_per_workload, unsigned int seed) noexcept {
+    ASSERT_VALID_POINTER(wls);
+    ASSERT_VALID_POINTER(piids);
+    ASSERT_VALID_POINTER(lower_is_better);
+    ASSERT_VALID_POINTER(on_frontier);
+    if (0 == num_of_wls || 0 == num_of_objectives || max_rounds_per_workload < 2) {
+        error_log << __func__ << "(): there must be at least one workload and one objective, and max_rounds_per_workload must be at least 2";
+        return ERR_WRONG_PARAM;
+    }
+    int res = _check_workloads_to_compare(wls, num_of_wls, piids, num_of_objectives);
+    if (0 != res) return res;
+    shared_ptr<void> wl_status_scope_guard(NULL, [wls, num_of_wls](void*) {
+        for (size_t i = 0; i < num_of_wls; ++i)
+            wls[i]->status_ = WL_NOT_RUNNING;
+    });
+    for (size_t i = 0; i < num_of_wls; ++i)
+        wls[i]->status_ = WL_RUNNING;
+
+    const double desired_p = wls[0]->desired_p_value_;
+    const auto session_start_time = std::chrono::steady_clock::now();
+    const size_t K = num_of_objectives;
+    // metrics[i][k] are the round metrics of workload i and objective k,
+    // stored with the sign that makes lower always better
+    vector<vector<vector<double> > > metrics(num_of_wls, vector<vector<double> >(K));
+    // the means and CIs of workload i and objective k are at [i * K + k]
+    vector<double> m(num_of_wls * K, numeric_limits<double>::quiet_NaN());
+    vector<double> lower(num_of_wls * K), upper(num_of_wls * K);
+    size_t looks = 0;
+    vector<size_t> rounds_run(num_of_wls, 0);
+    vector<bool> needs_more_rounds(num_of_wls, true);
+    vector<size_t> active(num_of_wls);
+    iota(active.begin(), active.end(), 0);
+    auto sign = [lower_is_better](size_t k) { return lower_is_better[k] ? 1.0 : -1.0; };
+    // whether a in v is no worse than b in w in every objective and better
+    // in at least one (strict: better in every objective)
+    auto dominates = [K](const vector<double> &v, size_t a, const vector<double> &w, size_t b, bool strict) {
+        bool better_in_one = false;
+        for (size_t k = 0; k < K; ++k) {
+            if (v[a * K + k] > w[b * K + k] || (strict && v[a * K + k] == w[b * K + k]))
+                return false;
+            better_in_one |= v[a * K + k] < w[b * K + k];
+        }
+        return better_in_one;
+    };
+
+    for (size_t iter = 0; ; ++iter) {
+        bool ran = false;
+        for (size_t i : _shuffled(active, seed, iter)) {
+            if (!needs_more_rounds[i]) continue;
+            pilot_workload_t *wl = wls[i];
+            size_t work_amount;
+            bool satisfied = !wl->calc_next_round_work_amount(&work_amount);
+            if (rounds_run[i] >= max_rounds_per_workload || (satisfied && metrics[i][0].size() >= 2)) {
+                needs_more_rounds[i] = false;
+                continue;
+            }
+            if (satisfied) work_amount = _next_common_work_amount(wl);
+            if (_stop_requested(wls, num_of_wls)) {
+                info_log << "Stop requested, exiting Pareto search";
+                res = ERR_STOPPED_BY_REQUEST;
+                break;
+            }
+            info_log << format("Pareto search iteration %1%: starting round %2% of workload %3% with work_amount %4%")
+                        % iter % wl->rounds_ % i % work_amount;
+            vector<size_t> num_of_readings_before(K);
+            for (size_t k = 0; k < K; ++k)
+                num_of_readings_before[k] = wl->readings_[piids[k]].size();
+            res = _run_compared_round(wl, work_amount, session_start_time);
+            if (0 != res) break;
+            ++rounds_run[i];
+            ran = true;
+            vector<double> round_metrics(K);
+            bool has_data = true;
+            for (size_t k = 0; k < K; ++k)
+                has_data &= _last_round_metric(wl, piids[k], num_of_readings_before[k], &round_metrics[k]);
+            if (!has_data) {
+                info_log << format("Round %1% of workload %2% doesn't have data for every objective, skipping") % (wl->rounds_ - 1) % i;
+                continue;
+            }
+            for (size_t k = 0; k < K; ++k)
+                metrics[i][k].push_back(sign(k) * round_metrics[k]);
+        }
+        if (0 != res || !ran) break;
+
+        // every objective of a workload has the same number of metrics
+        if (any_of(active.begin(), active.end(), [&metrics](size_t i) { return metrics[i][0].size() < 2; }))
+            continue;
+        ++looks;
+        for (size_t i : active) {
+            for (size_t k = 0; k < K; ++k) {
+                _round_metrics_ci(metrics[i][k], desired_p / (num_of_wls * K), looks,
+                                  &m[i * K + k], &lower[i * K + k], &upper[i * K + k]);
+            }
+        }
+        vector<size_t> remaining;
+        for (size_t i : active) {
+            auto by = find_if(active.begin(), active.end(), [&](size_t j) {
+                return j != i && dominates(upper, j, lower, i, true);
+            });
+            if (active.end() != by) {
+                info_log << format("Pareto search iteration %1%: eliminated workload %2% because it is dominated by workload %3%")
+                            % iter % i % *by;
+            } else {
+                remaining.push_back(i);
+            }
+        }
+        active.swap(remaining);
+    }
+
+    for (size_t i = 0; i < num_of_wls; ++i) {
+        for (size_t k = 0; k < K; ++k) {
+            if (!metrics[i][k].empty())
+                m[i * K + k] = pilot_subsession_mean(metrics[i][k].data(), metrics[i][k].size(), ARITHMETIC_MEAN);
+            if (means)
+                means[i * K + k] = sign(k) * m[i * K + k];
+        }
+        on_frontier[i] = false;
+    }
+    // the means are NaN only for workloads whose rounds have no data
+    auto has_means = [&m, K](size_t i) { return !std::isnan(m[i * K]); };
+    for (size_t i : active) {
+        on_frontier[i] = has_means(i) && none_of(active.begin(), active.end(), [&](size_t j) {
+            return j != i && has_means(j) && dominates(m, j, m, i, false);
+        });
+        if (on_frontier[i]) {
+            info_log << format("Workload %1% is on the Pareto frontier") % i;
+        }
+    }
+    _sync_journals(wls, num_of_wls);
+    return res;
+}
+
 size_t pilot_set_min_sample_size(pilot_workload_t *wl, size_t min_sample_size) noexcept {
     ASSERT_VALID_POINTER(wl);
     return wl->set_min_sample_size(min_sample_size);
 }
 
+bool g_simple_runner_perf_counters = false;
+
+int pilot_simple_runner_set_perf_counters(bool enabled) noexcept {
+#ifdef __linux__
+    g_simple_runner_perf_counters = enabled;
+    return 0;
+#else
+    return enabled ? ERR_NOT_IMPL : 0;
+#endif
+}
+
+/**
+ * \brief Read the counters for _simple_workload_func_runner()
+ * \details A failure is only logged once for each session.
+ * @return true on success
+ */
+static bool _simple_runner_read_counters(_simple_runner_data_t *rd, vector<double> *values) {
+    if (rd->counters->read(values) && values->size() >= rd->counters->size())
+        return true;
+    if (!rd->read_failed) {
+        warning_log << "Failed to read the performance counters, so the counter PIs get no data from the rounds in which that happens";
+        rd->read_failed = true;
+    }
+    return false;
+}
+
 int _simple_workload_func_runner(const pilot_workload_t *wl,
                        size_t round,
                        size_t total_work_amount,
@@ -1825,23 +2792,68 @@ int _simple_workload_func_runner(const pilot_workload_t *wl,
                        nanosecond_type *round_duration,
                        void *data) {
     ASSERT_VALID_POINTER(data);
-    pilot_simple_workload_func_t *func = (pilot_simple_workload_func_t*)data;
-    const size_t num_of_pi = 1;
+    _simple_runner_data_t *rd = (_simple_runner_data_t*)data;
+    pilot_simple_workload_func_t *func = rd->func;
+    const pilot_perf_counters_t *counters = rd->counters;
+    const size_t num_of_pi = wl->num_of_pi_;
     *num_of_work_unit = total_work_amount;
     *unit_readings = (double**)lib_malloc_func(sizeof(double*) * num_of_pi);
-    (*unit_readings)[0] = (double*)lib_malloc_func(sizeof(double) * *num_of_work_unit);
+    for (size_t piid = 0; piid < num_of_pi; ++piid)
+        (*unit_readings)[piid] = (double*)lib_malloc_func(sizeof(double) * *num_of_work_unit);
 
-    int rc;
+    int rc = 0;
     cpu_timer timer;
     nanosecond_type start_time, end_time;
-    for (size_t i = 0; i != total_work_amount; ++i) {
+    // the sum of the call durations, which leaves out reading the counters
+    nanosecond_type measured_time = 0;
+    vector<double> round_begin_counters, begin_counters, end_counters;
+    // once a read fails, the counters are not read again in this round
+    bool counters_ok = counters && _simple_runner_read_counters(rd, &round_begin_counters);
+    size_t i;
+    for (i = 0; i != total_work_amount; ++i) {
+        counters_ok = counters_ok && _simple_runner_read_counters(rd, &begin_counters);
+        // the timer is read inside the counter reads so that the call
+        // duration doesn't include them
         start_time = timer.elapsed().wall;
         rc = func();
         end_time = timer.elapsed().wall;
+        measured_time += end_time - start_time;
+        counters_ok = counters_ok && _simple_runner_read_counters(rd, &end_counters);
+        if (counters_ok) {
+            for (size_t c = 0; c < counters->size(); ++c)
+                (*unit_readings)[1 + c][i] = end_counters[c] - begin_counters[c];
+            if (rd->ipc_piid > 0) {
+                double cycles = (*unit_readings)[1 + counters->index_of("cycles")][i];
+                (*unit_readings)[rd->ipc_piid][i] = cycles > 0 ?
+                    (*unit_readings)[1 + counters->index_of("instructions")][i] / cycles : 0;
+            }
+        }
         (*unit_readings)[0][i] = double((end_time - start_time)) / ONE_SECOND;
         if (rc)
             return rc;
     }
+    if (counters && !counters_ok) {
+        // A round in which reading the counters failed only has the unit
+        // readings of the duration and no readings
+        for (size_t piid = 1; piid < num_of_pi; ++piid) {
+            free((*unit_readings)[piid]);
+            (*unit_readings)[piid] = NULL;
+        }
+        return 0;
+    }
+
+    // per-call averages of the whole round
+    if (counters && total_work_amount > 0 && _simple_runner_read_counters(rd, &end_counters)) {
+        *readings = (double*)lib_malloc_func(sizeof(double) * num_of_pi);
+        (*readings)[0] = double(measured_time) / ONE_SECOND / total_work_amount;
+        for (size_t c = 0; c < counters->size(); ++c)
+            (*readings)[1 + c] = (end_counters[c] - round_begin_counters[c]) / total_work_amount;
+        if (rd->ipc_piid > 0) {
+            double cycles = (*readings)[1 + counters->index_of("cycles")];
+            (*readings)[rd->ipc_piid] = cycles > 0 ?
+                (*readings)[1 + counters->index_of("instructions")] / cycles : 0;
+        }
+    }
     return 0;
 }
 
@@ -1866,12 +2878,28 @@ int _simple_runner(pilot_simple_workload_func_t func,
 
     pilot_set_log_level(lv_info);
     shared_ptr<pilot_workload_t> wl(pilot_new_workload(benchmark_name), pilot_destroy_workload);
-    pilot_set_num_of_pi(wl.get(), 1);
+
+    pilot_perf_counters_t counters;
+    _simple_runner_data_t rd = {func, NULL, -1, false};
+    if (g_simple_runner_perf_counters && counters.open() > 0) {
+        rd.counters = &counters;
+        if (counters.index_of("instructions") >= 0 && counters.index_of("cycles") >= 0)
+            rd.ipc_piid = 1 + counters.size();
+    }
+    pilot_set_num_of_pi(wl.get(), 1 + counters.size() + (rd.ipc_piid > 0 ? 1 : 0));
     pilot_set_pi_info(wl.get(), 0, "Duration", "second", NULL, NULL, false, true, ARITHMETIC_MEAN, ARITHMETIC_MEAN, SAMPLE_MEAN);
+    for (size_t c = 0; c < counters.size(); ++c) {
+        pilot_set_pi_info(wl.get(), 1 + c, counters.name(c).c_str(), counters.unit(c).c_str(),
+                          NULL, NULL, false, false, ARITHMETIC_MEAN, ARITHMETIC_MEAN, SAMPLE_MEAN);
+    }
+    if (rd.ipc_piid > 0) {
+        pilot_set_pi_info(wl.get(), rd.ipc_piid, "IPC", "instructions/cycle", NULL, NULL,
+                          false, false, ARITHMETIC_MEAN, ARITHMETIC_MEAN, SAMPLE_MEAN);
+    }
     pilot_set_wps_analysis(wl.get(), NULL, false, false);
     pilot_set_init_work_amount(wl.get(), 0);
     pilot_set_work_amount_limit(wl.get(), ULONG_MAX);
-    pilot_set_workload_data(wl.get(), (void*)func);
+    pilot_set_workload_data(wl.get(), &rd);
     pilot_set_workload_func(wl.get(), _simple_workload_func_runner);
     pilot_set_short_round_detection_threshold(wl.get(), 1);
 
@@ -0,0 +1,313 @@
+/*
+ * log_ring.cc: a fixed-capacity lock-free ring buffer for the in-memory log
+ *
+ * Copyright (c) 2017-2019 Yan Li <yanli@tuneup.ai>. All rights reserved.
+ * The Pilot tool and library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 (not any other version) as published by the Free
+ * Software Foundation.
+ *
+ * The Pilot tool and library is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program in file lgpl-2.1.txt; if not, see
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ *
+ * Commit 033228934e11b3f86fb0a4932b54b2aeea5c803c and before were
+ * released with the following license:
+ * Copyright (c) 2015, 2016, University of California, Santa Cruz, CA, USA.
+ * Created by Yan Li <yanli@tuneup.ai>,
+ * Department of Computer Science, Baskin School of Engineering.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Storage Systems Research Center, the
+ *       University of California, nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OF THE UNIVERSITY OF CALIFORNIA BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include "config.h"
+#include <cstdio>
+#include <cstring>
+#include "log_ring.hpp"
+#include <thread>
+#include <vector>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std;
+
+namespace pilot {
+
+/**
+ * Writes evicted records to a file. With zlib the records are compressed
+ * in blocks of kBlockSize bytes.
+ */
+class pilot_log_spill_t {
+public:
+    static const size_t kBlockSize = 64 * 1024;
+
+    pilot_log_spill_t() : f_(NULL) {}
+    ~pilot_log_spill_t() { close(); }
+
+    bool open(const string &path) {
+        close();
+#ifdef HAVE_ZLIB
+        f_ = gzopen(path.c_str(), "ab");
+#else
+        f_ = fopen(path.c_str(), "a");
+#endif
+        return NULL != f_;
+    }
+
+    void write(const char *s, size_t len) {
+        buf_.append(s, len);
+        if (buf_.size() >= kBlockSize) flush();
+    }
+
+    void flush() {
+        if (!f_ || buf_.empty()) return;
+#ifdef HAVE_ZLIB
+        gzwrite(f_, buf_.data(), unsigned(buf_.size()));
+        gzflush(f_, Z_SYNC_FLUSH);
+#else
+        fwrite(buf_.data(), 1, buf_.size(), f_);
+        fflush(f_);
+#endif
+        buf_.clear();
+    }
+
+    void close() {
+        if (!f_) return;
+        flush();
+#ifdef HAVE_ZLIB
+        gzclose(f_);
+#else
+        fclose(f_);
+#endif
+        f_ = NULL;
+    }
+
+private:
+#ifdef HAVE_ZLIB
+    gzFile f_;
+#else
+    FILE  *f_;
+#endif
+    string buf_;
+};
+
+pilot_log_ring_t::pilot_log_ring_t(size_t capacity)
+    : slots_(NULL), num_of_slots_(0), head_(0), drained_(0), evicted_records_(0) {
+    reset(capacity);
+}
+
+pilot_log_ring_t::~pilot_log_ring_t() {
+    delete[] slots_.load(memory_order_relaxed);
+}
+
+void pilot_log_ring_t::reset(size_t capacity) {
+    delete[] slots_.exchange(NULL, memory_order_relaxed);
+    num_of_slots_ = max(capacity / kSlotSize, size_t(2));
+    drained_.store(num_of_slots_, memory_order_relaxed);
+    evicted_records_.store(0, memory_order_relaxed);
+    head_.store(num_of_slots_, memory_order_release);
+}
+
+pilot_log_ring_t::slot_t* pilot_log_ring_t::get_slots() {
+    slot_t *slots = slots_.load(memory_order_acquire);
+    if (slots) return slots;
+    lock_guard<mutex> lock(alloc_mutex_);
+    slots = slots_.load(memory_order_relaxed);
+    if (slots) return slots;
+    slots = new slot_t[num_of_slots_];
+    for (size_t i = 0; i < num_of_slots_; ++i) {
+        slots[i].seq.store(2 * i + 2, memory_order_relaxed);
+        slots[i].meta.store(uint64_t(kEmpty) << 16, memory_order_relaxed);
+    }
+    slots_.store(slots, memory_order_release);
+    return slots;
+}
+
+bool pilot_log_ring_t::set_spill_file(const string &path) {
+    lock_guard<mutex> lock(spill_mutex_);
+    spill_.reset();
+    spill_path_.clear();
+    if (path.empty()) return true;
+    unique_ptr<pilot_log_spill_t> spill(new pilot_log_spill_t);
+    if (!spill->open(path)) return false;
+    spill_ = move(spill);
+    spill_path_ = path;
+    return true;
+}
+
+void pilot_log_ring_t::evict(uint64_t ticket, const slot_t &slot) {
+    uint64_t meta = slot.meta.load(memory_order_relaxed);
+    uint8_t flags = uint8_t(meta >> 16);
+    if (flags & kEmpty) return;
+    if (flags & kRecordBegin)
+        evicted_records_.fetch_add(1, memory_order_relaxed);
+    if (!spill_ || ticket < drained_.load(memory_order_acquire)) return;
+
+    uint64_t words[kSlotPayload / sizeof(uint64_t)];
+    size_t len = meta & 0xffff;
+    for (size_t w = 0; w * sizeof(uint64_t) < len; ++w)
+        words[w] = slot.words[w].load(memory_order_relaxed);
+    lock_guard<mutex> lock(spill_mutex_);
+    if (spill_) spill_->write((const char*)words, len);
+}
+
+void pilot_log_ring_t::append(const char *s, size_t len) {
+    if (0 == len) return;
+    const size_t n = num_of_slots_;
+    size_t num_of_needed_slots = (len + kSlotPayload - 1) / kSlotPayload;
+    if (num_of_needed_slots > n) {
+        // keep the tail of a record that doesn't fit in the whole ring
+        s += len - n * kSlotPayload;
+        len = n * kSlotPayload;
+        num_of_needed_slots = n;
+    }
+
+    slot_t *slots = get_slots();
+    const uint64_t first_ticket = head_.fetch_add(num_of_needed_slots, memory_order_acq_rel);
+    uint64_t words[kSlotPayload / sizeof(uint64_t)];
+    for (size_t k = 0; k < num_of_needed_slots; ++k) {
+        const uint64_t ticket = first_ticket + k;
+        slot_t &slot = slots[ticket % n];
+        // wait for the writer of the previous lap to finish
+        const uint64_t prev_published = 2 * (ticket - n) + 2;
+        while (slot.seq.load(memory_order_acquire) != prev_published)
+            this_thread::yield();
+        evict(ticket - n, slot);
+
+        slot.seq.store(2 * ticket + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        const size_t chunk_len = min(len - k * kSlotPayload, kSlotPayload);
+        memcpy(words, s + k * kSlotPayload, chunk_len);
+        for (size_t w = 0; w * sizeof(uint64_t) < chunk_len; ++w)
+            slot.words[w].store(words[w], memory_order_relaxed);
+        const uint8_t flags = (0 == k) ? kRecordBegin : 0;
+        slot.meta.store(uint64_t(flags) << 16 | chunk_len, memory_order_relaxed);
+        slot.seq.store(2 * ticket + 2, memory_order_release);
+    }
+}
+
+bool pilot_log_ring_t::read_slot(uint64_t ticket, size_t *len, uint8_t *flags, char *data) const {
+    const slot_t *slots = slots_.load(memory_order_acquire);
+    if (!slots) return false;
+    const slot_t &slot = slots[ticket % num_of_slots_];
+    const uint64_t seq = slot.seq.load(memory_order_acquire);
+    if (seq != 2 * ticket + 2) return false;
+    uint64_t meta = slot.meta.load(memory_order_relaxed);
+    *len = meta & 0xffff;
+    *flags = uint8_t(meta >> 16);
+    uint64_t words[kSlotPayload / sizeof(uint64_t)];
+    for (size_t w = 0; w * sizeof(uint64_t) < *len; ++w)
+        words[w] = slot.words[w].load(memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    if (slot.seq.load(memory_order_relaxed) != seq) return false;
+    memcpy(data, words, *len);
+    return true;
+}
+
+string pilot_log_ring_t::last_lines(size_t n) const {
+    if (0 == n || !slots_.load(memory_order_acquire)) return string();
+    const uint64_t head = head_.load(memory_order_acquire);
+    const uint64_t lower = max(drained_.load(memory_order_acquire), head - num_of_slots_);
+
+    // records in reverse order
+    vector<string> records;
+    string record;
+    size_t newlines = 0;
+    char data[kSlotPayload];
+    size_t len;
+    uint8_t flags;
+    for (uint64_t t = head; t-- > lower; ) {
+        if (!read_slot(t, &len, &flags, data)) {
+            // skip records that are still being written at the top
+            if (records.empty()) {
+                record.clear();
+                continue;
+            }
+            break;
+        }
+        if (flags & kEmpty) break;
+        record.insert(0, data, len);
+        if (flags & kRecordBegin) {
+            newlines += count(record.begin(), record.end(), '\n');
+            records.push_back(move(record));
+            record.clear();
+            // we need one extra new line to find the beginning of the
+            // first line unless the log doesn't end with a new line
+            if (newlines > n) break;
+        }
+    }
+    if (records.empty()) return string();
+
+    string s;
+    for (auto it = records.rbegin(); it != records.rend(); ++it)
+        s += *it;
+    // trim to the last n lines
+    size_t loc = ('\n' == s.back()) ? s.size() - 1 : s.size();
+    for (; n != 0; --n) {
+        if (0 == loc) return s;
+        loc = s.rfind('\n', loc - 1);
+        if (string::npos == loc) return s;
+    }
+    return s.substr(loc + 1);
+}
+
+uint64_t pilot_log_ring_t::write_records(ostream &o) const {
+    const slot_t *slots = slots_.load(memory_order_acquire);
+    if (!slots) return drained_.load(memory_order_acquire);
+    const uint64_t head = head_.load(memory_order_acquire);
+    uint64_t t = max(drained_.load(memory_order_acquire), head - num_of_slots_);
+    char data[kSlotPayload];
+    size_t len;
+    uint8_t flags;
+    for (; t < head; ++t) {
+        if (!read_slot(t, &len, &flags, data)) {
+            const uint64_t seq = slots[t % num_of_slots_].seq.load(memory_order_acquire);
+            // stop at the first slot that is still being written
+            if (seq < 2 * t + 2) break;
+            // otherwise the slot has been overwritten by a newer lap
+            continue;
+        }
+        if (flags & kEmpty) continue;
+        o.write(data, len);
+    }
+    return t;
+}
+
+void pilot_log_ring_t::drain(ostream &o) {
+    if (!slots_.load(memory_order_acquire)) return;
+    drained_.store(write_records(o), memory_order_release);
+    lock_guard<mutex> lock(spill_mutex_);
+    if (spill_) spill_->flush();
+}
+
+} // namespace pilot
@@ -0,0 +1,183 @@
+/*
+ * perf_counters.cc: collecting performance counters using perf_event_open
+ *
+ * Copyright (c) 2017-2019 Yan Li <yanli@tuneup.ai>. All rights reserved.
+ * The Pilot tool and library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 (not any other version) as published by the Free
+ * Software Foundation.
+ *
+ * The Pilot tool and library is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program in file lgpl-2.1.txt; if not, see
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ *
+ * Commit 033228934e11b3f86fb0a4932b54b2aeea5c803c and before were
+ * released with the following license:
+ * Copyright (c) 2015, 2016, University of California, Santa Cruz, CA, USA.
+ * Created by Yan Li <yanli@tuneup.ai>,
+ * Department of Computer Science, Baskin School of Engineering.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Storage Systems Research Center, the
+ *       University of California, nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OF THE UNIVERSITY OF CALIFORNIA BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "common.h"
+#include <cstring>
+#include <errno.h>
+#include "perf_counters.hpp"
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace pilot {
+
+#ifdef __linux__
+static int perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu,
+                           int group_fd, unsigned long flags) {
+    return (int)syscall(__NR_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+#endif
+
+pilot_perf_counters_t::pilot_perf_counters_t() : group_fd_(-1), hardware_(false) {}
+
+pilot_perf_counters_t::~pilot_perf_counters_t() {
+    close();
+}
+
+bool pilot_perf_counters_t::open_event(uint32_t type, uint64_t config,
+                                       const char *name, const char *unit) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.disabled = (-1 == group_fd_) ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 0;
+    int fd = perf_event_open(&attr, 0, -1, group_fd_, 0);
+    if (fd < 0) {
+        debug_log << "perf_event_open() failed for counter " << name << ": "
+                  << strerror(errno);
+        return false;
+    }
+    if (-1 == group_fd_) group_fd_ = fd;
+    fds_.push_back(fd);
+    names_.push_back(name);
+    units_.push_back(unit);
+    return true;
+#else
+    return false;
+#endif
+}
+
+size_t pilot_perf_counters_t::open() {
+    close();
+#ifdef __linux__
+    // The group leader decides whether we can use the PMU at all
+    if (open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions", "count")) {
+        hardware_ = true;
+        open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles", "count");
+        open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache-misses", "count");
+        open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch-misses", "count");
+    } else {
+        info_log << "Hardware performance counters are not available, "
+                    "falling back to software counters";
+        if (open_event(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, "task-clock", "ns")) {
+            open_event(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context-switches", "count");
+            open_event(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, "page-faults", "count");
+        }
+    }
+    if (-1 == group_fd_) {
+        warning_log << "No performance counter is available";
+        return 0;
+    }
+    read_buf_.resize(3 + fds_.size());
+    ioctl(group_fd_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    if (0 != ioctl(group_fd_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP)) {
+        warning_log << "Failed to enable performance counters: " << strerror(errno);
+        close();
+        return 0;
+    }
+#else
+    warning_log << "Performance counters are only supported on Linux";
+#endif
+    return fds_.size();
+}
+
+void pilot_perf_counters_t::close() {
+#ifdef __linux__
+    // close the group leader last
+    for (auto it = fds_.rbegin(); it != fds_.rend(); ++it)
+        ::close(*it);
+#endif
+    fds_.clear();
+    names_.clear();
+    units_.clear();
+    group_fd_ = -1;
+    hardware_ = false;
+}
+
+int pilot_perf_counters_t::index_of(const string &name) const {
+    for (size_t i = 0; i < names_.size(); ++i)
+        if (name == names_[i]) return int(i);
+    return -1;
+}
+
+bool pilot_perf_counters_t::read(vector<double> *values) const {
+#ifdef __linux__
+    if (-1 == group_fd_) return false;
+    // layout: nr, time_enabled, time_running, values[nr]
+    ssize_t len = sizeof(uint64_t) * read_buf_.size();
+    if (len != ::read(group_fd_, read_buf_.data(), len))
+        return false;
+    uint64_t nr = read_buf_[0];
+    uint64_t time_enabled = read_buf_[1];
+    uint64_t time_running = read_buf_[2];
+    double scale = (time_running > 0 && time_running < time_enabled) ?
+                   double(time_enabled) / time_running : 1.0;
+    values->resize(nr);
+    for (size_t i = 0; i < nr; ++i)
+        (*values)[i] = double(read_buf_[3 + i]) * scale;
+    return true;
+#else
+    return false;
+#endif
+}
+
+} // namespace pilot
@@ -0,0 +1,150 @@
+/*
+ * journal.hpp: append-only binary journal of the data of each round
+ *
+ * Copyright (c) 2017-2019 Yan Li <yanli@tuneup.ai>. All rights reserved.
+ * The Pilot tool and library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 (not any other version) as published by the Free
+ * Software Foundation.
+ *
+ * The Pilot tool and library is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program in file lgpl-2.1.txt; if not, see
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ *
+ * Commit 033228934e11b3f86fb0a4932b54b2aeea5c803c and before were
+ * released with the following license:
+ * Copyright (c) 2015, 2016, University of California, Santa Cruz, CA, USA.
+ * Created by Yan Li <yanli@tuneup.ai>,
+ * Department of Computer Science, Baskin School of Engineering.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Storage Systems Research Center, the
+ *       University of California, nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OF THE UNIVERSITY OF CALIFORNIA BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LIB_PRIV_INCLUDE_JOURNAL_HPP_
+#define LIB_PRIV_INCLUDE_JOURNAL_HPP_
+
+#include <functional>
+#include "pilot/libpilot.h"
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace pilot {
+
+/**
+ * \brief The data of one round as stored in the journal
+ * \details The unit readings are stored as they are kept in the workload,
+ * i.e., after the warm-up detection, so replaying a round does not need to
+ * run the detection again.
+ */
+struct pilot_journal_round_t {
+    size_t round;
+    size_t work_amount;
+    nanosecond_type round_duration;
+    bool has_readings;
+    std::vector<double> readings;                    //! Format: readings[piid]
+    std::vector<std::vector<double> > unit_readings; //! Format: unit_readings[piid][unit_id], after the warm-up detection
+    std::vector<size_t> warm_up_phase_len;           //! Format: warm_up_phase_len[piid]
+
+    pilot_journal_round_t() : round(0), work_amount(0), round_duration(0),
+        has_readings(false) {}
+};
+
+/**
+ * \brief An append-only binary journal of the data of each round
+ * \details The journal starts with a header that contains a magic string,
+ * the format version, the number of PIs, and the workload name. It is
+ * followed by one record per imported round. Each record is prefixed with
+ * its length and a checksum so a record that was partially written when the
+ * process crashed can be detected and discarded. The numbers are stored in
+ * the host's byte order.
+ *
+ * To limit the overhead, fsync() is called once every fsync_batch records
+ * and when sync() is called.
+ */
+class pilot_journal_t {
+public:
+    pilot_journal_t();
+    ~pilot_journal_t();
+
+    /**
+     * \brief Create a new journal, overwriting any existing file
+     * @return 0 on success; ERR_IO on I/O errors
+     */
+    int create(const std::string &filename, const std::string &workload_name,
+               size_t num_of_pi, size_t fsync_batch);
+
+    /**
+     * \brief Open an existing journal for appending
+     * \details All complete records are passed to round_func in order. An
+     * incomplete record at the end is truncated away.
+     * @return 0 on success; ERR_IO on I/O errors or if the file is not a
+     * journal; ERR_WRONG_PARAM if the number of PIs does not match
+     */
+    int open(const std::string &filename, size_t num_of_pi, size_t fsync_batch,
+             std::function<void(const pilot_journal_round_t&)> round_func);
+
+    /**
+     * \brief Append the data of one round
+     * \details If writing fails, the partial record is truncated away so that
+     * later records can still be loaded. If that fails too, all further
+     * appends fail.
+     * @return 0 on success; ERR_IO on I/O errors; ERR_WRONG_PARAM if the
+     * number of PIs in r does not match the journal
+     */
+    int append(const pilot_journal_round_t &r);
+
+    /**
+     * \brief Flush all records to the storage device
+     * @return 0 on success; ERR_IO on I/O errors
+     */
+    int sync();
+
+    void close();
+
+    const std::string& filename() const { return filename_; }
+
+private:
+    int         fd_;
+    std::string filename_;
+    size_t      num_of_pi_;
+    size_t      fsync_batch_;
+    size_t      num_of_unsynced_records_;
+    off_t       end_offset_;    //! end of the last complete record
+    bool        failed_;        //! a partial record could not be removed
+
+    pilot_journal_t(const pilot_journal_t&) = delete;
+    pilot_journal_t& operator=(const pilot_journal_t&) = delete;
+};
+
+} // namespace pilot
+
+#endif /* LIB_PRIV_INCLUDE_JOURNAL_HPP_ */
@@ -308,8 +308,8 @@ pilot_optimal_sample_size(InputIterator first, size_t n,
     double sm = pilot_subsession_mean(first, n, mean_method);
     double var = pilot_subsession_var(first, n, *q, sm, mean_method);
     *opt_sample_size = ceil(var * pow(T / e, 2));
-    trace_log << str(boost::format("number of samples required: %1% (desired sample size %2% x opt. subsession size %3%)")
-                 % ((*opt_sample_size) * (*q)) % *opt_sample_size % *q);
+    trace_log << boost::format("number of samples required: %1% (desired sample size %2% x opt. subsession size %3%)")
+                 % ((*opt_sample_size) * (*q)) % *opt_sample_size % *q;
     return true;
 }
 
@@ -323,122 +323,39 @@ void simple_regression_model(const std::vector<T1> &x, const std::vector<T2> &y,
     *alpha = y_mean - (*v) * x_mean;
 }
 
+class pilot_perf_counters_t;
+
 /**
- * Perform warm-up phase detection and removal on readings using the linear
- * regression method
- * @param rounds
- * @param round_work_amounts
- * @param round_durations
- * @param autocorrelation_coefficient_limit
- * @param duration_threshold any round whose duration is less than this threshold is discarded
- * @param v
- * @param ci_width
- * @return 0 on success; ERR_NOT_ENOUGH_DATA when there is not enough sample
- * for calculate v; ERR_NOT_ENOUGH_DATA_FOR_CI when there is enough data for
- * calculating v but not enough for calculating confidence interval.
+ * \brief The data of _simple_workload_func_runner()
  */
-template <typename WorkAmountInputIterator, typename RoundDurationInputIterator>
-int pilot_wps_warmup_removal_lr_method(size_t rounds, WorkAmountInputIterator round_work_amounts_raw,
-        RoundDurationInputIterator round_durations_raw,
-        float autocorrelation_coefficient_limit, nanosecond_type duration_threshold,
-        double *wps_alpha, double *wps_v,
-        double *wps_v_ci, double *ssr_out = NULL, double *ssr_percent_out = NULL,
-        size_t *subsession_sample_size = NULL, size_t *out_q = NULL) {
-    // first we create copies of round_work_amounts and round_durations with
-    // rounds that are shorter than round_durations filtered out
-    std::vector<size_t> round_work_amounts;
-    std::vector<nanosecond_type> round_durations;
-    // TODO: we can probably switch to using a more efficient iterator to skip
-    // those rounds that are too short. See FB#2947.
-    for (size_t i = 0; i < rounds; ++i) {
-        if (round_durations_raw[i] > duration_threshold) {
-            round_work_amounts.push_back(round_work_amounts_raw[i]);
-            round_durations.push_back(round_durations_raw[i]);
-        }
-    }
-
-    if (round_work_amounts.size() < 3) {
-        debug_log << __func__ << "() doesn't have enough samples after filtering using duration threshold";
-        return ERR_NOT_ENOUGH_DATA;
-    }
-
-    // then check for auto-correlation
-    std::vector<double> naive_v_per_round;
-    for (size_t i = 0; i < round_work_amounts.size(); ++i) {
-        naive_v_per_round.push_back(static_cast<double>(round_work_amounts[i]) / static_cast<double>(round_durations[i]));
-    }
-    int q = pilot_optimal_subsession_size(naive_v_per_round.begin(), naive_v_per_round.size(), HARMONIC_MEAN, autocorrelation_coefficient_limit);
-    if (q < 0) {
-        debug_log << __func__ << "() samples' autocorrelation coefficient too high; need more samples";
-        return ERR_NOT_ENOUGH_DATA;
-    }
-    if (out_q) { *out_q = q; }
-    debug_log << "WPS analysis: optimal subsession size (q) = " << q;
-    size_t h = round_work_amounts.size() / q;
-    if (subsession_sample_size) *subsession_sample_size = h;
-    if (h < 3) {
-        debug_log << __func__ << "() doesn't have enough samples (<3) after subsession grouping";
-        return ERR_NOT_ENOUGH_DATA;
-    }
-    std::vector<size_t> subsession_work_amounts;
-    std::vector<nanosecond_type> subsession_round_durations;
-
-    size_t subsession_sum_wa = 0;
-    nanosecond_type subsession_sum_dur = 0;
-    size_t total_sum_wa = 0;
-    nanosecond_type total_sum_dur = 0;
-    // convert input into subsession data by grouping every q samples
-    for (size_t i = 0; i < rounds; ++i) {
-        subsession_sum_wa  += round_work_amounts[i];
-        subsession_sum_dur += round_durations[i];
-        total_sum_wa += round_work_amounts[i];
-        total_sum_dur += round_durations[i];
-        if (i % size_t(q) == size_t(q) - 1) {
-            subsession_work_amounts.push_back(subsession_sum_wa);
-            subsession_round_durations.push_back(subsession_sum_dur);
-            subsession_sum_wa = 0;
-            subsession_sum_dur = 0;
-        }
-    }
+struct _simple_runner_data_t {
+    pilot_simple_workload_func_t *func;
+    pilot_perf_counters_t        *counters;  //! NULL if not collecting counters
+    int                           ipc_piid;  //! -1 if IPC is not available
+    bool                          read_failed;  //! a read of the counters has failed
+};
 
-    double wps_inv_v;
-    {
-        double wpns_inv_v;     // invert v of work amount per nanosecond
-        simple_regression_model(subsession_work_amounts, subsession_round_durations, wps_alpha, &wpns_inv_v);
-        wps_inv_v = wpns_inv_v / ONE_SECOND;
-        *wps_alpha /= ONE_SECOND;
-        *wps_v = ONE_SECOND / wpns_inv_v;
-    }
+/**
+ * \brief The workload function of simple_runner()
+ * @param data a _simple_runner_data_t
+ */
+int _simple_workload_func_runner(const pilot_workload_t *wl,
+                                 size_t round,
+                                 size_t total_work_amount,
+                                 pilot_malloc_func_t *lib_malloc_func,
+                                 size_t *num_of_work_unit,
+                                 double ***unit_readings,
+                                 double **readings,
+                                 nanosecond_type *round_duration,
+                                 void *data);
 
-    double sub_session_ssr = 0;
-    for (size_t i = 0; i < subsession_work_amounts.size(); ++i) {
-        double wa = double(subsession_work_amounts[i]);
-        double dur = double(subsession_round_durations[i]) / ONE_SECOND;
-        sub_session_ssr += pow(*wps_alpha + wps_inv_v * wa - dur, 2);
-    }
-    debug_log << __func__ << "(): sub_session_ssr: " << sub_session_ssr;
-    double ssr = 0;
-    double dur_sum = 0;
-    for (size_t i = 0; i < rounds; ++i) {
-        double wa = double(round_work_amounts_raw[i]);
-        double dur = double(round_durations_raw[i]) / ONE_SECOND;
-        ssr += pow(*wps_alpha + wps_inv_v * wa - dur, 2);
-        dur_sum += dur;
-    }
-    debug_log << __func__ << "(): ssr: " << ssr;
-    if (ssr_out) *ssr_out = ssr;
-    if (ssr_percent_out) *ssr_percent_out = sqrt(ssr) / dur_sum;
-
-    double sigma_sqr = sub_session_ssr / (h - 2);
-    double wa_mean = pilot_subsession_mean(round_work_amounts.begin(), round_work_amounts.size(), ARITHMETIC_MEAN);
-    double sum_var = pilot_subsession_var(round_work_amounts.begin(), round_work_amounts.size(), q, wa_mean, ARITHMETIC_MEAN) * (rounds -1);
-    double std_err_v = sqrt(sigma_sqr / sum_var);
-    double inv_v_ci = 2 * std_err_v;
-    // inv_v - inv_v_ci might be negative so we have to use abs() here
-    *wps_v_ci = std::abs( 1.0 / (wps_inv_v - inv_v_ci) - 1.0 / (wps_inv_v + inv_v_ci) );
-    debug_log << __func__ << "(): result wps_alpha " << *wps_alpha << ", wps_v " << *wps_v << ", wps_v_ci " << *wps_v_ci;
-    return 0;
-}
+/**
+ * \brief The O'Brien-Fleming-type alpha spending function (Lan-DeMets)
+ * @param t the information fraction, within (0, 1]
+ * @param alpha the overall error rate
+ * @return the error rate that can be spent by information fraction t
+ */
+double pilot_obf_alpha_spending(double t, double alpha);
 
 } // namespace pilot
 
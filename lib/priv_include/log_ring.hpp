@@ -0,0 +1,193 @@
+/*
+ * log_ring.hpp: a fixed-capacity lock-free ring buffer for the in-memory log
+ *
+ * Copyright (c) 2017-2019 Yan Li <yanli@tuneup.ai>. All rights reserved.
+ * The Pilot tool and library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 (not any other version) as published by the Free
+ * Software Foundation.
+ *
+ * The Pilot tool and library is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program in file lgpl-2.1.txt; if not, see
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ *
+ * Commit 033228934e11b3f86fb0a4932b54b2aeea5c803c and before were
+ * released with the following license:
+ * Copyright (c) 2015, 2016, University of California, Santa Cruz, CA, USA.
+ * Created by Yan Li <yanli@tuneup.ai>,
+ * Department of Computer Science, Baskin School of Engineering.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Storage Systems Research Center, the
+ *       University of California, nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OF THE UNIVERSITY OF CALIFORNIA BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LIB_PRIV_INCLUDE_LOG_RING_HPP_
+#define LIB_PRIV_INCLUDE_LOG_RING_HPP_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+
+namespace pilot {
+
+class pilot_log_spill_t;
+
+/**
+ * \brief A fixed-capacity, lock-free, multi-producer ring of log records
+ * \details Each record is stored in one or more consecutive fixed-size
+ * slots. A producer reserves all the slots it needs with a single atomic
+ * fetch_add on the head ticket, so appending never takes a lock. Each slot
+ * carries a sequence number that works as a seqlock, which lets readers
+ * detect slots that are being written or have been overwritten. Slots carry
+ * a flag marking the start of a record, so the last k records can be found
+ * by walking backwards from the head in O(k).
+ *
+ * When the ring is full the oldest records are evicted. If a spill file is
+ * set, evicted records are appended to it (compressed in blocks when built
+ * with zlib) instead of being dropped.
+ *
+ * The slots are allocated on the first append, so a ring that is never
+ * written to costs no memory.
+ */
+class pilot_log_ring_t {
+public:
+    static const size_t kDefaultCapacity = 16 * 1024 * 1024;
+
+    explicit pilot_log_ring_t(size_t capacity = kDefaultCapacity);
+    ~pilot_log_ring_t();
+
+    /**
+     * \brief Discard all records and change the capacity
+     * \details This function is not thread-safe and must not be called
+     * when other threads may log. The new slots are allocated on the next
+     * append.
+     * @param capacity the capacity in bytes
+     */
+    void reset(size_t capacity);
+
+    /**
+     * \brief Set the file for storing evicted records
+     * \details This function is not thread-safe and must not be called
+     * when other threads may log.
+     * @param path the path of the spill file, empty to stop spilling
+     * @return true on success
+     */
+    bool set_spill_file(const std::string &path);
+
+    const std::string& spill_file() const { return spill_path_; }
+
+    /**
+     * \brief Append a record
+     * \details This function is lock-free unless a spill file is set and
+     * a record is being evicted.
+     */
+    void append(const char *s, size_t len);
+    void append(const std::string &s) { append(s.data(), s.size()); }
+
+    /**
+     * \brief Get the last n lines
+     * @param n number of lines
+     * @return the last n lines, including the trailing new line
+     */
+    std::string last_lines(size_t n) const;
+
+    /**
+     * \brief Write all records in the ring to a stream and remove them
+     * \details Concurrent producers are allowed, but drain() must not be
+     * called from more than one thread at the same time.
+     */
+    void drain(std::ostream &o);
+
+    /**
+     * \brief Write all records in the ring to a stream and keep them
+     * \details Concurrent producers are allowed.
+     */
+    void copy(std::ostream &o) const { write_records(o); }
+
+    //! The number of records that have been evicted from the ring
+    uint64_t evicted_records() const { return evicted_records_.load(std::memory_order_relaxed); }
+
+private:
+    static const size_t  kSlotSize = 256;
+    static const uint8_t kRecordBegin = 1;
+    static const uint8_t kEmpty = 2;
+
+    // Slot contents are accessed with relaxed atomics so that the seqlock
+    // protocol is free of data races
+    struct slot_t {
+        // 2 * ticket + 1 when being written, 2 * ticket + 2 when published
+        std::atomic<uint64_t> seq;
+        // length in the lower 16 bits and flags in the next 8 bits
+        std::atomic<uint64_t> meta;
+        std::atomic<uint64_t> words[kSlotSize / sizeof(uint64_t) - 2];
+    };
+    static const size_t kSlotPayload = sizeof(((slot_t*)0)->words);
+
+    // NULL until the first append, see get_slots()
+    std::atomic<slot_t*>      slots_;
+    std::mutex                alloc_mutex_;
+    size_t                    num_of_slots_;
+    // Tickets start from num_of_slots_ so the initial empty slots look
+    // like published slots from the previous lap
+    std::atomic<uint64_t>     head_;
+    std::atomic<uint64_t>     drained_;
+    std::atomic<uint64_t>     evicted_records_;
+
+    std::mutex                         spill_mutex_;
+    std::unique_ptr<pilot_log_spill_t> spill_;
+    std::string                        spill_path_;
+
+    /**
+     * \brief Copy a published slot
+     * @return false if the slot does not hold the ticket anymore
+     */
+    bool read_slot(uint64_t ticket, size_t *len, uint8_t *flags, char *data) const;
+
+    void evict(uint64_t ticket, const slot_t &slot);
+
+    /**
+     * \brief Write the records that have not been drained to a stream
+     * @return the ticket of the first slot that was not written
+     */
+    uint64_t write_records(std::ostream &o) const;
+
+    //! Return the slots, allocating them if this is the first append
+    slot_t* get_slots();
+
+    pilot_log_ring_t(const pilot_log_ring_t&) = delete;
+    pilot_log_ring_t& operator=(const pilot_log_ring_t&) = delete;
+};
+
+} // namespace pilot
+
+#endif /* LIB_PRIV_INCLUDE_LOG_RING_HPP_ */
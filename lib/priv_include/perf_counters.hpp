@@ -0,0 +1,124 @@
+/*
+ * perf_counters.hpp: collecting hardware and software performance counters
+ * using perf_event_open
+ *
+ * Copyright (c) 2017-2019 Yan Li <yanli@tuneup.ai>. All rights reserved.
+ * The Pilot tool and library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 (not any other version) as published by the Free
+ * Software Foundation.
+ *
+ * The Pilot tool and library is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program in file lgpl-2.1.txt; if not, see
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ *
+ * Commit 033228934e11b3f86fb0a4932b54b2aeea5c803c and before were
+ * released with the following license:
+ * Copyright (c) 2015, 2016, University of California, Santa Cruz, CA, USA.
+ * Created by Yan Li <yanli@tuneup.ai>,
+ * Department of Computer Science, Baskin School of Engineering.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Storage Systems Research Center, the
+ *       University of California, nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OF THE UNIVERSITY OF CALIFORNIA BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LIB_PRIV_INCLUDE_PERF_COUNTERS_HPP_
+#define LIB_PRIV_INCLUDE_PERF_COUNTERS_HPP_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace pilot {
+
+/**
+ * \brief A group of performance counters of the calling thread
+ * \details On Linux the counters are opened as one perf_event_open group so
+ * they are scheduled onto the PMU together and can be read with a single
+ * read(). Hardware counters (instructions, cycles, cache misses, branch
+ * misses) are tried first. If the PMU is not accessible (e.g., in a VM or
+ * because of perf_event_paranoid), software counters (task clock, context
+ * switches, page faults) are used instead. On other platforms no counter
+ * can be opened and size() is always 0.
+ */
+class pilot_perf_counters_t {
+public:
+    pilot_perf_counters_t();
+    ~pilot_perf_counters_t();
+
+    /**
+     * \brief Open the counters
+     * @return the number of counters opened, 0 means no counter is
+     * available
+     */
+    size_t open();
+
+    /**
+     * \brief Close all counters
+     */
+    void close();
+
+    size_t size() const { return names_.size(); }
+    const std::string& name(size_t i) const { return names_[i]; }
+    const std::string& unit(size_t i) const { return units_[i]; }
+    bool is_hardware() const { return hardware_; }
+
+    /**
+     * \brief Get the index of a counter by name
+     * @return the index, or -1 if the counter is not opened
+     */
+    int index_of(const std::string &name) const;
+
+    /**
+     * \brief Read the current values of all counters
+     * \details The values are cumulative since open() and are scaled when
+     * the kernel had to multiplex the counters.
+     * @param[out] values the values, will be resized to size()
+     * @return true on success
+     */
+    bool read(std::vector<double> *values) const;
+
+private:
+    int                      group_fd_;
+    bool                     hardware_;
+    std::vector<int>         fds_;
+    std::vector<std::string> names_;
+    std::vector<std::string> units_;
+    mutable std::vector<uint64_t> read_buf_;
+
+    bool open_event(uint32_t type, uint64_t config, const char *name, const char *unit);
+
+    pilot_perf_counters_t(const pilot_perf_counters_t&) = delete;
+    pilot_perf_counters_t& operator=(const pilot_perf_counters_t&) = delete;
+};
+
+} // namespace pilot
+
+#endif /* LIB_PRIV_INCLUDE_PERF_COUNTERS_HPP_ */
@@ -58,13 +58,16 @@
 #include <boost/timer/timer.hpp>
 #include <chrono>
 #include <functional>
+#include <memory>
 #include <vector>
 #include "common.h"
 #include "pilot/libpilot.h"
+#include "wps_regression.hpp"
 
 namespace pilot {
 
 class PilotTUI;
+class pilot_journal_t;
 
 /**
  * This functor is used to format a number for human-readable display.
@@ -135,12 +138,36 @@ struct baseline_info_t {
     baseline_info_t() : set(false), mean(0), sample_size(0), var(0) {}
 };
 
+/**
+ * \brief The state of a SEQUENTIAL_COMPARISON against a baseline
+ */
+struct comparison_state_t {
+    pilot_comparison_decision_t decision;
+    size_t looks;                  //! number of looks taken
+    size_t last_look_round;        //! the value of rounds_ when the last look was taken
+    double spent_alpha;            //! the error rate spent by the previous looks
+    double p_value;                //! the p-value of Welch's t-test at the last look
+
+    comparison_state_t() : decision(COMPARISON_UNDECIDED), looks(0),
+        last_look_round(0), spent_alpha(0), p_value(1) {}
+};
+
 enum pilot_workload_status_t {
     WL_NOT_RUNNING,
     WL_RUNNING,
     WL_STOP_REQUESTED,
 };
 
+/**
+ * A published copy of the analytical result. result must be the first
+ * member so that a pointer to it can be converted back.
+ */
+struct analytical_result_snapshot_t {
+    pilot_analytical_result_t result;
+    mutable std::atomic<size_t> readers;
+    analytical_result_snapshot_t() : readers(0) {}
+};
+
 struct pilot_workload_t {
 private:
     double required_ci_percent_of_mean_;
@@ -150,7 +177,6 @@ public:  // FIXME: most of the following members should be private and controlle
     // Essential workload information
     std::string workload_name_;
     volatile std::atomic<pilot_workload_status_t> status_;
-    std::chrono::steady_clock::time_point raw_data_changed_time_; //! The time when the latest raw data came in
     size_t num_of_pi_;                               //! Number of performance indices to collect for each round
     size_t rounds_;                                  //! Number of rounds we've done so far
     size_t init_work_amount_;
@@ -177,9 +203,22 @@ public:  // FIXME: most of the following members should be private and controlle
     double warm_up_removal_percentage_;
     double warm_up_removal_moving_average_window_size_in_seconds_;
 
+    // Session planning
+    pilot_session_planner_t session_planner_;
+    nanosecond_type total_round_overhead_;           //! Total time spent between rounds (analysis, hooks, and UI)
+    size_t num_of_round_overheads_;                  //! Number of measurements in total_round_overhead_
+    mutable ssize_t planner_predicted_round_;        //! The round whose duration was predicted by the planner, -1 if none
+    mutable double planner_predicted_round_duration_; //! The predicted duration of planner_predicted_round_ in seconds
+    mutable double planner_total_round_duration_error_; //! Sum of the absolute relative errors of the predicted round durations
+    mutable std::vector<std::pair<size_t, double> > planner_remaining_time_predictions_; //! Pairs of <round, predicted remaining session time in seconds before the round>
+
     // Baseline for comparison analysis
     std::vector<baseline_info_t> baseline_of_readings_;
     std::vector<baseline_info_t> baseline_of_unit_readings_;
+    pilot_comparison_method_t comparison_method_;
+    double comparison_equivalence_margin_;           //! The largest difference from the baseline mean that counts as equivalent, as a fraction of the baseline mean
+    size_t comparison_max_looks_;
+    mutable std::vector<comparison_state_t> comparison_state_; //! The state of SEQUENTIAL_COMPARISON of each PI's unit readings
 
     // Raw data
     typedef std::vector<double> reading_data_t;      //! The data of one reading of all rounds
@@ -187,7 +226,8 @@ public:  // FIXME: most of the following members should be private and controlle
     typedef std::vector<unit_reading_data_per_round_t> unit_reading_data_t; //! Per round unit reading data
 
     std::vector<boost::timer::nanosecond_type> round_durations_; //! The duration of each round
-    std::vector<reading_data_t> readings_;           //! Reading data of each round. Format: readings_[piid][round_id].
+    std::vector<reading_data_t> readings_;           //! Readings of the rounds that have them, in the order of the rounds. Format: readings_[piid][readings_index(round_id)].
+    std::vector<bool> round_has_readings_;           //! Whether each round has readings
     std::vector<unit_reading_data_t> unit_readings_; //! Unit reading data of each round. Format: unit_readings_[piid][round_id].
     std::vector<std::vector<size_t> > warm_up_phase_len_;  //! The length of the warm-up phase of each PI per round. Format: warm_up_phase_len_[piid][round_id].
     std::vector<size_t> total_num_of_unit_readings_; //! Total number of unit readings per PI
@@ -198,10 +238,24 @@ public:  // FIXME: most of the following members should be private and controlle
 
     // Analytical result
     mutable pilot_analytical_result_t analytical_result_;
-    mutable std::chrono::steady_clock::time_point analytical_result_update_time_; //! The time when analytical_result_ is updated
+    enum analysis_kind_t : unsigned {
+        READINGS_ANALYSIS       = 1,
+        UNIT_READINGS_ANALYSIS  = 2,
+        ALL_PI_ANALYSES         = READINGS_ANALYSIS | UNIT_READINGS_ANALYSIS,
+    };
+    mutable std::vector<unsigned> dirty_pi_analyses_; //! The analysis_kind_t bits of each PI whose results in analytical_result_ are out of date
+    mutable ssize_t wps_analysis_rounds_;            //! rounds_ when the WPS results in analytical_result_ were computed, -1 if they are out of date
+    mutable std::atomic<bool> snapshots_wanted_;     //! Whether a snapshot has ever been acquired
+    std::atomic<analytical_result_snapshot_t*> published_snapshot_;
+    std::vector<std::unique_ptr<analytical_result_snapshot_t> > snapshots_; //! All snapshots, only the published one and those with readers are in use
 
     // WPS analysis bookkeeping
     mutable size_t wps_slices_;                              //! The total number of slices, which is used to generate work amounts for WPS analysis
+    pilot_wps_schedule_t wps_schedule_;                      //! How the work amounts of WPS rounds are chosen
+    mutable pilot_wps_regression_t wps_regression_;          //! Running state of the WPS regression, see refresh_wps_analysis_results()
+    mutable std::vector<size_t> wps_rounds_;                 //! The rounds in the WPS analysis, which are those not rejected
+    mutable std::vector<size_t> wps_work_amounts_;           //! The work amounts of wps_rounds_
+    mutable std::vector<nanosecond_type> wps_round_durations_; //! The round durations of wps_rounds_
 
     // Hook functions
     next_round_work_amount_hook_t *next_round_work_amount_hook_; //! The hook function that calculates the work amount for next round
@@ -214,6 +268,7 @@ public:  // FIXME: most of the following members should be private and controlle
 
     // Runtime data structures
     PilotTUI *tui_;
+    std::shared_ptr<pilot_journal_t> journal_;       //! The journal that the data of each round is appended to, if set
 
     pilot_workload_t(const char *wl_name) :
                          required_ci_percent_of_mean_(0.1), required_ci_absolute_value_(-1),
@@ -234,10 +289,19 @@ public:  // FIXME: most of the following members should be private and controlle
                          warm_up_removal_detection_method_(EDM),
                          warm_up_removal_percentage_(0.1),
                          warm_up_removal_moving_average_window_size_in_seconds_(3),
+                         session_planner_(GREEDY_PLANNER),
+                         total_round_overhead_(0), num_of_round_overheads_(0),
+                         planner_predicted_round_(-1),
+                         planner_predicted_round_duration_(0),
+                         planner_total_round_duration_error_(0),
+                         comparison_method_(FIXED_SAMPLE_SIZE_COMPARISON),
+                         comparison_equivalence_margin_(0.05),
+                         comparison_max_looks_(20),
                          wholly_rejected_rounds_(0),
                          analytical_result_(),
-                         analytical_result_update_time_(std::chrono::steady_clock::time_point::min()),
-                         wps_slices_(0),
+                         wps_analysis_rounds_(-1),
+                         snapshots_wanted_(false), published_snapshot_(nullptr),
+                         wps_slices_(0), wps_schedule_(WPS_EVEN_SLICES),
                          next_round_work_amount_hook_(NULL),
                          hook_pre_workload_run_(NULL), hook_post_workload_run_(NULL),
                          calc_required_readings_func_(NULL),
@@ -256,6 +320,21 @@ public:  // FIXME: most of the following members should be private and controlle
      */
     void set_num_of_pi(size_t num_of_pi);
 
+    /**
+     * \brief Return the index of the readings of a round in readings_[piid]
+     * \details If the round has no readings, it is the index at which they
+     * would be inserted.
+     */
+    size_t readings_index(size_t round) const;
+
+    /**
+     * \brief Whether a round is rejected
+     * \details A round is rejected when it has no readings while other rounds
+     * of the workload have, e.g., when it timed out. Rejected rounds are left
+     * out of the analyses of round durations, such as WPS analysis.
+     */
+    bool round_is_rejected(size_t round) const;
+
     /**
      * \brief Return the mean of the unit readings
      * @param piid the PI ID to analyze
@@ -292,6 +371,13 @@ public:  // FIXME: most of the following members should be private and controlle
      */
     ssize_t required_num_of_unit_readings_for_comparison(int piid) const;
 
+    /**
+     * \brief Take a look at the unit readings of piid for SEQUENTIAL_COMPARISON
+     * \details Updates comparison_state_[piid]. At most one look is taken
+     * per round and nothing changes after a decision has been made.
+     */
+    void take_comparison_look(size_t piid) const;
+
     /**
      * Calculate how much work amount is needed for next round
      * @param[out] needed_work_amount. A returned 0 value doesn't necessarily mean
@@ -301,6 +387,26 @@ public:  // FIXME: most of the following members should be private and controlle
      */
     bool calc_next_round_work_amount(size_t * const needed_work_amount) const;
 
+    /**
+     * \brief Plan the remaining rounds and return the work amount of the next one
+     * \details This is the MPC_PLANNER. It fits a linear model of round
+     * duration (fixed cost plus cost per unit of work amount) and a linear
+     * model of the usable unit readings of each PI per round (yield per unit
+     * of work amount minus the loss to warm-up removal), then finds the
+     * number of equally sized rounds that is predicted to meet all sample size
+     * requirements in the shortest time. The results are stored in the
+     * planner_* fields of analytical_result_.
+     * @param[out] needed_work_amount the work amount of the next round
+     * @param[out] duration_intercept the fixed part of the round duration in
+     * seconds, which together with duration_slope predicts the round duration
+     * @param[out] duration_slope the round duration per unit of work amount in
+     * seconds
+     * @return false if there is not enough data for planning
+     */
+    bool plan_next_round_work_amount(size_t *needed_work_amount,
+                                     double *duration_intercept,
+                                     double *duration_slope) const;
+
     inline double calc_avg_work_unit_per_amount(int piid) const {
         size_t total_work_units = 0;
         size_t total_work_amount = 0;
@@ -316,10 +422,29 @@ public:  // FIXME: most of the following members should be private and controlle
     /**
      * \brief Refresh the analytical result (analytical_result_)
      * \details This function is used mostly by the library internally. The
-     * user should consider using get_analytical_result().
+     * user should consider using get_analytical_result(). Only the analyses
+     * whose data have changed are run.
      */
     void refresh_analytical_result(void) const;
 
+    /**
+     * \brief Refresh only some analyses of one PI in analytical_result_
+     * @param piid the PI
+     * @param kinds the analysis_kind_t bits of the analyses to refresh
+     */
+    void refresh_analytical_result(size_t piid, unsigned kinds) const;
+
+    /**
+     * \brief Mark analyses as out of date after their data or settings changed
+     * @param piid the PI, or -1 for all PIs and WPS analysis
+     * @param kinds the analysis_kind_t bits of the analyses of the PI
+     */
+    void invalidate_analytical_result(size_t piid = static_cast<size_t>(-1),
+                                      unsigned kinds = ALL_PI_ANALYSES) const;
+
+    void refresh_readings_analysis(size_t piid) const;
+    void refresh_unit_readings_analysis(size_t piid) const;
+
     /**
      * \brief Get the analytical result of a workload
      * \details First this function update the cached analytical result if necessary.
@@ -335,6 +460,18 @@ public:  // FIXME: most of the following members should be private and controlle
      */
     pilot_analytical_result_t* get_analytical_result(pilot_analytical_result_t *winfo = NULL) const;
 
+    /**
+     * \brief Refresh the analytical result and publish a snapshot of it
+     * \details Only the thread running the workload may call this function.
+     */
+    void publish_analytical_result_snapshot(void);
+
+    /**
+     * \brief Get the latest published snapshot
+     * See pilot_acquire_analytical_result_snapshot() for detail.
+     */
+    const pilot_analytical_result_t* acquire_analytical_result_snapshot(void) const;
+
     /**
      * \brief Get the basic and statistics information of a workload round
      * \details If info is NULL, this function allocates memory for a
@@ -375,7 +512,7 @@ public:  // FIXME: most of the following members should be private and controlle
         return format_wps_(this, wps);
     }
 
-    int set_wps_analysis(bool enabled, bool wps_must_satisfy);
+    int set_wps_analysis(bool enabled, bool wps_must_satisfy, pilot_wps_schedule_t schedule);
     void refresh_wps_analysis_results(void) const;
 
     size_t set_session_desired_duration(size_t sec);
@@ -428,10 +565,12 @@ public:  // FIXME: most of the following members should be private and controlle
 
     inline void set_required_ci_percent_of_mean(double percent_of_mean) {
         required_ci_percent_of_mean_ = percent_of_mean;
+        invalidate_analytical_result();
     }
 
     inline void set_required_ci_absolute_value(double absolute_value) {
         required_ci_absolute_value_ = absolute_value;
+        invalidate_analytical_result();
     }
 
     /**
@@ -440,7 +579,6 @@ public:  // FIXME: most of the following members should be private and controlle
      * @return the desired width of CI
      */
     inline double get_required_ci(double mean) const {
-        refresh_analytical_result();
         double result = std::numeric_limits<double>::infinity();
 
         if (required_ci_percent_of_mean_ < 0 && required_ci_absolute_value_ < 0) {
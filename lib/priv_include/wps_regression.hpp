@@ -0,0 +1,218 @@
+/*
+ * wps_regression.hpp: running state of the WPS linear regression
+ *
+ * Copyright (c) 2017-2019 Yan Li <yanli@tuneup.ai>. All rights reserved.
+ * The Pilot tool and library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 (not any other version) as published by the Free
+ * Software Foundation.
+ *
+ * The Pilot tool and library is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program in file lgpl-2.1.txt; if not, see
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ *
+ * Commit 033228934e11b3f86fb0a4932b54b2aeea5c803c and before were
+ * released with the following license:
+ * Copyright (c) 2015, 2016, University of California, Santa Cruz, CA, USA.
+ * Created by Yan Li <yanli@tuneup.ai>,
+ * Department of Computer Science, Baskin School of Engineering.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Storage Systems Research Center, the
+ *       University of California, nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OF THE UNIVERSITY OF CALIFORNIA BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef LIB_PRIV_INCLUDE_WPS_REGRESSION_HPP_
+#define LIB_PRIV_INCLUDE_WPS_REGRESSION_HPP_
+
+#include <cstddef>
+#include <set>
+#include "pilot/libpilot.h"
+#include <vector>
+
+namespace pilot {
+
+/**
+ * \brief Running co-moments of (x, y) pairs (Welford's method)
+ * \details Keeps the means and the centered sums of squares and products,
+ * which don't suffer from the cancellation that raw sums of squares have
+ * when the values are large (e.g., durations in nanoseconds).
+ */
+struct pilot_running_moments_t {
+    size_t n;
+    double x_mean, y_mean;
+    double x_m2, y_m2, xy_m2;   //! sum of (x-x_mean)^2, (y-y_mean)^2, and (x-x_mean)(y-y_mean)
+
+    pilot_running_moments_t() : n(0), x_mean(0), y_mean(0), x_m2(0), y_m2(0), xy_m2(0) {}
+
+    void add(double x, double y) {
+        ++n;
+        double dx = x - x_mean;
+        double dy = y - y_mean;
+        x_mean += dx / n;
+        y_mean += dy / n;
+        x_m2  += dx * (x - x_mean);
+        y_m2  += dy * (y - y_mean);
+        xy_m2 += dx * (y - y_mean);
+    }
+};
+
+/**
+ * \brief The running state of one subsession size q of a bucket
+ * \details Rounds are grouped into subsessions of q consecutive rounds in
+ * the order they were added. Only complete subsessions are used.
+ */
+struct pilot_wps_subsession_state_t {
+    size_t q;
+    size_t h;                     //! number of complete subsessions
+    // the incomplete subsession at the end
+    size_t partial_n;
+    double partial_inv_naive_v_sum;
+    double partial_work_amount;
+    double partial_duration;
+    // subsession harmonic means of naive v
+    double last_naive_v;
+    pilot_running_moments_t naive_v;      //! x = y = subsession mean of naive v
+    pilot_running_moments_t naive_v_lag;  //! x = mean of subsession j-1, y = mean of subsession j
+    // subsession total work amount (x) and duration (y)
+    pilot_running_moments_t totals;
+
+    explicit pilot_wps_subsession_state_t(size_t q) : q(q), h(0), partial_n(0),
+        partial_inv_naive_v_sum(0), partial_work_amount(0), partial_duration(0),
+        last_naive_v(0) {}
+
+    void add(size_t work_amount, nanosecond_type round_duration);
+
+    /**
+     * The autocorrelation coefficient of the subsession means of naive v
+     * around sample_mean. Same as pilot_subsession_autocorrelation_coefficient().
+     */
+    double autocorrelation_coefficient(double sample_mean) const;
+};
+
+/**
+ * \brief The running state of the rounds that are longer than a duration threshold
+ */
+struct pilot_wps_bucket_t {
+    nanosecond_type duration_threshold;
+    size_t last_used;
+    std::vector<size_t> rounds;   //! the indices of the rounds that pass the filter
+    double inv_naive_v_sum;       //! for the harmonic mean of naive v
+    double work_amount_sum;
+    std::vector<pilot_wps_subsession_state_t> subsessions; //! subsessions[q-1], created on demand
+
+    explicit pilot_wps_bucket_t(nanosecond_type duration_threshold) :
+        duration_threshold(duration_threshold), last_used(0),
+        inv_naive_v_sum(0), work_amount_sum(0) {}
+
+    void add(size_t round, size_t work_amount, nanosecond_type round_duration);
+};
+
+/**
+ * \brief Running state of the WPS linear regression
+ * \details Each duration threshold gets a bucket that keeps the indices of
+ * the rounds that pass the filter and the running sums of each subsession
+ * size that has been asked for. Adding a round costs O(1) per bucket and
+ * subsession size, and so does a calc() call that is answered by an existing
+ * bucket and subsession size. A new threshold reuses the bucket of another
+ * threshold when no round duration lies in between; otherwise a new bucket
+ * is built from the data in O(n). Only the most recently used buckets are
+ * kept.
+ *
+ * The caller owns the round data. The same arrays must be passed to sync()
+ * and calc(), and reset() must be called if any round that has been synced
+ * is changed.
+ */
+class pilot_wps_regression_t {
+public:
+    pilot_wps_regression_t() : tick_(0) {}
+
+    void reset(void);
+
+    /**
+     * \brief Add the rounds that have not been added yet
+     * @param rounds total number of rounds in the arrays
+     */
+    void sync(size_t rounds, const size_t *round_work_amounts,
+              const nanosecond_type *round_durations);
+
+    size_t rounds(void) const { return round_durations_.size(); }
+
+    /**
+     * \brief Calculate the WPS regression of the synced rounds
+     * \details See pilot_wps_warmup_removal_lr_method() for the parameters
+     * and return values.
+     */
+    int calc(const size_t *round_work_amounts, const nanosecond_type *round_durations,
+             float autocorrelation_coefficient_limit, nanosecond_type duration_threshold,
+             double *wps_alpha, double *wps_v, double *wps_v_ci,
+             double *ssr_out = NULL, double *ssr_percent_out = NULL,
+             size_t *subsession_sample_size = NULL, size_t *out_q = NULL);
+
+private:
+    static const size_t kMaxBuckets = 4;
+
+    pilot_wps_bucket_t& get_bucket(const size_t *round_work_amounts,
+                                   const nanosecond_type *round_durations,
+                                   nanosecond_type duration_threshold);
+    pilot_wps_subsession_state_t& get_subsession(pilot_wps_bucket_t &b, size_t q,
+                                                 const size_t *round_work_amounts,
+                                                 const nanosecond_type *round_durations);
+
+    size_t tick_;
+    std::multiset<nanosecond_type> round_durations_;  //! all round durations, for matching thresholds to buckets
+    pilot_running_moments_t all_rounds_;              //! x = work amount, y = round duration of all rounds
+    std::vector<pilot_wps_bucket_t> buckets_;
+};
+
+/**
+ * Perform warm-up phase detection and removal on readings using the linear
+ * regression method
+ * @param rounds
+ * @param round_work_amounts
+ * @param round_durations
+ * @param autocorrelation_coefficient_limit
+ * @param duration_threshold any round whose duration is less than this threshold is discarded
+ * @param v
+ * @param ci_width
+ * @return 0 on success; ERR_NOT_ENOUGH_DATA when there is not enough sample
+ * for calculate v; ERR_NOT_ENOUGH_DATA_FOR_CI when there is enough data for
+ * calculating v but not enough for calculating confidence interval.
+ */
+int pilot_wps_warmup_removal_lr_method(size_t rounds, const size_t *round_work_amounts,
+        const nanosecond_type *round_durations,
+        float autocorrelation_coefficient_limit, nanosecond_type duration_threshold,
+        double *wps_alpha, double *wps_v,
+        double *wps_v_ci, double *ssr_out = NULL, double *ssr_percent_out = NULL,
+        size_t *subsession_sample_size = NULL, size_t *out_q = NULL);
+
+} // namespace pilot
+
+#endif /* LIB_PRIV_INCLUDE_WPS_REGRESSION_HPP_ */
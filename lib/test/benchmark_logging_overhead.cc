@@ -0,0 +1,132 @@
+/*
+ * benchmark_logging_overhead.cc: measures the per-round overhead of logging
+ * in pilot_run_workload() under different log levels
+ *
+ * Copyright (c) 2017-2019 Yan Li <yanli@tuneup.ai>. All rights reserved.
+ * The Pilot tool and library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 (not any other version) as published by the Free
+ * Software Foundation.
+ *
+ * The Pilot tool and library is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program in file lgpl-2.1.txt; if not, see
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ *
+ * Commit 033228934e11b3f86fb0a4932b54b2aeea5c803c and before were
+ * released with the following license:
+ * Copyright (c) 2015, 2016, University of California, Santa Cruz, CA, USA.
+ * Created by Yan Li <yanli@tuneup.ai>,
+ * Department of Computer Science, Baskin School of Engineering.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Storage Systems Research Center, the
+ *       University of California, nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OF THE UNIVERSITY OF CALIFORNIA BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include "pilot/libpilot.h"
+#include <vector>
+
+using namespace pilot;
+using namespace std;
+
+static const size_t g_num_of_rounds = 100;
+static const size_t g_num_of_units = 20;
+static size_t g_round = 0;
+
+static int mock_workload_func(const pilot_workload_t *wl,
+                              size_t round,
+                              size_t total_work_amount,
+                              pilot_malloc_func_t *lib_malloc_func,
+                              size_t *num_of_work_unit,
+                              double ***unit_readings,
+                              double **readings,
+                              nanosecond_type *round_duration, void *data) {
+    *num_of_work_unit = g_num_of_units;
+    *unit_readings = (double**)lib_malloc_func(sizeof(double*));
+    (*unit_readings)[0] = (double*)lib_malloc_func(sizeof(double) * g_num_of_units);
+    for (size_t i = 0; i < g_num_of_units; ++i)
+        (*unit_readings)[0][i] = 10 + (i * 7 + round * 13) % 5;
+    *readings = (double*)lib_malloc_func(sizeof(double));
+    (*readings)[0] = 10 + (round * 11) % 3;
+    *round_duration = 1000000000LL;
+    ++g_round;
+    return 0;
+}
+
+static bool post_workload_hook(pilot_workload_t* wl) {
+    return g_round < g_num_of_rounds;
+}
+
+/**
+ * \brief Run a session and return the average time spent per round
+ */
+static double run_session(pilot_log_level_t in_mem_log_level) {
+    pilot_set_in_mem_log_level(in_mem_log_level);
+    g_round = 0;
+    pilot_workload_t *wl = pilot_new_workload("Logging overhead");
+    pilot_set_num_of_pi(wl, 1);
+    pilot_set_pi_info(wl, 0, "PI", "unit", NULL, NULL, true, true);
+    pilot_set_short_round_detection_threshold(wl, 0);
+    pilot_set_warm_up_removal_method(wl, NO_WARM_UP_REMOVAL);
+    pilot_set_workload_func(wl, &mock_workload_func);
+    pilot_set_hook_func(wl, POST_WORKLOAD_RUN, &post_workload_hook);
+    pilot_set_min_sample_size(wl, 100000);
+
+    auto start = chrono::steady_clock::now();
+    pilot_run_workload(wl);
+    chrono::duration<double, micro> d = chrono::steady_clock::now() - start;
+    pilot_destroy_workload(wl);
+    return d.count() / g_num_of_rounds;
+}
+
+int main(int argc, char **argv) {
+    PILOT_LIB_SELF_CHECK;
+    // we measure at lv_info without the cost of writing to the terminal
+    pilot_set_log_level(lv_info);
+    pilot_remove_console_log_sink();
+
+    const pilot_log_level_t levels[] = {lv_trace, lv_debug, lv_info, lv_warning};
+    const char *level_names[] = {"trace", "debug", "info", "warning"};
+    cout << "console log level: info, rounds per session: " << g_num_of_rounds << endl;
+    cout << "in-mem log level | us per round" << endl;
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); ++i) {
+        // warm up once, then report the average of three sessions
+        run_session(levels[i]);
+        double us = 0;
+        for (int k = 0; k < 3; ++k)
+            us += run_session(levels[i]);
+        cout << setw(16) << left << level_names[i] << " | " << fixed << setprecision(1)
+             << us / 3 << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ * unit_test_benchmark_api.cc
+ *
+ * Copyright (c) 2017-2019 Yan Li <yanli@tuneup.ai>. All rights reserved.
+ * The Pilot tool and library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 (not any other version) as published by the Free
+ * Software Foundation.
+ *
+ * The Pilot tool and library is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program in file lgpl-2.1.txt; if not, see
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ *
+ * Commit 033228934e11b3f86fb0a4932b54b2aeea5c803c and before were
+ * released with the following license:
+ * Copyright (c) 2015, 2016, University of California, Santa Cruz, CA, USA.
+ * Created by Yan Li <yanli@tuneup.ai>,
+ * Department of Computer Science, Baskin School of Engineering.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Storage Systems Research Center, the
+ *       University of California, nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OF THE UNIVERSITY OF CALIFORNIA BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gtest/gtest.h"
+#include "pilot/pilot_benchmark.hpp"
+#include <vector>
+
+using namespace pilot;
+using namespace std;
+
+static benchmark_options quiet_short_options() {
+    benchmark_options opts;
+    opts.log_level = lv_fatal;
+    opts.short_round_detection_threshold = 0;
+    opts.init_work_amount = 100;
+    opts.work_amount_limit = 100;
+    opts.export_results = false;
+    opts.customize = [](pilot_workload_t *wl) {
+        pilot_set_min_sample_size(wl, 0);
+        pilot_set_required_confidence_interval(wl, 0.5, -1);
+    };
+    return opts;
+}
+
+TEST(BenchmarkAPITest, LambdaWithSetupAndTeardown) {
+    vector<int> data;
+    size_t calls = 0, setups = 0, teardowns = 0;
+    int sum = 0;
+    benchmark_options opts = quiet_short_options();
+    opts.setup = [&](size_t round, size_t work_amount) {
+        ASSERT_EQ(setups, round);
+        ++setups;
+        data.assign(1000, 1);
+    };
+    opts.teardown = [&](size_t round, size_t work_amount) {
+        ++teardowns;
+        data.clear();
+    };
+    int num_of_rounds = 0;
+    size_t num_of_unit_readings = 0;
+    opts.on_finished = [&](const pilot_workload_t *wl, int wl_res) {
+        num_of_rounds = pilot_get_num_of_rounds(wl);
+        for (int r = 0; r < num_of_rounds; ++r) {
+            size_t n;
+            const double *ur = pilot_get_pi_unit_readings(wl, 0, r, &n);
+            for (size_t i = 0; i < n; ++i)
+                ASSERT_LE(0, ur[i]);
+            num_of_unit_readings += n;
+        }
+    };
+
+    ASSERT_EQ(0, benchmark("lambda", [&] {
+        ++calls;
+        for (int v : data) sum += v;
+        do_not_optimize(sum);
+    }, opts));
+    ASSERT_LT(0, num_of_rounds);
+    ASSERT_EQ(size_t(num_of_rounds), setups);
+    ASSERT_EQ(setups, teardowns);
+    ASSERT_EQ(calls, num_of_unit_readings);
+    ASSERT_EQ(int(calls * 1000), sum);
+}
+
+static int g_func_calls = 0;
+static int failing_func() {
+    return ++g_func_calls == 10 ? 1 : 0;
+}
+
+TEST(BenchmarkAPITest, FunctionReturningError) {
+    ASSERT_EQ(ERR_WL_FAIL, benchmark("failing", failing_func, quiet_short_options()));
+    ASSERT_EQ(10, g_func_calls);
+}
+
+TEST(BenchmarkAPITest, ErrorLeavesNoUninitializedUnitReadings) {
+    int calls = 0;
+    auto func = [&] { return ++calls == 3 ? 1 : 0; };
+    benchmark_options opts;
+    _benchmark_context<decltype(func)> ctx{func, opts};
+    size_t num_of_work_unit;
+    double **unit_readings = NULL;
+    double *readings = NULL;
+    nanosecond_type round_duration;
+    ASSERT_EQ(1, _benchmark_workload_func<decltype(func)>(NULL, 0, 10, &malloc, &num_of_work_unit,
+                                                         &unit_readings, &readings, &round_duration, &ctx));
+    ASSERT_EQ(3U, num_of_work_unit);
+    for (size_t i = 3; i < 10; ++i)
+        ASSERT_EQ(0, unit_readings[0][i]);
+    free(unit_readings[0]);
+    free(unit_readings);
+}
+
+int main(int argc, char **argv) {
+    PILOT_LIB_SELF_CHECK;
+    pilot_set_log_level(lv_fatal);
+
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
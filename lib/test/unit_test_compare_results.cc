@@ -48,8 +48,11 @@
  * OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "common.h"
 #include "gtest/gtest.h"
+#include <memory>
 #include "pilot/libpilot.h"
+#include <vector>
 
 using namespace pilot;
 using namespace std;
@@ -105,6 +108,72 @@ TEST(PilotUnitCompareResults, LoadBaselineFromFile) {
     pilot_destroy_workload(wl);
 }
 
+/**
+ * Import rounds of 50 unit readings with the given mean and a standard
+ * deviation of 0.1 until the comparison against a baseline of mean 1.0
+ * stops asking for more rounds
+ * @return the number of rounds, or 100 if the comparison didn't stop
+ */
+static size_t run_comparison(pilot_comparison_method_t method, double mean,
+                             pilot_comparison_decision_t *decision) {
+    shared_ptr<pilot_workload_t> wl(pilot_new_workload("Test compare results"), pilot_destroy_workload);
+    pilot_set_num_of_pi(wl.get(), 1);
+    pilot_set_work_amount_limit(wl.get(), 1000);
+    pilot_set_warm_up_removal_method(wl.get(), NO_WARM_UP_REMOVAL);
+    pilot_set_short_round_detection_threshold(wl.get(), 1);
+    pilot_set_baseline(wl.get(), 0, UNIT_READING_TYPE, 1.0, 1000, 0.01);
+    EXPECT_EQ(0, pilot_set_comparison_method(wl.get(), method));
+    uint64_t r = 42;
+    size_t round;
+    for (round = 0; round < 100; ++round) {
+        vector<double> urs;
+        for (size_t i = 0; i < 50; ++i) {
+            double sum = 0;
+            for (int j = 0; j < 12; ++j) {
+                r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+                sum += double(r >> 11) / double(1ULL << 53);
+            }
+            urs.push_back(mean + 0.1 * (sum - 6));
+        }
+        const double *ur_ptrs[] = {urs.data()};
+        pilot_import_benchmark_results(wl.get(), round, 50, 2 * ONE_SECOND, NULL, urs.size(), ur_ptrs);
+        size_t wa;
+        if (!calc_next_round_work_amount_for_comparison(wl.get(), &wa)) break;
+    }
+    EXPECT_EQ(0, pilot_get_comparison_result(wl.get(), 0, decision));
+    return round + 1;
+}
+
+TEST(PilotUnitCompareResults, SequentialComparison) {
+    pilot_comparison_decision_t decision;
+    // a clear difference (10%) is found after a few looks, before the fixed
+    // sample size (200 unit readings) is reached
+    size_t fixed_rounds = run_comparison(FIXED_SAMPLE_SIZE_COMPARISON, 1.1, &decision);
+    ASSERT_EQ(COMPARISON_HIGHER, decision);
+    size_t sequential_rounds = run_comparison(SEQUENTIAL_COMPARISON, 1.1, &decision);
+    ASSERT_EQ(COMPARISON_HIGHER, decision);
+    ASSERT_LT(sequential_rounds, fixed_rounds);
+    ASSERT_EQ(COMPARISON_LOWER, (run_comparison(SEQUENTIAL_COMPARISON, 0.9, &decision), decision));
+
+    // the fixed sample size method can't tell anything when the means are
+    // equal, while the sequential method shows equivalence
+    run_comparison(FIXED_SAMPLE_SIZE_COMPARISON, 1.0, &decision);
+    ASSERT_EQ(COMPARISON_UNDECIDED, decision);
+    sequential_rounds = run_comparison(SEQUENTIAL_COMPARISON, 1.0, &decision);
+    ASSERT_EQ(COMPARISON_EQUIVALENT, decision);
+    ASSERT_GT(size_t(20), sequential_rounds);
+
+    // a difference (2%) within the margin (5%) is equivalent
+    run_comparison(SEQUENTIAL_COMPARISON, 1.02, &decision);
+    ASSERT_EQ(COMPARISON_EQUIVALENT, decision);
+
+    shared_ptr<pilot_workload_t> wl(pilot_new_workload("Test compare results"), pilot_destroy_workload);
+    pilot_set_num_of_pi(wl.get(), 1);
+    ASSERT_EQ(ERR_WRONG_PARAM, pilot_set_comparison_method(wl.get(), SEQUENTIAL_COMPARISON, 0));
+    ASSERT_EQ(ERR_NOT_INIT, pilot_get_comparison_result(wl.get(), 0, &decision));
+    ASSERT_EQ(ERR_WRONG_PARAM, pilot_get_comparison_result(wl.get(), 1, &decision));
+}
+
 int main(int argc, char **argv) {
     if (argc < 2) {
         cout << "Usage: " << argv[0] << " test_data_file" << endl;
@@ -0,0 +1,308 @@
+/*
+ * unit_test_journal.cc: unit tests for the round journal and session resuming
+ *
+ * Copyright (c) 2017-2019 Yan Li <yanli@tuneup.ai>. All rights reserved.
+ * The Pilot tool and library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 (not any other version) as published by the Free
+ * Software Foundation.
+ *
+ * The Pilot tool and library is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program in file lgpl-2.1.txt; if not, see
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ *
+ * Commit 033228934e11b3f86fb0a4932b54b2aeea5c803c and before were
+ * released with the following license:
+ * Copyright (c) 2015, 2016, University of California, Santa Cruz, CA, USA.
+ * Created by Yan Li <yanli@tuneup.ai>,
+ * Department of Computer Science, Baskin School of Engineering.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Storage Systems Research Center, the
+ *       University of California, nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OF THE UNIVERSITY OF CALIFORNIA BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "common.h"
+#include <cstdio>
+#include <fstream>
+#include "gtest/gtest.h"
+#include "pilot/libpilot.h"
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <vector>
+
+using namespace pilot;
+using namespace std;
+
+static const char *g_journal_file = "/tmp/unit_test_journal.journal";
+static const size_t g_num_of_pi = 2;
+
+/**
+ * Import round r with deterministic data into wl
+ */
+static void import_round(pilot_workload_t *wl, size_t r) {
+    vector<double> readings {100.0 + r, 200.0 + 2 * r};
+    vector<vector<double> > urs(g_num_of_pi);
+    for (size_t i = 0; i < 20 + r; ++i) {
+        urs[0].push_back(i < 3 ? 50 : 10 + (i + r) % 3);
+        urs[1].push_back(20 + (i * 7 + r) % 5);
+    }
+    const double *ur_ptrs[] = {urs[0].data(), urs[1].data()};
+    pilot_import_benchmark_results(wl, r, 10 * (r + 1), (r + 1) * ONE_SECOND,
+                                   readings.data(), urs[0].size(), ur_ptrs);
+}
+
+static pilot_workload_t* new_workload(pilot_warm_up_removal_detection_method_t m) {
+    pilot_workload_t *wl = pilot_new_workload("journal test");
+    pilot_set_num_of_pi(wl, g_num_of_pi);
+    pilot_set_short_round_detection_threshold(wl, 0);
+    pilot_set_warm_up_removal_method(wl, m);
+    pilot_set_warm_up_removal_percentage(wl, 0.2);
+    return wl;
+}
+
+static void expect_same_data(const pilot_workload_t *a, const pilot_workload_t *b) {
+    const int rounds = pilot_get_num_of_rounds(a);
+    ASSERT_EQ(rounds, pilot_get_num_of_rounds(b));
+    for (size_t piid = 0; piid < g_num_of_pi; ++piid) {
+        ASSERT_EQ(pilot_get_total_num_of_unit_readings(a, piid),
+                  pilot_get_total_num_of_unit_readings(b, piid));
+        const double *ra = pilot_get_pi_readings(a, piid);
+        const double *rb = pilot_get_pi_readings(b, piid);
+        for (int r = 0; r < rounds; ++r) {
+            ASSERT_EQ(ra[r], rb[r]);
+            size_t na, nb;
+            const double *ua = pilot_get_pi_unit_readings(a, piid, r, &na);
+            const double *ub = pilot_get_pi_unit_readings(b, piid, r, &nb);
+            ASSERT_EQ(na, nb);
+            ASSERT_EQ(vector<double>(ua, ua + na), vector<double>(ub, ub + nb));
+        }
+    }
+    pilot_analytical_result_t *ara = pilot_analytical_result(a);
+    pilot_analytical_result_t *arb = pilot_analytical_result(b);
+    for (size_t piid = 0; piid < g_num_of_pi; ++piid) {
+        ASSERT_DOUBLE_EQ(ara->readings_mean[piid], arb->readings_mean[piid]);
+        ASSERT_EQ(ara->unit_readings_num[piid], arb->unit_readings_num[piid]);
+        if (0 == ara->unit_readings_num[piid]) continue;
+        ASSERT_DOUBLE_EQ(ara->unit_readings_mean[piid], arb->unit_readings_mean[piid]);
+        ASSERT_DOUBLE_EQ(ara->unit_readings_var[piid], arb->unit_readings_var[piid]);
+    }
+    pilot_free_analytical_result(ara);
+    pilot_free_analytical_result(arb);
+}
+
+TEST(PilotJournal, LoadRestoresRounds) {
+    pilot_workload_t *wl = new_workload(FIXED_PERCENTAGE);
+    import_round(wl, 0);
+    // rounds that exist before the journal is set are written too
+    ASSERT_EQ(0, pilot_set_journal(wl, g_journal_file, 2));
+    for (size_t r = 1; r < 5; ++r)
+        import_round(wl, r);
+    // replacing a round is journaled as well
+    import_round(wl, 2);
+    ASSERT_EQ(0, pilot_set_journal(wl, NULL));
+
+    // the loading workload uses a different warm-up removal method to
+    // show that the stored warm-up detection results are used
+    pilot_workload_t *loaded = new_workload(NO_WARM_UP_REMOVAL);
+    ASSERT_EQ(0, pilot_load_journal(loaded, g_journal_file));
+    expect_same_data(wl, loaded);
+
+    // loading requires a workload without rounds
+    pilot_set_log_level(lv_fatal);
+    ASSERT_EQ(ERR_WRONG_PARAM, pilot_load_journal(loaded, g_journal_file));
+    pilot_set_log_level(lv_warning);
+
+    // new rounds are appended to the loaded journal
+    pilot_set_warm_up_removal_method(loaded, FIXED_PERCENTAGE);
+    import_round(loaded, 5);
+    import_round(wl, 5);
+    ASSERT_EQ(0, pilot_set_journal(loaded, NULL));
+    pilot_workload_t *reloaded = new_workload(EDM);
+    ASSERT_EQ(0, pilot_load_journal(reloaded, g_journal_file));
+    expect_same_data(wl, reloaded);
+
+    pilot_destroy_workload(reloaded);
+    pilot_destroy_workload(loaded);
+    pilot_destroy_workload(wl);
+}
+
+TEST(PilotJournal, TornRecordIsDiscarded) {
+    pilot_workload_t *wl = new_workload(FIXED_PERCENTAGE);
+    ASSERT_EQ(0, pilot_set_journal(wl, g_journal_file));
+    for (size_t r = 0; r < 3; ++r)
+        import_round(wl, r);
+    ASSERT_EQ(0, pilot_set_journal(wl, NULL));
+    struct stat st;
+    ASSERT_EQ(0, stat(g_journal_file, &st));
+    const off_t good_size = st.st_size;
+
+    // simulate a crash in the middle of writing a record
+    {
+        ofstream f(g_journal_file, ios::binary | ios::app);
+        const char partial[] = {64, 0, 0, 0, 1, 2, 3, 4, 5, 6};
+        f.write(partial, sizeof(partial));
+    }
+    pilot_set_log_level(lv_error);
+    pilot_workload_t *loaded = new_workload(FIXED_PERCENTAGE);
+    ASSERT_EQ(0, pilot_load_journal(loaded, g_journal_file));
+    pilot_set_log_level(lv_warning);
+    expect_same_data(wl, loaded);
+    ASSERT_EQ(0, stat(g_journal_file, &st));
+    ASSERT_EQ(good_size, st.st_size);
+
+    pilot_destroy_workload(loaded);
+    pilot_destroy_workload(wl);
+}
+
+TEST(PilotJournal, FailedAppendLeavesNoTornRecord) {
+    pilot_workload_t *wl = new_workload(FIXED_PERCENTAGE);
+    ASSERT_EQ(0, pilot_set_journal(wl, g_journal_file));
+    for (size_t r = 0; r < 2; ++r)
+        import_round(wl, r);
+    struct stat st;
+    ASSERT_EQ(0, stat(g_journal_file, &st));
+
+    // limit the file size so that the next record is only partially written
+    struct rlimit old_limit, limit;
+    ASSERT_EQ(0, getrlimit(RLIMIT_FSIZE, &old_limit));
+    limit = old_limit;
+    limit.rlim_cur = st.st_size + 16;
+    signal(SIGXFSZ, SIG_IGN);
+    ASSERT_EQ(0, setrlimit(RLIMIT_FSIZE, &limit));
+    pilot_set_log_level(lv_fatal);
+    import_round(wl, 2);
+    pilot_set_log_level(lv_warning);
+    ASSERT_EQ(0, setrlimit(RLIMIT_FSIZE, &old_limit));
+    signal(SIGXFSZ, SIG_DFL);
+
+    const off_t good_size = st.st_size;
+    ASSERT_EQ(0, stat(g_journal_file, &st));
+    ASSERT_EQ(good_size, st.st_size);
+
+    // records appended after the failed one must survive a reload
+    import_round(wl, 2);
+    import_round(wl, 3);
+    ASSERT_EQ(0, pilot_set_journal(wl, NULL));
+    pilot_workload_t *loaded = new_workload(FIXED_PERCENTAGE);
+    ASSERT_EQ(0, pilot_load_journal(loaded, g_journal_file));
+    expect_same_data(wl, loaded);
+
+    pilot_destroy_workload(loaded);
+    pilot_destroy_workload(wl);
+}
+
+TEST(PilotJournal, RejectsMismatchedFiles) {
+    pilot_workload_t *wl = new_workload(FIXED_PERCENTAGE);
+    ASSERT_EQ(0, pilot_set_journal(wl, g_journal_file));
+    import_round(wl, 0);
+    ASSERT_EQ(0, pilot_set_journal(wl, NULL));
+
+    pilot_set_log_level(lv_fatal);
+    pilot_workload_t *other = pilot_new_workload("journal test");
+    pilot_set_num_of_pi(other, g_num_of_pi + 1);
+    ASSERT_EQ(ERR_WRONG_PARAM, pilot_load_journal(other, g_journal_file));
+    ASSERT_EQ(0, pilot_get_num_of_rounds(other));
+    pilot_destroy_workload(other);
+    other = new_workload(FIXED_PERCENTAGE);
+
+    {
+        ofstream f(g_journal_file, ios::binary | ios::trunc);
+        f << "this is not a journal";
+    }
+    ASSERT_EQ(ERR_IO, pilot_load_journal(other, g_journal_file));
+    ASSERT_EQ(ERR_IO, pilot_load_journal(other, "/nonexistent/unit_test_journal.journal"));
+    pilot_set_log_level(lv_warning);
+
+    pilot_destroy_workload(other);
+    pilot_destroy_workload(wl);
+    remove(g_journal_file);
+}
+
+static size_t g_rounds_to_run;
+
+static int mock_workload_func(const pilot_workload_t *wl,
+                              size_t round,
+                              size_t total_work_amount,
+                              pilot_malloc_func_t *lib_malloc_func,
+                              size_t *num_of_work_unit,
+                              double ***unit_readings,
+                              double **readings,
+                              nanosecond_type *round_duration, void *data) {
+    *num_of_work_unit = 0;
+    *readings = (double*)lib_malloc_func(sizeof(double) * g_num_of_pi);
+    for (size_t piid = 0; piid < g_num_of_pi; ++piid)
+        (*readings)[piid] = 10 * (piid + 1) + round % 4;
+    *round_duration = ONE_SECOND;
+    return 0;
+}
+
+static bool post_workload_hook(pilot_workload_t* wl) {
+    return size_t(pilot_get_num_of_rounds(wl)) < g_rounds_to_run;
+}
+
+TEST(PilotJournal, ResumeWorkload) {
+    pilot_workload_t *wl = new_workload(NO_WARM_UP_REMOVAL);
+    pilot_set_work_amount_limit(wl, 100);
+    pilot_set_workload_func(wl, &mock_workload_func);
+    pilot_set_hook_func(wl, POST_WORKLOAD_RUN, &post_workload_hook);
+    ASSERT_EQ(0, pilot_set_journal(wl, g_journal_file, 3));
+    g_rounds_to_run = 4;
+    ASSERT_EQ(ERR_STOPPED_BY_HOOK, pilot_run_workload(wl));
+    ASSERT_EQ(4, pilot_get_num_of_rounds(wl));
+    pilot_destroy_workload(wl);
+
+    pilot_workload_t *resumed = new_workload(NO_WARM_UP_REMOVAL);
+    pilot_set_work_amount_limit(resumed, 100);
+    pilot_set_workload_func(resumed, &mock_workload_func);
+    pilot_set_hook_func(resumed, POST_WORKLOAD_RUN, &post_workload_hook);
+    g_rounds_to_run = 7;
+    ASSERT_EQ(ERR_STOPPED_BY_HOOK, pilot_resume_workload(resumed, g_journal_file));
+    ASSERT_EQ(7, pilot_get_num_of_rounds(resumed));
+    // the round IDs continue from where the journal ends
+    const double *readings = pilot_get_pi_readings(resumed, 0);
+    for (size_t r = 0; r < 7; ++r)
+        ASSERT_EQ(10 + r % 4, readings[r]);
+
+    pilot_workload_t *loaded = new_workload(NO_WARM_UP_REMOVAL);
+    ASSERT_EQ(0, pilot_load_journal(loaded, g_journal_file));
+    expect_same_data(resumed, loaded);
+
+    pilot_destroy_workload(loaded);
+    pilot_destroy_workload(resumed);
+    remove(g_journal_file);
+}
+
+int main(int argc, char **argv) {
+    PILOT_LIB_SELF_CHECK;
+    pilot_set_log_level(lv_warning);
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -48,9 +48,21 @@
  * OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <cmath>
 #include <common.h>
+#include <cstdio>
+#include <dirent.h>
+#include <fcntl.h>
 #include "gtest/gtest.h"
+#include "libpilotcpp.h"
+#include "log_ring.hpp"
+#include "perf_counters.hpp"
 #include "pilot/libpilot.h"
+#include <sstream>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 using namespace pilot;
 using namespace std;
@@ -114,6 +126,156 @@ TEST(MiscUnitTests, TestFindLastLines) {
     ASSERT_EQ("3:[2016-08-16 15:56:38] <debug> Reading data from unit_test_analyze_input_3col_with_malformed_header.csv\n", sstream_get_last_lines(ss, 100));
 }
 
+static string get_last_log_lines(size_t n) {
+    shared_ptr<const char> p(pilot_get_last_log_lines(n), [](const char *p){ pilot_free((void*)p); });
+    return string(p.get());
+}
+
+static bool ends_with(const string &s, const string &suffix) {
+    return s.size() >= suffix.size() &&
+           0 == s.compare(s.size() - suffix.size(), suffix.size(), suffix);
+}
+
+TEST(MiscUnitTests, TestInMemLogRing) {
+    const char *spill_dir = "/tmp/unit_test_misc_log_ring";
+    mkdir(spill_dir, 0777);
+    remove((string(spill_dir) + "/session_log_evicted.txt").c_str());
+    remove((string(spill_dir) + "/session_log_evicted.txt.gz").c_str());
+    // a small ring so most records get evicted
+    ASSERT_EQ(0, pilot_set_log_buffer(4096, spill_dir));
+    for (int i = 0; i < 1000; ++i) {
+        info_log << "log ring test line " << i;
+    }
+    string s = get_last_log_lines(1);
+    ASSERT_TRUE(ends_with(s, "log ring test line 999\n")) << s;
+    ASSERT_EQ(1, count(s.begin(), s.end(), '\n'));
+    s = get_last_log_lines(3);
+    ASSERT_EQ(3, count(s.begin(), s.end(), '\n'));
+    ASSERT_NE(string::npos, s.find("log ring test line 997\n"));
+    ASSERT_TRUE(ends_with(s, "log ring test line 999\n")) << s;
+
+    // a record that is longer than one slot
+    string long_msg(1000, 'x');
+    info_log << long_msg;
+    s = get_last_log_lines(1);
+    ASSERT_TRUE(ends_with(s, long_msg + "\n"));
+    ASSERT_EQ(1, count(s.begin(), s.end(), '\n'));
+
+    ASSERT_EQ(0, pilot_set_log_buffer(4096, NULL));
+    struct stat st;
+    ASSERT_TRUE(0 == stat((string(spill_dir) + "/session_log_evicted.txt").c_str(), &st) ||
+                0 == stat((string(spill_dir) + "/session_log_evicted.txt.gz").c_str(), &st));
+    ASSERT_LT(0, st.st_size);
+    ASSERT_EQ("", get_last_log_lines(1));
+    ASSERT_EQ(ERR_WRONG_PARAM, pilot_set_log_buffer(0, NULL));
+}
+
+TEST(MiscUnitTests, TestLogRingEmptyUntilFirstAppend) {
+    pilot_log_ring_t ring(4096);
+    ASSERT_EQ("", ring.last_lines(1));
+    stringstream ss;
+    ring.drain(ss);
+    ASSERT_EQ("", ss.str());
+
+    ring.append("first line\n");
+    ASSERT_EQ("first line\n", ring.last_lines(1));
+    ring.reset(8192);
+    ASSERT_EQ("", ring.last_lines(1));
+    ring.append("second line\n");
+    // copy() keeps the records
+    ring.copy(ss);
+    ASSERT_EQ("second line\n", ss.str());
+    ss.str(string());
+    ring.drain(ss);
+    ASSERT_EQ("second line\n", ss.str());
+    ss.str(string());
+    ring.copy(ss);
+    ASSERT_EQ("", ss.str());
+}
+
+TEST(MiscUnitTests, TestInMemLogRingConcurrentWriters) {
+    ASSERT_EQ(0, pilot_set_log_buffer(64 * 1024, NULL));
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < 2000; ++i)
+                info_log << "thread " << t << " line " << i;
+        });
+    }
+    for (auto &th : threads) th.join();
+    string s = get_last_log_lines(50);
+    ASSERT_EQ(50, count(s.begin(), s.end(), '\n'));
+    // every line must be intact
+    size_t begin = 0, end;
+    while (string::npos != (end = s.find('\n', begin))) {
+        string line = s.substr(begin, end - begin);
+        ASSERT_NE(string::npos, line.find("<info> thread ")) << line;
+        begin = end + 1;
+    }
+    ASSERT_EQ(0, pilot_set_log_buffer(16 * 1024 * 1024, NULL));
+}
+
+static int g_perf_calls = 0;
+
+// Replace the fds of the performance counters with /dev/null in the second
+// call, so that all later reads of the counters fail
+static int break_perf_counters_in_second_call(void) {
+    if (2 != ++g_perf_calls) return 0;
+    int null_fd = open("/dev/null", O_RDONLY);
+    DIR *dir = opendir("/proc/self/fd");
+    while (struct dirent *e = readdir(dir)) {
+        char link[64];
+        ssize_t n = readlinkat(dirfd(dir), e->d_name, link, sizeof(link) - 1);
+        if (n <= 0) continue;
+        link[n] = '\0';
+        if (0 == strcmp(link, "anon_inode:[perf_event]"))
+            dup2(null_fd, atoi(e->d_name));
+    }
+    closedir(dir);
+    close(null_fd);
+    return 0;
+}
+
+TEST(MiscUnitTests, SimpleRunnerCounterReadFailure) {
+    pilot_perf_counters_t counters;
+    // nothing to test if the system has no performance counter
+    if (0 == counters.open()) return;
+    shared_ptr<pilot_workload_t> wl(pilot_new_workload("perf"), pilot_destroy_workload);
+    const size_t num_of_pi = 1 + counters.size();
+    pilot_set_num_of_pi(wl.get(), num_of_pi);
+    _simple_runner_data_t rd = {break_perf_counters_in_second_call, &counters, -1, false};
+
+    size_t num_of_work_unit;
+    double **unit_readings = NULL;
+    double *readings = NULL;
+    nanosecond_type round_duration = 0;
+    ASSERT_EQ(0, _simple_workload_func_runner(wl.get(), 0, 4, &malloc, &num_of_work_unit,
+                                              &unit_readings, &readings, &round_duration, &rd));
+    ASSERT_TRUE(rd.read_failed);
+    ASSERT_EQ(4U, num_of_work_unit);
+    // the counter PIs get no data from the round, and the duration only gets
+    // its unit readings
+    ASSERT_TRUE(NULL == readings);
+    for (size_t i = 0; i < 4; ++i)
+        ASSERT_LE(0, unit_readings[0][i]);
+    for (size_t piid = 1; piid < num_of_pi; ++piid)
+        ASSERT_TRUE(NULL == unit_readings[piid]);
+
+    // which the library takes as no unit readings of those PIs
+    pilot_import_benchmark_results(wl.get(), 0, 4, round_duration, readings, num_of_work_unit, unit_readings);
+    size_t n;
+    ASSERT_TRUE(NULL != pilot_get_pi_unit_readings(wl.get(), 0, 0, &n));
+    ASSERT_EQ(4U, n);
+    for (size_t piid = 1; piid < num_of_pi; ++piid) {
+        pilot_get_pi_unit_readings(wl.get(), piid, 0, &n);
+        ASSERT_EQ(0U, n);
+    }
+
+    for (size_t piid = 0; piid < num_of_pi; ++piid)
+        free(unit_readings[piid]);
+    free(unit_readings);
+}
+
 int main(int argc, char **argv) {
     PILOT_LIB_SELF_CHECK;
     // we only display fatals because errors are expected in some test cases
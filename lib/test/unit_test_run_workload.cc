@@ -50,9 +50,14 @@
 
 #include <algorithm>
 #include <cmath>
+#include "common.h"
 #include <cstring>
+#include <cstdio>
+#include <fstream>
 #include "gtest/gtest.h"
 #include "pilot/libpilot.h"
+#include <random>
+#include <string>
 #include <vector>
 
 using namespace pilot;
@@ -207,10 +212,537 @@ TEST(PilotRunWorkloadTest, RunWorkload) {
     pilot_destroy_workload(wl);
 }
 
+TEST(PilotRunWorkloadTest, AnalyticalResultIsRefreshedOnDemand) {
+    // wls[0] refreshes parts of its analytical result between rounds when
+    // calculating the next work amount, while wls[1] only refreshes it in
+    // the end. Both must get the same result.
+    pilot_set_log_level(lv_warning);
+    pilot_workload_t *wls[2];
+    for (auto &wl : wls) {
+        wl = pilot_new_workload("Test workload");
+        pilot_set_num_of_pi(wl, 2);
+        pilot_set_short_round_detection_threshold(wl, 0);
+        pilot_set_warm_up_removal_method(wl, NO_WARM_UP_REMOVAL);
+        pilot_set_min_sample_size(wl, 0);
+        pilot_set_required_confidence_interval(wl, 0.1, -1);
+    }
+    minstd_rand rng(7);
+    normal_distribution<double> noise(0, 1);
+    size_t wa;
+    for (size_t round = 0; round < 30; ++round) {
+        vector<double> readings {10 + noise(rng), 20 + noise(rng)};
+        vector<vector<double> > urs(2);
+        for (int i = 0; i < 30; ++i) {
+            urs[0].push_back(5 + noise(rng));
+            urs[1].push_back(50 + noise(rng));
+        }
+        const double *ur_ptrs[] = {urs[0].data(), urs[1].data()};
+        for (auto wl : wls)
+            pilot_import_benchmark_results(wl, round, 100, ONE_SECOND, readings.data(), 30, ur_ptrs);
+        pilot_next_round_work_amount(wls[0], &wa);
+    }
+    // replacing a round must invalidate the results calculated from it
+    vector<double> readings {30, 40};
+    vector<double> urs(30, 15);
+    const double *ur_ptrs[] = {urs.data(), urs.data()};
+    for (auto wl : wls)
+        pilot_import_benchmark_results(wl, 3, 100, ONE_SECOND, readings.data(), 30, ur_ptrs);
+    pilot_next_round_work_amount(wls[0], &wa);
+
+    pilot_analytical_result_t *ar0 = pilot_analytical_result(wls[0]);
+    pilot_analytical_result_t *ar1 = pilot_analytical_result(wls[1]);
+    for (size_t piid = 0; piid < 2; ++piid) {
+        ASSERT_EQ(size_t(30), ar0->readings_num[piid]);
+        ASSERT_EQ(ar1->readings_mean[piid], ar0->readings_mean[piid]);
+        ASSERT_EQ(ar1->readings_var[piid], ar0->readings_var[piid]);
+        ASSERT_EQ(ar1->readings_required_sample_size[piid], ar0->readings_required_sample_size[piid]);
+        ASSERT_EQ(size_t(900), ar0->unit_readings_num[piid]);
+        ASSERT_EQ(ar1->unit_readings_mean[piid], ar0->unit_readings_mean[piid]);
+        ASSERT_EQ(ar1->unit_readings_var[piid], ar0->unit_readings_var[piid]);
+        ASSERT_EQ(ar1->unit_readings_required_sample_size[piid], ar0->unit_readings_required_sample_size[piid]);
+    }
+
+    // a narrower required CI needs more samples
+    pilot_set_required_confidence_interval(wls[0], 0.01, -1);
+    pilot_analytical_result(wls[0], ar0);
+    ASSERT_LT(ar1->readings_required_sample_size[0], ar0->readings_required_sample_size[0]);
+    ASSERT_LT(ar1->unit_readings_required_sample_size[0], ar0->unit_readings_required_sample_size[0]);
+
+    pilot_free_analytical_result(ar0);
+    pilot_free_analytical_result(ar1);
+    for (auto wl : wls)
+        pilot_destroy_workload(wl);
+}
+
 TEST(PilotRunWorkloadTest, ChangingNumberOfReadings) {
     //! TODO: Changing number of readings after running the first round of workload is not allowed.
 }
 
+static size_t g_ab_rounds = 0;          //! rounds run by both variants so far
+static minstd_rand g_ab_rng;
+
+/**
+ * A workload whose unit readings drift upward by 2% every round no matter
+ * which variant runs, which is much larger than the difference between the
+ * variants. data points to the offset of the variant.
+ */
+int mock_drifting_workload_func(const pilot_workload_t *wl,
+                                size_t round,
+                                size_t total_work_amount,
+                                pilot_malloc_func_t *lib_malloc_func,
+                                size_t *num_of_work_unit,
+                                double ***unit_readings,
+                                double **readings,
+                                nanosecond_type *round_duration, void *data) {
+    const double offset = *static_cast<double*>(data);
+    normal_distribution<double> noise(0, 0.05);
+    *num_of_work_unit = 20;
+    *unit_readings = (double**)lib_malloc_func(sizeof(double*));
+    (*unit_readings)[0] = (double*)lib_malloc_func(sizeof(double) * *num_of_work_unit);
+    for (size_t i = 0; i < *num_of_work_unit; ++i)
+        (*unit_readings)[0][i] = 1 + offset + 0.02 * g_ab_rounds + noise(g_ab_rng);
+    *readings = NULL;
+    ++g_ab_rounds;
+    return 0;
+}
+
+static pilot_workload_t* new_ab_workload(const char *name, double *offset) {
+    pilot_workload_t *wl = pilot_new_workload(name);
+    pilot_set_num_of_pi(wl, 1);
+    pilot_set_work_amount_limit(wl, 0);
+    pilot_set_short_round_detection_threshold(wl, 0);
+    pilot_set_workload_func(wl, mock_drifting_workload_func);
+    pilot_set_workload_data(wl, offset);
+    return wl;
+}
+
+TEST(PilotRunWorkloadTest, ABComparison) {
+    double offset_a = 0, offset_b = 0.05, offset_same = 0;
+    pilot_workload_t *wl_a = new_ab_workload("A", &offset_a);
+    pilot_workload_t *wl_b = new_ab_workload("B", &offset_b);
+    pilot_workload_t *wl_same = new_ab_workload("A'", &offset_same);
+    pilot_ab_result_t r;
+
+    ASSERT_EQ(ERR_WRONG_PARAM, pilot_run_ab_comparison(wl_a, wl_b, 1, &r));
+    ASSERT_EQ(ERR_WRONG_PARAM, pilot_run_ab_comparison(wl_a, wl_b, 0, &r, 0));
+    ASSERT_EQ(ERR_WRONG_PARAM, pilot_run_ab_comparison(wl_a, wl_a, 0, &r));
+
+    // The drift between two rounds is 0.02 while B is higher than A by 0.05,
+    // so the per-round means overlap heavily, but the paired differences
+    // don't.
+    g_ab_rng.seed(1);
+    ASSERT_EQ(0, pilot_run_ab_comparison(wl_a, wl_b, 0, &r, 50));
+    ASSERT_EQ(COMPARISON_HIGHER, r.decision);
+    ASSERT_LT(r.pairs, 20);
+    ASSERT_EQ(static_cast<int>(r.pairs), pilot_get_num_of_rounds(wl_a));
+    ASSERT_EQ(static_cast<int>(r.pairs), pilot_get_num_of_rounds(wl_b));
+    ASSERT_LT(r.ci_left, 0.05);
+    ASSERT_GT(r.ci_right, 0.05);
+    ASSERT_LT(r.p_value, 0.05);
+
+    // The same variant is equivalent to itself within the default 5% margin
+    g_ab_rng.seed(1);
+    pilot_set_comparison_method(wl_a, SEQUENTIAL_COMPARISON, 0.05);
+    ASSERT_EQ(0, pilot_run_ab_comparison(wl_a, wl_same, 0, &r, 50));
+    ASSERT_EQ(COMPARISON_EQUIVALENT, r.decision);
+    ASSERT_LT(r.ci_left, 0);
+    ASSERT_GT(r.ci_right, 0);
+
+    pilot_destroy_workload(wl_a);
+    pilot_destroy_workload(wl_b);
+    pilot_destroy_workload(wl_same);
+}
+
+/**
+ * A workload whose reading is always 1 + offset, where data points to the
+ * offset
+ */
+int mock_constant_workload_func(const pilot_workload_t *wl,
+                                size_t round,
+                                size_t total_work_amount,
+                                pilot_malloc_func_t *lib_malloc_func,
+                                size_t *num_of_work_unit,
+                                double ***unit_readings,
+                                double **readings,
+                                nanosecond_type *round_duration, void *data) {
+    *num_of_work_unit = 0;
+    *unit_readings = NULL;
+    *readings = (double*)lib_malloc_func(sizeof(double));
+    (*readings)[0] = 1 + *static_cast<double*>(data);
+    return 0;
+}
+
+/**
+ * A workload whose rounds have neither readings nor unit readings
+ */
+int mock_empty_workload_func(const pilot_workload_t *wl,
+                             size_t round,
+                             size_t total_work_amount,
+                             pilot_malloc_func_t *lib_malloc_func,
+                             size_t *num_of_work_unit,
+                             double ***unit_readings,
+                             double **readings,
+                             nanosecond_type *round_duration, void *data) {
+    *num_of_work_unit = 0;
+    *unit_readings = NULL;
+    *readings = NULL;
+    return 0;
+}
+
+static bool stop_hook(pilot_workload_t *wl) {
+    return pilot_get_num_of_rounds(wl) < 3;
+}
+
+TEST(PilotRunWorkloadTest, ABComparisonWithoutVariance) {
+    double offset_a = 0, offset_b = 0.5;
+    pilot_workload_t *wl_a = new_ab_workload("A", &offset_a);
+    pilot_workload_t *wl_b = new_ab_workload("B", &offset_b);
+    pilot_set_workload_func(wl_a, mock_constant_workload_func);
+    pilot_set_workload_func(wl_b, mock_constant_workload_func);
+    pilot_set_min_sample_size(wl_a, 5);
+    pilot_ab_result_t r;
+
+    // identical differences are not trusted before the minimum sample size
+    ASSERT_EQ(0, pilot_run_ab_comparison(wl_a, wl_b, 0, &r, 50));
+    ASSERT_EQ(COMPARISON_HIGHER, r.decision);
+    ASSERT_EQ(5, r.pairs);
+    ASSERT_DOUBLE_EQ(0.5, r.mean_diff);
+
+    // or before the last look
+    ASSERT_EQ(0, pilot_run_ab_comparison(wl_a, wl_b, 0, &r, 3));
+    ASSERT_EQ(COMPARISON_HIGHER, r.decision);
+    ASSERT_EQ(3, r.pairs);
+
+    // the hooks of the workloads are called
+    pilot_destroy_workload(wl_b);
+    wl_b = new_ab_workload("B", &offset_b);
+    pilot_set_workload_func(wl_b, mock_constant_workload_func);
+    pilot_set_hook_func(wl_b, POST_WORKLOAD_RUN, stop_hook);
+    ASSERT_EQ(ERR_STOPPED_BY_HOOK, pilot_run_ab_comparison(wl_a, wl_b, 0, &r, 50));
+    ASSERT_EQ(COMPARISON_UNDECIDED, r.decision);
+    ASSERT_EQ(3, pilot_get_num_of_rounds(wl_b));
+
+    pilot_destroy_workload(wl_a);
+    pilot_destroy_workload(wl_b);
+}
+
+/**
+ * A workload whose unit readings are normally distributed around
+ * 1 + offset, where data points to the offset
+ */
+int mock_noisy_workload_func(const pilot_workload_t *wl,
+                             size_t round,
+                             size_t total_work_amount,
+                             pilot_malloc_func_t *lib_malloc_func,
+                             size_t *num_of_work_unit,
+                             double ***unit_readings,
+                             double **readings,
+                             nanosecond_type *round_duration, void *data) {
+    const double offset = *static_cast<double*>(data);
+    normal_distribution<double> noise(0, 0.2);
+    *num_of_work_unit = 20;
+    *unit_readings = (double**)lib_malloc_func(sizeof(double*));
+    (*unit_readings)[0] = (double*)lib_malloc_func(sizeof(double) * *num_of_work_unit);
+    for (size_t i = 0; i < *num_of_work_unit; ++i)
+        (*unit_readings)[0][i] = 1 + offset + noise(g_ab_rng);
+    *readings = NULL;
+    return 0;
+}
+
+static vector<double> g_rejecting_readings;    //! the readings given by mock_rejecting_workload_func
+
+/**
+ * A workload whose first 3 rounds are rejected, e.g., timed out, so they have
+ * neither readings nor unit readings
+ */
+int mock_rejecting_workload_func(const pilot_workload_t *wl,
+                                 size_t round,
+                                 size_t total_work_amount,
+                                 pilot_malloc_func_t *lib_malloc_func,
+                                 size_t *num_of_work_unit,
+                                 double ***unit_readings,
+                                 double **readings,
+                                 nanosecond_type *round_duration, void *data) {
+    normal_distribution<double> noise(0, 0.5);
+    *num_of_work_unit = 0;
+    *unit_readings = NULL;
+    *readings = NULL;
+    if (round < 3) return 0;
+    *readings = (double*)lib_malloc_func(sizeof(double));
+    (*readings)[0] = 10 + noise(g_ab_rng);
+    g_rejecting_readings.push_back((*readings)[0]);
+    return 0;
+}
+
+static bool stop_after_100_rounds_hook(pilot_workload_t *wl) {
+    return pilot_get_num_of_rounds(wl) < 100;
+}
+
+static pilot_workload_t* new_workload_without_readings(const char *name, pilot_workload_func_t *func) {
+    pilot_workload_t *wl = pilot_new_workload(name);
+    pilot_set_num_of_pi(wl, 1);
+    pilot_set_short_round_detection_threshold(wl, 0);
+    pilot_set_warm_up_removal_method(wl, NO_WARM_UP_REMOVAL);
+    pilot_set_workload_func(wl, func);
+    pilot_set_hook_func(wl, POST_WORKLOAD_RUN, stop_after_100_rounds_hook);
+    return wl;
+}
+
+TEST(PilotRunWorkloadTest, RoundsWithoutReadings) {
+    pilot_set_log_level(lv_warning);
+
+    // a workload that only gives unit readings doesn't wait for readings
+    double offset = 0;
+    pilot_workload_t *wl = new_workload_without_readings("Unit readings only", mock_noisy_workload_func);
+    pilot_set_pi_info(wl, 0, "PI", "", NULL, NULL, true, true);
+    pilot_set_workload_data(wl, &offset);
+    ASSERT_EQ(0, pilot_run_workload(wl));
+    ASSERT_LT(pilot_get_num_of_rounds(wl), 100);
+    pilot_destroy_workload(wl);
+
+    // but a workload whose rounds so far were all rejected keeps running
+    g_rejecting_readings.clear();
+    wl = new_workload_without_readings("Rejected rounds", mock_rejecting_workload_func);
+    pilot_set_pi_info(wl, 0, "PI", "", NULL, NULL, true, false);
+    pilot_set_min_sample_size(wl, 5);
+    ASSERT_EQ(0, pilot_run_workload(wl));
+    const size_t rounds = pilot_get_num_of_rounds(wl);
+    ASSERT_LT(size_t(3), rounds);
+    ASSERT_GT(size_t(100), rounds);
+    ASSERT_EQ(rounds - 3, g_rejecting_readings.size());
+    pilot_analytical_result_t *ar = pilot_analytical_result(wl);
+    ASSERT_EQ(rounds - 3, ar->readings_num[0]);
+    ASSERT_EQ(0, memcmp(g_rejecting_readings.data(), pilot_get_pi_readings(wl, 0),
+                        sizeof(double) * g_rejecting_readings.size()));
+
+    // the readings stay with their rounds when a rejected round gets readings
+    const double reading = 42;
+    pilot_import_benchmark_results(wl, 1, 0, ONE_SECOND, &reading, 0, NULL);
+    pilot_analytical_result(wl, ar);
+    ASSERT_EQ(rounds - 2, ar->readings_num[0]);
+    ASSERT_EQ(reading, pilot_get_pi_readings(wl, 0)[0]);
+    ASSERT_EQ(g_rejecting_readings[0], pilot_get_pi_readings(wl, 0)[1]);
+    ASSERT_EQ(0, pilot_export(wl, "/tmp/unit_test_run_workload_rejected_export"));
+    ifstream readings_csv("/tmp/unit_test_run_workload_rejected_export/readings.csv");
+    vector<string> lines;
+    for (string line; getline(readings_csv, line); )
+        lines.push_back(line);
+    ASSERT_EQ(rounds + 1, lines.size());
+    ASSERT_EQ("0,0,,", lines[1]);
+    ASSERT_EQ("0,1,42,", lines[2]);
+    ASSERT_EQ("0,2,,", lines[3]);
+
+    // or when a round loses its readings
+    pilot_import_benchmark_results(wl, 1, 0, ONE_SECOND, NULL, 0, NULL);
+    pilot_analytical_result(wl, ar);
+    ASSERT_EQ(rounds - 3, ar->readings_num[0]);
+    ASSERT_EQ(g_rejecting_readings[0], pilot_get_pi_readings(wl, 0)[0]);
+
+    // and in the journal
+    const char *journal_file = "/tmp/unit_test_run_workload_rejected.journal";
+    ASSERT_EQ(0, pilot_set_journal(wl, journal_file));
+    pilot_workload_t *loaded = new_workload_without_readings("Rejected rounds", mock_rejecting_workload_func);
+    ASSERT_EQ(0, pilot_load_journal(loaded, journal_file));
+    ASSERT_EQ(rounds, size_t(pilot_get_num_of_rounds(loaded)));
+    pilot_analytical_result(loaded, ar);
+    ASSERT_EQ(rounds - 3, ar->readings_num[0]);
+    ASSERT_EQ(0, memcmp(g_rejecting_readings.data(), pilot_get_pi_readings(loaded, 0),
+                        sizeof(double) * g_rejecting_readings.size()));
+    remove(journal_file);
+
+    pilot_free_analytical_result(ar);
+    pilot_destroy_workload(loaded);
+    pilot_destroy_workload(wl);
+}
+
+TEST(PilotRunWorkloadTest, Race) {
+    vector<double> offsets {0.3, 0.1, 0.5, 0, 0.4, 0.2};
+    vector<pilot_workload_t*> wls;
+    for (double &offset : offsets) {
+        wls.push_back(new_ab_workload("race", &offset));
+        pilot_set_workload_func(wls.back(), mock_noisy_workload_func);
+    }
+    pilot_race_result_t r;
+
+    ASSERT_EQ(ERR_WRONG_PARAM, pilot_run_race(wls.data(), 1, 0, &r));
+    ASSERT_EQ(ERR_WRONG_PARAM, pilot_run_race(wls.data(), wls.size(), 1, &r));
+    ASSERT_EQ(ERR_WRONG_PARAM, pilot_run_race(wls.data(), wls.size(), 0, &r, true, 1));
+    vector<pilot_workload_t*> dup {wls[0], wls[1], wls[0]};
+    ASSERT_EQ(ERR_WRONG_PARAM, pilot_run_race(dup.data(), dup.size(), 0, &r));
+
+    g_ab_rng.seed(1);
+    ASSERT_EQ(0, pilot_run_race(wls.data(), wls.size(), 0, &r));
+    ASSERT_EQ(3, r.winner);
+    ASSERT_TRUE(r.identified);
+    ASSERT_NEAR(1, r.winner_mean, 0.05);
+    // the clearly worse workloads are eliminated early
+    ASSERT_LT(pilot_get_num_of_rounds(wls[2]), pilot_get_num_of_rounds(wls[1]));
+    ASSERT_LT(r.rounds, wls.size() * pilot_get_num_of_rounds(wls[3]));
+    size_t total_rounds = 0;
+    for (auto wl : wls)
+        total_rounds += pilot_get_num_of_rounds(wl);
+    ASSERT_EQ(total_rounds, r.rounds);
+
+    // when higher is better
+    g_ab_rng.seed(1);
+    ASSERT_EQ(0, pilot_run_race(wls.data(), wls.size(), 0, &r, false));
+    ASSERT_EQ(2, r.winner);
+    ASSERT_TRUE(r.identified);
+
+    // no workload has any metric
+    for (auto wl : wls)
+        pilot_destroy_workload(wl);
+    wls.clear();
+    for (double &offset : offsets) {
+        wls.push_back(new_ab_workload("race", &offset));
+        pilot_set_workload_func(wls.back(), mock_empty_workload_func);
+    }
+    ASSERT_EQ(0, pilot_run_race(wls.data(), wls.size(), 0, &r, true, 3));
+    ASSERT_FALSE(r.identified);
+    ASSERT_TRUE(std::isnan(r.winner_mean));
+    ASSERT_EQ(3 * wls.size(), r.rounds);
+
+    for (auto wl : wls)
+        pilot_destroy_workload(wl);
+}
+
+static const pilot_analytical_result_t *g_held_snapshot = NULL;
+
+bool snapshot_hook(pilot_workload_t* wl) {
+    const size_t rounds = pilot_get_num_of_rounds(wl);
+    const pilot_analytical_result_t *s = pilot_acquire_analytical_result_snapshot(wl);
+    // the first call enables publishing so there is nothing to read yet
+    if (1 == rounds) {
+        EXPECT_EQ(NULL, s);
+    } else {
+        EXPECT_EQ(rounds, s->num_of_rounds);
+        EXPECT_EQ(20 * rounds, s->unit_readings_num[0]);
+        // hold the first snapshot until the end of the session
+        if (!g_held_snapshot) {
+            g_held_snapshot = s;
+        } else {
+            pilot_release_analytical_result_snapshot(s);
+        }
+    }
+    return rounds < 10;
+}
+
+TEST(PilotRunWorkloadTest, AnalyticalResultSnapshot) {
+    double offset = 0;
+    pilot_workload_t *wl = new_ab_workload("snapshot", &offset);
+    pilot_set_workload_func(wl, mock_noisy_workload_func);
+    pilot_set_hook_func(wl, POST_WORKLOAD_RUN, &snapshot_hook);
+    g_ab_rng.seed(1);
+    ASSERT_EQ(ERR_STOPPED_BY_HOOK, pilot_run_workload(wl));
+    ASSERT_EQ(10, pilot_get_num_of_rounds(wl));
+
+    // a snapshot does not change while it is held
+    ASSERT_EQ(size_t(2), g_held_snapshot->num_of_rounds);
+    ASSERT_EQ(size_t(40), g_held_snapshot->unit_readings_num[0]);
+    pilot_release_analytical_result_snapshot(g_held_snapshot);
+
+    const pilot_analytical_result_t *s = pilot_acquire_analytical_result_snapshot(wl);
+    pilot_analytical_result_t *ar = pilot_analytical_result(wl);
+    ASSERT_EQ(size_t(10), s->num_of_rounds);
+    ASSERT_EQ(ar->unit_readings_mean[0], s->unit_readings_mean[0]);
+    ASSERT_EQ(ar->unit_readings_var[0], s->unit_readings_var[0]);
+    // copying into an existing result of the same number of PIs reuses its memory
+    const size_t *block = ar->readings_num;
+    pilot_analytical_result(wl, ar);
+    ASSERT_EQ(block, ar->readings_num);
+    pilot_release_analytical_result_snapshot(s);
+    pilot_free_analytical_result(ar);
+    pilot_destroy_workload(wl);
+}
+
+struct mock_config_t {
+    double latency;
+    double throughput;
+};
+
+/**
+ * A workload with two PIs, latency (PI 0) and throughput (PI 1), whose unit
+ * readings are normally distributed around the values of the
+ * mock_config_t that data points to
+ */
+int mock_two_pi_workload_func(const pilot_workload_t *wl,
+                              size_t round,
+                              size_t total_work_amount,
+                              pilot_malloc_func_t *lib_malloc_func,
+                              size_t *num_of_work_unit,
+                              double ***unit_readings,
+                              double **readings,
+                              nanosecond_type *round_duration, void *data) {
+    const mock_config_t *config = static_cast<mock_config_t*>(data);
+    normal_distribution<double> noise(0, 0.2);
+    *num_of_work_unit = 20;
+    *unit_readings = (double**)lib_malloc_func(sizeof(double*) * 2);
+    for (size_t piid = 0; piid < 2; ++piid) {
+        (*unit_readings)[piid] = (double*)lib_malloc_func(sizeof(double) * *num_of_work_unit);
+        for (size_t i = 0; i < *num_of_work_unit; ++i)
+            (*unit_readings)[piid][i] = (0 == piid ? config->latency : config->throughput) + noise(g_ab_rng);
+    }
+    *readings = NULL;
+    return 0;
+}
+
+TEST(PilotRunWorkloadTest, ParetoSearch) {
+    vector<mock_config_t> configs {{1, 10}, {2, 20}, {3, 15}, {1.5, 5}, {4, 30}};
+    vector<pilot_workload_t*> wls;
+    for (mock_config_t &c : configs) {
+        pilot_workload_t *wl = pilot_new_workload("pareto");
+        pilot_set_num_of_pi(wl, 2);
+        pilot_set_work_amount_limit(wl, 0);
+        pilot_set_short_round_detection_threshold(wl, 0);
+        pilot_set_min_sample_size(wl, 40);
+        pilot_set_workload_func(wl, mock_two_pi_workload_func);
+        pilot_set_workload_data(wl, &c);
+        wls.push_back(wl);
+    }
+    const size_t piids[] = {0, 1};
+    const bool lower_is_better[] = {true, false};
+    bool on_frontier[5];
+    double means[10];
+
+    ASSERT_EQ(ERR_WRONG_PARAM, pilot_run_pareto_search(wls.data(), wls.size(), piids, lower_is_better, 0, on_frontier));
+    const size_t bad_piids[] = {0, 2};
+    ASSERT_EQ(ERR_WRONG_PARAM, pilot_run_pareto_search(wls.data(), wls.size(), bad_piids, lower_is_better, 2, on_frontier));
+
+    g_ab_rng.seed(1);
+    ASSERT_EQ(0, pilot_run_pareto_search(wls.data(), wls.size(), piids, lower_is_better, 2, on_frontier, means));
+    const bool expected_frontier[] = {true, true, false, false, true};
+    for (size_t i = 0; i < configs.size(); ++i) {
+        ASSERT_EQ(expected_frontier[i], on_frontier[i]) << "workload " << i;
+        ASSERT_NEAR(configs[i].latency, means[i * 2], 0.1);
+        ASSERT_NEAR(configs[i].throughput, means[i * 2 + 1], 0.1);
+    }
+    // the dominated workloads stop early
+    ASSERT_LT(pilot_get_num_of_rounds(wls[2]), pilot_get_num_of_rounds(wls[1]));
+    ASSERT_LT(pilot_get_num_of_rounds(wls[3]), pilot_get_num_of_rounds(wls[0]));
+
+    // a workload without data is not on the frontier and dominates nobody
+    for (auto wl : wls)
+        pilot_destroy_workload(wl);
+    wls.clear();
+    for (size_t i = 0; i < 2; ++i) {
+        pilot_workload_t *wl = pilot_new_workload("pareto");
+        pilot_set_num_of_pi(wl, 2);
+        pilot_set_work_amount_limit(wl, 0);
+        pilot_set_short_round_detection_threshold(wl, 0);
+        pilot_set_workload_func(wl, 0 == i ? mock_two_pi_workload_func : mock_empty_workload_func);
+        pilot_set_workload_data(wl, &configs[0]);
+        wls.push_back(wl);
+    }
+    ASSERT_EQ(0, pilot_run_pareto_search(wls.data(), wls.size(), piids, lower_is_better, 2, on_frontier, means, 5));
+    ASSERT_TRUE(on_frontier[0]);
+    ASSERT_FALSE(on_frontier[1]);
+    ASSERT_TRUE(std::isnan(means[2]));
+    ASSERT_TRUE(std::isnan(means[3]));
+
+    for (auto wl : wls)
+        pilot_destroy_workload(wl);
+}
+
 int main(int argc, char **argv) {
     PILOT_LIB_SELF_CHECK;
     ::testing::InitGoogleTest(&argc, argv);
@@ -207,6 +207,179 @@ TEST(PilotRunWorkloadTest, TestCalcNextRoundWorkAmountFromWPS) {
     pilot_destroy_workload(wl);
 }
 
+TEST(PilotRunWorkloadTest, TestCalcNextRoundWorkAmountMeetLowerBound) {
+    pilot_set_log_level(lv_warning);
+    shared_ptr<pilot_workload_t> wl(pilot_new_workload("Test workload"), pilot_destroy_workload);
+    pilot_set_work_amount_limit(wl.get(), 100000);
+    pilot_set_short_round_detection_threshold(wl.get(), 20);
+    // rounds take 5 seconds plus 10 ms per unit of work amount
+    auto add_round = [&wl](size_t wa) {
+        wl->round_work_amounts_.push_back(wa);
+        wl->round_durations_.push_back(5 * ONE_SECOND + wa * ONE_SECOND / 100);
+        wl->rounds_++;
+    };
+    size_t wa;
+    add_round(1);
+    // With only one round the duration is assumed to be proportional to the
+    // work amount: 1.1 x 20 / 5.01 = 4.39
+    ASSERT_TRUE(calc_next_round_work_amount_meet_lower_bound(wl.get(), &wa));
+    ASSERT_EQ(size_t(5), wa);
+    add_round(wa);
+    // Now the fit is exact: (1.1 x 20 - 5) / 0.01 = 1700. Doubling would
+    // have taken 11 rounds to get here.
+    ASSERT_TRUE(calc_next_round_work_amount_meet_lower_bound(wl.get(), &wa));
+    ASSERT_EQ(size_t(1700), wa);
+    add_round(wa);
+    ASSERT_FALSE(calc_next_round_work_amount_meet_lower_bound(wl.get(), &wa));
+    ASSERT_EQ(1700, wl->adjusted_min_work_amount_);
+}
+
+TEST(PilotRunWorkloadTest, ShortProbingRoundsContributeData) {
+    pilot_set_log_level(lv_warning);
+    shared_ptr<pilot_workload_t> wl(pilot_new_workload("Test workload"), pilot_destroy_workload);
+    pilot_set_num_of_pi(wl.get(), 1);
+    pilot_set_work_amount_limit(wl.get(), 100000);
+    pilot_set_short_round_detection_threshold(wl.get(), 20);
+    pilot_set_warm_up_removal_method(wl.get(), FIXED_PERCENTAGE);
+    pilot_set_warm_up_removal_percentage(wl.get(), 0.1);
+    vector<double> urs(100, 42.42);
+    const double *ur_ptrs[] = {urs.data()};
+    // a short round while searching for the shortest valid round is kept
+    pilot_import_benchmark_results(wl.get(), 0, 100, 5 * ONE_SECOND, NULL, urs.size(), ur_ptrs);
+    ASSERT_EQ(size_t(90), pilot_get_total_num_of_unit_readings(wl.get(), 0));
+    // after the search has finished, short rounds are rejected
+    wl->adjusted_min_work_amount_ = 1700;
+    pilot_import_benchmark_results(wl.get(), 1, 100, 5 * ONE_SECOND, NULL, urs.size(), ur_ptrs);
+    ASSERT_EQ(size_t(90), pilot_get_total_num_of_unit_readings(wl.get(), 0));
+}
+
+/**
+ * A mock workload whose rounds cost 5 seconds plus 10 ms per unit of work
+ * amount, and yield one unit reading per unit of work amount
+ */
+int mock_workload_with_fixed_cost_func(const pilot_workload_t *wl,
+                                       size_t round,
+                                       size_t work_amount,
+                                       pilot_malloc_func_t *lib_malloc_func,
+                                       size_t *num_of_work_unit,
+                                       double ***unit_readings,
+                                       double **readings,
+                                       nanosecond_type *round_duration, void *data) {
+    *num_of_work_unit = work_amount;
+    *unit_readings = (double**)lib_malloc_func(sizeof(double*) * g_num_of_pi);
+    (*unit_readings)[0] = (double*)lib_malloc_func(sizeof(double) * work_amount);
+    for (size_t i = 0; i < work_amount; ++i)
+        (*unit_readings)[0][i] = 42.42;
+    *round_duration = 5 * ONE_SECOND + work_amount * ONE_SECOND / 100;
+    return 0;
+}
+
+ssize_t mock_calc_fixed_required_ur_func(const pilot_workload_t* wl, int piid) {
+    return 12000;
+}
+
+/**
+ * Run a session of mock_workload_with_fixed_cost_func()
+ * @return the sum of all round durations in seconds
+ */
+static double run_session_with_planner(pilot_session_planner_t planner, shared_ptr<pilot_workload_t> &wl) {
+    wl.reset(pilot_new_workload("Test workload"), pilot_destroy_workload);
+    pilot_set_workload_func(wl.get(), &mock_workload_with_fixed_cost_func);
+    pilot_set_work_amount_limit(wl.get(), 5000);
+    pilot_set_num_of_pi(wl.get(), 1);
+    pilot_set_pi_info(wl.get(), 0, "TestPI", "tick", NULL, NULL,
+                      false,  /* reading must satisfy */
+                      true);  /* unit readings must satisfy */
+    pilot_set_calc_required_unit_readings_func(wl.get(), &mock_calc_fixed_required_ur_func);
+    pilot_set_wps_analysis(wl.get(), NULL, false, false);
+    pilot_set_short_round_detection_threshold(wl.get(), 0);
+    pilot_set_warm_up_removal_method(wl.get(), NO_WARM_UP_REMOVAL);
+    pilot_set_session_planner(wl.get(), planner);
+    // take the soft limit out of the picture
+    wl->round_work_amount_to_avg_amount_limit_ = 10000;
+    EXPECT_EQ(0, pilot_run_workload(wl.get()));
+    double total = 0;
+    for (auto d : wl->round_durations_)
+        total += double(d) / ONE_SECOND;
+    return total;
+}
+
+TEST(PilotRunWorkloadTest, MPCPlannerShortensSession) {
+    pilot_set_log_level(lv_warning);
+    shared_ptr<pilot_workload_t> greedy_wl, mpc_wl;
+    // The greedy method uses 1, 5000, 5000, and 1.2 x 1999 = 2398, i.e., 4
+    // rounds and 143.99 seconds.
+    const double greedy_duration = run_session_with_planner(GREEDY_PLANNER, greedy_wl);
+    ASSERT_EQ(vector<size_t>({1, 5000, 5000, 2398}), greedy_wl->round_work_amounts_);
+    ASSERT_DOUBLE_EQ(4 * 5 + 12399 * 0.01, greedy_duration);
+
+    // The planner splits the remaining work evenly instead of overshooting
+    const double mpc_duration = run_session_with_planner(MPC_PLANNER, mpc_wl);
+    ASSERT_EQ(vector<size_t>({1, 4000, 4000, 4000}), mpc_wl->round_work_amounts_);
+    ASSERT_DOUBLE_EQ(4 * 5 + 12001 * 0.01, mpc_duration);
+    ASSERT_LT(mpc_duration, greedy_duration);
+
+    pilot_analytical_result_t *ar = pilot_analytical_result(mpc_wl.get());
+    ASSERT_TRUE(ar->planner_has_data);
+    // after the second round the model of round duration is exact
+    ASSERT_NEAR(0.01, ar->planner_work_amount_cost, 1e-9);
+    ASSERT_LE(5.0, ar->planner_round_fixed_cost);
+    ASSERT_EQ(size_t(0), ar->planner_planned_rounds);
+    ASSERT_EQ(size_t(3), ar->planner_num_of_predictions);
+    ASSERT_LE(0, ar->planner_remaining_time_error);
+    pilot_free_analytical_result(ar);
+}
+
+// Runs a mock WPS session of t = 2 + 0.01 * w seconds with up to 5% noise
+// and returns the total round duration in seconds
+static double run_wps_session(pilot_wps_schedule_t schedule, shared_ptr<pilot_workload_t> &wl) {
+    wl.reset(pilot_new_workload("Test workload"), pilot_destroy_workload);
+    pilot_set_work_amount_limit(wl.get(), 100000);
+    pilot_set_wps_analysis(wl.get(), NULL, true, true, schedule);
+    pilot_set_init_work_amount(wl.get(), 0);
+    pilot_set_session_desired_duration(wl.get(), 60);
+    pilot_set_short_round_detection_threshold(wl.get(), 5);
+    wl->adjusted_min_work_amount_ = 500;
+    size_t wa = 500;
+    double total = 0;
+    uint64_t r = 12345;
+    for (int i = 0; i < 200; ++i) {
+        r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+        double noise = (double((r >> 33) % 10000) / 10000 - 0.5) * 0.1;
+        double dur = (2 + 0.01 * wa) * (1 + noise);
+        wl->round_work_amounts_.push_back(wa);
+        wl->round_durations_.push_back(nanosecond_type(dur * ONE_SECOND));
+        wl->rounds_++;
+        total += dur;
+        if (!calc_next_round_work_amount_from_wps(wl.get(), &wa)) break;
+    }
+    return total;
+}
+
+TEST(PilotRunWorkloadTest, WPSOptimalDesignShortensSession) {
+    pilot_set_log_level(lv_warning);
+    shared_ptr<pilot_workload_t> even_wl, optimal_wl;
+    const double even_duration = run_wps_session(WPS_EVEN_SLICES, even_wl);
+    const double optimal_duration = run_wps_session(WPS_OPTIMAL_DESIGN, optimal_wl);
+    ASSERT_LT(optimal_wl->rounds_, size_t(200));
+    ASSERT_TRUE(optimal_wl->analytical_result_.wps_has_data);
+    ASSERT_NEAR(100, optimal_wl->analytical_result_.wps_v, optimal_wl->analytical_result_.wps_v_ci);
+    ASSERT_LT(optimal_duration, even_duration);
+
+    // most rounds are at the two ends but some are in between. The high end
+    // moves with the estimate of v, but its rounds take at least four times
+    // as long as the low-end ones (7 seconds).
+    size_t low = 0, high = 0, interior = 0;
+    for (size_t wa : optimal_wl->round_work_amounts_) {
+        if (wa == 500) ++low;
+        else if (wa >= 2000) ++high;
+        else ++interior;
+    }
+    ASSERT_LT(size_t(0), interior);
+    ASSERT_LT(interior, low);
+    ASSERT_LT(interior, high);
+}
+
 int main(int argc, char **argv) {
     PILOT_LIB_SELF_CHECK;
     ::testing::InitGoogleTest(&argc, argv);
@@ -98,6 +98,101 @@ TEST(WPSUnitTest, CornerCases) {
     ASSERT_EQ(false, ar->wps_has_data);
 }
 
+// The regression state kept by the workload must follow new and overwritten
+// rounds. The expected values are from the least-squares fit of duration
+// (seconds) on work amount, with q = 1 so every round is a subsession.
+TEST(WPSUnitTest, IncrementalRegression) {
+    pilot_set_log_level(lv_no_show);
+    shared_ptr<pilot_workload_t> wl(pilot_new_workload("WPSUnitTest"), pilot_destroy_workload);
+    pilot_set_init_work_amount(wl.get(), 1);
+    pilot_set_work_amount_limit(wl.get(), 100000);
+    pilot_set_wps_analysis(wl.get(), NULL, true, false);
+    pilot_set_short_round_detection_threshold(wl.get(), 0);
+    // the autocorrelation coefficients of the naive v of the data below
+    // are all under 0.35
+    pilot_set_autocorrelation_coefficient(wl.get(), 0.5);
+    pilot_analytical_result_t *ar = NULL;
+
+    // x = 1..5, t = 2,3,5,5,6: Sxx = 10, Sxy = 10, so 1/v = 1 and
+    // alpha = 4.2 - 3 = 1.2; the residuals are -0.2,-0.2,0.8,-0.2,-0.2
+    const size_t wa[] = {1, 2, 3, 4, 5};
+    const int dur[] = {2, 3, 5, 5, 6};
+    for (size_t i = 0; i < 5; ++i)
+        pilot_import_benchmark_results(wl.get(), i, wa[i], dur[i] * ONE_SECOND, NULL, 0, NULL);
+    ar = pilot_analytical_result(wl.get(), ar);
+    ASSERT_TRUE(ar->wps_has_data);
+    ASSERT_EQ(5, ar->wps_subsession_sample_size);
+    ASSERT_NEAR(1.2, ar->wps_alpha, 1e-9);
+    ASSERT_NEAR(1.0, ar->wps_v, 1e-9);
+    ASSERT_NEAR(0.8, ar->wps_err, 1e-9);
+    // se(1/v) = sqrt(0.8 / 3 / 10), v_ci = 1/(1 - 2 se) - 1/(1 + 2 se)
+    ASSERT_NEAR(0.731190967994978, ar->wps_v_ci, 1e-9);
+
+    // a new round (6, 8): Sxx = 17.5, Sxy = 19.5, so v = 35/39
+    pilot_import_benchmark_results(wl.get(), 5, 6, 8 * ONE_SECOND, NULL, 0, NULL);
+    ar = pilot_analytical_result(wl.get(), ar);
+    ASSERT_TRUE(ar->wps_has_data);
+    ASSERT_EQ(6, ar->wps_subsession_sample_size);
+    ASSERT_NEAR(29.0 / 6 - 3.5 * 39 / 35, ar->wps_alpha, 1e-9);
+    ASSERT_NEAR(35.0 / 39, ar->wps_v, 1e-9);
+    ASSERT_NEAR(1.104761904761904, ar->wps_err, 1e-9);
+    ASSERT_NEAR(0.426397329521637, ar->wps_v_ci, 1e-9);
+
+    // overwriting round 3 with (4, 6): Sxy = 20, so v = 7/8 and
+    // alpha = 5 - 3.5 * 8/7 = 1
+    pilot_import_benchmark_results(wl.get(), 3, 4, 6 * ONE_SECOND, NULL, 0, NULL);
+    ar = pilot_analytical_result(wl.get(), ar);
+    ASSERT_TRUE(ar->wps_has_data);
+    ASSERT_EQ(6, ar->wps_subsession_sample_size);
+    ASSERT_NEAR(1.0, ar->wps_alpha, 1e-9);
+    ASSERT_NEAR(0.875, ar->wps_v, 1e-9);
+    ASSERT_NEAR(8.0 / 7, ar->wps_err, 1e-9);
+    ASSERT_NEAR(0.411907259013119, ar->wps_v_ci, 1e-9);
+    pilot_free_analytical_result(ar);
+}
+
+// Rounds without readings in a workload whose other rounds have readings are
+// rejected and left out of WPS analysis, even when they were analyzed before
+// the first round with readings came
+TEST(WPSUnitTest, RejectedRoundsAreLeftOut) {
+    pilot_set_log_level(lv_no_show);
+    shared_ptr<pilot_workload_t> wl(pilot_new_workload("WPSUnitTest"), pilot_destroy_workload);
+    pilot_set_num_of_pi(wl.get(), 1);
+    pilot_set_init_work_amount(wl.get(), 1);
+    pilot_set_work_amount_limit(wl.get(), 100000);
+    pilot_set_wps_analysis(wl.get(), NULL, true, false);
+    pilot_set_short_round_detection_threshold(wl.get(), 0);
+    pilot_set_autocorrelation_coefficient(wl.get(), 0.5);
+    pilot_analytical_result_t *ar = NULL;
+
+    const size_t rejected_wa[] = {1, 2, 3};
+    const int rejected_dur[] = {50, 10, 70};
+    for (size_t i = 0; i < 3; ++i)
+        pilot_import_benchmark_results(wl.get(), i, rejected_wa[i], rejected_dur[i] * ONE_SECOND, NULL, 0, NULL);
+    ar = pilot_analytical_result(wl.get(), ar);
+
+    // the same rounds as in IncrementalRegression, with a rejected one
+    // among them
+    const size_t wa[] = {1, 2, 3, 4, 5};
+    const int dur[] = {2, 3, 5, 5, 6};
+    const double reading = 1;
+    size_t round = 3;
+    for (size_t i = 0; i < 5; ++i) {
+        pilot_import_benchmark_results(wl.get(), round++, wa[i], dur[i] * ONE_SECOND, &reading, 0, NULL);
+        if (2 == i)
+            pilot_import_benchmark_results(wl.get(), round++, 3, 100 * ONE_SECOND, NULL, 0, NULL);
+    }
+    ar = pilot_analytical_result(wl.get(), ar);
+    ASSERT_EQ(9, ar->num_of_rounds);
+    ASSERT_TRUE(ar->wps_has_data);
+    ASSERT_EQ(5, ar->wps_subsession_sample_size);
+    ASSERT_NEAR(1.2, ar->wps_alpha, 1e-9);
+    ASSERT_NEAR(1.0, ar->wps_v, 1e-9);
+    ASSERT_NEAR(0.8, ar->wps_err, 1e-9);
+    ASSERT_NEAR(0.731190967994978, ar->wps_v_ci, 1e-9);
+    pilot_free_analytical_result(ar);
+}
+
 int main(int argc, char **argv) {
     PILOT_LIB_SELF_CHECK;
 
@@ -50,11 +50,15 @@
 
 #include <algorithm>
 #include <boost/format.hpp>
+#include <boost/math/distributions/normal.hpp>
+#include <boost/math/distributions/students_t.hpp>
 #include <chrono>
+#include <cmath>
 #include "common.h"
 #include "csv.h"
 #include "pilot/libpilot.h"
 #include "libpilotcpp.h"
+#include <limits>
 #include <numeric>
 #include <sstream>
 #include <vector>
@@ -78,8 +82,18 @@ void pilot_workload_t::set_num_of_pi(size_t num_of_pi) {
     total_num_of_readings_.resize(num_of_pi);
     baseline_of_readings_.resize(num_of_pi);
     baseline_of_unit_readings_.resize(num_of_pi);
+    comparison_state_.resize(num_of_pi);
     analytical_result_.set_num_of_pi(num_of_pi);
-    analytical_result_update_time_ = chrono::steady_clock::time_point::min();
+    dirty_pi_analyses_.resize(num_of_pi);
+    invalidate_analytical_result();
+}
+
+size_t pilot_workload_t::readings_index(size_t round) const {
+    return count(round_has_readings_.begin(), round_has_readings_.begin() + round, true);
+}
+
+bool pilot_workload_t::round_is_rejected(size_t round) const {
+    return num_of_pi_ > 0 && !readings_[0].empty() && !round_has_readings_[round];
 }
 
 double pilot_workload_t::unit_readings_mean(int piid) const {
@@ -106,7 +120,7 @@ ssize_t pilot_workload_t::required_num_of_readings(int piid) const {
     if (calc_required_readings_func_) {
         return calc_required_readings_func_(this, piid);
     }
-    refresh_analytical_result();
+    refresh_analytical_result(piid, READINGS_ANALYSIS);
     if (analytical_result_.readings_required_sample_size[piid] < 0) {
         return -1;
     } else {
@@ -122,7 +136,7 @@ ssize_t pilot_workload_t::required_num_of_readings(int piid) const {
 ssize_t pilot_workload_t::required_num_of_unit_readings_for_comparison(int piid) const {
     assert (baseline_of_unit_readings_[piid].set);
     // refresh the analytical result
-    refresh_analytical_result();
+    refresh_analytical_result(piid, UNIT_READINGS_ANALYSIS);
     ssize_t q = analytical_result_.unit_readings_optimal_subsession_size[piid];
     if (q < 0)
         return -1;
@@ -149,11 +163,118 @@ ssize_t pilot_workload_t::required_num_of_unit_readings_for_comparison(int piid)
     return q * opt_sample_size;
 }
 
+double pilot::pilot_obf_alpha_spending(double t, double alpha) {
+    using namespace boost::math;
+    if (t <= 0) return 0;
+    normal_distribution<> n;
+    double z = quantile(complement(n, alpha / 2));
+    return 2 * cdf(complement(n, z / sqrt(min(1.0, t))));
+}
+
+void pilot_workload_t::take_comparison_look(size_t piid) const {
+    using namespace boost::math;
+    comparison_state_t &s = comparison_state_[piid];
+    if (COMPARISON_UNDECIDED != s.decision || (0 != s.looks && s.last_look_round == rounds_)) {
+        return;
+    }
+    const baseline_info_t &b = baseline_of_unit_readings_[piid];
+    refresh_analytical_result(piid, UNIT_READINGS_ANALYSIS);
+    ssize_t q = analytical_result_.unit_readings_optimal_subsession_size[piid];
+    if (q < 0) return;
+    size_t n = analytical_result_.unit_readings_num[piid] / q;
+    if (n < 2 || b.sample_size < 2) return;
+    double mean = analytical_result_.unit_readings_mean[piid];
+    double var = analytical_result_.unit_readings_optimal_subsession_var[piid];
+
+    s.last_look_round = rounds_;
+    ++s.looks;
+    double spent = pilot_obf_alpha_spending(double(s.looks) / comparison_max_looks_, desired_p_value_);
+    double alpha = spent - s.spent_alpha;
+    s.spent_alpha = spent;
+
+    s.p_value = pilot_p_eq(mean, b.mean, n, b.sample_size, var, b.var, NULL, NULL);
+    if (s.p_value < alpha) {
+        s.decision = mean < b.mean ? COMPARISON_LOWER : COMPARISON_HIGHER;
+    } else {
+        // TOST: both one-sided tests must reject that the difference is
+        // outside of the margin
+        double se = sqrt(var / n + b.var / b.sample_size);
+        double d = mean - b.mean;
+        double margin = comparison_equivalence_margin_ * abs(b.mean);
+        if (se > 0) {
+            students_t dist(pilot_calc_deg_of_freedom(var, b.var, n, b.sample_size));
+            double p_tost = max(cdf(complement(dist, (d + margin) / se)),
+                                cdf(complement(dist, (margin - d) / se)));
+            if (p_tost < alpha) {
+                s.decision = COMPARISON_EQUIVALENT;
+            }
+        }
+    }
+    if (COMPARISON_UNDECIDED == s.decision && s.looks >= comparison_max_looks_) {
+        s.decision = COMPARISON_INCONCLUSIVE;
+    }
+    info_log << format("[PI %1%] sequential comparison look %2%/%3%: mean %4% vs. baseline %5%, p-value %6% (alpha %7%), decision %8%")
+                % piid % s.looks % comparison_max_looks_ % mean % b.mean % s.p_value % alpha % s.decision;
+}
+
 ssize_t pilot_workload_t::required_num_of_unit_readings(int piid) const {
-    refresh_analytical_result();
+    refresh_analytical_result(piid, UNIT_READINGS_ANALYSIS);
     return analytical_result_.unit_readings_required_sample_size[piid];
 }
 
+/**
+ * Fit y = a + b * x using simple_regression_model()
+ * @return false if there are fewer than two distinct x values
+ */
+static bool _fit_line(const vector<double> &x, const vector<double> &y, double *a, double *b) {
+    if (x.size() < 2 || all_of(x.begin(), x.end(), [&x](double v) { return v == x[0]; }))
+        return false;
+    simple_regression_model(x, y, a, b);
+    return true;
+}
+
+/**
+ * Compare the planner's prediction of the last round's duration with the
+ * measured one
+ */
+static void _update_planner_round_duration_error(const pilot_workload_t *wl) {
+    if (wl->planner_predicted_round_ < 0 || size_t(wl->planner_predicted_round_) >= wl->rounds_)
+        return;
+    const double actual = double(wl->round_durations_[wl->planner_predicted_round_]) / ONE_SECOND;
+    wl->planner_predicted_round_ = -1;
+    if (actual <= 0) return;
+    wl->planner_total_round_duration_error_ += abs(wl->planner_predicted_round_duration_ - actual) / actual;
+    pilot_analytical_result_t &ar = wl->analytical_result_;
+    ++ar.planner_num_of_predictions;
+    ar.planner_round_duration_error = wl->planner_total_round_duration_error_ / ar.planner_num_of_predictions;
+    debug_log << format("Planner: predicted round duration %1% s, measured %2% s") % wl->planner_predicted_round_duration_ % actual;
+}
+
+/**
+ * Compare the planner's predictions of the remaining session time with the
+ * actual ones once the session has finished
+ */
+static void _update_planner_remaining_time_error(const pilot_workload_t *wl) {
+    if (wl->planner_remaining_time_predictions_.empty()) return;
+    const double overhead = wl->num_of_round_overheads_ == 0 ? 0 :
+        double(wl->total_round_overhead_) / ONE_SECOND / wl->num_of_round_overheads_;
+    double total_error = 0;
+    size_t n = 0;
+    for (auto const &p : wl->planner_remaining_time_predictions_) {
+        double actual = 0;
+        for (size_t r = p.first; r < wl->rounds_; ++r)
+            actual += double(wl->round_durations_[r]) / ONE_SECOND + overhead;
+        if (actual <= 0) continue;
+        total_error += abs(p.second - actual) / actual;
+        ++n;
+    }
+    if (n != 0) {
+        wl->analytical_result_.planner_remaining_time_error = total_error / n;
+        info_log << format("Planner: mean error of the predicted remaining session time %1%%%")
+                        % (100 * wl->analytical_result_.planner_remaining_time_error);
+    }
+}
+
 bool pilot_workload_t::calc_next_round_work_amount(size_t * const needed_work_amount) const {
     if (next_round_work_amount_hook_) {
         return next_round_work_amount_hook_(this, needed_work_amount);
@@ -185,6 +306,9 @@ bool pilot_workload_t::calc_next_round_work_amount(size_t * const needed_work_am
             *needed_work_amount = max(adjusted_min_work_amount_, ssize_t(min_work_amount_));
         }
     }
+    if (MPC_PLANNER == session_planner_) {
+        _update_planner_round_duration_error(this);
+    }
     for (auto &r : runtime_analysis_plugins_) {
         if (!r.enabled || r.finished) continue;
         size_t nwa;
@@ -195,13 +319,37 @@ bool pilot_workload_t::calc_next_round_work_amount(size_t * const needed_work_am
         *needed_work_amount = max(*needed_work_amount, nwa);
         more_rounds_needed = more_rounds_needed | rc;
     }
+    // The MPC planner replaces the plugins' greedy proposals when it has
+    // enough data to plan
+    bool planned = false;
+    double duration_intercept = 0, duration_slope = 0;
+    if (MPC_PLANNER == session_planner_ && more_rounds_needed) {
+        size_t planned_work_amount;
+        planned = plan_next_round_work_amount(&planned_work_amount, &duration_intercept, &duration_slope);
+        if (planned) *needed_work_amount = planned_work_amount;
+    }
     *needed_work_amount = min(*needed_work_amount, max_work_amount_);
     const size_t soft_limit = get_round_work_amount_soft_limit();
     if (*needed_work_amount > soft_limit) {
-        info_log << str(format("Limiting next round's work amount to %1% (no more than %2% times of the average round work amount)")
-                % soft_limit % round_work_amount_to_avg_amount_limit_);
+        info_log << format("Limiting next round's work amount to %1% (no more than %2% times of the average round work amount)")
+                % soft_limit % round_work_amount_to_avg_amount_limit_;
         *needed_work_amount = soft_limit;
     }
+    if (planned) {
+        planner_predicted_round_ = rounds_;
+        planner_predicted_round_duration_ = duration_intercept + duration_slope * *needed_work_amount;
+        if (!planner_remaining_time_predictions_.empty() &&
+            planner_remaining_time_predictions_.back().first == rounds_) {
+            planner_remaining_time_predictions_.back().second = analytical_result_.planner_predicted_remaining_time;
+        } else {
+            planner_remaining_time_predictions_.emplace_back(rounds_, analytical_result_.planner_predicted_remaining_time);
+        }
+    } else if (!more_rounds_needed && analytical_result_.planner_has_data) {
+        analytical_result_.planner_planned_rounds = 0;
+        analytical_result_.planner_planned_work_amount = 0;
+        analytical_result_.planner_predicted_remaining_time = 0;
+        _update_planner_remaining_time_error(this);
+    }
 
     if (0 == rounds_) {
         return true;
@@ -215,6 +363,153 @@ bool pilot_workload_t::calc_next_round_work_amount(size_t * const needed_work_am
     SHOULD_NOT_REACH_HERE;
 }
 
+bool pilot_workload_t::plan_next_round_work_amount(size_t *needed_work_amount,
+                                                   double *duration_intercept,
+                                                   double *duration_slope) const {
+    // The greedy method is used until the shortest valid round is found
+    if (0 == rounds_ || 0 == max_work_amount_ || adjusted_min_work_amount_ < 0) {
+        return false;
+    }
+    // WPS analysis needs rounds of different work amounts, which the planner
+    // doesn't plan for
+    if (wps_must_satisfy_ && wps_enabled()) {
+        debug_log << "Planner: WPS analysis must satisfy, using the greedy method";
+        return false;
+    }
+
+    vector<double> wa, dur;
+    vector<size_t> wa_rounds;
+    for (size_t r = 0; r < rounds_; ++r) {
+        if (0 == round_work_amounts_[r] || round_is_rejected(r)) continue;
+        wa.push_back(round_work_amounts_[r]);
+        dur.push_back(double(round_durations_[r]) / ONE_SECOND);
+        wa_rounds.push_back(r);
+    }
+    if (wa.empty()) return false;
+    const double sum_wa = accumulate(wa.begin(), wa.end(), 0.0);
+
+    // Round duration model: duration = c0 + c1 * work_amount
+    double c0, c1;
+    if (!_fit_line(wa, dur, &c0, &c1) || c0 < 0 || c1 <= 0) {
+        // assume the duration is proportional to the work amount
+        c0 = 0;
+        c1 = accumulate(dur.begin(), dur.end(), 0.0) / sum_wa;
+    }
+    if (c1 <= 0) return false;
+    const double overhead = 0 == num_of_round_overheads_ ? 0 :
+        double(total_round_overhead_) / ONE_SECOND / num_of_round_overheads_;
+
+    // Each round yields one reading, so the readings requirements set the
+    // lower bound of the number of rounds
+    size_t rounds_needed = 0;
+    // Usable URs of a round = yield * work_amount - loss
+    vector<double> urs_needed(num_of_pi_, 0), yield(num_of_pi_, 0), loss(num_of_pi_, 0);
+    double margin = 1;
+    for (size_t piid = 0; piid < num_of_pi_; ++piid) {
+        if (pi_info_[piid].reading_must_satisfy && 0 != total_num_of_readings_[piid]) {
+            ssize_t req = required_num_of_readings(piid);
+            if (req < 0) return false;
+            if (size_t(req) > total_num_of_readings_[piid])
+                rounds_needed = max(rounds_needed, size_t(req) - total_num_of_readings_[piid]);
+        }
+
+        size_t ur_target = 0;
+        bool has_urs = any_of(unit_readings_[piid].begin(), unit_readings_[piid].end(),
+                              [](const unit_reading_data_per_round_t &c) { return !c.empty(); });
+        if (!has_urs) continue;
+        if (0 == total_num_of_unit_readings_[piid]) return false;
+        if (pi_info_[piid].unit_reading_must_satisfy) {
+            ssize_t req = required_num_of_unit_readings(piid);
+            if (req < 0) return false;
+            ur_target = req;
+        }
+        if (baseline_of_unit_readings_[piid].set) {
+            if (SEQUENTIAL_COMPARISON == comparison_method_) {
+                // the number of rounds a sequential comparison needs is not
+                // known in advance
+                if (COMPARISON_UNDECIDED == comparison_state_[piid].decision) return false;
+            } else {
+                ssize_t req = required_num_of_unit_readings_for_comparison(piid);
+                if (req < 0) return false;
+                ur_target = max(ur_target, size_t(req));
+            }
+        }
+        // like calc_next_round_work_amount_from_unit_readings(), we need more
+        // than the required number of unit readings
+        if (ur_target < total_num_of_unit_readings_[piid]) continue;
+        urs_needed[piid] = ur_target - total_num_of_unit_readings_[piid] + 1;
+
+        vector<double> usable;
+        for (size_t r : wa_rounds) {
+            const size_t n = unit_readings_[piid][r].size();
+            usable.push_back(n > warm_up_phase_len_[piid][r] ? n - warm_up_phase_len_[piid][r] : 0);
+        }
+        double a, b;
+        if (!_fit_line(wa, usable, &a, &b) || a > 0 || b <= 0) {
+            a = 0;
+            b = accumulate(usable.begin(), usable.end(), 0.0) / sum_wa;
+        }
+        if (b <= 0) return false;
+        yield[piid] = b;
+        loss[piid] = -a;
+        // The scatter of the yield model sets the safety margin, which is
+        // capped at the 20% that the greedy method uses
+        double sq_err = 0;
+        for (size_t i = 0; i < wa.size(); ++i) {
+            double e = (usable[i] - (a + b * wa[i])) / max(1.0, a + b * wa[i]);
+            sq_err += e * e;
+        }
+        margin = max(margin, min(1.2, 1 + sqrt(sq_err / wa.size())));
+    }
+
+    // Find the number of equally sized rounds that minimizes the remaining
+    // session time. More rounds cost more fixed cost but allow smaller rounds.
+    const size_t kMaxPlannedRounds = 10000;
+    const size_t min_wa = max(max(size_t(adjusted_min_work_amount_), min_work_amount_), size_t(1));
+    const double round_fixed_cost = c0 + overhead;
+    const size_t k_begin = max(size_t(1), rounds_needed);
+    size_t best_k = 0, best_wa = 0;
+    double best_t = numeric_limits<double>::max();
+    for (size_t k = k_begin; k < k_begin + kMaxPlannedRounds; ++k) {
+        if (k * round_fixed_cost >= best_t) break;
+        double total_wa = 0;
+        for (size_t piid = 0; piid < num_of_pi_; ++piid) {
+            if (0 == urs_needed[piid]) continue;
+            total_wa = max(total_wa, (margin * urs_needed[piid] + k * loss[piid]) / yield[piid]);
+        }
+        total_wa = max(total_wa, double(k * min_wa));
+        size_t round_wa = size_t(ceil(total_wa / k));
+        if (round_wa > max_work_amount_) continue;
+        // Rounding up round_wa is left out of the cost so it doesn't make
+        // the plan favor the k that happen to divide total_wa evenly
+        double t = k * round_fixed_cost + c1 * total_wa;
+        if (t < best_t) {
+            best_t = t;
+            best_k = k;
+            best_wa = round_wa;
+        }
+    }
+    if (0 == best_k) {
+        debug_log << "Planner: the requirements cannot be met within " << kMaxPlannedRounds << " rounds";
+        return false;
+    }
+
+    pilot_analytical_result_t &ar = analytical_result_;
+    if (!ar.planner_has_data) ar.planner_remaining_time_error = -1;
+    ar.planner_has_data = true;
+    ar.planner_planned_rounds = best_k;
+    ar.planner_planned_work_amount = best_wa;
+    ar.planner_round_fixed_cost = round_fixed_cost;
+    ar.planner_work_amount_cost = c1;
+    ar.planner_predicted_remaining_time = best_t;
+    info_log << format("Planner: %1% more round(s) of work amount %2%, predicted remaining session time %3% seconds")
+                    % best_k % best_wa % best_t;
+    *needed_work_amount = best_wa;
+    *duration_intercept = c0;
+    *duration_slope = c1;
+    return true;
+}
+
 pilot_analytical_result_t* pilot_workload_t::get_analytical_result(pilot_analytical_result_t *info) const {
     refresh_analytical_result();
     if (!info) {
@@ -225,6 +520,38 @@ pilot_analytical_result_t* pilot_workload_t::get_analytical_result(pilot_analyti
     return info;
 }
 
+void pilot_workload_t::publish_analytical_result_snapshot(void) {
+    refresh_analytical_result();
+    analytical_result_snapshot_t *published = published_snapshot_.load();
+    analytical_result_snapshot_t *s = nullptr;
+    // Reuse a snapshot that nobody reads. A reader that starts reading it
+    // after the check finds it is no longer published and tries again (see
+    // acquire_analytical_result_snapshot()).
+    for (auto &c : snapshots_) {
+        if (c.get() != published && 0 == c->readers.load()) {
+            s = c.get();
+            break;
+        }
+    }
+    if (!s) {
+        snapshots_.emplace_back(new analytical_result_snapshot_t);
+        s = snapshots_.back().get();
+    }
+    s->result = analytical_result_;
+    published_snapshot_.store(s);
+}
+
+const pilot_analytical_result_t* pilot_workload_t::acquire_analytical_result_snapshot(void) const {
+    snapshots_wanted_ = true;
+    while (true) {
+        analytical_result_snapshot_t *s = published_snapshot_.load();
+        if (!s) return nullptr;
+        ++s->readers;
+        if (s == published_snapshot_.load()) return &s->result;
+        --s->readers;
+    }
+}
+
 template <typename InputIterator>
 static ssize_t _calc_required_num_of_readings(const pilot_workload_t *wl,
         const InputIterator data, const size_t n, size_t *q, const pilot_mean_method_t mean_method,
@@ -249,156 +576,181 @@ static ssize_t _calc_required_num_of_readings(const pilot_workload_t *wl,
             opt_sample_size = wl->min_sample_size_;
         }
         if (*q != 1) {
-            debug_log << str(format("High autocorrelation detected, merging every %1% samples to reduce autocorrelation") % *q);
+            debug_log << format("High autocorrelation detected, merging every %1% samples to reduce autocorrelation") % *q;
         }
-        debug_log << str(format("Required reading size = subsession size (%1%) x required subsession sample size (%2%) = %3%")
-                               % (*q) % opt_sample_size % (*q * opt_sample_size));
+        debug_log << format("Required reading size = subsession size (%1%) x required subsession sample size (%2%) = %3%")
+                               % (*q) % opt_sample_size % (*q * opt_sample_size);
         return *q * opt_sample_size;
     }
 }
 
+void pilot_workload_t::invalidate_analytical_result(size_t piid, unsigned kinds) const {
+    if (static_cast<size_t>(-1) == piid) {
+        for (auto &d : dirty_pi_analyses_) d = ALL_PI_ANALYSES;
+        wps_analysis_rounds_ = -1;
+    } else {
+        dirty_pi_analyses_[piid] |= kinds;
+    }
+}
+
 void pilot_workload_t::refresh_analytical_result(void) const {
-    if (raw_data_changed_time_ <= analytical_result_update_time_) {
-        debug_log << "No need to refresh analytical result";
+    analytical_result_.num_of_pi = num_of_pi_;
+    analytical_result_.num_of_rounds = rounds_;
+    for (size_t piid = 0; piid < num_of_pi_; ++piid) {
+        refresh_analytical_result(piid, ALL_PI_ANALYSES);
+    }
+    // WPS analysis data
+    refresh_wps_analysis_results();
+}
+
+void pilot_workload_t::refresh_analytical_result(size_t piid, unsigned kinds) const {
+    kinds &= dirty_pi_analyses_[piid];
+    if (0 == kinds) {
+        debug_log << format("[PI %1%] no need to refresh analytical result") % piid;
         return;
     }
-    analytical_result_update_time_ = chrono::steady_clock::now();
+    // clear the bits first as the analyses below may query the workload
+    dirty_pi_analyses_[piid] &= ~kinds;
     analytical_result_.num_of_pi = num_of_pi_;
     analytical_result_.num_of_rounds = rounds_;
+    info_log << format("[PI %1%] analyzing results") % piid;
+    if (kinds & READINGS_ANALYSIS) {
+        refresh_readings_analysis(piid);
+    }
+    if (kinds & UNIT_READINGS_ANALYSIS) {
+        refresh_unit_readings_analysis(piid);
+    }
+}
 
-    for (size_t piid = 0; piid < num_of_pi_; ++piid) {
-        info_log << str(format("[PI %1%] analyzing results") % piid);
-        // Readings analysis
-        analytical_result_.readings_num[piid] = readings_[piid].size();
-        analytical_result_.readings_mean_method[piid] = pi_info_[piid].reading_mean_method;
-        analytical_result_.readings_ci_type[piid] = pi_info_[piid].reading_ci_type;
-        if (analytical_result_.readings_num[piid] >= 2) {
-            // First see if we can find a dominant segment
-            if (analytical_result_.readings_num[piid] > MIN_CHANGEPOINT_DETECTION_SAMPLE_SIZE) {
-                size_t change_loc;
-                // We use 30% as change penalty to make sure the changepoint is significant enough
-                int res = pilot_find_one_changepoint(readings_[piid].data() + analytical_result_.readings_last_changepoint[piid],
-                                                     readings_[piid].size() - analytical_result_.readings_last_changepoint[piid],
-                                                     &change_loc);
-                switch (res) {
-                case ERR_NO_CHANGEPOINT:
-                    debug_log << __func__ << "(): readings have no changepoint detected";
-                    break;
-                case 0:
-                    analytical_result_.readings_last_changepoint[piid] += change_loc;
-                    info_log << __func__ << format("(): changepoint in readings detected at %1%. "
-                                                   "Previous readings will be ignored in analysis.") %
-                                                   analytical_result_.readings_last_changepoint[piid];
-                    break;
-                default:
-                    fatal_log << __func__ << format("(): unknown error %1% detected, aborting") % res;
-                    abort();
-                    break;
-                }
+void pilot_workload_t::refresh_readings_analysis(size_t piid) const {
+    analytical_result_.readings_num[piid] = readings_[piid].size();
+    analytical_result_.readings_mean_method[piid] = pi_info_[piid].reading_mean_method;
+    analytical_result_.readings_ci_type[piid] = pi_info_[piid].reading_ci_type;
+    if (analytical_result_.readings_num[piid] >= 2) {
+        // First see if we can find a dominant segment
+        if (analytical_result_.readings_num[piid] > MIN_CHANGEPOINT_DETECTION_SAMPLE_SIZE) {
+            size_t change_loc;
+            // We use 30% as change penalty to make sure the changepoint is significant enough
+            int res = pilot_find_one_changepoint(readings_[piid].data() + analytical_result_.readings_last_changepoint[piid],
+                                                 readings_[piid].size() - analytical_result_.readings_last_changepoint[piid],
+                                                 &change_loc);
+            switch (res) {
+            case ERR_NO_CHANGEPOINT:
+                debug_log << __func__ << "(): readings have no changepoint detected";
+                break;
+            case 0:
+                analytical_result_.readings_last_changepoint[piid] += change_loc;
+                info_log << __func__ << format("(): changepoint in readings detected at %1%. "
+                                               "Previous readings will be ignored in analysis.") %
+                                               analytical_result_.readings_last_changepoint[piid];
+                break;
+            default:
+                fatal_log << __func__ << format("(): unknown error %1% detected, aborting") % res;
+                abort();
+                break;
             }
+        }
 
-            double sm, var_rt, subsession_var_rt, ci, cif_low, cif_high;
-            size_t q;
+        double sm, var_rt, subsession_var_rt, ci, cif_low, cif_high;
+        size_t q;
 
 #define ANALYZE_READINGS(prefix, data, size) \
-            prefix##_mean[piid] = pilot_subsession_mean(data,                                         \
-                    size, analytical_result_.readings_mean_method[piid]);                             \
-            sm = prefix##_mean[piid];                                                                 \
-            prefix##_mean_formatted[piid] = format_reading(piid, sm);                                 \
-            prefix##_var[piid] = pilot_subsession_var(data,                                           \
-                    size,                                                                             \
-                    1,                                                                                \
-                    sm,                                                                               \
-                    analytical_result_.readings_mean_method[piid]);                                   \
-            var_rt = prefix##_var[piid] / sm;                                                         \
-            prefix##_var_formatted[piid] = prefix##_mean_formatted[piid] * var_rt;                    \
-            prefix##_autocorrelation_coefficient[piid] =                                              \
-                    pilot_subsession_autocorrelation_coefficient(data,                                \
-                            size, 1, prefix##_mean[piid],                                             \
-                            analytical_result_.readings_mean_method[piid]);                           \
-            prefix##_required_sample_size[piid] = _calc_required_num_of_readings(this,                \
-                    data, size, &q,                                                                   \
-                    analytical_result_.readings_mean_method[piid],                                    \
-                    analytical_result_.readings_ci_type[piid]);                                       \
-            if (prefix##_required_sample_size[piid] > 0) {                                            \
-                prefix##_optimal_subsession_size[piid] = q;                                           \
-                prefix##_optimal_subsession_var[piid] =                                               \
-                        pilot_subsession_var(data, size,                                              \
-                                prefix##_optimal_subsession_size[piid], prefix##_mean[piid],          \
-                                analytical_result_.readings_mean_method[piid]);                       \
-                subsession_var_rt = prefix##_optimal_subsession_var[piid] / sm;                       \
-                prefix##_optimal_subsession_var_formatted[piid] = prefix##_mean_formatted[piid] * subsession_var_rt; \
-                prefix##_optimal_subsession_autocorrelation_coefficient[piid] =                       \
-                        pilot_subsession_autocorrelation_coefficient(data,                            \
-                                size, prefix##_optimal_subsession_size[piid],                         \
-                                prefix##_mean[piid], analytical_result_.readings_mean_method[piid]);  \
-                prefix##_optimal_subsession_ci_width[piid] =                                          \
-                        pilot_subsession_confidence_interval(data,                                    \
-                                size, prefix##_optimal_subsession_size[piid],                         \
-                                confidence_level_, analytical_result_.readings_mean_method[piid],     \
-                                analytical_result_.readings_ci_type[piid]);                           \
-                ci = prefix##_optimal_subsession_ci_width[piid];                                      \
-                cif_low = format_reading(piid, sm - ci/2);                                            \
-                cif_high = format_reading(piid, sm + ci/2);                                           \
-                prefix##_optimal_subsession_ci_width_formatted[piid] = abs(cif_high - cif_low);       \
-            } else {                                                                                  \
-                prefix##_optimal_subsession_size[piid] = -1;                                          \
-            }
+        prefix##_mean[piid] = pilot_subsession_mean(data,                                         \
+                size, analytical_result_.readings_mean_method[piid]);                             \
+        sm = prefix##_mean[piid];                                                                 \
+        prefix##_mean_formatted[piid] = format_reading(piid, sm);                                 \
+        prefix##_var[piid] = pilot_subsession_var(data,                                           \
+                size,                                                                             \
+                1,                                                                                \
+                sm,                                                                               \
+                analytical_result_.readings_mean_method[piid]);                                   \
+        var_rt = prefix##_var[piid] / sm;                                                         \
+        prefix##_var_formatted[piid] = prefix##_mean_formatted[piid] * var_rt;                    \
+        prefix##_autocorrelation_coefficient[piid] =                                              \
+                pilot_subsession_autocorrelation_coefficient(data,                                \
+                        size, 1, prefix##_mean[piid],                                             \
+                        analytical_result_.readings_mean_method[piid]);                           \
+        prefix##_required_sample_size[piid] = _calc_required_num_of_readings(this,                \
+                data, size, &q,                                                                   \
+                analytical_result_.readings_mean_method[piid],                                    \
+                analytical_result_.readings_ci_type[piid]);                                       \
+        if (prefix##_required_sample_size[piid] > 0) {                                            \
+            prefix##_optimal_subsession_size[piid] = q;                                           \
+            prefix##_optimal_subsession_var[piid] =                                               \
+                    pilot_subsession_var(data, size,                                              \
+                            prefix##_optimal_subsession_size[piid], prefix##_mean[piid],          \
+                            analytical_result_.readings_mean_method[piid]);                       \
+            subsession_var_rt = prefix##_optimal_subsession_var[piid] / sm;                       \
+            prefix##_optimal_subsession_var_formatted[piid] = prefix##_mean_formatted[piid] * subsession_var_rt; \
+            prefix##_optimal_subsession_autocorrelation_coefficient[piid] =                       \
+                    pilot_subsession_autocorrelation_coefficient(data,                            \
+                            size, prefix##_optimal_subsession_size[piid],                         \
+                            prefix##_mean[piid], analytical_result_.readings_mean_method[piid]);  \
+            prefix##_optimal_subsession_ci_width[piid] =                                          \
+                    pilot_subsession_confidence_interval(data,                                    \
+                            size, prefix##_optimal_subsession_size[piid],                         \
+                            confidence_level_, analytical_result_.readings_mean_method[piid],     \
+                            analytical_result_.readings_ci_type[piid]);                           \
+            ci = prefix##_optimal_subsession_ci_width[piid];                                      \
+            cif_low = format_reading(piid, sm - ci/2);                                            \
+            cif_high = format_reading(piid, sm + ci/2);                                           \
+            prefix##_optimal_subsession_ci_width_formatted[piid] = abs(cif_high - cif_low);       \
+        } else {                                                                                  \
+            prefix##_optimal_subsession_size[piid] = -1;                                          \
+        }
 
-            // Dominant segment analysis
-            ANALYZE_READINGS(analytical_result_.readings, readings_[piid].data() + analytical_result_.readings_last_changepoint[piid],
-                             readings_[piid].size() - analytical_result_.readings_last_changepoint[piid])
-            // Raw data analysis
-            ANALYZE_READINGS(analytical_result_.readings_raw, readings_[piid].data(), readings_[piid].size())
+        // Dominant segment analysis
+        ANALYZE_READINGS(analytical_result_.readings, readings_[piid].data() + analytical_result_.readings_last_changepoint[piid],
+                         readings_[piid].size() - analytical_result_.readings_last_changepoint[piid])
+        // Raw data analysis
+        ANALYZE_READINGS(analytical_result_.readings_raw, readings_[piid].data(), readings_[piid].size())
 #undef ANALYZE_READINGS
-        } /* if (analytical_result_.readings_num[piid] >= 2) */
-
-        // Unit readings analysis
-        double sm = unit_readings_mean(piid);
-        analytical_result_.unit_readings_num[piid] = total_num_of_unit_readings_[piid];
-        if (0 == total_num_of_unit_readings_[piid]) {
-            // no data for the following calculation
-            continue;
-        }
-        analytical_result_.unit_readings_mean_method[piid] = pi_info_[piid].unit_reading_mean_method;
-        analytical_result_.unit_readings_mean[piid] = sm;
-        analytical_result_.unit_readings_mean_formatted[piid] = format_unit_reading(piid, sm);
-        analytical_result_.unit_readings_var[piid] = unit_readings_var(piid, 1);
-        double var_rt = analytical_result_.unit_readings_var[piid] / sm;
-        analytical_result_.unit_readings_var_formatted[piid] = var_rt * analytical_result_.unit_readings_mean_formatted[piid];
-        analytical_result_.unit_readings_autocorrelation_coefficient[piid] = unit_readings_autocorrelation_coefficient(piid, 1, ARITHMETIC_MEAN);
-        size_t q;
+    } /* if (analytical_result_.readings_num[piid] >= 2) */
+}
 
-        // We already use our own _calc_required_num_of_readings() no matter if calc_required_unit_readings_func_ is set because
-        // the latter may use our calculation as an input.
-        if ((analytical_result_.unit_readings_required_sample_size[piid] =
-                _calc_required_num_of_readings(this, pilot_pi_unit_readings_iter_t(this, piid),
-                        total_num_of_unit_readings_[piid], &q, ARITHMETIC_MEAN, SAMPLE_MEAN)) < 0) {
-            analytical_result_.unit_readings_optimal_subsession_size[piid] = -1;
-        } else {
-            analytical_result_.unit_readings_optimal_subsession_size[piid] = q;
-            analytical_result_.unit_readings_optimal_subsession_var[piid] = unit_readings_var(piid, q);
-            double subsession_var_rt = analytical_result_.unit_readings_optimal_subsession_var[piid] / sm;
-            analytical_result_.unit_readings_optimal_subsession_var_formatted[piid] = subsession_var_rt * analytical_result_.unit_readings_mean_formatted[piid];
-            analytical_result_.unit_readings_optimal_subsession_autocorrelation_coefficient[piid] = unit_readings_autocorrelation_coefficient(piid, q, ARITHMETIC_MEAN);
-            analytical_result_.unit_readings_optimal_subsession_ci_width[piid] =
-                    pilot_subsession_confidence_interval(pilot_pi_unit_readings_iter_t(this, piid), total_num_of_unit_readings_[piid], q, .95, ARITHMETIC_MEAN, SAMPLE_MEAN);
-            double ci = analytical_result_.unit_readings_optimal_subsession_ci_width[piid];
-            double cif_low = format_unit_reading(piid, sm - ci / 2);
-            double cif_high = format_unit_reading(piid, sm + ci / 2);
-            analytical_result_.unit_readings_optimal_subsession_ci_width_formatted[piid] = abs(cif_high - cif_low);
-        }
+void pilot_workload_t::refresh_unit_readings_analysis(size_t piid) const {
+    double sm = unit_readings_mean(piid);
+    analytical_result_.unit_readings_num[piid] = total_num_of_unit_readings_[piid];
+    if (0 == total_num_of_unit_readings_[piid]) {
+        // no data for the following calculation
+        return;
+    }
+    analytical_result_.unit_readings_mean_method[piid] = pi_info_[piid].unit_reading_mean_method;
+    analytical_result_.unit_readings_mean[piid] = sm;
+    analytical_result_.unit_readings_mean_formatted[piid] = format_unit_reading(piid, sm);
+    analytical_result_.unit_readings_var[piid] = unit_readings_var(piid, 1);
+    double var_rt = analytical_result_.unit_readings_var[piid] / sm;
+    analytical_result_.unit_readings_var_formatted[piid] = var_rt * analytical_result_.unit_readings_mean_formatted[piid];
+    analytical_result_.unit_readings_autocorrelation_coefficient[piid] = unit_readings_autocorrelation_coefficient(piid, 1, ARITHMETIC_MEAN);
+    size_t q;
 
-        // Let calc_required_unit_readings_func_ overwrite our own calculation if the hook has been set
-        if (calc_required_unit_readings_func_) {
-            analytical_result_.unit_readings_required_sample_size[piid] = calc_required_unit_readings_func_(this, piid);
-            analytical_result_.unit_readings_required_sample_size_is_from_user[piid] = 1;
-        } else {
-            analytical_result_.unit_readings_required_sample_size_is_from_user[piid] = 0;
-        }
+    // We already use our own _calc_required_num_of_readings() no matter if calc_required_unit_readings_func_ is set because
+    // the latter may use our calculation as an input.
+    if ((analytical_result_.unit_readings_required_sample_size[piid] =
+            _calc_required_num_of_readings(this, pilot_pi_unit_readings_iter_t(this, piid),
+                    total_num_of_unit_readings_[piid], &q, ARITHMETIC_MEAN, SAMPLE_MEAN)) < 0) {
+        analytical_result_.unit_readings_optimal_subsession_size[piid] = -1;
+    } else {
+        analytical_result_.unit_readings_optimal_subsession_size[piid] = q;
+        analytical_result_.unit_readings_optimal_subsession_var[piid] = unit_readings_var(piid, q);
+        double subsession_var_rt = analytical_result_.unit_readings_optimal_subsession_var[piid] / sm;
+        analytical_result_.unit_readings_optimal_subsession_var_formatted[piid] = subsession_var_rt * analytical_result_.unit_readings_mean_formatted[piid];
+        analytical_result_.unit_readings_optimal_subsession_autocorrelation_coefficient[piid] = unit_readings_autocorrelation_coefficient(piid, q, ARITHMETIC_MEAN);
+        analytical_result_.unit_readings_optimal_subsession_ci_width[piid] =
+                pilot_subsession_confidence_interval(pilot_pi_unit_readings_iter_t(this, piid), total_num_of_unit_readings_[piid], q, .95, ARITHMETIC_MEAN, SAMPLE_MEAN);
+        double ci = analytical_result_.unit_readings_optimal_subsession_ci_width[piid];
+        double cif_low = format_unit_reading(piid, sm - ci / 2);
+        double cif_high = format_unit_reading(piid, sm + ci / 2);
+        analytical_result_.unit_readings_optimal_subsession_ci_width_formatted[piid] = abs(cif_high - cif_low);
+    }
+
+    // Let calc_required_unit_readings_func_ overwrite our own calculation if the hook has been set
+    if (calc_required_unit_readings_func_) {
+        analytical_result_.unit_readings_required_sample_size[piid] = calc_required_unit_readings_func_(this, piid);
+        analytical_result_.unit_readings_required_sample_size_is_from_user[piid] = 1;
+    } else {
+        analytical_result_.unit_readings_required_sample_size_is_from_user[piid] = 0;
     }
-    // WPS analysis data
-    refresh_wps_analysis_results();
 }
 
 pilot_round_info_t* pilot_workload_t::round_info(size_t round, pilot_round_info_t *rinfo) const {
@@ -434,6 +786,24 @@ char* pilot_workload_t::text_round_summary(size_t round) const {
         s << "warm-up phase length: " << ri->warm_up_phase_lens[piid] << " units" << endl;
     }
     pilot_free_round_info(ri);
+    if (analytical_result_.planner_has_data) {
+        s << endl;
+        s << "  SESSION PLANNER" << endl;
+        s << "==================================================" << endl;
+        s << "round fixed cost: " << analytical_result_.planner_round_fixed_cost << " seconds" << endl;
+        s << "work amount cost: " << analytical_result_.planner_work_amount_cost << " seconds" << endl;
+        s << "planned rounds: " << analytical_result_.planner_planned_rounds << " x work amount "
+          << analytical_result_.planner_planned_work_amount << endl;
+        s << "predicted remaining time: " << analytical_result_.planner_predicted_remaining_time << " seconds" << endl;
+        if (0 != analytical_result_.planner_num_of_predictions) {
+            s << "round duration prediction error: " << analytical_result_.planner_round_duration_error * 100
+              << "% (" << analytical_result_.planner_num_of_predictions << " rounds)" << endl;
+        }
+        if (analytical_result_.planner_remaining_time_error >= 0) {
+            s << "remaining time prediction error: " << analytical_result_.planner_remaining_time_error * 100 << "%" << endl;
+        }
+    }
+
     size_t len = s.str().size() + 1;
     char *result = new char[len];
     memcpy(result, s.str().c_str(), len);
@@ -537,23 +907,49 @@ char* pilot_workload_t::text_workload_summary(void) const {
     return result;
 }
 
-int pilot_workload_t::set_wps_analysis(bool enabled, bool wps_must_satisfy) {
+int pilot_workload_t::set_wps_analysis(bool enabled, bool wps_must_satisfy, pilot_wps_schedule_t schedule) {
     if (wps_must_satisfy && !enabled) {
         fatal_log << __func__ << "(): WPS analysis is not enabled yet satisfaction is required";
         return ERR_WRONG_PARAM;
     }
     if (enabled && max_work_amount_ <= init_work_amount_) {
-        fatal_log << __func__ << str(format("(): It is impossible to do WPS analysis when init_work_amount (%1%) == max_work_amount (%2%). Consider increasing max_work_amount.")
-                % init_work_amount_ % max_work_amount_);
+        fatal_log << __func__ << format("(): It is impossible to do WPS analysis when init_work_amount (%1%) == max_work_amount (%2%). Consider increasing max_work_amount.")
+                % init_work_amount_ % max_work_amount_;
         return ERR_WRONG_PARAM;
     }
     wps_must_satisfy_ = wps_must_satisfy;
+    wps_schedule_ = schedule;
     load_runtime_analysis_plugin(calc_next_round_work_amount_from_wps, enabled);
+    wps_analysis_rounds_ = -1;
     return 0;
 }
 
 void pilot_workload_t::refresh_wps_analysis_results(void) const {
-    if (rounds_ < 3) {
+    if (ssize_t(rounds_) == wps_analysis_rounds_) {
+        debug_log << __func__ << "(): no need to refresh WPS analysis results";
+        return;
+    }
+    wps_analysis_rounds_ = rounds_;
+    // rejected rounds are left out. A round can become rejected when a later
+    // round is the first to have readings, and then the running regression
+    // has to start over.
+    vector<size_t> wps_rounds;
+    for (size_t r = 0; r < rounds_; ++r) {
+        if (!round_is_rejected(r)) wps_rounds.push_back(r);
+    }
+    if (wps_rounds.size() < wps_rounds_.size() ||
+        !equal(wps_rounds_.begin(), wps_rounds_.end(), wps_rounds.begin())) {
+        wps_regression_.reset();
+    }
+    wps_rounds_.swap(wps_rounds);
+    wps_work_amounts_.clear();
+    wps_round_durations_.clear();
+    for (size_t r : wps_rounds_) {
+        wps_work_amounts_.push_back(round_work_amounts_[r]);
+        wps_round_durations_.push_back(round_durations_[r]);
+    }
+    const size_t n = wps_rounds_.size();
+    if (n < 3) {
         debug_log << __func__ << "(): need more than 3 rounds data for WPS analysis";
         analytical_result_.wps_has_data = false;
         return;
@@ -565,20 +961,21 @@ void pilot_workload_t::refresh_wps_analysis_results(void) const {
     }
     // calculate naive_v and its error
     size_t sum_of_work_amount =
-            accumulate(round_work_amounts_.begin(), round_work_amounts_.end(), static_cast<size_t>(0));
+            accumulate(wps_work_amounts_.begin(), wps_work_amounts_.end(), static_cast<size_t>(0));
     nanosecond_type sum_of_round_durations =
-            accumulate(round_durations_.begin(), round_durations_.end(), static_cast<nanosecond_type>(0));
+            accumulate(wps_round_durations_.begin(), wps_round_durations_.end(), static_cast<nanosecond_type>(0));
     analytical_result_.wps_harmonic_mean = double(sum_of_work_amount) / ( double(sum_of_round_durations) / ONE_SECOND );
     analytical_result_.wps_harmonic_mean_formatted = format_wps(analytical_result_.wps_harmonic_mean);
     analytical_result_.wps_naive_v_err = 0;
-    for (size_t i = 0; i < rounds_; ++i) {
-        double wa  = double(round_work_amounts_[i]);
-        double dur = double(round_durations_[i]) / ONE_SECOND;
+    for (size_t i = 0; i < n; ++i) {
+        double wa  = double(wps_work_amounts_[i]);
+        double dur = double(wps_round_durations_[i]) / ONE_SECOND;
         analytical_result_.wps_naive_v_err += pow(wa / analytical_result_.wps_harmonic_mean - dur, 2);
     }
     analytical_result_.wps_naive_v_err_percent = sqrt(analytical_result_.wps_naive_v_err) / sum_of_round_durations;
 
     // the WPS linear regression method
+    wps_regression_.sync(n, wps_work_amounts_.data(), wps_round_durations_.data());
     nanosecond_type duration_threshold;
     int r = 0;
     do {
@@ -588,18 +985,17 @@ void pilot_workload_t::refresh_wps_analysis_results(void) const {
             duration_threshold = short_round_detection_threshold_;
         }
         debug_log << __func__ << "(): round " << r << " WPS regression (duration_threshold = " << duration_threshold << ")";
-        int res = pilot_wps_warmup_removal_lr_method(round_work_amounts_.size(),
-                                                     round_work_amounts_.begin(),
-                                                     round_durations_.begin(),
-                                                     autocorrelation_coefficient_limit_,
-                                                     duration_threshold,
-                                                     &analytical_result_.wps_alpha,
-                                                     &analytical_result_.wps_v,
-                                                     &analytical_result_.wps_v_ci,
-                                                     &analytical_result_.wps_err,
-                                                     &analytical_result_.wps_err_percent,
-                                                     &analytical_result_.wps_subsession_sample_size,
-                                                     &analytical_result_.wps_optimal_subsession_size);
+        int res = wps_regression_.calc(wps_work_amounts_.data(),
+                                       wps_round_durations_.data(),
+                                       autocorrelation_coefficient_limit_,
+                                       duration_threshold,
+                                       &analytical_result_.wps_alpha,
+                                       &analytical_result_.wps_v,
+                                       &analytical_result_.wps_v_ci,
+                                       &analytical_result_.wps_err,
+                                       &analytical_result_.wps_err_percent,
+                                       &analytical_result_.wps_subsession_sample_size,
+                                       &analytical_result_.wps_optimal_subsession_size);
         if (ERR_NOT_ENOUGH_DATA == res) {
             debug_log << "Not enough data for calculating WPS warm-up removal (duration_threshold = " << duration_threshold << ")";
             analytical_result_.wps_has_data = false;
@@ -642,7 +1038,7 @@ size_t pilot_workload_t::set_min_sample_size(size_t min_sample_size) {
     size_t old_min_sample_size = min_sample_size_;
     min_sample_size_ = min_sample_size;
     // invalidate the cache because re-calculation is needed
-    analytical_result_update_time_ = chrono::steady_clock::time_point::min();
+    invalidate_analytical_result();
     return old_min_sample_size;
 }
 
@@ -686,6 +1082,7 @@ void pilot_workload_t::set_baseline(size_t piid, pilot_reading_type_t rt,
         baseline_of_unit_readings_[piid].sample_size = baseline_sample_size;
         baseline_of_unit_readings_[piid].var = baseline_var;
         baseline_of_unit_readings_[piid].set = true;
+        comparison_state_[piid] = comparison_state_t();
         break;
     case WPS_TYPE:
         fatal_log << __func__ << "(): unimplemented yet";
@@ -771,6 +1168,7 @@ int pilot_workload_t::load_baseline_file(const char *filename) {
             baseline_of_unit_readings_[piid].sample_size = ur_num;
             baseline_of_unit_readings_[piid].mean = ur_mean;
             baseline_of_unit_readings_[piid].var = ur_var;
+            comparison_state_[piid] = comparison_state_t();
             info_log << __func__ << "(): loaded unit reading baseline for PI "
                      << piid << ": mean " << ur_mean << ", sample_size "
                      << ur_num << ", var " << ur_var;
@@ -793,10 +1191,17 @@ bool pilot_workload_t::wps_enabled(void) const {
 }
 
 double pilot_workload_t::duration_to_work_amount_ratio(void) const {
-    size_t sum_of_work_amount =
-            accumulate(round_work_amounts_.begin(), round_work_amounts_.end(), static_cast<size_t>(0));
+    // the time and work amounts of rejected rounds are left out
+    size_t sum_of_work_amount = 0;
+    double session_duration = analytical_result_.session_duration;
+    for (size_t r = 0; r < rounds_; ++r) {
+        if (round_is_rejected(r))
+            session_duration -= double(round_durations_[r]) / ONE_SECOND;
+        else
+            sum_of_work_amount += round_work_amounts_[r];
+    }
 
-    return analytical_result_.session_duration / sum_of_work_amount;
+    return session_duration / sum_of_work_amount;
 }
 
 size_t pilot_workload_t::get_round_work_amount_soft_limit(void) const {
@@ -0,0 +1,259 @@
+/*
+ * wps_regression.cc: running state of the WPS linear regression
+ *
+ * Copyright (c) 2017-2019 Yan Li <yanli@tuneup.ai>. All rights reserved.
+ * The Pilot tool and library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 (not any other version) as published by the Free
+ * Software Foundation.
+ *
+ * The Pilot tool and library is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program in file lgpl-2.1.txt; if not, see
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ *
+ * Commit 033228934e11b3f86fb0a4932b54b2aeea5c803c and before were
+ * released with the following license:
+ * Copyright (c) 2015, 2016, University of California, Santa Cruz, CA, USA.
+ * Created by Yan Li <yanli@tuneup.ai>,
+ * Department of Computer Science, Baskin School of Engineering.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Storage Systems Research Center, the
+ *       University of California, nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OF THE UNIVERSITY OF CALIFORNIA BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "common.h"
+#include "wps_regression.hpp"
+
+using namespace std;
+
+namespace pilot {
+
+void pilot_wps_subsession_state_t::add(size_t work_amount, nanosecond_type round_duration) {
+    double v = static_cast<double>(work_amount) / static_cast<double>(round_duration);
+    partial_inv_naive_v_sum += 1.0 / v;
+    partial_work_amount += double(work_amount);
+    partial_duration += double(round_duration);
+    if (++partial_n != q) {
+        return;
+    }
+    // harmonic mean of the subsession
+    double m = static_cast<double>(q) / partial_inv_naive_v_sum;
+    naive_v.add(m, m);
+    if (h > 0) {
+        naive_v_lag.add(last_naive_v, m);
+    }
+    last_naive_v = m;
+    totals.add(partial_work_amount, partial_duration);
+    ++h;
+    partial_n = 0;
+    partial_inv_naive_v_sum = 0;
+    partial_work_amount = 0;
+    partial_duration = 0;
+}
+
+double pilot_wps_subsession_state_t::autocorrelation_coefficient(double sample_mean) const {
+    if (h < 2) {
+        return 1;
+    }
+    // move the centered sums from the running means to sample_mean
+    double var = (naive_v.x_m2 + h * pow(naive_v.x_mean - sample_mean, 2)) / (h - 1);
+    double cov = (naive_v_lag.xy_m2 +
+                  (h - 1) * (naive_v_lag.x_mean - sample_mean) * (naive_v_lag.y_mean - sample_mean)) / (h - 1);
+    double res = cov / var;
+    // res can be NaN when the variance is 0, in this case we just return 1,
+    // which means the result has high autocorrelation.
+    if (std::isnan(res))
+        return 1;
+    else
+        return res;
+}
+
+void pilot_wps_bucket_t::add(size_t round, size_t work_amount, nanosecond_type round_duration) {
+    rounds.push_back(round);
+    inv_naive_v_sum += 1.0 / (static_cast<double>(work_amount) / static_cast<double>(round_duration));
+    work_amount_sum += double(work_amount);
+    for (auto &s : subsessions) {
+        s.add(work_amount, round_duration);
+    }
+}
+
+void pilot_wps_regression_t::reset(void) {
+    round_durations_.clear();
+    all_rounds_ = pilot_running_moments_t();
+    buckets_.clear();
+}
+
+void pilot_wps_regression_t::sync(size_t rounds, const size_t *round_work_amounts,
+                                  const nanosecond_type *round_durations) {
+    if (rounds < this->rounds()) {
+        reset();
+    }
+    for (size_t i = this->rounds(); i < rounds; ++i) {
+        round_durations_.insert(round_durations[i]);
+        all_rounds_.add(double(round_work_amounts[i]), double(round_durations[i]));
+        for (auto &b : buckets_) {
+            if (round_durations[i] > b.duration_threshold) {
+                b.add(i, round_work_amounts[i], round_durations[i]);
+            }
+        }
+    }
+}
+
+pilot_wps_bucket_t& pilot_wps_regression_t::get_bucket(const size_t *round_work_amounts,
+                                                       const nanosecond_type *round_durations,
+                                                       nanosecond_type duration_threshold) {
+    for (auto &b : buckets_) {
+        // the buckets are the same if no round duration lies in (lo, hi]
+        nanosecond_type lo = min(b.duration_threshold, duration_threshold);
+        nanosecond_type hi = max(b.duration_threshold, duration_threshold);
+        auto it = round_durations_.upper_bound(lo);
+        if (round_durations_.end() == it || *it > hi) {
+            b.last_used = ++tick_;
+            return b;
+        }
+    }
+
+    if (buckets_.size() == kMaxBuckets) {
+        buckets_.erase(min_element(buckets_.begin(), buckets_.end(),
+            [](const pilot_wps_bucket_t &a, const pilot_wps_bucket_t &b) { return a.last_used < b.last_used; }));
+    }
+    buckets_.emplace_back(duration_threshold);
+    pilot_wps_bucket_t &b = buckets_.back();
+    for (size_t i = 0; i < rounds(); ++i) {
+        if (round_durations[i] > duration_threshold) {
+            b.add(i, round_work_amounts[i], round_durations[i]);
+        }
+    }
+    b.last_used = ++tick_;
+    return b;
+}
+
+pilot_wps_subsession_state_t& pilot_wps_regression_t::get_subsession(pilot_wps_bucket_t &b, size_t q,
+                                                                     const size_t *round_work_amounts,
+                                                                     const nanosecond_type *round_durations) {
+    while (b.subsessions.size() < q) {
+        b.subsessions.emplace_back(b.subsessions.size() + 1);
+        pilot_wps_subsession_state_t &s = b.subsessions.back();
+        for (size_t i : b.rounds) {
+            s.add(round_work_amounts[i], round_durations[i]);
+        }
+    }
+    return b.subsessions[q - 1];
+}
+
+int pilot_wps_regression_t::calc(const size_t *round_work_amounts, const nanosecond_type *round_durations,
+                                 float autocorrelation_coefficient_limit, nanosecond_type duration_threshold,
+                                 double *wps_alpha, double *wps_v, double *wps_v_ci,
+                                 double *ssr_out, double *ssr_percent_out,
+                                 size_t *subsession_sample_size, size_t *out_q) {
+    // rounds that are shorter than duration_threshold are filtered out
+    pilot_wps_bucket_t &b = get_bucket(round_work_amounts, round_durations, duration_threshold);
+    const size_t n = b.rounds.size();
+    if (n < 3) {
+        debug_log << __func__ << "() doesn't have enough samples after filtering using duration threshold";
+        return ERR_NOT_ENOUGH_DATA;
+    }
+
+    // then check for auto-correlation of the naive v of each round (see
+    // pilot_optimal_subsession_size())
+    const double sm = static_cast<double>(n) / b.inv_naive_v_sum;
+    size_t q = 0;
+    for (size_t i = 1; i != n / 3 + 1; ++i) {
+        double cov = get_subsession(b, i, round_work_amounts, round_durations).autocorrelation_coefficient(sm);
+        trace_log << __func__ << "(): subsession size: " << i << ", auto. cor. coef.: " << cov;
+        if (std::abs(cov) <= autocorrelation_coefficient_limit) {
+            q = i;
+            break;
+        }
+    }
+    if (0 == q) {
+        debug_log << __func__ << "() samples' autocorrelation coefficient too high; need more samples";
+        return ERR_NOT_ENOUGH_DATA;
+    }
+    if (out_q) { *out_q = q; }
+    debug_log << "WPS analysis: optimal subsession size (q) = " << q;
+    const pilot_wps_subsession_state_t &s = b.subsessions[q - 1];
+    const size_t h = s.h;
+    if (subsession_sample_size) *subsession_sample_size = h;
+    if (h < 3) {
+        debug_log << __func__ << "() doesn't have enough samples (<3) after subsession grouping";
+        return ERR_NOT_ENOUGH_DATA;
+    }
+
+    // regression of the subsession durations on the subsession work amounts
+    const pilot_running_moments_t &m = s.totals;
+    const double wpns_inv_v = m.xy_m2 / m.x_m2;     // invert v of work amount per nanosecond
+    const double alpha_ns = m.y_mean - wpns_inv_v * m.x_mean;
+    const double wps_inv_v = wpns_inv_v / ONE_SECOND;
+    *wps_alpha = alpha_ns / ONE_SECOND;
+    *wps_v = ONE_SECOND / wpns_inv_v;
+
+    // SSR of the least-squares fit
+    const double sub_session_ssr = max(0.0, m.y_m2 - m.xy_m2 * wpns_inv_v) / pow(double(ONE_SECOND), 2);
+    debug_log << __func__ << "(): sub_session_ssr: " << sub_session_ssr;
+    // SSR of the fit over all rounds, including the filtered ones
+    const pilot_running_moments_t &a = all_rounds_;
+    const double c = alpha_ns + wpns_inv_v * a.x_mean - a.y_mean;
+    const double ssr = max(0.0, a.n * c * c + wpns_inv_v * wpns_inv_v * a.x_m2
+                                - 2 * wpns_inv_v * a.xy_m2 + a.y_m2) / pow(double(ONE_SECOND), 2);
+    const double dur_sum = a.n * a.y_mean / ONE_SECOND;
+    debug_log << __func__ << "(): ssr: " << ssr;
+    if (ssr_out) *ssr_out = ssr;
+    if (ssr_percent_out) *ssr_percent_out = sqrt(ssr) / dur_sum;
+
+    double sigma_sqr = sub_session_ssr / (h - 2);
+    // pilot_subsession_var() of the work amounts, which uses the subsession means
+    const double wa_mean = b.work_amount_sum / n;
+    const double wa_var = (m.x_m2 / (q * q) + h * pow(m.x_mean / q - wa_mean, 2)) / (h - 1);
+    double sum_var = wa_var * (n - 1);
+    double std_err_v = sqrt(sigma_sqr / sum_var);
+    double inv_v_ci = 2 * std_err_v;
+    // inv_v - inv_v_ci might be negative so we have to use abs() here
+    *wps_v_ci = std::abs( 1.0 / (wps_inv_v - inv_v_ci) - 1.0 / (wps_inv_v + inv_v_ci) );
+    debug_log << __func__ << "(): result wps_alpha " << *wps_alpha << ", wps_v " << *wps_v << ", wps_v_ci " << *wps_v_ci;
+    return 0;
+}
+
+int pilot_wps_warmup_removal_lr_method(size_t rounds, const size_t *round_work_amounts,
+        const nanosecond_type *round_durations,
+        float autocorrelation_coefficient_limit, nanosecond_type duration_threshold,
+        double *wps_alpha, double *wps_v,
+        double *wps_v_ci, double *ssr_out, double *ssr_percent_out,
+        size_t *subsession_sample_size, size_t *out_q) {
+    pilot_wps_regression_t r;
+    r.sync(rounds, round_work_amounts, round_durations);
+    return r.calc(round_work_amounts, round_durations, autocorrelation_coefficient_limit,
+                  duration_threshold, wps_alpha, wps_v, wps_v_ci, ssr_out, ssr_percent_out,
+                  subsession_sample_size, out_q);
+}
+
+} // namespace pilot